@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lexer.h"
+
+#define CORPUS_BYTES (8 * 1024 * 1024)
+#define RUNS 5
+
+// keywords, identifiers that share a length and first letter with a keyword,
+// and plain identifiers, roughly the mix found in declaration heavy code
+static const char *WORDS[] = {
+    "int", "char", "unsigned", "long", "static", "const", "return", "struct",
+    "if", "else", "while", "for", "void", "sizeof", "typedef", "enum",
+    "index", "count", "buffer", "result", "node", "value", "length", "offset",
+    "iff", "doit", "intx", "chars", "unsign", "returns", "structs", "volatiles",
+    "lexer", "parser", "token", "source", "current", "capacity", "tree", "i",
+};
+
+static const int WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+static char *make_corpus(size_t size) {
+    char *corpus = malloc(size + 1);
+    unsigned int seed = 12345;
+
+    size_t written = 0;
+    while (1) {
+        seed = seed * 1103515245 + 12345;
+        const char *word = WORDS[(seed >> 16) % WORD_COUNT];
+        size_t len = strlen(word);
+
+        if (written + len + 1 > size) break;
+
+        memcpy(corpus + written, word, len);
+        written += len;
+        corpus[written++] = (seed >> 8) % 8 == 0 ? '\n' : ' ';
+    }
+    memset(corpus + written, ' ', size - written);
+    corpus[size] = '\0';
+
+    return corpus;
+}
+
+int main(void) {
+    char *corpus = make_corpus(CORPUS_BYTES);
+
+    double best = 0;
+    int token_count = 0;
+
+    for (int i = 0; i < RUNS; i++) {
+        Lexer *lexer = init_lexer(corpus, 0);
+
+        clock_t start = clock();
+        tokenize(lexer);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        if (i == 0 || seconds < best) best = seconds;
+        token_count = lexer->tokens.count;
+
+        free_lexer(lexer);
+    }
+
+    printf("identifier heavy corpus: %d bytes, %d tokens\n", CORPUS_BYTES, token_count);
+    printf("  best of %d: %.3f s, %.1f MB/s, %.1f ns/token\n",
+        RUNS, best, CORPUS_BYTES / best / (1024 * 1024), best * 1e9 / token_count);
+
+    free(corpus);
+    return 0;
+}
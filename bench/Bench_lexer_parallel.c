@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lexer.h"
+
+#define CORPUS_BYTES (128 * 1024 * 1024)
+#define RUNS 3
+
+static const char *LINES[] = {
+    "static int counter_value = 0x1F + 12; /* comment */ // trailing\n",
+    "    if (index < length && buffer[index] != '\\n') { total += table[index]; }\n",
+    "    \"a string table entry with an \\\"escape\\\" in it\",\n",
+    "/* generated, do not edit */\n",
+};
+
+static const int LINE_COUNT = sizeof(LINES) / sizeof(LINES[0]);
+
+static char *make_corpus(size_t size) {
+    char *corpus = malloc(size + 1);
+    unsigned int seed = 12345;
+
+    size_t written = 0;
+    while (1) {
+        seed = seed * 1103515245 + 12345;
+        const char *line = LINES[(seed >> 16) % LINE_COUNT];
+        size_t len = strlen(line);
+
+        if (written + len > size) break;
+
+        memcpy(corpus + written, line, len);
+        written += len;
+    }
+    memset(corpus + written, ' ', size - written);
+    corpus[size] = '\0';
+
+    return corpus;
+}
+
+// wall time, clock() would add up the time of every thread
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run(const char *corpus, int threads) {
+    double best = 0;
+
+    for (int i = 0; i < RUNS; i++) {
+        Lexer *lexer = init_lexer(corpus, 0);
+
+        double start = now();
+        tokenize_parallel(lexer, threads);
+        double seconds = now() - start;
+
+        if (i == 0 || seconds < best) best = seconds;
+        free_lexer(lexer);
+    }
+
+    return best;
+}
+
+int main(void) {
+    char *corpus = make_corpus(CORPUS_BYTES);
+
+    printf("parallel lexing: %d bytes\n", CORPUS_BYTES);
+
+    double serial = run(corpus, 1);
+    for (int threads = 1; threads <= 16; threads *= 2) {
+        double best = threads == 1 ? serial : run(corpus, threads);
+        printf("  %2d threads best of %d: %.3f s, %.1f MB/s, %.2fx\n",
+            threads, RUNS, best, CORPUS_BYTES / best / (1024 * 1024), serial / best);
+    }
+
+    free(corpus);
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lexer.h"
+#include "scan.h"
+
+#define CORPUS_BYTES (8 * 1024 * 1024)
+#define RUNS 5
+
+// the shape of machine generated sources, long comment banners, indented
+// blocks and tables of string literals
+static const char *LINES[] = {
+    "/* ------------------------------------------------------------------------\n"
+    " * generated table, do not edit, regenerate with the table tool instead of\n"
+    " * changing the entries by hand\n"
+    " * ---------------------------------------------------------------------- */\n",
+    "                                        \"a fairly long string table entry of text\",\n",
+    "    \"escaped \\t entry with a \\n newline and a \\\" quote inside of it\",\n",
+    "        // a trailing line comment that runs for most of the width of the line\n",
+    "    int value = 1;\n",
+};
+
+static const int LINE_COUNT = sizeof(LINES) / sizeof(LINES[0]);
+
+static char *make_corpus(size_t size) {
+    char *corpus = malloc(size + 1);
+    unsigned int seed = 12345;
+
+    size_t written = 0;
+    while (1) {
+        seed = seed * 1103515245 + 12345;
+        const char *line = LINES[(seed >> 16) % LINE_COUNT];
+        size_t len = strlen(line);
+
+        if (written + len > size) break;
+
+        memcpy(corpus + written, line, len);
+        written += len;
+    }
+    memset(corpus + written, ' ', size - written);
+    corpus[size] = '\0';
+
+    return corpus;
+}
+
+static void run(const char *corpus, const char *name) {
+    double best = 0;
+
+    for (int i = 0; i < RUNS; i++) {
+        Lexer *lexer = init_lexer(corpus, 0);
+
+        clock_t start = clock();
+        tokenize(lexer);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        if (i == 0 || seconds < best) best = seconds;
+        free_lexer(lexer);
+    }
+
+    printf("  %-6s best of %d: %.3f s, %.1f MB/s\n", name, RUNS, best, CORPUS_BYTES / best / (1024 * 1024));
+}
+
+int main(void) {
+    char *corpus = make_corpus(CORPUS_BYTES);
+
+    printf("comment and string heavy corpus: %d bytes\n", CORPUS_BYTES);
+
+    const char *names[] = { "scalar", "sse2", "avx2" };
+    for (ScanLevel level = SCAN_SCALAR; level <= SCAN_AVX2; level++) {
+        if (scan_set_level(level)) run(corpus, names[level]);
+    }
+
+    free(corpus);
+    return 0;
+}
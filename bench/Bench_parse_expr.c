@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lexer.h"
+#include "ast.h"
+
+#define CORPUS_BYTES (8 * 1024 * 1024)
+#define RUNS 5
+
+// statements that are nearly all operators and operands
+static const char *LINES[] = {
+    "return a * (b + c) - d / e % f << 2 >= g && h != i || j ? k : l;\n",
+    "x += -y[i + 1] * ~z + (w & 0xFF) ^ (v | 0b1010) >> 3;\n",
+    "return f(a + 1, b * 2, g(c, d - e)) + (int)p * sizeof(q);\n",
+    "return ((((a + b) * (c + d)) - ((e - f) / (g + h))) % 17) == 0;\n",
+    "n = !a && !b || c < d && d <= e || e > f && f >= g;\n",
+};
+
+static const int LINE_COUNT = sizeof(LINES) / sizeof(LINES[0]);
+
+static char *make_corpus(size_t size) {
+    char *corpus = malloc(size + 1);
+    unsigned int seed = 12345;
+
+    size_t written = 0;
+    while (1) {
+        seed = seed * 1103515245 + 12345;
+        const char *line = LINES[(seed >> 16) % LINE_COUNT];
+        size_t len = strlen(line);
+
+        if (written + len > size) break;
+
+        memcpy(corpus + written, line, len);
+        written += len;
+    }
+    memset(corpus + written, ' ', size - written);
+    corpus[size] = '\0';
+
+    return corpus;
+}
+
+int main(void) {
+    char *corpus = make_corpus(CORPUS_BYTES);
+
+    Lexer *lexer = init_lexer(corpus, 0);
+    tokenize(lexer);
+
+    printf("expression heavy corpus: %d bytes, %d tokens\n", CORPUS_BYTES, lexer->tokens.count);
+
+    double best = 0;
+    int statements = 0;
+    for (int i = 0; i < RUNS; i++) {
+        Parser *parser = init_parser(lexer, 0, "");
+
+        clock_t start = clock();
+        parse_ast(parser);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        if (i == 0 || seconds < best) best = seconds;
+        statements = parser->node_count;
+        free_parser(parser);
+    }
+
+    printf("  parse best of %d: %.3f s, %d statements, %.1f M tokens/s\n",
+        RUNS, best, statements, lexer->tokens.count / best / 1e6);
+
+    free_lexer(lexer);
+    free(corpus);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ppd.h"
+#include "intern.h"
+#include "incpath.h"
+#include "source.h"
+
+// a chain of headers each including the next half way through, every level
+// is read while all the ones above it are part way done
+#define DEPTH 150
+#define LINES_PER_HEADER 2000
+#define RUNS 5
+
+static void header_path(char *path, int size, int level) {
+    snprintf(path, size, "build/bench/include_%d.h", level);
+}
+
+static void write_headers() {
+    char path[64];
+
+    for (int level = 0; level < DEPTH; level++) {
+        header_path(path, sizeof(path), level);
+        FILE *fptr = fopen(path, "wb");
+
+        for (int line = 0; line < LINES_PER_HEADER; line++) {
+            if (line == LINES_PER_HEADER / 2 && level + 1 < DEPTH) {
+                // quoted names are found next to the header including them
+                fprintf(fptr, "#include \"include_%d.h\"\n", level + 1);
+            }
+            fprintf(fptr, "static int value_%d_%d = %d + SCALE; // level %d\n", level, line, line, level);
+        }
+
+        fclose(fptr);
+    }
+}
+
+static void remove_headers() {
+    char path[64];
+
+    for (int level = 0; level < DEPTH; level++) {
+        header_path(path, sizeof(path), level);
+        remove(path);
+    }
+}
+
+static double run(const char *source, int *length) {
+    double best = 0;
+
+    for (int i = 0; i < RUNS; i++) {
+        clock_t start = clock();
+        const char *processed = preprocess(source, strlen(source), length);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        if (i == 0 || seconds < best) best = seconds;
+        free((char *)processed);
+        free_include_paths();
+        free_interner();
+    }
+
+    return best;
+}
+
+int main(void) {
+    write_headers();
+
+    char source[128];
+    char first[64];
+    header_path(first, sizeof(first), 0);
+    snprintf(source, sizeof(source), "#define SCALE 2\n#include \"%s\"\nint main() { return 0; }\n", first);
+
+    int length;
+    double best = run(source, &length);
+
+    printf("include chain: %d headers deep, %d bytes out\n", DEPTH, length);
+    printf("  best of %d: %.3f s, %.1f MB/s\n", RUNS, best, length / best / (1024 * 1024));
+
+    free_source_cache();
+    remove_headers();
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ppd.h"
+#include "strbuf.h"
+#include "intern.h"
+#include "incpath.h"
+
+// a define between every expansion, as an x-macro list redefines its item
+// macro around each include. every define drops the cached expansions, so
+// this times how much dropping them costs
+#define LINES 40000
+#define RUNS 5
+
+static double run(const char *source, int length, int *processed_length) {
+    double best = 0;
+
+    for (int i = 0; i < RUNS; i++) {
+        clock_t start = clock();
+        const char *processed = preprocess(source, length, processed_length);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        if (i == 0 || seconds < best) best = seconds;
+        free((char *)processed);
+        free_include_paths();
+        free_interner();
+    }
+
+    return best;
+}
+
+int main(void) {
+    StrBuf with_uses;
+    StrBuf defines_only;
+    init_strbuf(&with_uses, 0);
+    init_strbuf(&defines_only, 0);
+
+    char line[64];
+    strbuf_append(&with_uses, "#define X(a) a + Y\n", 19);
+    for (int i = 0; i < LINES / 2; i++) {
+        int length = snprintf(line, sizeof(line), "#define Y %d\n", i);
+        strbuf_append(&with_uses, line, length);
+        strbuf_append(&defines_only, line, length);
+
+        strbuf_append(&with_uses, "int v = X(1);\n", 14);
+    }
+
+    int length;
+    double uses = run(with_uses.data, with_uses.length, &length);
+    double defines = run(defines_only.data, defines_only.length, &length);
+
+    printf("redefine between expansions: %d lines\n", LINES);
+    printf("  best of %d: %.3f s with expansions, %.3f s defines alone\n", RUNS, uses, defines);
+
+    free_strbuf(&with_uses);
+    free_strbuf(&defines_only);
+    return 0;
+}
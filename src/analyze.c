@@ -6,9 +6,7 @@
 #include "symtab.h"
 #include "utils.h"
 
-static void analyze_node(AstNode *node, Analyzer *analyzer);
-
-Analyzer *init_analyzer(AstNode **tree, int count) {
+Analyzer *init_analyzer(AstNode *nodes, NodeId *tree, int count) {
     Analyzer *analyzer = malloc(sizeof(Analyzer));
     if (!analyzer) {
         perror("Error allocating analyzer.");
@@ -19,22 +17,93 @@ Analyzer *init_analyzer(AstNode **tree, int count) {
     analyzer->variable_symbols->capacity = 1;
     analyzer->variable_symbols->count = 0;
     analyzer->variable_symbols->symbols = malloc(sizeof(VariableSymbol *));
+    analyzer->variable_symbols->index = (SymbolMap){0};
     analyzer->err = NO_ANALYZE_ERR;
 
+    analyzer->nodes = nodes;
     analyzer->node_count = count;
     analyzer->tree = tree;
 
+    analyzer->pending = NULL;
+    analyzer->pending_count = 0;
+    analyzer->pending_capacity = 0;
+
+    analyzer->scopes = NULL;
+    analyzer->scope_count = 0;
+    analyzer->scope_capacity = 0;
+
     return analyzer;
 }
 
 void free_analyzer(Analyzer *analyzer) {
     if (!analyzer) return;
+
+    for (int i = 0; i < analyzer->variable_symbols->count; i++) {
+        free(analyzer->variable_symbols->symbols[i]);
+    }
+    free(analyzer->variable_symbols->symbols);
+    free_symbol_map(&analyzer->variable_symbols->index);
+    free(analyzer->variable_symbols);
+
+    free(analyzer->pending);
+    free(analyzer->scopes);
     free(analyzer);
 }
 
+static void push_pending(NodeId node, Analyzer *analyzer) {
+    if (analyzer->pending_count >= analyzer->pending_capacity) {
+        analyzer->pending_capacity = analyzer->pending_capacity ? analyzer->pending_capacity * 2 : 16;
+        analyzer->pending = realloc(analyzer->pending, sizeof(NodeId) * analyzer->pending_capacity);
+    }
+    analyzer->pending[analyzer->pending_count++] = node;
+}
+
+// pushed last to first, so the statements are visited in order
+static void push_pending_list(NodeId *nodes, int count, Analyzer *analyzer) {
+    for (int i = count - 1; i >= 0; i--) {
+        push_pending(nodes[i], analyzer);
+    }
+}
+
+// the statements are visited in a scope of their own, closed by the NO_NODE
+// pushed under them
+static void push_body(NodeId *body, int count, Analyzer *analyzer) {
+    if (analyzer->scope_count >= analyzer->scope_capacity) {
+        analyzer->scope_capacity = analyzer->scope_capacity ? analyzer->scope_capacity * 2 : 16;
+        analyzer->scopes = realloc(analyzer->scopes, sizeof(int) * analyzer->scope_capacity);
+    }
+    analyzer->scopes[analyzer->scope_count++] = analyzer->variable_symbols->count;
+
+    push_pending(NO_NODE, analyzer);
+    push_pending_list(body, count, analyzer);
+}
+
+// the variables declared since the body was entered are dropped
+static void close_scope(Analyzer *analyzer) {
+    VariableSymbols *symbols = analyzer->variable_symbols;
+    int start = analyzer->scopes[--analyzer->scope_count];
+
+    while (symbols->count > start) {
+        VariableSymbol *symbol = symbols->symbols[--symbols->count];
+        symbol_map_remove(&symbols->index, symbol->identifier);
+        free(symbol);
+    }
+}
+
 static void analyze_function(AstFunctionDeclaration *func, Analyzer *analyzer) {
-    for (int i = 0; i < func->body_count; i++) {
-        analyze_node(func->body[i], analyzer);
+    push_body(func->body, func->body_count, analyzer);
+}
+
+// only the bodies are visited, as only statements are analyzed
+static void analyze_if(AstIfStatement *iff, Analyzer *analyzer) {
+    push_body(iff->else_body, iff->else_body_count, analyzer);
+    push_body(iff->body, iff->body_count, analyzer);
+}
+
+static void analyze_switch(AstSwitch *switch_stmt, Analyzer *analyzer) {
+    for (int i = switch_stmt->case_count - 1; i >= 0; i--) {
+        AstBlock *block = switch_stmt->cases[i]->block;
+        if (block) push_body(block->body, block->body_count, analyzer);
     }
 }
 
@@ -45,21 +114,17 @@ static void add_variable_symbol(AstDeclarator *var_dec, Analyzer *analyzer) {
     }
     
     VariableSymbol *symbol = malloc(sizeof(VariableSymbol));
-    symbol->identifier = strdup(var_dec->identifier);
+    symbol->identifier = var_dec->identifier;
 
+    symbol_map_put(&analyzer->variable_symbols->index, symbol->identifier, analyzer->variable_symbols->count);
     analyzer->variable_symbols->symbols[analyzer->variable_symbols->count++] = symbol;
 }
 
-static VariableSymbol *get_variable_symbol(char *symbol, Analyzer *analyzer) {
-    for (int i = 0; i < analyzer->variable_symbols->count; i++) {
-        VariableSymbol *var = analyzer->variable_symbols->symbols[i];
+static VariableSymbol *get_variable_symbol(SymbolId symbol, Analyzer *analyzer) {
+    int index = symbol_map_get(&analyzer->variable_symbols->index, symbol);
+    if (index < 0) return NULL;
 
-        if (strcmp(var->identifier, symbol) == 0) {
-            return var;
-        }
-    }
-
-    return NULL;
+    return analyzer->variable_symbols->symbols[index];
 }
 
 static void err(AnalyzerErr err, Analyzer *analyzer) {
@@ -67,26 +132,18 @@ static void err(AnalyzerErr err, Analyzer *analyzer) {
 }
 
 static void analyze_assignment(AstAssignment *assign, Analyzer *analyzer) {
-    int exists = 0;
-    for (int i = 0; i < analyzer->variable_symbols->count; i++) {
-        if (get_variable_symbol(assign->identifier, analyzer)) {
-            exists = 1;
-            break;
-        }
-    }
-
-    if (!exists) {
-        printf("Undefined identifier '%s'\n", assign->identifier);
+    if (!get_variable_symbol(assign->identifier, analyzer)) {
+        printf("Undefined identifier '%s'\n", symbol_str(assign->identifier));
         err(ANALYZE_ERR_UNDEFINED_IDENTIFIER, analyzer);
     }
 
-    analyze_node(assign->value, analyzer);
+    push_pending(assign->value, analyzer);
 }
 
 static void analyze_variable_declaration(AstVariableDeclaration *var_dec, Analyzer *analyzer) {
     for (int i = 0; i < var_dec->declarator_count; i++) {
         if (get_variable_symbol(var_dec->declarators[i]->identifier, analyzer)) {
-            printf("Redefinition of variable '%s'\n", var_dec->declarators[i]->identifier);
+            printf("Redefinition of variable '%s'\n", symbol_str(var_dec->declarators[i]->identifier));
             err(ANALYZE_ERR_REDEFINED_VARIABLE, analyzer);
             return;
         }
@@ -99,7 +156,7 @@ static void analyze_variable_declaration(AstVariableDeclaration *var_dec, Analyz
 
 static void analyze_identifier(AstIdentifier *ident, Analyzer *analyzer) {
     if (!get_variable_symbol(ident->name, analyzer)) {
-        printf("Undefined identifier '%s'\n", ident->name);
+        printf("Undefined identifier '%s'\n", symbol_str(ident->name));
         err(ANALYZE_ERR_UNDEFINED_IDENTIFIER, analyzer);
         return;
     }
@@ -114,18 +171,46 @@ static void analyze_node(AstNode *node, Analyzer *analyzer) {
         analyze_function(node->as.func, analyzer);
     }
     else if (node->type == AST_ASSIGNMENT) {
-        analyze_assignment(node->as.assign, analyzer);
+        analyze_assignment(&node->as.assign, analyzer);
     }
     else if (node->type == AST_IDENTIFIER) {
-        analyze_identifier(node->as.ident, analyzer);
+        analyze_identifier(&node->as.ident, analyzer);
+    }
+    else if (node->type == AST_IF) {
+        analyze_if(node->as.if_stmt, analyzer);
+    }
+    else if (node->type == AST_WHILE) {
+        push_body(node->as.while_stmt->body, node->as.while_stmt->body_count, analyzer);
+    }
+    else if (node->type == AST_FOR) {
+        if (node->as.for_stmt->block) push_pending(node->as.for_stmt->block, analyzer);
+    }
+    else if (node->type == AST_DO_WHILE) {
+        push_body(node->as.do_while->block->body, node->as.do_while->block->body_count, analyzer);
+    }
+    else if (node->type == AST_BLOCK) {
+        push_body(node->as.block->body, node->as.block->body_count, analyzer);
+    }
+    else if (node->type == AST_SWITCH) {
+        analyze_switch(node->as.switch_stmt, analyzer);
     }
     else {
         printf("Unknown node type '%s' in 'analyze_node'\n", ast_type_to_str(node->type));
     }
 }
 
+// the nodes still to visit are kept on analyzer->pending rather than the
+// native stack, a node pushes its children instead of analyzing them
 void analyze_ast(Analyzer *analyzer) {
-    for (int i = 0; i < analyzer->node_count; i++) {
-        analyze_node(analyzer->tree[i], analyzer);
+    push_pending_list(analyzer->tree, analyzer->node_count, analyzer);
+
+    while (analyzer->pending_count > 0) {
+        NodeId id = analyzer->pending[--analyzer->pending_count];
+        if (id == NO_NODE) {
+            close_scope(analyzer);
+            continue;
+        }
+
+        analyze_node(&analyzer->nodes[id], analyzer);
     }
 }
\ No newline at end of file
@@ -11,7 +11,9 @@ typedef enum {
 } AnalyzerErr;
 
 typedef struct {
-    AstNode        **tree;
+    // the parser's nodes, tree and pending index into it
+    AstNode         *nodes;
+    NodeId          *tree;
     int              node_count;
 
     VariableSymbols *variable_symbols;
@@ -19,10 +21,21 @@ typedef struct {
     TypedefSymbols  *typedef_symbols;
     LabelSymbols    *label_symbols;
 
+    // the nodes left to visit, the next one last. NO_NODE marks where a body
+    // ends and the variables declared in it go out of scope
+    NodeId          *pending;
+    int              pending_count;
+    int              pending_capacity;
+
+    // the variable count as each open body was entered
+    int             *scopes;
+    int              scope_count;
+    int              scope_capacity;
+
     AnalyzerErr      err;
 } Analyzer;
 
-extern Analyzer *init_analyzer(AstNode **tree, int count);
+extern Analyzer *init_analyzer(AstNode *nodes, NodeId *tree, int count);
 extern void free_analyzer(Analyzer *analyzer);
 extern void analyze_ast(Analyzer *analyzer);
 
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+// every allocation is aligned to this and preceded by its size, which
+// arena_realloc needs to copy it
+#define ARENA_ALIGN sizeof(size_t)
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t      size;
+};
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static void *map_block(size_t size) {
+#ifndef _WIN32
+    void *block = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return block == MAP_FAILED ? NULL : block;
+#else
+    return malloc(size);
+#endif
+}
+
+static void unmap_block(ArenaBlock *block) {
+#ifndef _WIN32
+    munmap(block, block->size);
+#else
+    free(block);
+#endif
+}
+
+void init_arena(Arena *arena) {
+    arena->blocks = NULL;
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->allocations = 0;
+    arena->block_count = 0;
+    arena->bytes = 0;
+}
+
+static int add_block(Arena *arena, size_t need) {
+    size_t size = align_up(sizeof(ArenaBlock)) + need;
+    if (size < ARENA_BLOCK_SIZE) size = ARENA_BLOCK_SIZE;
+
+    ArenaBlock *block = map_block(size);
+    if (!block) return 0;
+
+    block->next = arena->blocks;
+    block->size = size;
+    arena->blocks = block;
+    arena->block_count++;
+
+    arena->next = (char *)block + align_up(sizeof(ArenaBlock));
+    arena->end = (char *)block + size;
+    return 1;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size_t need = ARENA_ALIGN + align_up(size);
+
+    if ((size_t)(arena->end - arena->next) < need && !add_block(arena, need)) {
+        return NULL;
+    }
+
+    *(size_t *)arena->next = size;
+    void *ptr = arena->next + ARENA_ALIGN;
+    arena->next += need;
+
+    arena->allocations++;
+    arena->bytes += size;
+    return ptr;
+}
+
+void *arena_realloc(Arena *arena, void *ptr, size_t size) {
+    if (!ptr) return arena_alloc(arena, size);
+
+    size_t *header = (size_t *)((char *)ptr - ARENA_ALIGN);
+    size_t old_size = *header;
+    if (size <= old_size) return ptr;
+
+    // the last allocation made can take the room after it
+    char *old_end = (char *)ptr + align_up(old_size);
+    if (old_end == arena->next && (size_t)(arena->end - (char *)ptr) >= align_up(size)) {
+        arena->next = (char *)ptr + align_up(size);
+        arena->bytes += size - old_size;
+        *header = size;
+        return ptr;
+    }
+
+    void *grown = arena_alloc(arena, size);
+    if (grown) memcpy(grown, ptr, old_size);
+    return grown;
+}
+
+char *arena_strndup(Arena *arena, const char *str, size_t length) {
+    char *copy = arena_alloc(arena, length + 1);
+    if (!copy) return NULL;
+
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void free_arena(Arena *arena) {
+    ArenaBlock *block = arena->blocks;
+    while (block) {
+        ArenaBlock *next = block->next;
+        unmap_block(block);
+        block = next;
+    }
+
+    init_arena(arena);
+}
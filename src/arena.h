@@ -0,0 +1,33 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// the size blocks are mapped in, a larger allocation gets a block of its own
+#define ARENA_BLOCK_SIZE (1024 * 1024)
+
+typedef struct ArenaBlock ArenaBlock;
+
+// a bump allocator. memory is handed out from large blocks and never freed on
+// its own, the blocks all go at once in free_arena
+typedef struct {
+    ArenaBlock *blocks;
+    char       *next;
+    char       *end;
+
+    // what has been asked of it, for the allocation report
+    int         allocations;
+    int         block_count;
+    size_t      bytes;
+} Arena;
+
+extern void init_arena(Arena *arena);
+extern void *arena_alloc(Arena *arena, size_t size);
+
+// like realloc, the allocation grows in place when it was the last one made
+extern void *arena_realloc(Arena *arena, void *ptr, size_t size);
+extern char *arena_strndup(Arena *arena, const char *str, size_t length);
+
+extern void free_arena(Arena *arena);
+
+#endif
@@ -6,25 +6,41 @@
 #include "ast.h"
 #include "utils.h"
 
-static AstNode *parse_statement(Parser *parser);
-static AstNode *parse_expression(Parser *parser);
-static AstAssignment *init_assignment(char *identifier, AstNode *value);
+static NodeId parse_statement(Parser *parser);
+static NodeId parse_expression(Parser *parser);
+static AstAssignment init_assignment(SymbolId identifier, NodeId value);
 
-Parser *init_parser(Token *tokens, int debug, char *file) {
+Parser *init_parser(Lexer *lexer, int debug, char *file) {
     Parser *parser = (Parser *)malloc(sizeof(Parser));
     if (!parser) {
         perror("Error allocating parser.");
         return NULL;
     }
 
+    init_arena(&parser->arena);
+
+    // index 0 stands for no node, so the first one made is 1
+    parser->nodes_capacity = 64;
+    parser->nodes = calloc(parser->nodes_capacity, sizeof(AstNode));
+    parser->nodes_used = 1;
+
     parser->node_count = 0;
     parser->node_capacity = 1;
     parser->debug = debug;
-    parser->tree = malloc(sizeof(AstNode *) * parser->node_capacity);
-    parser->tokens = tokens;
+    parser->tree = arena_alloc(&parser->arena, sizeof(NodeId) * parser->node_capacity);
+    parser->tokens = &lexer->tokens;
+    parser->lexer = lexer;
     parser->err = NO_PARSER_ERROR;
     parser->current = 0;
     parser->file = file;
+    parser->defer_bodies = 0;
+    parser->quiet = 0;
+    parser->frames = NULL;
+    parser->frame_count = 0;
+    parser->frame_capacity = 0;
+    parser->open_bodies = NULL;
+    parser->open_body_count = 0;
+    parser->open_body_capacity = 0;
 
     return parser;
 }
@@ -50,22 +66,23 @@ static void print_type_specifiers(TypeSpecifier type_specifier, int depth) {
     printf("%s\n", token_type_to_str(type_specifier.type));
 }
 
-static void print_node(AstNode *node, int depth) {
+static void print_node(Parser *parser, NodeId id, int depth) {
+    AstNode *node = ast_node(parser, id);
     print_depth(depth);
 
     int factor = 2;
 
     switch (node->type) {
         case AST_LITERAL_INT:
-            printf("LITERAL INT: %d\n", node->as.lit_int->value);
+            printf("LITERAL INT: %d\n", node->as.lit_int.value);
             break;
 
         case AST_LITERAL_CHAR:
-            printf("LITERAL CHAR: '%c'\n", node->as.lit_char->value);
+            printf("LITERAL CHAR: '%c'\n", node->as.lit_char.value);
             break;
 
         case AST_LITERAL_STRING:
-            printf("LITERAL STRING: '%s'\n", node->as.lit_str->value);
+            printf("LITERAL STRING: '%s'\n", node->as.lit_str.value);
             break;
 
         case AST_VARIABLE_DECLARATION:
@@ -80,13 +97,13 @@ static void print_node(AstNode *node, int depth) {
                 print_depth(depth + factor * 2);
                 printf("DECLARATOR:\n");
                 print_depth(depth + factor * 3);
-                printf("IDENTIFIER: %s\n", node->as.var_dec->declarators[i]->identifier);
+                printf("IDENTIFIER: %s\n", symbol_str(node->as.var_dec->declarators[i]->identifier));
                 print_depth(depth + factor * 3);
                 printf("POINTER LEVEL: %d\n", node->as.var_dec->declarators[i]->pointer_level);
                 if (node->as.var_dec->declarators[i]->value) {
                     print_depth(depth + factor * 3);
                     printf("VALUE:\n");
-                    print_node(node->as.var_dec->declarators[i]->value, depth + factor * 4);
+                    print_node(parser, node->as.var_dec->declarators[i]->value, depth + factor * 4);
                 }
             }
             break;
@@ -102,7 +119,7 @@ static void print_node(AstNode *node, int depth) {
         case AST_FUNCTION:
             printf("FUNCTION:\n");
             print_depth(depth + factor);
-            printf("IDENTIFIER: %s\n", node->as.func->identifier);
+            printf("IDENTIFIER: %s\n", symbol_str(node->as.func->identifier));
             print_depth(depth + factor);
             printf("TYPE SPECIFIERS:");
             print_type_specifiers(node->as.func->type_specifier, depth + factor);
@@ -112,70 +129,75 @@ static void print_node(AstNode *node, int depth) {
             printf("PARAMETERS (%d):\n", node->as.func->params_count);
             for (int i = 0; i < node->as.func->params_count; i++) {
                 print_depth(depth + factor * 2);
-                printf("ID: %s\n", node->as.func->params[i]->name);
+                printf("ID: %s\n", symbol_str(node->as.func->params[i]->name));
                 print_depth(depth + factor * 2);
                 printf("TYPE SPECIFIER: ");
                 print_type_specifiers(node->as.func->params[i]->type_specifier, depth + factor);
             }
 
             print_depth(depth + factor);
+            if (node->as.func->body_deferred) {
+                printf("BODY: deferred, tokens %d to %d\n", node->as.func->body_start, node->as.func->body_end);
+                break;
+            }
+
             printf("BODY (%d):\n", node->as.func->body_count);
             for (int i = 0; i < node->as.func->body_count; i++) {
-                print_node(node->as.func->body[i], depth + factor * 2);
+                print_node(parser, node->as.func->body[i], depth + factor * 2);
             }
             break;
 
         case AST_RETURN:
             printf("RETURN:\n");
-            print_node(node->as.ret->value, depth + factor);
+            print_node(parser, node->as.ret.value, depth + factor);
             break;
 
         case AST_BINARY:
             printf("BINARY EXPRESSION:\n");
             print_depth(depth + factor);
             printf("LEFT:\n");
-            print_node(node->as.binary->left, depth + factor * 2);
+            print_node(parser, node->as.binary.left, depth + factor * 2);
             print_depth(depth + factor);
-            printf("OPERATOR: %s\n", node->as.binary->op.lexeme);
+            printf("OPERATOR: %s\n", token_type_to_lexeme(node->as.binary.op));
             print_depth(depth + factor);
             printf("RIGHT:\n");
-            print_node(node->as.binary->right, depth + factor * 2);
+            print_node(parser, node->as.binary.right, depth + factor * 2);
             break;
 
         case AST_UNARY:
             printf("UNARY EXPRESSION:\n");
             print_depth(depth + factor);
             printf("LEFT:\n");
-            print_node(node->as.unary->left, depth +  factor * 2);
+            print_node(parser, node->as.unary.left, depth +  factor * 2);
             print_depth(depth + factor);
-            printf("OPERATOR: %s\n", node->as.unary->op.lexeme);
+            printf("OPERATOR: %s\n", token_type_to_lexeme(node->as.unary.op));
             print_depth(depth + factor);
-            printf("POSTFIX: %d\n", node->as.unary->is_postfix);
+            printf("POSTFIX: %d\n", node->as.unary.is_postfix);
             break;
 
         case AST_IDENTIFIER:
-            printf("IDENTIFIER: %s\n", node->as.ident->name);
+            printf("IDENTIFIER: %s\n", symbol_str(node->as.ident.name));
             break;
 
         case AST_CALL_EXPR:
             printf("CALL EXPRESSION:\n");
             print_depth(depth + factor);
-            printf("FUNCTION: %s\n", node->as.call->identifier);
+            printf("FUNCTION: %s\n", symbol_str(node->as.call.identifier));
             
             print_depth(depth + factor);
-            printf("ARGS (%d):\n", node->as.call->arg_count);
-            for (int i = 0; i < node->as.call->arg_count; i++) {
-                print_node(node->as.call->args[i], depth * factor);
+            printf("ARGS (%d):\n", node->as.call.arg_count);
+            for (int i = 0; i < node->as.call.arg_count; i++) {
+                print_node(parser, node->as.call.args[i], depth * factor);
             }
             break;
 
         case AST_ASSIGNMENT:
             printf("ASSIGNMENT:\n");
             print_depth(depth + factor);
-            printf("IDENTIFIER: %s\n", node->as.assign->identifier);
+            printf("IDENTIFIER: %s\n", symbol_str(node->as.assign.identifier));
             print_depth(depth + factor);
             printf("VALUE:\n");
-            print_node(node->as.assign->value, depth + factor * 2);
+            print_node(parser, node->as.assign.value, depth + factor * 2);
             break;
 
         case AST_BREAK:
@@ -190,11 +212,11 @@ static void print_node(AstNode *node, int depth) {
             printf("IF STATEMENT:\n");
             print_depth(depth + factor);
             printf("CONDITION:\n");
-            print_node(node->as.if_stmt->condition, depth + factor * 2);
+            print_node(parser, node->as.if_stmt->condition, depth + factor * 2);
             print_depth(depth + factor * 2);
             printf("BODY (%d):\n", node->as.if_stmt->body_count);
             for (int i = 0; i < node->as.if_stmt->body_count; i++) {
-                print_node(node->as.if_stmt->body[i], depth + factor * 3);
+                print_node(parser, node->as.if_stmt->body[i], depth + factor * 3);
             }
             if (node->as.if_stmt->else_body) {
                 print_depth(depth);
@@ -202,7 +224,7 @@ static void print_node(AstNode *node, int depth) {
                 print_depth(depth + factor);
                 printf("BODY (%d):\n", node->as.if_stmt->else_body_count);
                 for (int i = 0; i < node->as.if_stmt->else_body_count; i++) {
-                    print_node(node->as.if_stmt->else_body[i], depth + factor * 2);
+                    print_node(parser, node->as.if_stmt->else_body[i], depth + factor * 2);
                 }
             }
             break;
@@ -211,11 +233,11 @@ static void print_node(AstNode *node, int depth) {
             printf("WHILE STATEMENT:\n");
             print_depth(depth + factor);
             printf("CONDITION:\n");
-            print_node(node->as.while_stmt->condition, depth + factor * 2);
+            print_node(parser, node->as.while_stmt->condition, depth + factor * 2);
             print_depth(depth + factor * 2);
             printf("BODY (%d):\n", node->as.while_stmt->body_count);
             for (int i = 0; i < node->as.while_stmt->body_count; i++) {
-                print_node(node->as.while_stmt->body[i], depth + factor * 3);
+                print_node(parser, node->as.while_stmt->body[i], depth + factor * 3);
             }
             break;
 
@@ -225,7 +247,7 @@ static void print_node(AstNode *node, int depth) {
             
             printf("INITIALIZER:\n");
             if (node->as.for_stmt->initializer) {
-                print_node(node->as.for_stmt->initializer, depth + factor * 2);
+                print_node(parser, node->as.for_stmt->initializer, depth + factor * 2);
             } else {
                 print_depth(depth + factor * 2);
                 printf("NONE\n");
@@ -234,7 +256,7 @@ static void print_node(AstNode *node, int depth) {
             
             printf("CONDITION:\n");
             if (node->as.for_stmt->condition) {
-                print_node(node->as.for_stmt->condition, depth + factor * 2);
+                print_node(parser, node->as.for_stmt->condition, depth + factor * 2);
             } else {
                 print_depth(depth + factor * 2);
                 printf("NONE\n");
@@ -243,18 +265,18 @@ static void print_node(AstNode *node, int depth) {
             
             printf("ALTERATION:\n");
             if (node->as.for_stmt->alteration) {
-                print_node(node->as.for_stmt->alteration, depth + factor * 2);
+                print_node(parser, node->as.for_stmt->alteration, depth + factor * 2);
             } else {
                 print_depth(depth + factor * 2);
                 printf("NONE\n");
             }
-            print_node(node->as.for_stmt->block, depth + factor);
+            print_node(parser, node->as.for_stmt->block, depth + factor);
             break;
         
         case AST_BLOCK:
             printf("BODY (%d):\n", node->as.block->body_count);
             for (int i = 0; i < node->as.block->body_count; i++) {
-                print_node(node->as.block->body[i], depth + factor);
+                print_node(parser, node->as.block->body[i], depth + factor);
             }
             break;
 
@@ -262,47 +284,47 @@ static void print_node(AstNode *node, int depth) {
             printf("DO WHILE STATEMENT:\n");
             print_depth(depth + factor);
             printf("CONDITION:\n");
-            print_node(node->as.while_stmt->condition, depth + factor * 2);
+            print_node(parser, node->as.while_stmt->condition, depth + factor * 2);
             print_depth(depth + factor);
             printf("BODY (%d):\n", node->as.do_while->block->body_count);
             for (int i = 0; i < node->as.do_while->block->body_count; i++) {
-                print_node(node->as.do_while->block->body[i], depth + factor * 2);
+                print_node(parser, node->as.do_while->block->body[i], depth + factor * 2);
             }
             break;
 
         case AST_STRUCT:
             printf("STRUCT:\n");
             print_depth(depth + factor);
-            printf("NAME: %s\n", node->as.a_struct->name);
+            printf("NAME: %s\n", symbol_str(node->as.a_struct->name));
             print_depth(depth + factor);
             printf("FIELDS: (%d)\n", node->as.a_struct->field_count);
             for (int i = 0; i < node->as.a_struct->field_count; i++) {
-                print_node(node->as.a_struct->fields[i], depth + factor * 2);
+                print_node(parser, node->as.a_struct->fields[i], depth + factor * 2);
             }
             break;
 
         case AST_UNION:
             printf("UNION:\n");
             print_depth(depth + factor);
-            printf("NAME: %s\n", node->as.a_union->name);
+            printf("NAME: %s\n", symbol_str(node->as.a_union->name));
             print_depth(depth + factor);
             printf("FIELDS: (%d)\n", node->as.a_union->field_count);
             for (int i = 0; i < node->as.a_union->field_count; i++) {
-                print_node(node->as.a_union->fields[i], depth + factor * 2);
+                print_node(parser, node->as.a_union->fields[i], depth + factor * 2);
             }
             break;
 
         case AST_ENUM:
             printf("ENUM:\n");
             print_depth(depth + factor);
-            printf("NAME: %s\n", node->as.an_enum->name);
+            printf("NAME: %s\n", symbol_str(node->as.an_enum->name));
             print_depth(depth + factor);
             printf("VALUES (%d):\n", node->as.an_enum->value_count);
             for (int i = 0; i < node->as.an_enum->value_count; i++) {
                 print_depth(depth + factor * 2);
                 printf("ENUM VALUE %d:\n", i);
                 print_depth(depth + factor * 3);
-                printf("NAME: %s\n", node->as.an_enum->values[i]->name);
+                printf("NAME: %s\n", symbol_str(node->as.an_enum->values[i]->name));
                 print_depth(depth + factor * 3);
                 printf("VALUE: %d\n", node->as.an_enum->values[i]->value);
                 print_depth(depth + factor * 3);
@@ -314,22 +336,22 @@ static void print_node(AstNode *node, int depth) {
             printf("TERNARY:\n");
             print_depth(depth + factor);
             printf("CONDITION:\n");
-            print_node(node->as.ternary->condition, depth + factor * 2);
+            print_node(parser, node->as.ternary.condition, depth + factor * 2);
             print_depth(depth + factor);
             printf("TRUE EXPR:\n");
-            print_node(node->as.ternary->true_expr, depth + factor * 2);
+            print_node(parser, node->as.ternary.true_expr, depth + factor * 2);
             print_depth(depth + factor);
             printf("FALSE EXPR:\n");
-            print_node(node->as.ternary->false_expr, depth + factor * 2);
+            print_node(parser, node->as.ternary.false_expr, depth + factor * 2);
             break;
             
         case AST_CAST:
             printf("CAST:\n");
             print_depth(depth + factor);
             printf("RIGHT:\n");
-            print_node(node->as.cast->right, depth + factor * 2);
+            print_node(parser, node->as.cast->right, depth + factor * 2);
             print_depth(depth + factor);
-            printf("TO: %s\n", node->as.cast->type.lexeme);
+            printf("TO: %s\n", token_type_to_lexeme(node->as.cast->type.type));
             print_depth(depth + factor);
             printf("POINTER LEVEL: %d\n", node->as.cast->pointer_level);
             break;
@@ -338,15 +360,15 @@ static void print_node(AstNode *node, int depth) {
             printf("ARR SUB:\n");
             print_depth(depth + factor);
             printf("BASE:\n");
-            print_node(node->as.arr_sub->base, depth + factor * 2);
+            print_node(parser, node->as.arr_sub.base, depth + factor * 2);
             print_depth(depth + factor);
             printf("INDEX:\n");
-            print_node(node->as.arr_sub->index, depth + factor * 2);
+            print_node(parser, node->as.arr_sub.index, depth + factor * 2);
             break;
 
         case AST_TYPEDEF:
             printf("IDENTIFIER: ");
-            printf("%s\n", node->as.type_def->identifier);
+            printf("%s\n", symbol_str(node->as.type_def->identifier));
             print_depth(depth + factor);
             printf("TYPE SPECIFIERS:");
             print_type_specifiers(node->as.type_def->type_specs, depth + factor);
@@ -354,7 +376,7 @@ static void print_node(AstNode *node, int depth) {
 
         case AST_ARRAY_DECLARATION:
             printf("ARRAY DECLARATION: ");
-            printf("%s\n", node->as.array_decl->identifier);
+            printf("%s\n", symbol_str(node->as.array_decl->identifier));
             print_depth(depth + factor);
             printf("TYPE SPECIFIERS:");
             print_type_specifiers(node->as.array_decl->type_specs, depth + factor);
@@ -363,13 +385,13 @@ static void print_node(AstNode *node, int depth) {
             for (int i = 0; i < node->as.array_decl->dimension_count; i++) {
                 print_depth(depth + factor * 2);
                 printf("DIMENSION (%d):\n", i);
-                print_node(node->as.array_decl->dimensions[i], depth + factor * 3);
+                print_node(parser, node->as.array_decl->dimensions[i], depth + factor * 3);
             }
             break;
 
         case AST_FUNCTION_POINTER_DECLARATION:
             printf("FUNCTION POINTER DECLARATION: ");
-            printf("%s\n", node->as.fptr->identifier);
+            printf("%s\n", symbol_str(node->as.fptr->identifier));
             print_depth(depth + factor);
             printf("RETURN TYPE SPECIFIERS: ");
             print_type_specifiers(node->as.fptr->return_type_specs, depth + factor);
@@ -390,7 +412,7 @@ static void print_node(AstNode *node, int depth) {
                 print_depth(depth + factor * 3);
                 if (node->as.switch_stmt->cases[i]->value) {
                     printf("EXPRESSION: \n");
-                    print_node(node->as.switch_stmt->cases[i]->value, factor * 6);
+                    print_node(parser, node->as.switch_stmt->cases[i]->value, factor * 6);
                 } else {
                     printf("DEFAULT: \n");
                 }
@@ -399,7 +421,7 @@ static void print_node(AstNode *node, int depth) {
                     print_depth(depth + factor * 3);
                     printf("BODY (%d): \n", node->as.switch_stmt->cases[i]->block->body_count);
                     for (int j = 0; j < node->as.switch_stmt->cases[i]->block->body_count; j++) {
-                        print_node(node->as.switch_stmt->cases[i]->block->body[j], factor * 7);
+                        print_node(parser, node->as.switch_stmt->cases[i]->block->body[j], factor * 7);
                     }
                 }
             }
@@ -428,246 +450,50 @@ void parser_print(Parser *parser) {
   printf("\n\nPARSER SUCCESS\n");
   printf("AST Nodes (%d):\n", parser->node_count);
     for (int i = 0; i < parser->node_count; i++) {
-        AstNode *node = parser->tree[i];
-        print_node(node, 1);
+        print_node(parser, parser->tree[i], 1);
     }
     printf("\n");
-}
-
-static void free_node(AstNode *node) {
-    if (!node) return;
-
-    if (node->type == AST_LITERAL_INT) {
-        free(node->as.lit_int);
-        free(node);
-    }
-    else if (node->type == AST_LITERAL_CHAR) {
-        free(node->as.lit_char);
-        free(node);
-    }
-    else if (node->type == AST_LITERAL_STRING) {
-        free(node->as.lit_str);
-        free(node);
-    }
-    else if (node->type == AST_VARIABLE_DECLARATION) {
-        for (int i = 0; i < node->as.var_dec->declarator_count; i++) {
-            free(node->as.var_dec->declarators[i]->identifier);
-            free_node(node->as.var_dec->declarators[i]->value);
-        }
-        free(node->as.var_dec->declarators);
-        free(node->as.var_dec);
-        free(node);
-    }
-    else if (node->type == AST_FUNCTION) {
-        for (int i = 0; i < node->as.func->body_count; i++) {
-            free_node(node->as.func->body[i]);
-        }
-        for (int i = 0; i < node->as.func->params_count; i++) {
-            free(node->as.func->params[i]->name);
-            free(node->as.func->params[i]);
-        }
-        free(node->as.func->identifier);
-        free(node->as.func->body);
-        free(node->as.func);
-        free(node);
-    }
-    else if (node->type == AST_FUNCTION_PARAMETER) {
-        free(node->as.param->name);
-        free(node->as.param);
-        free(node);
-    }
-    else if (node->type == AST_RETURN) {
-        free_node(node->as.ret->value);
-        free(node->as.ret);
-        free(node);
-    }
-    else if (node->type == AST_IDENTIFIER) {
-        free(node->as.ident->name);
-        free(node->as.ident);
-        free(node);
-    }
-    else if (node->type == AST_BINARY) {
-        free_node(node->as.binary->left);
-        free_node(node->as.binary->right);
-        free(node->as.binary);
-        free(node);
-    }
-    else if (node->type == AST_UNARY) {
-        free(node->as.unary->left);
-        free(node->as.unary);
-        free(node);
-    }
-    else if (node->type == AST_CALL_EXPR) {
-        free(node->as.call->identifier);
-        free(node->as.call);
-        free(node);
-    }
-    else if (node->type == AST_INLINE_ASM_BLOCK) {
-        for (int i = 0; i < node->as.asm_inl->line_count; i++) {
-            free(node->as.asm_inl->lines[i]);
-        }
-
-        free(node->as.asm_inl);
-        free(node);
-    }
-    else if (node->type == AST_ASSIGNMENT) {
-        free_node(node->as.assign->value);
-        free(node->as.assign->identifier);
-        free(node->as.assign);
-        free(node);
-    }
-    else if (node->type == AST_IF) {
-        for (int i = 0; i < node->as.if_stmt->body_count; i++) {
-            free_node(node->as.if_stmt->body[i]);
-        }
-
-        free(node->as.if_stmt);
-        free(node);
-    }
-    else if (node->type == AST_WHILE) {
-        for (int i = 0; i < node->as.while_stmt->body_count; i++) {
-            free_node(node->as.while_stmt->body[i]);
-        }
-
-        free_node(node->as.while_stmt->condition);
-
-        free(node->as.while_stmt);
-        free(node);
-    }
-    else if (node->type == AST_CONTINUE) {
-        free(node->as.cont);
-        free(node);
-    }
-    else if (node->type == AST_BREAK) {
-        free(node->as.brk);
-        free(node);
-    }
-    else if (node->type == AST_FOR) {
-        free_node(node->as.for_stmt->block);
-
-        free_node(node->as.for_stmt->initializer);
-        free_node(node->as.for_stmt->condition);
-        free_node(node->as.for_stmt->alteration);
-
-        free(node->as.for_stmt);
-        free(node);
-    }
-    else if (node->type == AST_BLOCK) {
-        for (int i = 0; i < node->as.block->body_count; i++) {
-            free_node(node->as.block->body[i]);
-        }
-    }
-    else if (node->type == AST_TERNARY) {
-        free(node->as.ternary->condition);
-        free(node->as.ternary->true_expr);
-        free(node->as.ternary->false_expr);
-        free(node->as.ternary);
-        free(node);
-    }
-    else if (node->type == AST_STRUCT) {
-        for (int i = 0; i < node->as.a_struct->field_count; i++) {
-            free_node(node->as.a_struct->fields[i]);
-        }
-        free(node->as.a_struct->name);
-        free(node->as.a_struct);
-        free(node);
-    }
-    else if (node->type == AST_UNION) {
-        for (int i = 0; i < node->as.a_union->field_count; i++) {
-            free_node(node->as.a_union->fields[i]);
-        }
-        free(node->as.a_union->name);
-        free(node->as.a_union);
-        free(node);
-    }
-    else if (node->type == AST_ENUM) {
-        for (int i = 0; i < node->as.an_enum->value_count; i++) {
-            free(node->as.an_enum->values[i]->name);
-            free(node->as.an_enum->values[i]);
-        }
-        free(node->as.an_enum->name);
-        free(node->as.an_enum);
-        free(node);
-    }
-    else if (node->type == AST_CAST) {
-        free_node(node->as.cast->right);
-        free(node->as.cast);
-        free(node);
-    }
-    else if (node->type == AST_ARR_SUBSCRIPT) {
-        free_node(node->as.arr_sub->index);
-        free_node(node->as.arr_sub->base);
-        free(node->as.arr_sub);
-        free(node);
-    }
-    else if (node->type == AST_TYPEDEF) {
-        free(node->as.type_def->identifier);
-        free(node->as.type_def);
-        free(node);
-    }
-    else if (node->type == AST_ARRAY_DECLARATION) {
-        for (int i = 0; i < node->as.array_decl->dimension_count; i++) {
-            free_node(node->as.array_decl->dimensions[i]);
-        }
-        free(node->as.array_decl->identifier);
-        free(node->as.array_decl);
-        free(node);
-    }
-    else if (node->type == AST_FUNCTION_POINTER_DECLARATION) {
-        // for (int i = 0; i < node->as.fptr->param_count; i++) {
-        //     free(node->as.fptr->param_type_specs);
-        // }
-        free(node->as.fptr->identifier);
-        free(node->as.fptr);
-        free(node);
-    }
-    else if (node->type == AST_SWITCH) {
-        for (int i = 0; i < node->as.switch_stmt->case_count; i++) {
-            AstCase *switch_case = node->as.switch_stmt->cases[i];
-            if (!switch_case->block) continue;
 
-            for (int j = 0; j < switch_case->block->body_count; j++) {
-                free_node(switch_case->block->body[j]);
-            }
-            free_node(switch_case->value);
-            free(switch_case);
-        }
-        free_node(node->as.switch_stmt->expression);
-        free(node->as.switch_stmt);
-        free(node);
-    }
-    else {
-        printf("unknown ast_type in 'free_node': '%s' (%d)\n", ast_type_to_str(node->type), node->type);
-        printf("you probably forgot to add this type to the if-else block.\n");
-    }
+    Arena *arena = &parser->arena;
+    printf("AST memory: %u nodes, %d allocations, %zu bytes in %d blocks\n", parser->nodes_used - 1, arena->allocations, arena->bytes, arena->block_count);
 }
 
+// every payload and list came from the arena, only the nodes and the frame
+// stacks are separate
 void free_parser(Parser *parser) {
-    for (int i = 0; i < parser->node_count; i++) {
-        free_node(parser->tree[i]);
-    }
-
-    free(parser->tree);
+    free(parser->nodes);
+    free(parser->frames);
+    free(parser->open_bodies);
+    free_arena(&parser->arena);
     free(parser);
 }
 
-static AstNode *init_node(void *value, AstType type){
-    AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-    if (!node) {
-        perror("Error allocating node.");
-        return NULL;
+// appends a node to parser->nodes. any AstNode pointer taken before this is
+// stale once it returns, as the array can move
+NodeId init_node(Parser *parser, void *value, AstType type){
+    if (parser->nodes_used >= parser->nodes_capacity) {
+        AstNode *nodes = realloc(parser->nodes, sizeof(AstNode) * parser->nodes_capacity * 2);
+        if (!nodes) {
+            perror("Error allocating node.");
+            return NO_NODE;
+        }
+
+        parser->nodes = nodes;
+        parser->nodes_capacity *= 2;
     }
 
+    NodeId id = parser->nodes_used++;
+    AstNode *node = ast_node(parser, id);
     node->type = type;
 
     if (type == AST_LITERAL_INT) {
-        node->as.lit_int = (AstLiteralInt *)value;
+        node->as.lit_int = *(AstLiteralInt *)value;
     }
     else if (type == AST_LITERAL_CHAR) {
-        node->as.lit_char = (AstLiteralChar *)value;
+        node->as.lit_char = *(AstLiteralChar *)value;
     }
     else if (type == AST_LITERAL_STRING) {
-        node->as.lit_str = (AstLiteralString *)value;
+        node->as.lit_str = *(AstLiteralString *)value;
     }
     else if (type == AST_VARIABLE_DECLARATION) {
         node->as.var_dec = (AstVariableDeclaration *)value;
@@ -676,22 +502,22 @@ static AstNode *init_node(void *value, AstType type){
         node->as.func = (AstFunctionDeclaration *)value;
     }
     else if (type == AST_RETURN) {
-        node->as.ret = (AstReturn *)value;
+        node->as.ret = *(AstReturn *)value;
     }
     else if (type == AST_IDENTIFIER) {
-        node->as.ident = (AstIdentifier *)value;
+        node->as.ident = *(AstIdentifier *)value;
     }
     else if (type == AST_BINARY) {
-        node->as.binary = (AstBinaryExpr *)value;
+        node->as.binary = *(AstBinaryExpr *)value;
     }
     else if (type == AST_CALL_EXPR) {
-        node->as.call = (AstCallExpr *)value;
+        node->as.call = *(AstCallExpr *)value;
     }
     else if (type == AST_INLINE_ASM_BLOCK) {
         node->as.asm_inl = (AstInlineAsmBlock *)value;
     }
     else if (type == AST_ASSIGNMENT) {
-        node->as.assign = (AstAssignment *)value;
+        node->as.assign = *(AstAssignment *)value;
     }
     else if (type == AST_IF) {
         node->as.if_stmt = (AstIfStatement *)value;
@@ -700,19 +526,19 @@ static AstNode *init_node(void *value, AstType type){
         node->as.while_stmt = (AstWhile *)value;
     }
     else if (type == AST_BREAK) {
-        node->as.brk = (AstBreak *)value;
+        node->as.brk = *(AstBreak *)value;
     }
     else if (type == AST_CONTINUE) {
-        node->as.cont = (AstContinue *)value;
+        node->as.cont = *(AstContinue *)value;
     }
     else if (type == AST_UNARY) {
-        node->as.unary = (AstUnary *)value;
+        node->as.unary = *(AstUnary *)value;
     }
     else if (type == AST_FOR) {
         node->as.for_stmt = (AstFor *)value;
     }
     else if (type == AST_TERNARY) {
-        node->as.ternary = (AstTernary *)value;
+        node->as.ternary = *(AstTernary *)value;
     }
     else if (type == AST_BLOCK) {
         node->as.block = (AstBlock *)value;
@@ -733,7 +559,7 @@ static AstNode *init_node(void *value, AstType type){
         node->as.cast = (AstCast *)value;
     }
     else if (type == AST_ARR_SUBSCRIPT) {
-        node->as.arr_sub = (AstArraySubscript *)value;
+        node->as.arr_sub = *(AstArraySubscript *)value;
     }
     else if (type == AST_TYPEDEF) {
         node->as.type_def = (AstTypedef *)value;
@@ -752,7 +578,7 @@ static AstNode *init_node(void *value, AstType type){
         printf("you probably forgot to add this type to the if-else block.\n");
     }
 
-    return node;
+    return id;
 }
 
 static AstDataType token_to_ast_data_type(Token token) {
@@ -778,9 +604,50 @@ static int is_valid_type(Token token) {
 }
 
 static inline Token current_token(Parser *parser) {
-    return parser->tokens[parser->current];
+    return token_at(parser->tokens, parser->current);
+}
+
+static inline TokenType current_type(Parser *parser) {
+    return (TokenType)parser->tokens->types[parser->current];
+}
+
+static inline const char *lexeme(Parser *parser, Token token) {
+    return parser->lexer->source + token.offset;
 }
 
+// copies the lexeme of a token out of the source buffer
+static char *lexeme_dup(Parser *parser, Token token) {
+    return arena_strndup(&parser->arena, lexeme(parser, token), token.length);
+}
+
+static inline SymbolId lexeme_intern(Parser *parser, Token token) {
+    return intern(lexeme(parser, token), token.length);
+}
+
+// converts a numeric lexeme, it is copied out first because the source is not
+// null terminated and a number can be the last thing in it
+static int lexeme_to_int(Parser *parser, Token token, int base) {
+    char digits[64];
+    int length = token.length < (int)sizeof(digits) - 1 ? token.length : (int)sizeof(digits) - 1;
+
+    memcpy(digits, lexeme(parser, token), length);
+    digits[length] = '\0';
+
+    return (int)strtol(digits, NULL, base);
+}
+
+// copies the value of the char or string literal at the token index, with its
+// escape sequences decoded
+static char *literal_dup(Parser *parser, int index) {
+    const DecodedLiteral *decoded = lexer_decoded_literal(parser->lexer, index);
+    if (decoded) {
+        char *value = arena_alloc(&parser->arena, decoded->length + 1);
+        memcpy(value, decoded->value, decoded->length + 1);
+        return value;
+    }
+
+    return lexeme_dup(parser, token_at(parser->tokens, index));
+}
 static inline void advance(Parser *parser) {
     parser->current++;
 }
@@ -790,16 +657,16 @@ static inline void recede(Parser *parser) {
 }
 
 static inline int is_end(Parser *parser) {
-    return current_token(parser).type == TOKEN_EOF;
+    return current_type(parser) == TOKEN_EOF;
 }
 
 static inline int match(TokenType type, Parser *parser) {
-    return current_token(parser).type == type;
+    return current_type(parser) == type;
 }
 
-static inline void *parser_err(ParseErr err, Parser *parser) {
+static inline NodeId parser_err(ParseErr err, Parser *parser) {
     parser->err = err;
-    return NULL;
+    return NO_NODE;
 }
 
 int len_helper(unsigned x) {
@@ -816,56 +683,47 @@ int len_helper(unsigned x) {
 }
 
 static void pretty_error(Parser *parser) {
+    if (parser->quiet) return;
+
     Token errTok;
 
     recede(parser);
     errTok = current_token(parser);
 
-    if (errTok.lexeme == NULL) {
+    if (errTok.type == TOKEN_EOF) {
         advance(parser);
         for (int i = parser->current; i >= 0; i--) {
-            if (parser->tokens[i].type != TOKEN_EOF) {
-                errTok = parser->tokens[i];
+            if (parser->tokens->types[i] != TOKEN_EOF) {
+                errTok = token_at(parser->tokens, i);
                 break;
             }
         }
     }
 
-    printf("\n%s:%d\n", parser->file, errTok.line);
-    printf("error: %s\n", parser_err_to_str(parser->err));
-
-    // const int line_num_len = 6; // '   XX | ' is 6 characters
-    printf("   %d | ", errTok.line);
-
-    int char_pos = 0;
-    int caret_pos = -1;
-
-    for (int i = 0; parser->tokens[i].type != TOKEN_EOF; i++) {
-        Token tok = parser->tokens[i];
-        if (tok.line != errTok.line) continue;
+    int line, column;
+    lexer_position(parser->lexer, errTok.offset, &line, &column);
 
-        if (caret_pos == -1 &&
-            tok.line == errTok.line &&
-            strcmp(tok.lexeme, errTok.lexeme) == 0) {
-            caret_pos = char_pos;
-        }
+    printf("\n%s:%d\n", parser->file, line);
+    printf("error: %s\n", parser_err_to_str(parser->err));
 
-        printf("%s", tok.lexeme);
-        char_pos += strlen(tok.lexeme);
+    // the failing line is printed straight from the source
+    const char *source = parser->lexer->source;
+    const char *line_start = source + errTok.offset - (column - 1);
+    const char *source_end = source + parser->lexer->length;
 
-        if (tok.has_whitespace_after) {
-            printf(" ");
-            char_pos++;
-        }
-    }
+    const char *line_end = memchr(line_start, '\n', source_end - line_start);
+    if (!line_end) line_end = source_end;
+    if (line_end > line_start && line_end[-1] == '\r') line_end--;
 
-    if (caret_pos == -1) caret_pos = char_pos;
+    // const int line_num_len = 6; // '   XX | ' is 6 characters
+    printf("   %d | %.*s", line, (int)(line_end - line_start), line_start);
 
+    // tabs are kept so the caret lines up with the source above it
     printf("\n     | ");
-    for (int i = 0; i < caret_pos + 1; i++) {
-        printf(" ");
+    for (int i = 0; i < column - 1; i++) {
+        printf("%c", line_start[i] == '\t' ? '\t' : ' ');
     }
-    printf("^\n");
+    printf(" ^\n");
 }
 
 
@@ -881,7 +739,7 @@ static void pretty_error(Parser *parser) {
 // }
 
 static inline int expect(TokenType type, Parser *parser) {
-    if (parser->tokens[parser->current].type == type) {
+    if (current_type(parser) == type) {
         advance(parser);
         return 1;
     }
@@ -889,158 +747,117 @@ static inline int expect(TokenType type, Parser *parser) {
     return 0;
 }
 
-static AstBinaryExpr *init_binary_node(AstNode *left, Token op, AstNode *right) {
-    AstBinaryExpr *binary = malloc(sizeof(AstBinaryExpr));
-    binary->left = left;
-    binary->op = op;
-    binary->right = right;
+static AstBinaryExpr init_binary_node(NodeId left, TokenType op, NodeId right) {
+    AstBinaryExpr binary;
+    binary.left = left;
+    binary.op = op;
+    binary.right = right;
 
     return binary;
 }
 
-static AstUnary *init_unary_node(AstNode *left, Token op, int is_postfix) {
-    AstUnary *unary = malloc(sizeof(AstUnary));
-    unary->left = left;
-    unary->op = op;
-    unary->is_postfix = is_postfix;
+static AstUnary init_unary_node(NodeId left, TokenType op, int is_postfix) {
+    AstUnary unary;
+    unary.left = left;
+    unary.op = op;
+    unary.is_postfix = is_postfix;
 
     return unary;
 }
 
-static AstArraySubscript *init_array_subscript(AstNode *base, AstNode* index) {
-    AstArraySubscript *arr_sub = malloc(sizeof(AstArraySubscript));
-    arr_sub->base = base;
-    arr_sub->index = index;
+static AstArraySubscript init_array_subscript(NodeId base, NodeId index) {
+    AstArraySubscript arr_sub;
+    arr_sub.base = base;
+    arr_sub.index = index;
 
     return arr_sub;
 }
 
-static AstCallExpr *init_call_expr(char *identifier, AstNode **args, int arg_count) {
-    AstCallExpr *expr = malloc(sizeof(AstCallExpr));
-    expr->identifier = strdup(identifier);
-    expr->args = args;
-    expr->arg_count = arg_count;
+static AstCallExpr init_call_expr(SymbolId identifier, NodeId *args, int arg_count) {
+    AstCallExpr expr;
+    expr.identifier = identifier;
+    expr.args = args;
+    expr.arg_count = arg_count;
 
     return expr;
 }
 
-static AstNode *parse_call_expr(Parser *parser) {
-    Token identifier = current_token(parser);
-    advance(parser);
-
-    AstNode **args = malloc(sizeof(AstNode *));
-    int capacity = 1;
-    int count = 0;
-    
-    parser->ignore_comma_op = 1;
-    do {
-        advance(parser);
-        if (match(TOKEN_RIGHT_PAREN, parser)) break;
-
-        AstNode *expr = parse_expression(parser);
-        if (!expr) return NULL;
-
-        if (count >= capacity) {
-            capacity *= 2;
-            args = realloc(args, sizeof(AstNode *) * capacity);
-        }        
-        args[count++] = expr;
-
-        printf("%s", current_token(parser).lexeme);
-
-    } while(match(TOKEN_COMMA, parser));
-    parser->ignore_comma_op = 0;
-    
-    if (!expect(TOKEN_RIGHT_PAREN, parser)) {
-        return parser_err(PARSE_ERR_EXPECTED_EXPRESSION, parser);
-    }
-
-    AstCallExpr *expr = init_call_expr(identifier.lexeme, args, count);
-    AstNode *node = init_node(expr, AST_CALL_EXPR);
+static AstTernary init_ternary_node(NodeId condition, NodeId true_expr, NodeId false_expr) {
+    AstTernary ternary;
+    ternary.condition = condition;
+    ternary.true_expr = true_expr;
+    ternary.false_expr = false_expr;
 
-    return node;
+    return ternary;
 }
 
-static AstNode *parse_primary(Parser *parser) {
+// literals and identifiers, everything else is opened by parse_expression
+static NodeId parse_primary(Parser *parser) {
     Token token = current_token(parser);
-    
-    if (token.type == TOKEN_LEFT_PAREN) {
-        advance(parser);
-
-        AstNode *expr = parse_expression(parser);
-        if (!expect(TOKEN_RIGHT_PAREN, parser)) {
-            return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
-        }
-
-        return expr;
-    }
-
     advance(parser);
 
     if (token.type == TOKEN_INTEGER_LITERAL) {
-        AstLiteralInt *lit = malloc(sizeof(AstLiteralInt));
-        lit->value = atoi(token.lexeme);
-        AstNode *node = init_node(lit, AST_LITERAL_INT);
+        AstLiteralInt lit;
+        lit.value = lexeme_to_int(parser, token, 10);
+        NodeId node = init_node(parser, &lit, AST_LITERAL_INT);
 
         return node;
     }
     else if (token.type == TOKEN_HEX_LITERAL) {
-        AstLiteralInt *lit = malloc(sizeof(AstLiteralInt));
-        lit->value = (int)strtol(token.lexeme, NULL, 16);
-        AstNode *node = init_node(lit, AST_LITERAL_INT);
+        AstLiteralInt lit;
+        lit.value = lexeme_to_int(parser, token, 16);
+        NodeId node = init_node(parser, &lit, AST_LITERAL_INT);
 
         return node;
     }
     else if (token.type == TOKEN_BINARY_LITERAL) {
-        AstLiteralInt *lit = malloc(sizeof(AstLiteralInt));
-        
+        AstLiteralInt lit;
+
+        const char *digits = lexeme(parser, token);
+
+        // skips the '0b' prefix
         int value = 0;
-        for (int i = 0; token.lexeme[i] != '\0'; i++) {
+        for (int i = 2; i < token.length; i++) {
             value <<= 1;
-            if (token.lexeme[i] == '1') {
+            if (digits[i] == '1') {
                 value |= 1;
-            } else if (token.lexeme[i] != '0') {
+            } else if (digits[i] != '0') {
                 value = 0;
                 break;
             }
         }
-    
-        lit->value = value;
-        AstNode *node = init_node(lit, AST_LITERAL_INT);
+
+        lit.value = value;
+        NodeId node = init_node(parser, &lit, AST_LITERAL_INT);
         return node;
     }
     else if (token.type == TOKEN_OCTAL_LITERAL) {
-        AstLiteralInt *lit = malloc(sizeof(AstLiteralInt));
-        lit->value = (int)strtol(token.lexeme, NULL, 8);
-        AstNode *node = init_node(lit, AST_LITERAL_INT);
+        AstLiteralInt lit;
+        lit.value = lexeme_to_int(parser, token, 8);
+        NodeId node = init_node(parser, &lit, AST_LITERAL_INT);
         return node;
     }
     else if (token.type == TOKEN_CHAR_LITERAL) {
-        AstLiteralChar *lit = malloc(sizeof(AstLiteralChar));
-        lit->value = token.lexeme[0];
-        AstNode *node = init_node(lit, AST_LITERAL_CHAR);
+        const DecodedLiteral *decoded = lexer_decoded_literal(parser->lexer, parser->current - 1);
+
+        AstLiteralChar lit;
+        lit.value = decoded ? decoded->value[0] : lexeme(parser, token)[0];
+        NodeId node = init_node(parser, &lit, AST_LITERAL_CHAR);
 
         return node;
 
     }
     else if (token.type == TOKEN_STRING_LITERAL) {
-        AstLiteralString *lit = malloc(sizeof(AstLiteralString));
-        lit->value = strdup(token.lexeme);
-        AstNode *node = init_node(lit, AST_LITERAL_STRING);
+        AstLiteralString lit;
+        lit.value = literal_dup(parser, parser->current - 1);
+        NodeId node = init_node(parser, &lit, AST_LITERAL_STRING);
 
         return node;
     }
     else if (token.type == TOKEN_IDENTIFIER) {
-        if (match(TOKEN_LEFT_PAREN, parser)) {
-            recede(parser);
-            return parse_call_expr(parser);
-        }
-
-        char *name = strdup(token.lexeme);
-
-        AstIdentifier *ident = malloc(sizeof(AstIdentifier));
-        ident->name = name;
-        AstNode *node = init_node(ident, AST_IDENTIFIER);
+        AstIdentifier ident;
+        ident.name = lexeme_intern(parser, token);
+        NodeId node = init_node(parser, &ident, AST_IDENTIFIER);
 
         return node;
     }
@@ -1049,62 +866,121 @@ static AstNode *parse_primary(Parser *parser) {
     }
 }
 
-static AstNode *parse_postfix_unary(Parser *parser) {
-    AstNode *expr = parse_primary(parser);
-
-    while (1) {
-        if (match(TOKEN_SQUARE_BRACKET_LEFT, parser)) {
-            advance(parser);
-            AstNode *index = parse_expression(parser);
-            if (!index || !expect(TOKEN_SQUARE_BRACKET_RIGHT, parser)) {
-                return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
-            }
-
-            AstArraySubscript *arr_sub = init_array_subscript(expr, index);
-            expr = init_node(arr_sub, AST_ARR_SUBSCRIPT);
-        }
-        else if (match(TOKEN_INCREMENT, parser) || match(TOKEN_DECREMENT, parser)) {
-            Token op = current_token(parser);
-            advance(parser);
+// how tightly each infix operator binds, the tokens left out end an expression
+static const uint8_t infix_precedence[TOKEN_NONE + 1] = {
+    [TOKEN_COMMA]                      = PREC_COMMA,
+
+    [TOKEN_PLUS_EQUALS]                = PREC_COMPOUND,
+    [TOKEN_MINUS_EQUALS]               = PREC_COMPOUND,
+    [TOKEN_STAR_EQUALS]                = PREC_COMPOUND,
+    [TOKEN_SLASH_EQUALS]               = PREC_COMPOUND,
+    [TOKEN_MODULO_EQUALS]              = PREC_COMPOUND,
+    [TOKEN_BITWISE_AND_EQUALS]         = PREC_COMPOUND,
+    [TOKEN_BITWISE_OR_EQUALS]          = PREC_COMPOUND,
+    [TOKEN_BITWISE_XOR_EQUALS]         = PREC_COMPOUND,
+    [TOKEN_BITWISE_LEFT_SHIFT_EQUALS]  = PREC_COMPOUND,
+    [TOKEN_BITWISE_RIGHT_SHIFT_EQUALS] = PREC_COMPOUND,
+
+    [TOKEN_QUESTION]                   = PREC_TERNARY,
+    [TOKEN_OR]                         = PREC_LOGICAL_OR,
+    [TOKEN_AND]                        = PREC_LOGICAL_AND,
+    [TOKEN_BITWISE_OR]                 = PREC_BITWISE_OR,
+    [TOKEN_BITWISE_XOR]                = PREC_BITWISE_XOR,
+    [TOKEN_BITWISE_AND]                = PREC_BITWISE_AND,
+
+    [TOKEN_EQUALS]                     = PREC_EQUALITY,
+    [TOKEN_NOT_EQUALS]                 = PREC_EQUALITY,
+
+    [TOKEN_GREATER_THAN]               = PREC_RELATIONAL,
+    [TOKEN_GREATER_THAN_EQUALS]        = PREC_RELATIONAL,
+    [TOKEN_LESS_THAN]                  = PREC_RELATIONAL,
+    [TOKEN_LESS_THAN_EQUALS]           = PREC_RELATIONAL,
+
+    [TOKEN_BITWISE_LEFT_SHIFT]         = PREC_SHIFT,
+    [TOKEN_BITWISE_RIGHT_SHIFT]        = PREC_SHIFT,
+
+    [TOKEN_PLUS]                       = PREC_TERM,
+    [TOKEN_MINUS]                      = PREC_TERM,
+
+    [TOKEN_STAR]                       = PREC_FACTOR,
+    [TOKEN_SLASH]                      = PREC_FACTOR,
+    [TOKEN_MODULO]                     = PREC_FACTOR,
+};
+
+// the operator x op= y is rewritten with, x = x op y
+static const uint8_t compound_operator[TOKEN_NONE + 1] = {
+    [TOKEN_PLUS_EQUALS]                = TOKEN_PLUS,
+    [TOKEN_MINUS_EQUALS]               = TOKEN_MINUS,
+    [TOKEN_STAR_EQUALS]                = TOKEN_STAR,
+    [TOKEN_SLASH_EQUALS]               = TOKEN_SLASH,
+    [TOKEN_MODULO_EQUALS]              = TOKEN_MODULO,
+    [TOKEN_BITWISE_AND_EQUALS]         = TOKEN_BITWISE_AND,
+    [TOKEN_BITWISE_OR_EQUALS]          = TOKEN_BITWISE_OR,
+    [TOKEN_BITWISE_XOR_EQUALS]         = TOKEN_BITWISE_XOR,
+    [TOKEN_BITWISE_LEFT_SHIFT_EQUALS]  = TOKEN_BITWISE_LEFT_SHIFT,
+    [TOKEN_BITWISE_RIGHT_SHIFT_EQUALS] = TOKEN_BITWISE_RIGHT_SHIFT,
+};
+
+static const uint8_t is_prefix_operator[TOKEN_NONE + 1] = {
+    [TOKEN_PLUS]        = 1,
+    [TOKEN_MINUS]       = 1,
+    [TOKEN_EXCLAMATION] = 1,
+    [TOKEN_BITWISE_NOT] = 1,
+    [TOKEN_INCREMENT]   = 1,
+    [TOKEN_DECREMENT]   = 1,
+    [TOKEN_BITWISE_AND] = 1,
+    [TOKEN_STAR]        = 1,
+};
+
+static ExprFrame *push_frame(Parser *parser, ExprFrameKind kind, Precedence precedence) {
+    if (parser->frame_count >= parser->frame_capacity) {
+        parser->frame_capacity = parser->frame_capacity ? parser->frame_capacity * 2 : 16;
+        parser->frames = realloc(parser->frames, sizeof(ExprFrame) * parser->frame_capacity);
+    }
+
+    ExprFrame *frame = &parser->frames[parser->frame_count++];
+    frame->kind = kind;
+    frame->precedence = precedence;
+
+    return frame;
+}
+
+// the operators of an expression that failed are dropped with it
+static NodeId expression_err(ParseErr err, Parser *parser, int base) {
+    parser->frame_count = base;
+    return parser_err(err, parser);
+}
+
+// pushes the frame for a prefix operator, cast, parenthesis or call that
+// starts the operand at the current token. returns 0 when the operand is a
+// plain primary or a call without arguments, which is left in *operand
+static int open_operand(Parser *parser, NodeId *operand, int base) {
+    TokenType type = current_type(parser);
+
+    if (is_prefix_operator[type]) {
+        ExprFrame *frame = push_frame(parser, FRAME_UNARY, PREC_UNARY);
+        frame->op = type;
+        advance(parser);
 
-            AstUnary *unary = init_unary_node(expr, op, 1);
-            expr = init_node(unary, AST_UNARY);
-        }
-        else {
-            break;
-        }
+        return 1;
     }
 
-    return expr;
-}
-
-static AstNode *parse_prefix_unary(Parser *parser) {
-    if (match(TOKEN_PLUS, parser) || match(TOKEN_MINUS, parser) || 
-        match(TOKEN_EXCLAMATION, parser) || match(TOKEN_BITWISE_NOT, parser) ||
-        match(TOKEN_INCREMENT, parser) || match(TOKEN_DECREMENT, parser)
-    ) {
-        Token op = current_token(parser);
+    if (type == TOKEN_SIZEOF) {
         advance(parser);
 
-        AstNode *right = parse_prefix_unary(parser);
-        if (!right) return NULL;
+        if (!expect(TOKEN_LEFT_PAREN, parser)) {
+            *operand = expression_err(PARSE_ERR_INVALID_SYNTAX, parser, base);
+            return 0;
+        }
 
-        AstUnary *unary = init_unary_node(right, op, 0);
-        return init_node(unary, AST_UNARY);
+        push_frame(parser, FRAME_SIZEOF, PREC_NONE);
+        return 1;
     }
 
-    return parse_postfix_unary(parser);
-}
-
-static AstNode *parse_cast(Parser *parser) {
-    advance(parser);
-    Token next_token = current_token(parser);
-    recede(parser);
-
-    if (match(TOKEN_LEFT_PAREN, parser) && is_valid_type(next_token)) {
+    if (type == TOKEN_LEFT_PAREN && is_valid_type(token_at(parser->tokens, parser->current + 1))) {
         advance(parser);
 
-        Token type = current_token(parser);
+        Token cast_type = current_token(parser);
         advance(parser);
 
         int pointer_level = 0;
@@ -1114,362 +990,249 @@ static AstNode *parse_cast(Parser *parser) {
         }
 
         if (!expect(TOKEN_RIGHT_PAREN, parser)) {
-            return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+            *operand = expression_err(PARSE_ERR_INVALID_SYNTAX, parser, base);
+            return 0;
         }
 
-        AstNode *right = parse_expression(parser);
-        if (!right) return NULL;
-
-        AstCast *cast = malloc(sizeof(AstCast));
-        cast->right = right;
-        cast->type = type;
-        cast->pointer_level = pointer_level;
-
-        return init_node(cast, AST_CAST);
-    }
-
-    return parse_prefix_unary(parser);
-}
-
-static AstNode *parse_pointer_operator(Parser *parser) {
-    if (match(TOKEN_BITWISE_AND, parser) || match(TOKEN_STAR, parser)) {
-        Token op = current_token(parser);
-        advance(parser);
-
-        AstNode *right = parse_cast(parser);
-        if (!right) return NULL;
+        // the cast applies to the whole expression after it
+        ExprFrame *frame = push_frame(parser, FRAME_CAST, PREC_NONE);
+        frame->token = cast_type;
+        frame->count = pointer_level;
 
-        AstUnary *unary = init_unary_node(right, op, 0);
-        return init_node(unary, AST_UNARY);
-    }
-
-    return parse_cast(parser);
-}
-
-static AstNode *parse_sizeof(Parser *parser) {
-    if (match(TOKEN_SIZEOF, parser)) {
-        Token op = current_token(parser);
-        advance(parser);
-
-        if (!expect(TOKEN_LEFT_PAREN, parser)) {
-            return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
-        }
-
-        AstNode *right = parse_expression(parser);
-        if (!right) return NULL;
-
-        AstUnary *unary = init_unary_node(right, op, 0);
-
-        if (!expect(TOKEN_RIGHT_PAREN, parser)) {
-            return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
-        }
-
-        return init_node(unary, AST_UNARY);
+        return 1;
     }
 
-    return parse_pointer_operator(parser);
-}
-
-static AstNode *parse_factor(Parser *parser) {
-    AstNode *left = parse_sizeof(parser);
-    
-    while (match(TOKEN_STAR, parser) || match(TOKEN_SLASH, parser) || match(TOKEN_MODULO, parser)) {
-        Token op = current_token(parser);
+    if (type == TOKEN_LEFT_PAREN) {
         advance(parser);
-        
-        AstNode *right = parse_sizeof(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        left = init_node(binary, AST_BINARY);
-    }
-
-    return left;
-}
+        push_frame(parser, FRAME_GROUP, PREC_NONE);
 
-static AstNode *parse_term(Parser *parser) {
-    AstNode *left = parse_factor(parser);
-
-    while (match(TOKEN_PLUS, parser) || match(TOKEN_MINUS, parser)) {
-        Token op = current_token(parser);
-        advance(parser);
-        
-        AstNode *right = parse_factor(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        left = init_node(binary, AST_BINARY);
+        return 1;
     }
 
-    return left;
-}
-
-static AstNode *parse_bitwise_shift(Parser *parser) {
-    AstNode *left = parse_term(parser);
-
-    while (match(TOKEN_BITWISE_LEFT_SHIFT, parser) || match(TOKEN_BITWISE_RIGHT_SHIFT, parser)) {
-        Token op = current_token(parser);
+    if (type == TOKEN_IDENTIFIER && parser->tokens->types[parser->current + 1] == TOKEN_LEFT_PAREN) {
+        Token identifier = current_token(parser);
         advance(parser);
-
-        AstNode *right = parse_term(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        left = init_node(binary, AST_BINARY);
-    }
-
-    return left;
-}
-
-static AstNode *parse_relational(Parser *parser) {
-    AstNode *left = parse_bitwise_shift(parser);
-
-    while (
-        match(TOKEN_GREATER_THAN, parser) || match(TOKEN_LESS_THAN_EQUALS, parser) ||
-        match(TOKEN_GREATER_THAN_EQUALS, parser) || match(TOKEN_LESS_THAN, parser)
-    ) {
-        Token op = current_token(parser);
         advance(parser);
 
-        AstNode *right = parse_bitwise_shift(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        left = init_node(binary, AST_BINARY);
-    }
+        NodeId *args = arena_alloc(&parser->arena, sizeof(NodeId));
+        parser->ignore_comma_op = 1;
 
-    return left;
-}
+        if (match(TOKEN_RIGHT_PAREN, parser)) {
+            advance(parser);
+            parser->ignore_comma_op = 0;
 
-static AstNode *parse_equality(Parser *parser) {
-    AstNode *left = parse_relational(parser);
+            AstCallExpr expr = init_call_expr(lexeme_intern(parser, identifier), args, 0);
+            *operand = init_node(parser, &expr, AST_CALL_EXPR);
+            return 0;
+        }
 
-    while (match(TOKEN_EQUALS, parser) || match(TOKEN_NOT_EQUALS, parser)) {
-        Token op = current_token(parser);
-        advance(parser);
+        ExprFrame *frame = push_frame(parser, FRAME_CALL, PREC_NONE);
+        frame->token = identifier;
+        frame->args = args;
+        frame->count = 0;
+        frame->capacity = 1;
 
-        AstNode *right = parse_relational(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        left = init_node(binary, AST_BINARY);
+        return 1;
     }
 
-    return left;
+    *operand = parse_primary(parser);
+    return 0;
 }
 
-static AstNode *parse_bitwise_and(Parser *parser) {
-    AstNode *left = parse_equality(parser);
-        
-    while (match(TOKEN_BITWISE_AND, parser)) {
-        Token op = current_token(parser);
-        advance(parser);
-
-        AstNode *right = parse_equality(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        return init_node(binary, AST_BINARY);
+// applies the operator of the top frame to its left side and the operand
+static NodeId reduce_frame(Parser *parser, ExprFrame *frame, NodeId operand) {
+    if (frame->kind == FRAME_UNARY) {
+        AstUnary unary = init_unary_node(operand, frame->op, 0);
+        return init_node(parser, &unary, AST_UNARY);
     }
 
-    return left;
-
-}
-
-static AstNode *parse_bitwise_xor(Parser *parser) {
-    AstNode *left = parse_bitwise_and(parser);
-    
-    while (match(TOKEN_BITWISE_XOR, parser)) {
-        Token op = current_token(parser);
-        advance(parser);
-
-        AstNode *right = parse_bitwise_and(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        return init_node(binary, AST_BINARY);
+    if (frame->kind == FRAME_TERNARY_ELSE) {
+        AstTernary ternary = init_ternary_node(frame->left, frame->middle, operand);
+        return init_node(parser, &ternary, AST_TERNARY);
     }
 
-    return left;
-}
-
-static AstNode *parse_bitwise_or(Parser *parser) {
-    AstNode *left = parse_bitwise_xor(parser);
+    if (frame->kind == FRAME_COMPOUND) {
+        AstBinaryExpr binary = init_binary_node(frame->left, compound_operator[frame->op], operand);
+        NodeId node = init_node(parser, &binary, AST_BINARY);
 
-    while (match(TOKEN_BITWISE_OR, parser)) {
-        Token op = current_token(parser);
-        advance(parser);
-
-        AstNode *right = parse_bitwise_xor(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        return init_node(binary, AST_BINARY);
+        AstAssignment assign = init_assignment(ast_node(parser, frame->left)->as.ident.name, node);
+        return init_node(parser, &assign, AST_ASSIGNMENT);
     }
 
-    return left;
+    AstBinaryExpr binary = init_binary_node(frame->left, frame->op, operand);
+    return init_node(parser, &binary, AST_BINARY);
 }
 
-static AstNode *parse_logical_and(Parser *parser) {
-    AstNode *left = parse_bitwise_or(parser);
-
-    while (match(TOKEN_AND, parser)) {
-        Token op = current_token(parser);
-        advance(parser);
+// precedence climbing driven by infix_precedence. the operators still waiting
+// for their right side are kept on parser->frames rather than the native
+// stack, so how deep an expression nests is bounded by the heap. frames below
+// base belong to an enclosing parse_expression
+static NodeId parse_expression(Parser *parser) {
+    int base = parser->frame_count;
+    NodeId operand = NO_NODE;
 
-        AstNode *right = parse_bitwise_or(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        left = init_node(binary, AST_BINARY);
-    }
+    while (1) {
+        // prefix operators and openers, then the operand they apply to
+        while (open_operand(parser, &operand, base));
+        if (!operand) {
+            parser->frame_count = base;
+            return NO_NODE;
+        }
+
+        int next_operand = 0;
+        while (!next_operand) {
+            if (match(TOKEN_SQUARE_BRACKET_LEFT, parser)) {
+                advance(parser);
+
+                ExprFrame *frame = push_frame(parser, FRAME_SUBSCRIPT, PREC_NONE);
+                frame->left = operand;
+                next_operand = 1;
+                continue;
+            }
 
-    return left;
-}
+            if (match(TOKEN_INCREMENT, parser) || match(TOKEN_DECREMENT, parser)) {
+                AstUnary unary = init_unary_node(operand, current_type(parser), 1);
+                operand = init_node(parser, &unary, AST_UNARY);
+                advance(parser);
+                continue;
+            }
 
-static AstNode *parse_logical_or(Parser *parser) {
-    AstNode *left = parse_logical_and(parser);
+            // the comma of an argument list or declarator list is not an operator
+            TokenType op = current_type(parser);
+            Precedence precedence = infix_precedence[op];
+            if (op == TOKEN_COMMA && parser->ignore_comma_op) precedence = PREC_NONE;
 
-    while (match(TOKEN_OR, parser)) {
-        Token op = current_token(parser);
-        advance(parser);
+            // reduces the frames that bind tighter, the right associative
+            // compound and ternary frames wait for the operator of the same level
+            while (parser->frame_count > base) {
+                ExprFrame *top = &parser->frames[parser->frame_count - 1];
+                if (top->precedence == PREC_NONE) break;
 
-        AstNode *right = parse_logical_and(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        left = init_node(binary, AST_BINARY);
-    }
+                int right_assoc = top->kind == FRAME_COMPOUND || top->kind == FRAME_TERNARY_ELSE;
+                if (top->precedence < precedence || (top->precedence == precedence && right_assoc)) break;
 
-    return left;
-}
-
-static AstTernary *init_ternary_node(AstNode *condition, AstNode *true_expr, AstNode *false_expr) {
-    AstTernary *ternary = malloc(sizeof(AstTernary));
-    ternary->condition = condition;
-    ternary->true_expr = true_expr;
-    ternary->false_expr = false_expr;
-    
-    return ternary;
-}
+                operand = reduce_frame(parser, top, operand);
+                parser->frame_count--;
+            }
 
-static AstNode *parse_ternary(Parser *parser) {
-    AstNode *left = parse_logical_or(parser);
-    
-    while (match(TOKEN_QUESTION, parser)) {
-        advance(parser);
+            if (precedence != PREC_NONE) {
+                ExprFrameKind kind = FRAME_BINARY;
+                if (op == TOKEN_QUESTION) kind = FRAME_TERNARY_THEN;
+                else if (precedence == PREC_COMPOUND) kind = FRAME_COMPOUND;
 
-        AstNode *true_expr = parse_expression(parser);
-        if (!true_expr) return NULL;
+                // the assignment stores to a name, nothing else can take one
+                if (kind == FRAME_COMPOUND && ast_node(parser, operand)->type != AST_IDENTIFIER) {
+                    return expression_err(PARSE_ERR_INVALID_SYNTAX, parser, base);
+                }
 
-        if (!expect(TOKEN_COLON, parser)) {
-            return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
-        }
+                // the true side of a ternary is a whole expression up to the ':'
+                ExprFrame *frame = push_frame(parser, kind, kind == FRAME_TERNARY_THEN ? PREC_NONE : precedence);
+                frame->op = op;
+                frame->left = operand;
+                advance(parser);
 
-        AstNode *false_expr = parse_ternary(parser);
-        if (!false_expr) return NULL;
+                next_operand = 1;
+                continue;
+            }
 
-        AstTernary *ternary = init_ternary_node(left, true_expr, false_expr);
-        return init_node(ternary, AST_TERNARY);
-    }
+            if (parser->frame_count == base) return operand;
 
-    return left;
-}
+            // the expression inside the top frame has ended, the frame closes
+            ExprFrame *top = &parser->frames[parser->frame_count - 1];
+            switch (top->kind) {
+                case FRAME_GROUP: {
+                    if (!expect(TOKEN_RIGHT_PAREN, parser)) {
+                        return expression_err(PARSE_ERR_INVALID_SYNTAX, parser, base);
+                    }
+                    parser->frame_count--;
+                    break;
+                }
+                case FRAME_SUBSCRIPT: {
+                    if (!expect(TOKEN_SQUARE_BRACKET_RIGHT, parser)) {
+                        return expression_err(PARSE_ERR_INVALID_SYNTAX, parser, base);
+                    }
 
-static AstNode *parse_compound(Parser *parser) {
-    AstNode *left = parse_ternary(parser);
+                    AstArraySubscript arr_sub = init_array_subscript(top->left, operand);
+                    operand = init_node(parser, &arr_sub, AST_ARR_SUBSCRIPT);
+                    parser->frame_count--;
+                    break;
+                }
+                case FRAME_SIZEOF: {
+                    if (!expect(TOKEN_RIGHT_PAREN, parser)) {
+                        return expression_err(PARSE_ERR_INVALID_SYNTAX, parser, base);
+                    }
 
-    if (match(TOKEN_EQUALS, parser)) {
-        Token op = current_token(parser);
-        advance(parser);
+                    AstUnary unary = init_unary_node(operand, TOKEN_SIZEOF, 0);
+                    operand = init_node(parser, &unary, AST_UNARY);
+                    parser->frame_count--;
+                    break;
+                }
+                case FRAME_CAST: {
+                    AstCast *cast = arena_alloc(&parser->arena, sizeof(AstCast));
+                    cast->right = operand;
+                    cast->type = top->token;
+                    cast->pointer_level = top->count;
+
+                    operand = init_node(parser, cast, AST_CAST);
+                    parser->frame_count--;
+                    break;
+                }
+                case FRAME_TERNARY_THEN: {
+                    if (!expect(TOKEN_COLON, parser)) {
+                        return expression_err(PARSE_ERR_INVALID_SYNTAX, parser, base);
+                    }
 
-        AstNode *right = parse_compound(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        return init_node(binary, AST_BINARY);
-    }
+                    top->kind = FRAME_TERNARY_ELSE;
+                    top->precedence = PREC_TERNARY;
+                    top->middle = operand;
+                    next_operand = 1;
+                    break;
+                }
+                case FRAME_CALL: {
+                    if (top->count >= top->capacity) {
+                        top->capacity *= 2;
+                        top->args = arena_realloc(&parser->arena, top->args, sizeof(NodeId) * top->capacity);
+                    }
+                    top->args[top->count++] = operand;
+
+                    if (match(TOKEN_COMMA, parser)) {
+                        advance(parser);
+                        if (!match(TOKEN_RIGHT_PAREN, parser)) {
+                            next_operand = 1;
+                            break;
+                        }
+                    }
 
-    if (
-        match(TOKEN_PLUS_EQUALS, parser) || match(TOKEN_MINUS_EQUALS, parser) || 
-        match(TOKEN_STAR_EQUALS, parser) || match(TOKEN_SLASH_EQUALS, parser) ||
-        match(TOKEN_MODULO_EQUALS, parser) || match(TOKEN_BITWISE_AND_EQUALS, parser) ||
-        match(TOKEN_BITWISE_OR_EQUALS, parser) || match(TOKEN_BITWISE_XOR_EQUALS, parser) ||
-        match(TOKEN_BITWISE_LEFT_SHIFT_EQUALS, parser) || match(TOKEN_BITWISE_RIGHT_SHIFT_EQUALS, parser)
-    ) {
-        Token compound_op = current_token(parser);
-        advance(parser);
+                    if (!expect(TOKEN_RIGHT_PAREN, parser)) {
+                        return expression_err(PARSE_ERR_EXPECTED_EXPRESSION, parser, base);
+                    }
+                    parser->ignore_comma_op = 0;
 
-        AstNode *right = parse_compound(parser);
-        if (!right) return NULL;
-        
-        TokenType binary_type;
-        switch (compound_op.type) {
-            case TOKEN_PLUS_EQUALS: binary_type = TOKEN_PLUS; break;
-            case TOKEN_MINUS_EQUALS: binary_type = TOKEN_MINUS; break;
-            case TOKEN_STAR_EQUALS: binary_type = TOKEN_STAR; break;
-            case TOKEN_SLASH_EQUALS: binary_type = TOKEN_SLASH; break;
-            case TOKEN_MODULO_EQUALS: binary_type = TOKEN_MODULO; break;
-            case TOKEN_BITWISE_AND_EQUALS: binary_type = TOKEN_BITWISE_AND; break;
-            case TOKEN_BITWISE_OR_EQUALS: binary_type = TOKEN_BITWISE_OR; break;
-            case TOKEN_BITWISE_XOR_EQUALS: binary_type = TOKEN_BITWISE_XOR; break;
-            case TOKEN_BITWISE_LEFT_SHIFT_EQUALS: binary_type = TOKEN_BITWISE_LEFT_SHIFT; break;
-            case TOKEN_BITWISE_RIGHT_SHIFT_EQUALS: binary_type = TOKEN_BITWISE_RIGHT_SHIFT; break;
-            default: return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+                    AstCallExpr expr = init_call_expr(lexeme_intern(parser, top->token), top->args, top->count);
+                    operand = init_node(parser, &expr, AST_CALL_EXPR);
+                    parser->frame_count--;
+                    break;
+                }
+                default:
+                    break;
+            }
         }
-
-        // x += 1;
-        // x = x + 1;
-
-        Token binary_tok = compound_op;
-        binary_tok.type = binary_type;
-        binary_tok.lexeme = "+";
-
-        AstBinaryExpr *binary = init_binary_node(left, binary_tok, right);
-        AstNode *node = init_node(binary, AST_BINARY);
-
-        AstAssignment *assign = init_assignment(left->as.ident->name, node);
-        return init_node(assign, AST_ASSIGNMENT);
     }
-
-    return left;
 }
 
-static AstNode *parse_comma(Parser *parser) {
-    AstNode *left = parse_compound(parser);
-    if (parser->ignore_comma_op) return left;
-
-    while (match(TOKEN_COMMA, parser)) {
-        Token op = current_token(parser);
-        advance(parser);
-
-        AstNode *right = parse_compound(parser);
-        if (!right) return NULL;
-        
-        AstBinaryExpr *binary = init_binary_node(left, op, right);
-        left = init_node(binary, AST_BINARY);
-    }
-
-    return left;
-}
-
-static AstNode *parse_expression(Parser *parser) {
-    return parse_comma(parser);
-}
-
-static AstVariableDeclaration *init_var_dec(AstDeclarator **declarators, int declarator_count) {
-    AstVariableDeclaration *var_dec = (AstVariableDeclaration *)malloc(sizeof(AstVariableDeclaration));
+static AstVariableDeclaration *init_var_dec(Parser *parser, AstDeclarator **declarators, int declarator_count) {
+    AstVariableDeclaration *var_dec = arena_alloc(&parser->arena, sizeof(AstVariableDeclaration));
     var_dec->declarators= declarators;
     var_dec->declarator_count = declarator_count;
 
     return var_dec;
 }
 
-static AstNode *parse_variable_declaration(Parser *parser, TypeSpecifier type_specs) {
+static NodeId parse_variable_declaration(Parser *parser, TypeSpecifier type_specs) {
     parser->ignore_comma_op = 1;
     advance(parser);
 
-    AstDeclarator **declarators = malloc(sizeof(AstDeclarator));
+    AstDeclarator **declarators = arena_alloc(&parser->arena, sizeof(AstDeclarator *));
     int declarator_count = 0;
     int declarator_capacity = 1;
 
@@ -1489,26 +1252,26 @@ static AstNode *parse_variable_declaration(Parser *parser, TypeSpecifier type_sp
             return parser_err(PARSE_ERR_EXPECTED_IDENTIFIER, parser);
         }
 
-        AstNode *initializer = NULL;
+        NodeId initializer = NO_NODE;
         if (match(TOKEN_SINGLE_EQUALS, parser)) {
             advance(parser);
 
-            AstNode *expr = parse_expression(parser);
+            NodeId expr = parse_expression(parser);
             if (!expr) {
                 parser->ignore_comma_op = 0;
-                return NULL;
+                return NO_NODE;
             }
             initializer = expr;
         }
 
-        AstDeclarator *declarator = malloc(sizeof(AstDeclarator));
-        declarator->identifier = strdup(id.lexeme);
+        AstDeclarator *declarator = arena_alloc(&parser->arena, sizeof(AstDeclarator));
+        declarator->identifier = lexeme_intern(parser, id);
         declarator->pointer_level = pointer_level;
         declarator->value = initializer;
 
         if (declarator_count >= declarator_capacity) {
             declarator_capacity *= 2;
-            declarators = realloc(declarators, sizeof(AstDeclarator) * declarator_capacity);
+            declarators = arena_realloc(&parser->arena, declarators, sizeof(AstDeclarator *) * declarator_capacity);
         }
 
         declarators[declarator_count++] = declarator;
@@ -1520,23 +1283,77 @@ static AstNode *parse_variable_declaration(Parser *parser, TypeSpecifier type_sp
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
-    AstVariableDeclaration *var_dec = init_var_dec(declarators, declarator_count);
+    AstVariableDeclaration *var_dec = init_var_dec(parser, declarators, declarator_count);
     var_dec->type_specifier = type_specs;
 
-    AstNode *node = init_node(var_dec, AST_VARIABLE_DECLARATION);
+    NodeId node = init_node(parser, var_dec, AST_VARIABLE_DECLARATION);
 
     parser->ignore_comma_op = 0;
     return node;
 }
 
-static AstFunctionDeclaration *init_function_node(AstNode **body, int body_count, char *identifier, AstFunctionParameter **params, int params_count, int is_void_params) {
-    AstFunctionDeclaration *func = (AstFunctionDeclaration *)malloc(sizeof(AstFunctionDeclaration));
+// returned by the statement parsers that pushed a BodyFrame rather than
+// parsing their body, parse_statement reads the body and closes the frame.
+// no node gets this index
+#define BODY_OPENED UINT32_MAX
+
+static BodyFrame *push_body(Parser *parser, BodyKind kind) {
+    if (parser->open_body_count >= parser->open_body_capacity) {
+        parser->open_body_capacity = parser->open_body_capacity ? parser->open_body_capacity * 2 : 16;
+        parser->open_bodies = realloc(parser->open_bodies, sizeof(BodyFrame) * parser->open_body_capacity);
+    }
+
+    BodyFrame *frame = &parser->open_bodies[parser->open_body_count++];
+    frame->kind = kind;
+    frame->body = NULL;
+    frame->body_count = 0;
+    frame->body_capacity = 0;
+
+    return frame;
+}
+
+static void start_body(Parser *parser, BodyFrame *frame) {
+    frame->body_capacity = 1;
+    frame->body = arena_alloc(&parser->arena, sizeof(NodeId) * frame->body_capacity);
+    frame->body_count = 0;
+}
+
+static void append_statement(Parser *parser, BodyFrame *frame, NodeId statement) {
+    if (frame->body_count >= frame->body_capacity) {
+        frame->body_capacity = frame->body_capacity ? frame->body_capacity * 2 : 4;
+        frame->body = arena_realloc(&parser->arena, frame->body, frame->body_capacity * sizeof(NodeId));
+    }
+    frame->body[frame->body_count++] = statement;
+}
+
+// the index of the '}' closing the '{' at open, -1 when the tokens run out first
+static int matching_brace(Parser *parser, int open) {
+    const uint8_t *types = parser->tokens->types;
+    int depth = 0;
+
+    for (int i = open; i < parser->tokens->count; i++) {
+        if (types[i] == TOKEN_LEFT_BRACE) {
+            depth++;
+        }
+        else if (types[i] == TOKEN_RIGHT_BRACE && --depth == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static AstFunctionDeclaration *init_function_node(Parser *parser, NodeId *body, int body_count, SymbolId identifier, AstFunctionParameter **params, int params_count, int is_void_params) {
+    AstFunctionDeclaration *func = arena_alloc(&parser->arena, sizeof(AstFunctionDeclaration));
     func->body = body;
     func->body_count = body_count;
-    func->identifier = strdup(identifier);
+    func->identifier = identifier;
     func->params = params;
     func->params_count = params_count;
     func->is_void_params = is_void_params;
+    func->body_deferred = 0;
+    func->body_start = 0;
+    func->body_end = 0;
 
     return func;
 }
@@ -1593,7 +1410,7 @@ static TypeSpecifier parse_type_specifiers(Parser *parser) {
             match(TOKEN_FLOAT, parser) || match(TOKEN_DOUBLE, parser) ||
             match(TOKEN_VOID, parser)
          ) {
-            specs.type = current_token(parser).type;
+            specs.type = current_type(parser);
             advance(parser);
         }
         else if (match(TOKEN_STAR, parser)) {
@@ -1629,15 +1446,15 @@ static TypeSpecifier parse_type_specifiers(Parser *parser) {
     return specs;
 }
 
-static AstFunctionParameter *init_func_parameter(char *id, TypeSpecifier type_specs) {
-    AstFunctionParameter *param = malloc(sizeof(AstFunctionParameter));
-    param->name = strdup(id);
+static AstFunctionParameter *init_func_parameter(Parser *parser, SymbolId id, TypeSpecifier type_specs) {
+    AstFunctionParameter *param = arena_alloc(&parser->arena, sizeof(AstFunctionParameter));
+    param->name = id;
     param->type_specifier = type_specs;
 
     return param;
 }
 
-static AstNode *parse_function(Parser *parser, TypeSpecifier type_specs) {
+static NodeId parse_function(Parser *parser, TypeSpecifier type_specs) {
     advance(parser);
 
     Token identifier_token = current_token(parser);
@@ -1650,7 +1467,7 @@ static AstNode *parse_function(Parser *parser, TypeSpecifier type_specs) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    AstFunctionParameter **params = malloc(sizeof(AstFunctionParameter *));
+    AstFunctionParameter **params = arena_alloc(&parser->arena, sizeof(AstFunctionParameter *));
     if (!params) {
         return parser_err(PARSE_ERR_OUT_OF_MEMORY, parser);
     }
@@ -1677,10 +1494,10 @@ static AstNode *parse_function(Parser *parser, TypeSpecifier type_specs) {
             }
             advance(parser);
     
-            AstFunctionParameter *param = init_func_parameter(id.lexeme, type_specs);
+            AstFunctionParameter *param = init_func_parameter(parser, lexeme_intern(parser, id), type_specs);
             if (params_count >= capacity) {
                 capacity *= 2;
-                params = realloc(params, sizeof(AstFunctionParameter *) * capacity);
+                params = arena_realloc(&parser->arena, params, sizeof(AstFunctionParameter *) * capacity);
             }
             params[params_count++] = param;
         } while (match(TOKEN_COMMA, parser));
@@ -1693,8 +1510,9 @@ static AstNode *parse_function(Parser *parser, TypeSpecifier type_specs) {
     if (match(TOKEN_SEMICOLON, parser)) {
         advance(parser);
 
-        AstFunctionDeclaration *func = init_function_node(NULL, 0, identifier_token.lexeme, params, params_count, is_void_params);
-        AstNode *node = init_node(func, AST_FUNCTION);
+        AstFunctionDeclaration *func = init_function_node(parser, NULL, 0, lexeme_intern(parser, identifier_token), params, params_count, is_void_params);
+        func->type_specifier = type_specs;
+        NodeId node = init_node(parser, func, AST_FUNCTION);
 
         return node;
     }
@@ -1703,71 +1521,69 @@ static AstNode *parse_function(Parser *parser, TypeSpecifier type_specs) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    int body_statement_count = 0;
-    int body_capacity = 1;
-    AstNode **body = malloc(sizeof(AstNode *) * body_capacity);
-    
-    while (!match(TOKEN_RIGHT_BRACE, parser)) {
-        AstNode *node = parse_statement(parser);
-        if (!node) return NULL;
-
-        if (body_statement_count >= body_capacity) {
-            body_capacity *= 2;
-            body = realloc(body, sizeof(AstNode *) * body_capacity);
+    if (parser->defer_bodies) {
+        int body_end = matching_brace(parser, parser->current - 1);
+        if (body_end < 0) {
+            parser->current = parser->tokens->count - 1;
+            return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
         }
-        body[body_statement_count++] = node;
-    }
-
-    AstFunctionDeclaration *func = init_function_node(
-        body, body_statement_count, identifier_token.lexeme, 
-        params, params_count, is_void_params
-    );
-    func->type_specifier = type_specs;
 
-    AstNode *node = init_node(func, AST_FUNCTION);
+        AstFunctionDeclaration *func = init_function_node(parser,
+            NULL, 0, lexeme_intern(parser, identifier_token),
+            params, params_count, is_void_params
+        );
+        func->type_specifier = type_specs;
+        func->body_deferred = 1;
+        func->body_start = parser->current;
+        func->body_end = body_end;
 
-    if (!expect(TOKEN_RIGHT_BRACE, parser)) {
-        // free some shit here
-        return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+        parser->current = body_end + 1;
+        return init_node(parser, func, AST_FUNCTION);
     }
 
-    return node;
+    BodyFrame *frame = push_body(parser, BODY_FUNCTION);
+    frame->identifier = identifier_token;
+    frame->params = params;
+    frame->param_count = params_count;
+    frame->is_void_params = is_void_params;
+    frame->type_specs = type_specs;
+    start_body(parser, frame);
+
+    return BODY_OPENED;
 }
 
-static AstReturn *init_return(AstNode *value) {
-    AstReturn *ret = (AstReturn *)malloc(sizeof(AstReturn));
-    ret->value = value;
+static AstReturn init_return(NodeId value) {
+    AstReturn ret;
+    ret.value = value;
 
     return ret;
 }
 
-static AstNode *parse_return(Parser *parser) {
+static NodeId parse_return(Parser *parser) {
     advance(parser);
 
-    AstNode *return_expr = parse_expression(parser);
-    if (!return_expr) {
-        return parser_err(PARSE_ERR_EXPECTED_EXPRESSION, parser);
-    }
+    NodeId return_expr = parse_expression(parser);
+    if (!return_expr) return NO_NODE;
 
     if (!expect(TOKEN_SEMICOLON, parser)) {
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
-    AstReturn *ret = init_return(return_expr);
-    AstNode *node = init_node(ret, AST_RETURN);
+    AstReturn ret = init_return(return_expr);
+    NodeId node = init_node(parser, &ret, AST_RETURN);
 
     return node;
 }
 
-static AstInlineAsmBlock *init_inline_asm_node(char **asm_lines, int line_count) {
-    AstInlineAsmBlock *asm_inl = malloc(sizeof(AstInlineAsmBlock));
+static AstInlineAsmBlock *init_inline_asm_node(Parser *parser, char **asm_lines, int line_count) {
+    AstInlineAsmBlock *asm_inl = arena_alloc(&parser->arena, sizeof(AstInlineAsmBlock));
     asm_inl->lines = asm_lines;
     asm_inl->line_count = line_count;
 
     return asm_inl;
 }
 
-static AstNode *parse_inline_asm(Parser *parser) {
+static NodeId parse_inline_asm(Parser *parser) {
     advance(parser);
     
     if (!expect(TOKEN_LEFT_PAREN, parser)) {
@@ -1776,83 +1592,47 @@ static AstNode *parse_inline_asm(Parser *parser) {
 
     int capacity = 1;
     int count = 0;
-    char **asm_lines = malloc(sizeof(char *) * capacity);
+    char **asm_lines = arena_alloc(&parser->arena, sizeof(char *) * capacity);
 
     recede(parser);
     do {
         advance(parser);
         
         if (!match(TOKEN_STRING_LITERAL, parser)) {
-            free(asm_lines);
             return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
         }
 
-        Token str_token = current_token(parser);
-        
         if (count >= capacity) {
             capacity *= 2;
-            char **new_lines = realloc(asm_lines, sizeof(char *) * capacity);
+            char **new_lines = arena_realloc(&parser->arena, asm_lines, sizeof(char *) * capacity);
             if (!new_lines) {
-                free(asm_lines);
                 return parser_err(PARSE_ERR_OUT_OF_MEMORY, parser);
             }
             asm_lines = new_lines;
         }
 
-        asm_lines[count++] = strdup(str_token.lexeme);
+        asm_lines[count++] = literal_dup(parser, parser->current);
         advance(parser);
 
     } while (match(TOKEN_COMMA, parser));
 
     if (!expect(TOKEN_RIGHT_PAREN, parser)) {
-        for (int i = 0; i < count; i++) free(asm_lines[i]);
-        free(asm_lines);
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
     if (!expect(TOKEN_SEMICOLON, parser)) {
-        for (int i = 0; i < count; i++) free(asm_lines[i]);
-        free(asm_lines);
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
-    AstInlineAsmBlock *asm_inl = init_inline_asm_node(asm_lines, count);
-    AstNode *node = init_node(asm_inl, AST_INLINE_ASM_BLOCK);
+    AstInlineAsmBlock *asm_inl = init_inline_asm_node(parser, asm_lines, count);
+    NodeId node = init_node(parser, asm_inl, AST_INLINE_ASM_BLOCK);
 
     return node;
 }
 
-// static AstDeclarator *init_declarator(char *name, int pointer_level) {
-//     AstDeclarator *declarator = malloc(sizeof(AstDeclarator));
-//     declarator->identifier = name;
-//     declarator->pointer_level = pointer_level;
-
-//     return declarator;
-// }
-
-// uhhhh
-// static AstNode *parse_declarator(Parser *parser) {
-//     int pointer_depth = 0;
-    
-//     while (match(TOKEN_STAR, parser)) {
-//         advance(parser);
-//         pointer_depth++;
-//     }
-
-//     if (!match(TOKEN_IDENTIFIER, parser)) {
-//         return parser_err(PARSE_ERR_EXPECTED_IDENTIFIER, parser);
-//     }
-
-//     Token ident = current_token(parser);
-//     advance(parser);
-
-//     AstNode *node = init_declarator(ident.lexeme, pointer_depth);
-//     return node;
-// }
-
-static AstArrayDeclaration *init_array_declaration(char *identifier, TypeSpecifier type_specs, AstNode **dimensions, int dimension_count) {
-    AstArrayDeclaration *arr_decl = malloc(sizeof(AstArrayDeclaration));
-    arr_decl->identifier = strdup(identifier);
+static AstArrayDeclaration *init_array_declaration(Parser *parser, SymbolId identifier, TypeSpecifier type_specs, NodeId *dimensions, int dimension_count) {
+    AstArrayDeclaration *arr_decl = arena_alloc(&parser->arena, sizeof(AstArrayDeclaration));
+    arr_decl->identifier = identifier;
     arr_decl->type_specs = type_specs;
     arr_decl->dimension_count = dimension_count;
     arr_decl->dimensions = dimensions;
@@ -1860,7 +1640,7 @@ static AstArrayDeclaration *init_array_declaration(char *identifier, TypeSpecifi
     return arr_decl;
 }
 
-static AstNode *parse_array_declaration(Parser *parser, TypeSpecifier type_specs) {
+static NodeId parse_array_declaration(Parser *parser, TypeSpecifier type_specs) {
     advance(parser);
 
     Token array_identifier = current_token(parser);
@@ -1869,14 +1649,14 @@ static AstNode *parse_array_declaration(Parser *parser, TypeSpecifier type_specs
     }
     advance(parser);
 
-    AstNode **dimensions = malloc(sizeof(AstNode *));
+    NodeId *dimensions = arena_alloc(&parser->arena, sizeof(NodeId));
     int dimension_count = 0;
     int capacity = 1;
 
     do {
         advance(parser);
-        AstNode *dimension = parse_expression(parser);
-        if (!dimension) return NULL;
+        NodeId dimension = parse_expression(parser);
+        if (!dimension) return NO_NODE;
 
         if (!expect(TOKEN_SQUARE_BRACKET_RIGHT, parser)) {
             return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
@@ -1884,7 +1664,7 @@ static AstNode *parse_array_declaration(Parser *parser, TypeSpecifier type_specs
 
         if (dimension_count >= capacity) {
             capacity *= 2;
-            dimensions = realloc(dimensions, capacity * sizeof(AstNode *));
+            dimensions = arena_realloc(&parser->arena, dimensions, capacity * sizeof(NodeId));
         }
         dimensions[dimension_count++] = dimension;
 
@@ -1894,16 +1674,16 @@ static AstNode *parse_array_declaration(Parser *parser, TypeSpecifier type_specs
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
-    AstArrayDeclaration *arr_decl = init_array_declaration(array_identifier.lexeme, type_specs, dimensions, 
+    AstArrayDeclaration *arr_decl = init_array_declaration(parser, lexeme_intern(parser, array_identifier), type_specs, dimensions, 
     dimension_count);
-    AstNode *node = init_node(arr_decl, AST_ARRAY_DECLARATION);
+    NodeId node = init_node(parser, arr_decl, AST_ARRAY_DECLARATION);
 
     return node;
 }
 
-static AstFunctionPointerDeclaration *init_function_pointer(char *identifier, TypeSpecifier return_type_specs, TypeSpecifier *param_type_specs, int param_count) {
-    AstFunctionPointerDeclaration *fptr = malloc(sizeof(AstFunctionPointerDeclaration));
-    fptr->identifier = strdup(identifier);
+static AstFunctionPointerDeclaration *init_function_pointer(Parser *parser, SymbolId identifier, TypeSpecifier return_type_specs, TypeSpecifier *param_type_specs, int param_count) {
+    AstFunctionPointerDeclaration *fptr = arena_alloc(&parser->arena, sizeof(AstFunctionPointerDeclaration));
+    fptr->identifier = identifier;
     fptr->param_type_specs = param_type_specs;
     fptr->param_count = param_count;
     fptr->return_type_specs = return_type_specs;
@@ -1911,7 +1691,7 @@ static AstFunctionPointerDeclaration *init_function_pointer(char *identifier, Ty
     return fptr;
 }
 
-static AstNode *parse_function_pointer_declaration(Parser *parser, TypeSpecifier type_specs) {
+static NodeId parse_function_pointer_declaration(Parser *parser, TypeSpecifier type_specs) {
     advance(parser);
 
     if (!expect(TOKEN_LEFT_PAREN, parser)) {
@@ -1938,14 +1718,14 @@ static AstNode *parse_function_pointer_declaration(Parser *parser, TypeSpecifier
 
     int capacity = 1;
     int count = 0;
-    TypeSpecifier *specs = malloc(sizeof(TypeSpecifier) * capacity);
+    TypeSpecifier *specs = arena_alloc(&parser->arena, sizeof(TypeSpecifier) * capacity);
 
     while (!match(TOKEN_RIGHT_PAREN, parser)) {
         TypeSpecifier type_specs = parse_type_specifiers(parser);
 
         if (count >= capacity) {
             capacity *= 2;
-            specs = realloc(specs, sizeof(TypeSpecifier) * capacity);
+            specs = arena_realloc(&parser->arena, specs, sizeof(TypeSpecifier) * capacity);
         }
         specs[count++] = type_specs;
 
@@ -1964,13 +1744,13 @@ static AstNode *parse_function_pointer_declaration(Parser *parser, TypeSpecifier
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    AstFunctionPointerDeclaration *fptr = init_function_pointer(identifier.lexeme, type_specs, specs, count);
-    AstNode *node = init_node(fptr, AST_FUNCTION_POINTER_DECLARATION);
+    AstFunctionPointerDeclaration *fptr = init_function_pointer(parser, lexeme_intern(parser, identifier), type_specs, specs, count);
+    NodeId node = init_node(parser, fptr, AST_FUNCTION_POINTER_DECLARATION);
 
     return node;
 }
 
-static AstNode *parse_type_statement(Parser *parser) {
+static NodeId parse_type_statement(Parser *parser) {
     TypeSpecifier type_specs = parse_type_specifiers(parser);
 
     if (match(TOKEN_LEFT_PAREN, parser)) {
@@ -2019,27 +1799,27 @@ static AstNode *parse_type_statement(Parser *parser) {
     }
 }
 
-static AstNode *parse_empty_expression(Parser *parser) {
-    AstNode *expr = parse_expression(parser);
-    if (!expr) return parser_err(PARSE_ERR_EXPECTED_EXPRESSION, parser);
+static NodeId parse_empty_expression(Parser *parser) {
+    // parse_expression has set why it failed
+    NodeId expr = parse_expression(parser);
+    if (!expr) return NO_NODE;
 
     if (!expect(TOKEN_SEMICOLON, parser)) {
-        free_node(expr);
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
     return expr;
 }
 
-static AstAssignment *init_assignment(char *identifier, AstNode *value) {
-    AstAssignment *assign = malloc(sizeof(AstAssignment));
-    assign->identifier = strdup(identifier);
-    assign->value = value;
+static AstAssignment init_assignment(SymbolId identifier, NodeId value) {
+    AstAssignment assign;
+    assign.identifier = identifier;
+    assign.value = value;
 
     return assign;
 }
 
-static AstNode *parse_assignment(Parser *parser) {
+static NodeId parse_assignment(Parser *parser) {
     Token id = current_token(parser);
     advance(parser);
 
@@ -2047,20 +1827,20 @@ static AstNode *parse_assignment(Parser *parser) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    AstNode *expr = parse_expression(parser);
+    NodeId expr = parse_expression(parser);
 
     if (!expect(TOKEN_SEMICOLON, parser)) {
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
-    AstAssignment *assign = init_assignment(id.lexeme, expr);
-    AstNode *node = init_node(assign, AST_ASSIGNMENT);
+    AstAssignment assign = init_assignment(lexeme_intern(parser, id), expr);
+    NodeId node = init_node(parser, &assign, AST_ASSIGNMENT);
 
     return node;
 }
 
-static AstIfStatement *init_if_statement(AstNode **body, AstNode **else_body, AstNode *condition, int body_count, int else_body_count) {
-    AstIfStatement *if_stmt = malloc(sizeof(AstIfStatement));
+static AstIfStatement *init_if_statement(Parser *parser, NodeId *body, NodeId *else_body, NodeId condition, int body_count, int else_body_count) {
+    AstIfStatement *if_stmt = arena_alloc(&parser->arena, sizeof(AstIfStatement));
     if_stmt->condition = condition;
     if_stmt->body = body;
     if_stmt->body_count = body_count;
@@ -2070,14 +1850,14 @@ static AstIfStatement *init_if_statement(AstNode **body, AstNode **else_body, As
     return if_stmt;
 }
 
-static AstNode *parse_if(Parser *parser) {
+static NodeId parse_if(Parser *parser) {
     advance(parser);
 
     if (!expect(TOKEN_LEFT_PAREN, parser)) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    AstNode *if_condition = parse_expression(parser);
+    NodeId if_condition = parse_expression(parser);
     if (!if_condition) {
         return parser_err(PARSE_ERR_EXPECTED_EXPRESSION, parser);
     }
@@ -2090,66 +1870,40 @@ static AstNode *parse_if(Parser *parser) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    int body_count = 0;
-    int body_capacity = 1;
-    AstNode **body = malloc(sizeof(AstNode *));
-
-    do {
-        if (match(TOKEN_RIGHT_BRACE, parser)) break;
-        AstNode *statement = parse_statement(parser);
-
-        if (body_count >= body_capacity) {
-            body_capacity *= 2;
-            body = realloc(body, body_capacity * sizeof(AstNode *));
-        }
-        body[body_count++] = statement;
+    BodyFrame *frame = push_body(parser, BODY_IF);
+    frame->condition = if_condition;
+    start_body(parser, frame);
 
-    } while (!match(TOKEN_RIGHT_BRACE, parser));
+    return BODY_OPENED;
+}
 
+// the then body has been read, an else body may follow it
+static NodeId close_then_body(Parser *parser, BodyFrame *frame) {
     if (!expect(TOKEN_RIGHT_BRACE, parser)) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    int else_body_count = 0;
-    int else_body_capacity = 1;
-    AstNode **else_body = malloc(sizeof(AstNode *));
-
-    int has_else = 0;
+    frame->then_body = frame->body;
+    frame->then_count = frame->body_count;
+    start_body(parser, frame);
 
     if (match(TOKEN_ELSE, parser)) {
-        has_else = 1;
         advance(parser);
-        
+
         if (!expect(TOKEN_LEFT_BRACE, parser)) {
             return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
         }
-            
-        do {
-            if (match(TOKEN_RIGHT_BRACE, parser)) break;
-            
-            AstNode *statement = parse_statement(parser);
-
-            if (else_body_count >= else_body_capacity) {
-                else_body_capacity *= 2;
-                else_body = realloc(else_body, else_body_capacity * sizeof(AstNode *));
-            }
-            else_body[else_body_count++] = statement;
-
-        } while (!match(TOKEN_RIGHT_BRACE, parser));
-    }
 
-    if (has_else) {
-        advance(parser);
+        frame->kind = BODY_ELSE;
+        return BODY_OPENED;
     }
 
-    AstIfStatement *if_stmt = init_if_statement(body, else_body, if_condition, body_count, else_body_count);
-    AstNode *node = init_node(if_stmt, AST_IF);
-
-    return node;
+    AstIfStatement *if_stmt = init_if_statement(parser, frame->then_body, frame->body, frame->condition, frame->then_count, 0);
+    return init_node(parser, if_stmt, AST_IF);
 }
 
-static AstWhile *init_while(AstNode *condition, AstNode **body, int body_count) {
-    AstWhile *while_stmt = malloc(sizeof(AstWhile));
+static AstWhile *init_while(Parser *parser, NodeId condition, NodeId *body, int body_count) {
+    AstWhile *while_stmt = arena_alloc(&parser->arena, sizeof(AstWhile));
     while_stmt->condition = condition;
     while_stmt->body = body;
     while_stmt->body_count = body_count;
@@ -2157,14 +1911,14 @@ static AstWhile *init_while(AstNode *condition, AstNode **body, int body_count)
     return while_stmt;
 }
 
-static AstNode *parse_while(Parser *parser) {
+static NodeId parse_while(Parser *parser) {
     advance(parser);
 
     if (!expect(TOKEN_LEFT_PAREN, parser)) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    AstNode *condition = parse_expression(parser);
+    NodeId condition = parse_expression(parser);
     if (!condition) {
         return parser_err(PARSE_ERR_EXPECTED_EXPRESSION, parser);
     }
@@ -2177,60 +1931,43 @@ static AstNode *parse_while(Parser *parser) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    int body_count = 0;
-    int body_capacity = 1;
-    AstNode **body = malloc(sizeof(AstNode *));
-
-    do {
-        if (match(TOKEN_RIGHT_BRACE, parser)) break;
-        AstNode *statement = parse_statement(parser);
-
-        if (body_count >= body_capacity) {
-            body_capacity *= 2;
-            body = realloc(body, body_capacity * sizeof(AstNode *));
-        }
-        body[body_count++] = statement;
-
-    } while (!match(TOKEN_RIGHT_BRACE, parser));
-
-    advance(parser);
-
-    AstWhile *while_stmt = init_while(condition, body, body_count);
-    AstNode *node = init_node(while_stmt, AST_WHILE);
+    BodyFrame *frame = push_body(parser, BODY_WHILE);
+    frame->condition = condition;
+    start_body(parser, frame);
 
-    return node;
+    return BODY_OPENED;
 }
 
-static AstNode *parse_break(Parser *parser) {
+static NodeId parse_break(Parser *parser) {
     advance(parser);
 
     if (!expect(TOKEN_SEMICOLON, parser)) {
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
-    AstBreak *brk = malloc(sizeof(AstBreak));
-    AstNode *node = init_node(brk, AST_BREAK);
-    brk->dummy = 0;
+    AstBreak brk;
+    brk.dummy = 0;
+    NodeId node = init_node(parser, &brk, AST_BREAK);
 
     return node;
 }
 
-static AstNode *parse_continue(Parser *parser) {
+static NodeId parse_continue(Parser *parser) {
     advance(parser);
 
     if (!expect(TOKEN_SEMICOLON, parser)) {
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
-    AstContinue *cont = malloc(sizeof(AstContinue));
-    AstNode *node = init_node(cont, AST_CONTINUE);
-    cont->dummy = 0;
+    AstContinue cont;
+    cont.dummy = 0;
+    NodeId node = init_node(parser, &cont, AST_CONTINUE);
 
     return node;
 }
 
-static AstFor *init_for(AstNode *initializer, AstNode *condition, AstNode *alteration, AstNode *block) {
-    AstFor *for_stmt = malloc(sizeof(AstFor));
+static AstFor *init_for(Parser *parser, NodeId initializer, NodeId condition, NodeId alteration, NodeId block) {
+    AstFor *for_stmt = arena_alloc(&parser->arena, sizeof(AstFor));
     for_stmt->condition = condition;
     for_stmt->initializer = initializer;
     for_stmt->alteration = alteration;
@@ -2239,61 +1976,41 @@ static AstFor *init_for(AstNode *initializer, AstNode *condition, AstNode *alter
     return for_stmt;
 }
 
-static AstBlock *init_block(AstNode **body, int body_count) {
-    AstBlock *block = malloc(sizeof(AstBlock));
+static AstBlock *init_block(Parser *parser, NodeId *body, int body_count) {
+    AstBlock *block = arena_alloc(&parser->arena, sizeof(AstBlock));
     block->body = body;
     block->body_count = body_count;
 
     return block;
 }
 
-static AstNode *parse_block(Parser *parser) {
-    if (!expect(TOKEN_LEFT_BRACE, parser)) {
-        return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
-    }
-
-    int body_count = 0;
-    int body_capacity = 1;
-    AstNode **body = malloc(sizeof(AstNode *));
-
-    do {
-        if (match(TOKEN_RIGHT_BRACE, parser)) break;
-        AstNode *statement = parse_statement(parser);
-
-        if (body_count >= body_capacity) {
-            body_capacity *= 2;
-            body = realloc(body, body_capacity * sizeof(AstNode *));
-        }
-        body[body_count++] = statement;
-
-    } while (!match(TOKEN_RIGHT_BRACE, parser));
-
+static NodeId close_block(Parser *parser, BodyFrame *frame) {
     if (!expect(TOKEN_RIGHT_BRACE, parser)) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    AstBlock *block = init_block(body, body_count);
-    AstNode *node = init_node(block, AST_BLOCK);
+    AstBlock *block = init_block(parser, frame->body, frame->body_count);
+    NodeId node = init_node(parser, block, AST_BLOCK);
 
     return node;
 }
 
-static AstNode *parse_for(Parser *parser) {
+static NodeId parse_for(Parser *parser) {
     advance(parser);
 
     if (!expect(TOKEN_LEFT_PAREN, parser)) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    AstNode *initializer = NULL;
-    AstNode *condition = NULL;
-    AstNode *alteration = NULL;
+    NodeId initializer = NO_NODE;
+    NodeId condition = NO_NODE;
+    NodeId alteration = NO_NODE;
 
     if (match(TOKEN_SEMICOLON, parser)) {
         advance(parser);
     } else {
-        AstNode *expr = parse_statement(parser);
-        if (!expr) return NULL;
+        NodeId expr = parse_statement(parser);
+        if (!expr) return NO_NODE;
 
         initializer = expr;
     }
@@ -2301,16 +2018,16 @@ static AstNode *parse_for(Parser *parser) {
     if (match(TOKEN_SEMICOLON, parser)) {
         // do not advance for this semicolon, there are only two in a for loop construct
     } else {
-        AstNode *expr = parse_expression(parser);
-        if (!expr) return NULL;
+        NodeId expr = parse_expression(parser);
+        if (!expr) return NO_NODE;
 
         condition = expr;
     }
     advance(parser);
 
     if (!match(TOKEN_RIGHT_PAREN, parser)) {
-        AstNode *expr = parse_expression(parser);
-        if (!expr) return NULL;
+        NodeId expr = parse_expression(parser);
+        if (!expr) return NO_NODE;
 
         alteration = expr;
     }
@@ -2319,28 +2036,43 @@ static AstNode *parse_for(Parser *parser) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    AstNode *block = parse_block(parser);
-    if (!block) return NULL;
+    if (!expect(TOKEN_LEFT_BRACE, parser)) {
+        return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+    }
 
-    AstFor *for_stmt = init_for(initializer, condition, alteration, block);
-    AstNode *node = init_node(for_stmt, AST_FOR);
+    BodyFrame *frame = push_body(parser, BODY_FOR);
+    frame->initializer = initializer;
+    frame->condition = condition;
+    frame->alteration = alteration;
+    start_body(parser, frame);
 
-    return node; 
+    return BODY_OPENED;
 }
 
-static AstDoWhile *init_do_while(AstNode *condition, AstNode *block) {
-    AstDoWhile *do_while = malloc(sizeof(AstDoWhile));
+static AstDoWhile *init_do_while(Parser *parser, NodeId condition, NodeId block) {
+    AstDoWhile *do_while = arena_alloc(&parser->arena, sizeof(AstDoWhile));
     do_while->condition = condition;
-    do_while->block = block->as.block;
+    do_while->block = ast_node(parser, block)->as.block;
 
     return do_while;
 }
 
-static AstNode *parse_do_while(Parser *parser) {
+static NodeId parse_do_while(Parser *parser) {
     advance(parser);
 
-    AstNode *block = parse_block(parser);
-    if (!block) return NULL;
+    if (!expect(TOKEN_LEFT_BRACE, parser)) {
+        return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+    }
+
+    BodyFrame *frame = push_body(parser, BODY_DO_WHILE);
+    start_body(parser, frame);
+
+    return BODY_OPENED;
+}
+
+static NodeId close_do_while(Parser *parser, BodyFrame *frame) {
+    NodeId block = close_block(parser, frame);
+    if (!block) return NO_NODE;
 
     if (!expect(TOKEN_WHILE, parser)) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
@@ -2350,7 +2082,7 @@ static AstNode *parse_do_while(Parser *parser) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
     }
 
-    AstNode *condition = parse_expression(parser);
+    NodeId condition = parse_expression(parser);
 
     if (!expect(TOKEN_RIGHT_PAREN, parser)) {
         return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
@@ -2360,31 +2092,31 @@ static AstNode *parse_do_while(Parser *parser) {
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
-    AstDoWhile *do_while = init_do_while(condition, block);
-    AstNode *node = init_node(do_while, AST_DO_WHILE);
+    AstDoWhile *do_while = init_do_while(parser, condition, block);
+    NodeId node = init_node(parser, do_while, AST_DO_WHILE);
 
     return node;
 }
 
-static AstStruct *init_struct(char *name, AstNode **fields, int field_count) {
-    AstStruct *a_struct = malloc(sizeof(AstStruct));
-    a_struct->name = strdup(name);
+static AstStruct *init_struct(Parser *parser, SymbolId name, NodeId *fields, int field_count) {
+    AstStruct *a_struct = arena_alloc(&parser->arena, sizeof(AstStruct));
+    a_struct->name = name;
     a_struct->fields = fields;
     a_struct->field_count = field_count;
 
     return a_struct;
 }
 
-static AstUnion *init_union(char *name, AstNode **fields, int field_count) {
-    AstUnion *a_union = malloc(sizeof(AstUnion));
-    a_union->name = strdup(name);
+static AstUnion *init_union(Parser *parser, SymbolId name, NodeId *fields, int field_count) {
+    AstUnion *a_union = arena_alloc(&parser->arena, sizeof(AstUnion));
+    a_union->name = name;
     a_union->fields = fields;
     a_union->field_count = field_count;
 
     return a_union;
 }
 
-static AstNode *parse_struct_or_union(Parser *parser) {
+static NodeId parse_struct_or_union(Parser *parser) {
     int is_union = 0;
     if (match(TOKEN_UNION, parser)) {
         is_union = 1;
@@ -2403,17 +2135,17 @@ static AstNode *parse_struct_or_union(Parser *parser) {
 
     int member_capacity = 1;
     int member_count = 0;
-    AstNode **members = malloc(sizeof(AstNode *) * member_capacity);
+    NodeId *members = arena_alloc(&parser->arena, sizeof(NodeId) * member_capacity);
 
     do {
-        AstNode *member = parse_statement(parser);
-        if (member->type != AST_VARIABLE_DECLARATION) {
+        NodeId member = parse_statement(parser);
+        if (!member || ast_node(parser, member)->type != AST_VARIABLE_DECLARATION) {
             return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
         }
 
         if (member_count >= member_capacity) {
             member_capacity *= 2;
-            members = realloc(members, sizeof(AstNode *) * member_capacity);
+            members = arena_realloc(&parser->arena, members, sizeof(NodeId) * member_capacity);
         }
         members[member_count++] = member;
 
@@ -2424,28 +2156,28 @@ static AstNode *parse_struct_or_union(Parser *parser) {
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
-    AstNode *node;
+    NodeId node;
     if (!is_union) {
-        AstStruct *a_struct = init_struct(name_token.lexeme, members, member_count);
-        node = init_node(a_struct, AST_STRUCT);
+        AstStruct *a_struct = init_struct(parser, lexeme_intern(parser, name_token), members, member_count);
+        node = init_node(parser, a_struct, AST_STRUCT);
     } else {
-        AstUnion *a_union = init_union(name_token.lexeme, members, member_count);
-        node = init_node(a_union, AST_UNION);
+        AstUnion *a_union = init_union(parser, lexeme_intern(parser, name_token), members, member_count);
+        node = init_node(parser, a_union, AST_UNION);
     }
 
     return node;
 }
 
-static AstEnum *init_enum(char *name, AstEnumValue **values, int value_count) {
-    AstEnum *an_enum = malloc(sizeof(AstEnum));
-    an_enum->name = strdup(name);
+static AstEnum *init_enum(Parser *parser, SymbolId name, AstEnumValue **values, int value_count) {
+    AstEnum *an_enum = arena_alloc(&parser->arena, sizeof(AstEnum));
+    an_enum->name = name;
     an_enum->values = values;
     an_enum->value_count = value_count;
 
     return an_enum;
 }
 
-static AstNode *parse_enum(Parser *parser) {
+static NodeId parse_enum(Parser *parser) {
     advance(parser);
 
     Token enum_name_token = current_token(parser);
@@ -2460,7 +2192,7 @@ static AstNode *parse_enum(Parser *parser) {
 
     int value_capacity = 1;
     int value_count = 0;
-    AstEnumValue **values = malloc(sizeof(AstEnumValue) * value_capacity);
+    AstEnumValue **values = arena_alloc(&parser->arena, sizeof(AstEnumValue *) * value_capacity);
 
     int current_value = 0;
     while (!match(TOKEN_RIGHT_BRACE, parser)) {
@@ -2481,16 +2213,21 @@ static AstNode *parse_enum(Parser *parser) {
                 return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
             }
 
-            enum_value = atoi(current_token(parser).lexeme);
+            enum_value = lexeme_to_int(parser, current_token(parser), 10);
             has_explicit_value = 1;
             advance(parser);
         }
 
-        AstEnumValue *enum_val = malloc(sizeof(AstEnumValue));
-        enum_val->name = strdup(identifier.lexeme);
+        AstEnumValue *enum_val = arena_alloc(&parser->arena, sizeof(AstEnumValue));
+        enum_val->name = lexeme_intern(parser, identifier);
         enum_val->explicit_value = has_explicit_value;
         enum_val->value = enum_value;
 
+        if (value_count >= value_capacity) {
+            value_capacity *= 2;
+            values = arena_realloc(&parser->arena, values, sizeof(AstEnumValue *) * value_capacity);
+        }
+
         values[value_count++] = enum_val;
         current_value = enum_value + 1;
 
@@ -2509,21 +2246,21 @@ static AstNode *parse_enum(Parser *parser) {
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
-    AstEnum *an_enum = init_enum(enum_name_token.lexeme, values, value_count);
-    AstNode *node = init_node(an_enum, AST_ENUM);
+    AstEnum *an_enum = init_enum(parser, lexeme_intern(parser, enum_name_token), values, value_count);
+    NodeId node = init_node(parser, an_enum, AST_ENUM);
 
     return node;
 }
 
-static AstTypedef *init_typedef(char *identifier, TypeSpecifier type_specs) {
-    AstTypedef *type_def = malloc(sizeof(AstTypedef));
-    type_def->identifier = strdup(identifier);
+static AstTypedef *init_typedef(Parser *parser, SymbolId identifier, TypeSpecifier type_specs) {
+    AstTypedef *type_def = arena_alloc(&parser->arena, sizeof(AstTypedef));
+    type_def->identifier = identifier;
     type_def->type_specs = type_specs;
 
     return type_def;
 }
 
-static AstNode *parse_typedef(Parser *parser) {
+static NodeId parse_typedef(Parser *parser) {
     advance(parser);
 
     TypeSpecifier type_specs = parse_type_specifiers(parser);
@@ -2537,22 +2274,22 @@ static AstNode *parse_typedef(Parser *parser) {
         return parser_err(PARSE_ERR_EXPECTED_SEMICOLON, parser);
     }
 
-    AstTypedef *type_def = init_typedef(identifier.lexeme, type_specs);
-    AstNode *node = init_node(type_def, AST_TYPEDEF);
+    AstTypedef *type_def = init_typedef(parser, lexeme_intern(parser, identifier), type_specs);
+    NodeId node = init_node(parser, type_def, AST_TYPEDEF);
 
     return node;
 }
 
-static AstNode *parse_typedef_declaration(Parser *parser) {
+static NodeId parse_typedef_declaration(Parser *parser) {
 
     TypeSpecifier type_specs = init_type_specifier();
-    type_specs.type = current_token(parser).type;
+    type_specs.type = current_type(parser);
 
     return parse_variable_declaration(parser, type_specs);
 }
 
-static AstSwitch *init_switch(AstNode *expression, AstCase **cases, int case_count) {
-    AstSwitch *switch_stmt = malloc(sizeof(AstSwitch));
+static AstSwitch *init_switch(Parser *parser, NodeId expression, AstCase **cases, int case_count) {
+    AstSwitch *switch_stmt = arena_alloc(&parser->arena, sizeof(AstSwitch));
     switch_stmt->cases = cases;
     switch_stmt->expression = expression;
     switch_stmt->case_count = case_count;
@@ -2560,142 +2297,143 @@ static AstSwitch *init_switch(AstNode *expression, AstCase **cases, int case_cou
     return switch_stmt;
 }
 
-static AstNode *parse_switch(Parser *parser) {
-    advance(parser);
-
-    if (!expect(TOKEN_LEFT_PAREN, parser)) {
-        return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
-    }
-
-    AstNode *expression = parse_expression(parser);
-    if (!expression) return NULL;
-
-    if (!expect(TOKEN_RIGHT_PAREN, parser)) {
-        return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
-    }
-
-    if (match(TOKEN_SEMICOLON, parser)) {
-        advance(parser);
-
-        AstSwitch *switch_stmt = init_switch(expression, NULL, 0);
-        AstNode *node = init_node(switch_stmt, AST_SWITCH);
-
-        return node;
-    }
+static void add_case(Parser *parser, BodyFrame *frame, NodeId value, AstBlock *block) {
+    AstCase *switch_case = arena_alloc(&parser->arena, sizeof(AstCase));
+    switch_case->value = value;
+    switch_case->block = block;
 
-    if (!expect(TOKEN_LEFT_BRACE, parser)) {
-        return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+    if (frame->case_count >= frame->case_capacity) {
+        frame->case_capacity = frame->case_capacity ? frame->case_capacity * 2 : 4;
+        frame->cases = arena_realloc(&parser->arena, frame->cases, frame->case_capacity * sizeof(AstCase *));
     }
-    
-    if (match(TOKEN_RIGHT_BRACE, parser)) {
-        advance(parser);
+    frame->cases[frame->case_count++] = switch_case;
+}
 
-        AstSwitch *switch_stmt = init_switch(expression, NULL, 0);
-        AstNode *node = init_node(switch_stmt, AST_SWITCH);
+// consumes the token after the closing brace as well
+static NodeId close_switch(Parser *parser, BodyFrame *frame) {
+    advance(parser);
 
-        return node;
-    }
+    AstSwitch *switch_stmt = init_switch(parser, frame->condition, frame->cases, frame->case_count);
+    NodeId node = init_node(parser, switch_stmt, AST_SWITCH);
 
-    AstCase **cases = malloc(sizeof(AstCase *));
-    int count = 0;
-    int capacity = 1;
+    return node;
+}
 
-    do {
+// reads case labels up to one with statements after it, whose body the frame
+// then collects
+static NodeId parse_case_label(Parser *parser, BodyFrame *frame) {
+    while (1) {
         int is_default = 0;
         if (match(TOKEN_DEFAULT, parser)) {
             is_default = 1;
         }
         advance(parser);
 
-        AstNode *value = NULL;
+        NodeId value = NO_NODE;
         if (!is_default) {
             value = parse_expression(parser);
-            if (!expect(TOKEN_COLON, parser)) {
-                return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
-            }
-        } else {
-            if (!expect(TOKEN_COLON, parser))
-                return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+        }
+
+        if (!expect(TOKEN_COLON, parser)) {
+            return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
         }
 
         if (match(TOKEN_RIGHT_BRACE, parser)) {
             advance(parser);
+            add_case(parser, frame, value, NULL);
 
-            AstCase *switch_case = malloc(sizeof(AstCase));
-            switch_case->value = value;
-            switch_case->block = NULL;
-
-            cases[count++] = switch_case;
-            break;
+            return close_switch(parser, frame);
         }
 
         if (match(TOKEN_CASE, parser) || match(TOKEN_DEFAULT, parser)) {
-            AstCase *switch_case = malloc(sizeof(AstCase));
-            switch_case->value = value;
-            switch_case->block = NULL;
-
-            cases[count++] = switch_case;
+            add_case(parser, frame, value, NULL);
             continue;
         }
 
-        int is_brace_block = 0;
+        frame->is_brace_block = 0;
         if (match(TOKEN_LEFT_BRACE, parser)) {
             advance(parser);
-            is_brace_block = 1;
-        } 
+            frame->is_brace_block = 1;
+        }
 
-        AstNode **body = NULL;
-        int body_count = 0;
-        int body_capacity = 0;
+        frame->case_value = value;
+        frame->body = NULL;
+        frame->body_count = 0;
+        frame->body_capacity = 0;
 
-        do {
-            AstNode *statement = parse_statement(parser);
-            if (!statement) {
-                return NULL;
-            }
+        return BODY_OPENED;
+    }
+}
 
-            if (body_count >= body_capacity) {
-                body_capacity = body_capacity ? body_capacity * 2 : 4;
-                body = realloc(body, body_capacity * sizeof(AstNode *));
-            }
-            body[body_count++] = statement;
-            
-        } while (
-            !match(TOKEN_CASE, parser) && 
-            !match(TOKEN_DEFAULT, parser) &&
-            !match(TOKEN_RIGHT_BRACE, parser)
-        );
+static NodeId close_case(Parser *parser, BodyFrame *frame) {
+    AstBlock *block = arena_alloc(&parser->arena, sizeof(AstBlock));
+    block->body = frame->body;
+    block->body_count = frame->body_count;
 
-        AstBlock *block = malloc(sizeof(AstBlock));
-        block->body = body;
-        block->body_count = body_count;
-        
-        AstCase *switch_case = malloc(sizeof(AstCase));
-        switch_case->value = value;
-        switch_case->block = block;
+    add_case(parser, frame, frame->case_value, block);
 
-        if (count >= capacity) {
-            capacity = capacity ? capacity * 2 : 4;
-            cases = realloc(cases, capacity * sizeof(AstCase *));
+    if (frame->is_brace_block) {
+        if (!match(TOKEN_RIGHT_BRACE, parser)) {
+            return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
         }
-        cases[count++] = switch_case;
+    }
 
-        if (is_brace_block) {
-            if (!match(TOKEN_RIGHT_BRACE, parser)) {
-                return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
-            }
-        }
+    if (match(TOKEN_RIGHT_BRACE, parser)) {
+        return close_switch(parser, frame);
+    }
 
-    } while (!match(TOKEN_RIGHT_BRACE, parser));
+    return parse_case_label(parser, frame);
+}
+
+static NodeId parse_switch(Parser *parser) {
     advance(parser);
 
-    AstSwitch *switch_stmt = init_switch(expression, cases, count);
-    AstNode *node = init_node(switch_stmt, AST_SWITCH);
+    if (!expect(TOKEN_LEFT_PAREN, parser)) {
+        return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+    }
+
+    NodeId expression = parse_expression(parser);
+    if (!expression) return NO_NODE;
+
+    if (!expect(TOKEN_RIGHT_PAREN, parser)) {
+        return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+    }
+
+    if (match(TOKEN_SEMICOLON, parser)) {
+        advance(parser);
+
+        AstSwitch *switch_stmt = init_switch(parser, expression, NULL, 0);
+        NodeId node = init_node(parser, switch_stmt, AST_SWITCH);
+
+        return node;
+    }
+
+    if (!expect(TOKEN_LEFT_BRACE, parser)) {
+        return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+    }
+    
+    if (match(TOKEN_RIGHT_BRACE, parser)) {
+        advance(parser);
+
+        AstSwitch *switch_stmt = init_switch(parser, expression, NULL, 0);
+        NodeId node = init_node(parser, switch_stmt, AST_SWITCH);
+
+        return node;
+    }
+
+    BodyFrame *frame = push_body(parser, BODY_CASE);
+    frame->condition = expression;
+    frame->case_capacity = 1;
+    frame->case_count = 0;
+    frame->cases = arena_alloc(&parser->arena, sizeof(AstCase *) * frame->case_capacity);
+
+    NodeId node = parse_case_label(parser, frame);
+    if (node != BODY_OPENED) parser->open_body_count--;
 
     return node;
 }
 
-static AstNode *parse_statement(Parser *parser) {
+static NodeId begin_statement(Parser *parser) {
     if (is_valid_type(current_token(parser))) {
         return parse_type_statement(parser);
     }
@@ -2768,19 +2506,112 @@ static AstNode *parse_statement(Parser *parser) {
     }
 }
 
+static int body_ended(Parser *parser, BodyFrame *frame) {
+    if (frame->kind == BODY_CASE) {
+        return match(TOKEN_CASE, parser) || match(TOKEN_DEFAULT, parser) || match(TOKEN_RIGHT_BRACE, parser);
+    }
+
+    return match(TOKEN_RIGHT_BRACE, parser);
+}
+
+// makes the statement of a frame whose body has ended. returns BODY_OPENED
+// when the frame goes on to another body, an else or the next case
+static NodeId close_body(Parser *parser, BodyFrame *frame) {
+    switch (frame->kind) {
+        case BODY_FUNCTION: {
+            AstFunctionDeclaration *func = init_function_node(parser, 
+                frame->body, frame->body_count, lexeme_intern(parser, frame->identifier),
+                frame->params, frame->param_count, frame->is_void_params
+            );
+            func->type_specifier = frame->type_specs;
+
+            NodeId node = init_node(parser, func, AST_FUNCTION);
+
+            if (!expect(TOKEN_RIGHT_BRACE, parser)) {
+                return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+            }
+
+            return node;
+        }
+        case BODY_IF: {
+            return close_then_body(parser, frame);
+        }
+        case BODY_ELSE: {
+            advance(parser);
+
+            AstIfStatement *if_stmt = init_if_statement(parser, frame->then_body, frame->body, frame->condition, frame->then_count, frame->body_count);
+            return init_node(parser, if_stmt, AST_IF);
+        }
+        case BODY_WHILE: {
+            advance(parser);
+
+            AstWhile *while_stmt = init_while(parser, frame->condition, frame->body, frame->body_count);
+            return init_node(parser, while_stmt, AST_WHILE);
+        }
+        case BODY_FOR: {
+            NodeId block = close_block(parser, frame);
+            if (!block) return NO_NODE;
+
+            AstFor *for_stmt = init_for(parser, frame->initializer, frame->condition, frame->alteration, block);
+            return init_node(parser, for_stmt, AST_FOR);
+        }
+        case BODY_DO_WHILE: {
+            return close_do_while(parser, frame);
+        }
+        case BODY_CASE: {
+            return close_case(parser, frame);
+        }
+    }
+
+    return parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+}
+
+// the compound statements being read are kept on parser->open_bodies rather
+// than the native stack, so how deep blocks nest is bounded by the heap.
+// frames below base belong to an enclosing parse_statement
+static NodeId parse_statement(Parser *parser) {
+    int base = parser->open_body_count;
+    NodeId node = begin_statement(parser);
+
+    while (1) {
+        if (!node) {
+            parser->open_body_count = base;
+            return NO_NODE;
+        }
+
+        if (node != BODY_OPENED) {
+            if (parser->open_body_count == base) return node;
+            append_statement(parser, &parser->open_bodies[parser->open_body_count - 1], node);
+        }
+
+        BodyFrame *top = &parser->open_bodies[parser->open_body_count - 1];
+        if (!body_ended(parser, top)) {
+            node = begin_statement(parser);
+            continue;
+        }
+
+        node = close_body(parser, top);
+        if (node && node != BODY_OPENED) parser->open_body_count--;
+    }
+}
+
+void add_declaration(Parser *parser, NodeId node) {
+    if (parser->node_count >= parser->node_capacity) {
+        parser->node_capacity *= 2;
+        parser->tree = arena_realloc(&parser->arena, parser->tree, sizeof(NodeId) * parser->node_capacity);
+    }
+
+    parser->tree[parser->node_count++] = node;
+}
+
 void parse_ast(Parser *parser) {
     while (!is_end(parser)) {
-        AstNode *node = parse_statement(parser);
+        NodeId node = parse_statement(parser);
         if (!node) {
             break;
         }
         
-        if (parser->node_count >= parser->node_capacity) {
-            parser->node_capacity *= 2;
-            parser->tree = realloc(parser->tree, sizeof(AstNode *) * parser->node_capacity);
-        }
-    
-        parser->tree[parser->node_count++] = node;
+        add_declaration(parser, node);
 
         if (is_end(parser)) break;
     }
@@ -2791,4 +2622,96 @@ void parse_ast(Parser *parser) {
     }
 
     if (parser->debug) parser_print(parser);
-}
\ No newline at end of file
+}
+
+int parse_function_body(Parser *parser, AstFunctionDeclaration *func) {
+    if (!func->body_deferred) return 1;
+
+    int resume = parser->current;
+    parser->current = func->body_start;
+
+    int body_capacity = 1;
+    int body_count = 0;
+    NodeId *body = arena_alloc(&parser->arena, sizeof(NodeId) * body_capacity);
+
+    while (parser->current < func->body_end) {
+        NodeId node = parse_statement(parser);
+        if (!node) return 0;
+
+        if (body_count >= body_capacity) {
+            body_capacity *= 2;
+            body = arena_realloc(&parser->arena, body, sizeof(NodeId) * body_capacity);
+        }
+        body[body_count++] = node;
+    }
+
+    // a statement ran past the brace that closed the body
+    if (parser->current != func->body_end) {
+        parser_err(PARSE_ERR_INVALID_SYNTAX, parser);
+        return 0;
+    }
+
+    func->body = body;
+    func->body_count = body_count;
+    func->body_deferred = 0;
+    parser->current = resume;
+
+    return 1;
+}
+
+void parse_reachable_bodies(Parser *parser) {
+    SymbolMap functions = {0};
+    for (int i = 0; i < parser->node_count; i++) {
+        AstNode *node = ast_node(parser, parser->tree[i]);
+        if (node->type == AST_FUNCTION && node->as.func->body_deferred) {
+            symbol_map_put(&functions, node->as.func->identifier, i);
+        }
+    }
+
+    // every function is queued at most once
+    int *pending = malloc(sizeof(int) * (parser->node_count + 1));
+    char *queued = calloc(parser->node_count + 1, 1);
+    int pending_count = 0;
+
+    SymbolId entry = symbol_lookup("main", 4);
+    int main_index = entry == NO_SYMBOL ? -1 : symbol_map_get(&functions, entry);
+
+    for (int i = 0; i < parser->node_count; i++) {
+        AstNode *node = ast_node(parser, parser->tree[i]);
+        if (node->type != AST_FUNCTION || !node->as.func->body_deferred) continue;
+
+        if (main_index < 0 || i == main_index) {
+            queued[i] = 1;
+            pending[pending_count++] = i;
+        }
+    }
+
+    const uint8_t *types = parser->tokens->types;
+    while (pending_count > 0) {
+        AstFunctionDeclaration *func = ast_node(parser, parser->tree[pending[--pending_count]])->as.func;
+
+        // a function named anywhere in the body is reachable, called or not, as
+        // it may be taken as a pointer. names never interned cannot be one
+        for (int i = func->body_start; i < func->body_end; i++) {
+            if (types[i] != TOKEN_IDENTIFIER) continue;
+
+            Token token = token_at(parser->tokens, i);
+            SymbolId name = symbol_lookup(lexeme(parser, token), token.length);
+            int index = name == NO_SYMBOL ? -1 : symbol_map_get(&functions, name);
+
+            if (index >= 0 && !queued[index]) {
+                queued[index] = 1;
+                pending[pending_count++] = index;
+            }
+        }
+
+        if (!parse_function_body(parser, func)) {
+            pretty_error(parser);
+            break;
+        }
+    }
+
+    free(pending);
+    free(queued);
+    free_symbol_map(&functions);
+}
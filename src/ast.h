@@ -2,6 +2,9 @@
 #define AST_H
 
 #include "token.h"
+#include "lexer.h"
+#include "intern.h"
+#include "arena.h"
 
 typedef enum {
     AST_VARIABLE_DECLARATION,
@@ -51,6 +54,12 @@ typedef enum {
 
 typedef struct AstNode AstNode;
 
+// a node is addressed by its index in Parser.nodes, which moves as it grows.
+// index 0 is never used, so a zeroed child means there is none
+typedef uint32_t NodeId;
+
+#define NO_NODE 0
+
 typedef struct {
     int       is_const;
     int       is_volatile;
@@ -64,8 +73,8 @@ typedef struct {
 } TypeSpecifier;
 
 typedef struct {
-    AstNode **body;
-    int       body_count;
+    NodeId *body;
+    int     body_count;
 } AstBlock;
 
 typedef struct {
@@ -81,8 +90,8 @@ typedef struct {
 } AstLiteralString;
 
 typedef struct {
-    char       *identifier;
-    AstNode    *value;
+    SymbolId    identifier;
+    NodeId      value;
     int         pointer_level;
 } AstDeclarator;
 
@@ -93,86 +102,92 @@ typedef struct {
 } AstVariableDeclaration;
 
 typedef struct {
-    AstNode *value;
+    NodeId value;
 } AstReturn;
 
 typedef struct {
-    char *name;
+    SymbolId name;
 } AstIdentifier;
 
 typedef struct {
-    AstNode *right;
+    NodeId   right;
     Token    type;
     int      pointer_level;
 } AstCast;
 
 typedef struct {
-    char         *name;
+    SymbolId      name;
     TypeSpecifier type_specifier;
 } AstFunctionParameter;
 
 typedef struct {
-    AstNode *value;
+    NodeId    value;
     AstBlock *block;
 } AstCase;
 
 typedef struct {
-    AstNode *expression;
+    NodeId   expression;
     AstCase **cases;
     int case_count;
 } AstSwitch;
 
 typedef struct {
-    char     *name;
-    AstNode **fields;
+    SymbolId  name;
+    NodeId   *fields;
     int       field_count;
 } AstStruct;
 
 typedef struct {
-    char     *name;
-    AstNode **fields;
+    SymbolId  name;
+    NodeId   *fields;
     int       field_count;
 } AstUnion;
 
 typedef struct {
-    char *name;
-    int   value;
-    int   explicit_value;
+    SymbolId name;
+    int      value;
+    int      explicit_value;
 } AstEnumValue;
 
 typedef struct {
-    char          *name;
+    SymbolId       name;
     AstEnumValue **values;
     int            value_count;
 } AstEnum;
 
 typedef struct {
-    char                  *identifier;
+    SymbolId               identifier;
     AstDeclarator         *declarator;
-    AstNode              **body;
+    NodeId                *body;
     int                    body_count;
     int                    params_count;
     AstFunctionParameter **params;
     int                    is_void_params;
     TypeSpecifier          type_specifier;
+
+    // 1 while the body is only the tokens [body_start, body_end), the last
+    // being its closing brace. parse_function_body builds it
+    int                    body_deferred;
+    int                    body_start;
+    int                    body_end;
 } AstFunctionDeclaration;
 
 typedef struct {
-    char          *identifier;
+    SymbolId       identifier;
     TypeSpecifier  return_type_specs;
     TypeSpecifier *param_type_specs;
     int            param_count;
 } AstFunctionPointerDeclaration;
 
 typedef struct {
-    AstNode *left;
-    Token    op;
-    AstNode *right;
+    NodeId    left;
+    TokenType op;
+    NodeId    right;
 } AstBinaryExpr;
 
 typedef struct {
-    char     *identifier;
-    AstNode **args;
+    NodeId   *args;
+    SymbolId  identifier;
     int       arg_count;
 } AstCallExpr;
 
@@ -182,31 +197,31 @@ typedef struct {
 } AstInlineAsmBlock;
 
 typedef struct {
-    char    *identifier;
-    AstNode *value;
+    SymbolId identifier;
+    NodeId   value;
 } AstAssignment;
 
 typedef struct {
     TypeSpecifier type_specs;
-    char         *identifier;
+    SymbolId      identifier;
 } AstTypedef;
 
 typedef struct {
-    AstNode *condition;
-    AstNode **body;
+    NodeId    condition;
+    NodeId   *body;
     int       body_count;
-    AstNode **else_body;
+    NodeId   *else_body;
     int       else_body_count;
 } AstIfStatement;
 
 typedef struct {
-    AstNode  *condition;
-    AstNode **body;
+    NodeId    condition;
+    NodeId   *body;
     int       body_count;
 } AstWhile;
 
 typedef struct {
-    AstNode  *condition;
+    NodeId    condition;
     AstBlock *block;
 } AstDoWhile;
 
@@ -219,59 +234,63 @@ typedef struct {
 } AstContinue;
 
 typedef struct {
-    AstNode *left;
-    Token    op;
-    int      is_postfix;
+    NodeId    left;
+    TokenType op;
+    int       is_postfix;
 } AstUnary;
 
 typedef struct {
-    AstNode *base;
-    AstNode *index;
+    NodeId base;
+    NodeId index;
 } AstArraySubscript;
 
 typedef struct {
-    AstNode *initializer;
-    AstNode *condition;
-    AstNode *alteration;
-    AstNode *block;
+    NodeId initializer;
+    NodeId condition;
+    NodeId alteration;
+    NodeId block;
 } AstFor;
 
 typedef struct {
-    AstNode *condition;
-    AstNode *true_expr;
-    AstNode *false_expr;
+    NodeId condition;
+    NodeId true_expr;
+    NodeId false_expr;
 } AstTernary;
 
 typedef struct {
-    char         *identifier;
+    SymbolId      identifier;
     TypeSpecifier type_specs;
-    AstNode     **dimensions;
+    NodeId       *dimensions;
     int           dimension_count;
 } AstArrayDeclaration;
 
 struct AstNode {
     AstType type;
 
+    // payloads of up to two words are kept in the node, so expressions are
+    // walked without a second load. the larger statements are pointed to
     union {
-        AstLiteralInt                 *lit_int;
-        AstLiteralChar                *lit_char;
-        AstLiteralString              *lit_str;
+        AstLiteralInt                  lit_int;
+        AstLiteralChar                 lit_char;
+        AstLiteralString               lit_str;
+        AstReturn                      ret;
+        AstIdentifier                  ident;
+        AstBinaryExpr                  binary;
+        AstUnary                       unary;
+        AstCallExpr                    call;
+        AstAssignment                  assign;
+        AstBreak                       brk;
+        AstContinue                    cont;
+        AstArraySubscript              arr_sub;
+        AstTernary                     ternary;
+
         AstVariableDeclaration        *var_dec;
         AstFunctionDeclaration        *func;
-        AstReturn                     *ret;
-        AstIdentifier                 *ident;
-        AstBinaryExpr                 *binary;
-        AstCallExpr                   *call;
         AstFunctionParameter          *param;
         AstInlineAsmBlock             *asm_inl;
-        AstAssignment                 *assign;
         AstIfStatement                *if_stmt;
         AstWhile                      *while_stmt;
-        AstBreak                      *brk;
-        AstContinue                   *cont;
-        AstUnary                      *unary;
         AstFor                        *for_stmt;
-        AstTernary                    *ternary;
         AstBlock                      *block;
         AstDoWhile                    *do_while;
         AstStruct                     *a_struct;
@@ -279,7 +298,6 @@ struct AstNode {
         AstEnumValue                  *enum_val;
         AstUnion                      *a_union;
         AstCast                       *cast;
-        AstArraySubscript             *arr_sub;
         AstDeclarator                 *declarator;
         AstTypedef                    *type_def;
         AstArrayDeclaration           *array_decl;
@@ -298,13 +316,127 @@ typedef enum {
     PARSE_ERR_VOID_NOT_ALLOWED,
 } ParseErr;
 
+// binding power of the infix operators, lowest first. prefix operators bind
+// tighter than any of them
+typedef enum {
+    PREC_NONE,
+    PREC_COMMA,
+    PREC_COMPOUND,
+    PREC_TERNARY,
+    PREC_LOGICAL_OR,
+    PREC_LOGICAL_AND,
+    PREC_BITWISE_OR,
+    PREC_BITWISE_XOR,
+    PREC_BITWISE_AND,
+    PREC_EQUALITY,
+    PREC_RELATIONAL,
+    PREC_SHIFT,
+    PREC_TERM,
+    PREC_FACTOR,
+    PREC_UNARY,
+} Precedence;
+
+typedef enum {
+    // operators waiting for their right side
+    FRAME_BINARY,
+    FRAME_COMPOUND,
+    FRAME_TERNARY_ELSE,
+    FRAME_UNARY,
+
+    // openers waiting for a whole expression and the token that closes it
+    FRAME_GROUP,
+    FRAME_SUBSCRIPT,
+    FRAME_SIZEOF,
+    FRAME_CAST,
+    FRAME_TERNARY_THEN,
+    FRAME_CALL,
+} ExprFrameKind;
+
+// an operator of the expression being parsed that is still missing an operand
+typedef struct {
+    ExprFrameKind kind;
+
+    // PREC_NONE for the openers, which only the closing token pops
+    Precedence    precedence;
+    TokenType     op;
+    NodeId        left;
+
+    // the true side of a ternary
+    NodeId        middle;
+
+    // the type of a cast or the name of a call
+    Token         token;
+
+    // the arguments of a call, count is the pointer level of a cast
+    NodeId       *args;
+    int           count;
+    int           capacity;
+} ExprFrame;
+
+typedef enum {
+    BODY_FUNCTION,
+    BODY_IF,
+    BODY_ELSE,
+    BODY_WHILE,
+    BODY_FOR,
+    BODY_DO_WHILE,
+    BODY_CASE,
+} BodyKind;
+
+// a compound statement whose body is being parsed, the statement node is
+// made once the closing brace is reached
+typedef struct {
+    BodyKind   kind;
+
+    // the statements read so far
+    NodeId    *body;
+    int        body_count;
+    int        body_capacity;
+
+    // the condition of an if, while or for, the expression of a switch
+    NodeId     condition;
+    NodeId     initializer;
+    NodeId     alteration;
+
+    // the then body of an if while its else body is read
+    NodeId    *then_body;
+    int        then_count;
+
+    Token                  identifier;
+    AstFunctionParameter **params;
+    int                    param_count;
+    int                    is_void_params;
+    TypeSpecifier          type_specs;
+
+    // the cases of a switch so far, and the value of the one being read
+    AstCase  **cases;
+    int        case_count;
+    int        case_capacity;
+    NodeId     case_value;
+    int        is_brace_block;
+} BodyFrame;
+
 typedef struct {
-    AstNode **tree;
+    // every payload and list the parser makes
+    Arena     arena;
+
+    // every node the parser makes, in one block that is grown by doubling.
+    // children are indices into it, so no node is held across a new one
+    AstNode  *nodes;
+    uint32_t  nodes_used;
+    uint32_t  nodes_capacity;
+
+    // the top level declarations, in order
+    NodeId   *tree;
     int       node_count;
     int       node_capacity;
     int       debug;
     int       current;
-    Token    *tokens;
+    TokenStream *tokens;
+
+    // the lexer that produced the tokens, lexemes and decoded literals are read
+    // from it so it must outlive the parser
+    Lexer    *lexer;
 
     // the name of the file being parsed
     char     *file;
@@ -317,12 +449,50 @@ typedef struct {
     // this flag prevents the above being parsed as a binary expression rather than a list of declarators
     int       ignore_comma_op;
 
+    // 1 to skip function bodies by matching their braces, they are built when
+    // a later phase asks for them
+    int       defer_bodies;
+
+    // 1 to leave reporting an error to the caller
+    int       quiet;
+
     // the token that caused the err, null if none occurred
     Token     errToken;
+
+    // the operators parse_expression has open, shared by nested expressions
+    ExprFrame *frames;
+    int        frame_count;
+    int        frame_capacity;
+
+    // the compound statements parse_statement has open, innermost last
+    BodyFrame *open_bodies;
+    int        open_body_count;
+    int        open_body_capacity;
 } Parser;
 
-extern Parser *init_parser(Token *tokens, int debug, char *file);
+// the node at id, the pointer is good until the parser makes another node
+static inline AstNode *ast_node(const Parser *parser, NodeId id) {
+    return &parser->nodes[id];
+}
+
+extern Parser *init_parser(Lexer *lexer, int debug, char *file);
+
+// appends a node of the type to parser->nodes, value is copied into it or
+// pointed to as the parser does for that type
+extern NodeId init_node(Parser *parser, void *value, AstType type);
+
+// appends a top level declaration to parser->tree, parse_ast adds what it
+// reads after any already there
+extern void add_declaration(Parser *parser, NodeId node);
 extern void parse_ast(Parser *parser);
+
+// builds the body of a function that was deferred, the lexer has to still be
+// alive. returns 0 when the body has a parse error
+extern int parse_function_body(Parser *parser, AstFunctionDeclaration *func);
+
+// builds the bodies of main and of every function named in a body built, the
+// rest stay deferred. every body is built when there is no main
+extern void parse_reachable_bodies(Parser *parser);
 extern void free_parser(Parser *parser);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "incpath.h"
+#include "source.h"
+#include "strbuf.h"
+
+// a header name probed in one directory. path is NO_SYMBOL when it was not
+// there, so a miss is not probed twice either
+typedef struct {
+    SymbolId dir;
+    SymbolId name;
+    SymbolId path;
+} HeaderLookup;
+
+typedef struct {
+    SymbolId *dirs;
+    int       dir_count;
+    int       dir_capacity;
+
+    // where the -isystem directories start in dirs
+    int       system_start;
+
+    // open addressed on (dir, name), a dir of NO_SYMBOL marks an empty slot
+    HeaderLookup *lookups;
+    int           lookup_count;
+    int           lookup_capacity;
+} IncludePaths;
+
+static IncludePaths paths;
+
+static uint32_t hash_lookup(SymbolId dir, SymbolId name) {
+    uint32_t hash = dir * 2654435761u;
+    return (hash ^ name) * 2246822519u;
+}
+
+static HeaderLookup *find_slot(HeaderLookup *lookups, int capacity, SymbolId dir, SymbolId name) {
+    uint32_t slot = hash_lookup(dir, name) & (capacity - 1);
+    while (lookups[slot].dir != NO_SYMBOL && (lookups[slot].dir != dir || lookups[slot].name != name)) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    return &lookups[slot];
+}
+
+static void grow_lookups() {
+    int capacity = paths.lookup_capacity ? paths.lookup_capacity * 2 : 256;
+    HeaderLookup *lookups = calloc(capacity, sizeof(HeaderLookup));
+
+    for (int i = 0; i < paths.lookup_capacity; i++) {
+        HeaderLookup *lookup = &paths.lookups[i];
+        if (lookup->dir != NO_SYMBOL) {
+            *find_slot(lookups, capacity, lookup->dir, lookup->name) = *lookup;
+        }
+    }
+
+    free(paths.lookups);
+    paths.lookups = lookups;
+    paths.lookup_capacity = capacity;
+}
+
+void add_include_dir(const char *dir, int system) {
+    if (paths.dir_count >= paths.dir_capacity) {
+        paths.dir_capacity = paths.dir_capacity ? paths.dir_capacity * 2 : 16;
+        paths.dirs = realloc(paths.dirs, sizeof(SymbolId) * paths.dir_capacity);
+    }
+
+    // a trailing slash would be doubled when a name is joined on
+    int length = strlen(dir);
+    while (length > 1 && dir[length - 1] == '/') length--;
+    SymbolId id = intern(dir, length);
+
+    if (system) {
+        paths.dirs[paths.dir_count++] = id;
+        return;
+    }
+
+    memmove(&paths.dirs[paths.system_start + 1], &paths.dirs[paths.system_start],
+        sizeof(SymbolId) * (paths.dir_count - paths.system_start));
+    paths.dirs[paths.system_start++] = id;
+    paths.dir_count++;
+}
+
+SymbolId path_dir(const char *path) {
+    const char *slash = strrchr(path, '/');
+    if (!slash) return intern_str(".");
+
+    // the root keeps its slash
+    return intern(path, slash == path ? 1 : slash - path);
+}
+
+// the path of name inside dir, from the cache when it was probed before
+static SymbolId lookup_header(SymbolId dir, SymbolId name) {
+    if (paths.lookup_count * 2 >= paths.lookup_capacity) {
+        grow_lookups();
+    }
+
+    HeaderLookup *lookup = find_slot(paths.lookups, paths.lookup_capacity, dir, name);
+    if (lookup->dir != NO_SYMBOL) return lookup->path;
+
+    // names in the current directory are kept as written
+    StrBuf joined;
+    init_strbuf(&joined, 64);
+    if (strcmp(symbol_str(dir), ".") != 0) {
+        strbuf_append(&joined, symbol_str(dir), symbol_length(dir));
+        if (symbol_str(dir)[symbol_length(dir) - 1] != '/') strbuf_push(&joined, '/');
+    }
+    strbuf_append(&joined, symbol_str(name), symbol_length(name));
+
+    FileId id;
+    SymbolId path = identify_source_file(joined.data, &id) ? intern(joined.data, joined.length) : NO_SYMBOL;
+    free_strbuf(&joined);
+
+    lookup->dir = dir;
+    lookup->name = name;
+    lookup->path = path;
+    paths.lookup_count++;
+
+    return path;
+}
+
+const char *find_header(const char *name, SymbolId from_dir, int quoted) {
+    SymbolId name_id = intern_str(name);
+
+    if (name[0] == '/') {
+        SymbolId path = lookup_header(intern_str("."), name_id);
+        return path != NO_SYMBOL ? symbol_str(path) : NULL;
+    }
+
+    if (quoted) {
+        SymbolId path = lookup_header(from_dir, name_id);
+        if (path != NO_SYMBOL) return symbol_str(path);
+    }
+
+    for (int i = 0; i < paths.dir_count; i++) {
+        SymbolId path = lookup_header(paths.dirs[i], name_id);
+        if (path != NO_SYMBOL) return symbol_str(path);
+    }
+
+    return NULL;
+}
+
+void free_include_paths() {
+    free(paths.dirs);
+    free(paths.lookups);
+    memset(&paths, 0, sizeof(paths));
+}
@@ -0,0 +1,24 @@
+#ifndef INCPATH_H
+#define INCPATH_H
+
+#include "intern.h"
+
+// the directories searched for included headers and what was found in them.
+// one set is kept for the whole process, so every file compiled by the same
+// run shares the lookups.
+//
+// -I directories are searched in the order given, then the -isystem ones
+extern void add_include_dir(const char *dir, int system);
+
+// the path to read a header from, or NULL if no directory has it. a quoted
+// name is looked for next to the file including it first, from_dir being that
+// file's directory. the path is interned and lives as long as the interner
+extern const char *find_header(const char *name, SymbolId from_dir, int quoted);
+
+// the directory part of a path, "." when it has none
+extern SymbolId path_dir(const char *path);
+
+// the lookups hold interned names, so this goes before free_interner
+extern void free_include_paths();
+
+#endif
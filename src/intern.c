@@ -0,0 +1,199 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+
+// interned strings are copied into blocks of this size so their addresses
+// stay put as more are added, longer strings get a block of their own
+#define STRING_BLOCK_SIZE (64 * 1024)
+
+typedef struct {
+    const char *str;
+    int         length;
+    uint32_t    hash;
+} InternEntry;
+
+typedef struct {
+    // indexed by symbol id, entry 0 is unused
+    InternEntry *entries;
+    int          entry_count;
+    int          entry_capacity;
+
+    // open addressed table of symbol ids, 0 marks an empty slot
+    SymbolId    *table;
+    int          table_capacity;
+
+    char       **blocks;
+    int          block_count;
+    int          block_capacity;
+    int          block_used;
+} Interner;
+
+static Interner interner;
+
+static uint32_t hash_string(const char *str, int length) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static char *store_string(const char *str, int length) {
+    int need = length + 1;
+
+    if (interner.block_count == 0 || interner.block_used + need > STRING_BLOCK_SIZE) {
+        if (interner.block_count >= interner.block_capacity) {
+            interner.block_capacity = interner.block_capacity ? interner.block_capacity * 2 : 8;
+            interner.blocks = realloc(interner.blocks, sizeof(char *) * interner.block_capacity);
+        }
+
+        int size = need > STRING_BLOCK_SIZE ? need : STRING_BLOCK_SIZE;
+        interner.blocks[interner.block_count++] = malloc(size);
+        interner.block_used = 0;
+    }
+
+    char *copy = interner.blocks[interner.block_count - 1] + interner.block_used;
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+
+    // an oversized string fills its block, so the next one starts a fresh block
+    interner.block_used += need > STRING_BLOCK_SIZE ? STRING_BLOCK_SIZE : need;
+
+    return copy;
+}
+
+static void grow_table() {
+    int capacity = interner.table_capacity ? interner.table_capacity * 2 : 1024;
+    SymbolId *table = calloc(capacity, sizeof(SymbolId));
+
+    for (int id = 1; id < interner.entry_count; id++) {
+        uint32_t slot = interner.entries[id].hash & (capacity - 1);
+        while (table[slot] != NO_SYMBOL) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        table[slot] = id;
+    }
+
+    free(interner.table);
+    interner.table = table;
+    interner.table_capacity = capacity;
+}
+
+// the slot holding the string, or the empty slot where it would go
+static uint32_t find_slot(const char *str, int length, uint32_t hash) {
+    uint32_t slot = hash & (interner.table_capacity - 1);
+
+    while (interner.table[slot] != NO_SYMBOL) {
+        InternEntry *entry = &interner.entries[interner.table[slot]];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->str, str, length) == 0) {
+            break;
+        }
+
+        slot = (slot + 1) & (interner.table_capacity - 1);
+    }
+
+    return slot;
+}
+
+SymbolId intern(const char *str, int length) {
+    // keeps the table at most half full
+    if ((interner.entry_count + 1) * 2 > interner.table_capacity) {
+        grow_table();
+    }
+
+    uint32_t hash = hash_string(str, length);
+    uint32_t slot = find_slot(str, length, hash);
+
+    if (interner.table[slot] != NO_SYMBOL) {
+        return interner.table[slot];
+    }
+
+    if (interner.entry_count == 0) {
+        interner.entry_count = 1;
+    }
+
+    if (interner.entry_count >= interner.entry_capacity) {
+        interner.entry_capacity = interner.entry_capacity ? interner.entry_capacity * 2 : 256;
+        interner.entries = realloc(interner.entries, sizeof(InternEntry) * interner.entry_capacity);
+    }
+
+    SymbolId id = interner.entry_count++;
+    interner.entries[id].str = store_string(str, length);
+    interner.entries[id].length = length;
+    interner.entries[id].hash = hash;
+    interner.table[slot] = id;
+
+    return id;
+}
+
+SymbolId symbol_lookup(const char *str, int length) {
+    if (interner.table_capacity == 0) return NO_SYMBOL;
+
+    return interner.table[find_slot(str, length, hash_string(str, length))];
+}
+
+SymbolId intern_str(const char *str) {
+    return intern(str, strlen(str));
+}
+
+const char *symbol_str(SymbolId id) {
+    if (id == NO_SYMBOL || (int)id >= interner.entry_count) return NULL;
+    return interner.entries[id].str;
+}
+
+int symbol_length(SymbolId id) {
+    if (id == NO_SYMBOL || (int)id >= interner.entry_count) return 0;
+    return interner.entries[id].length;
+}
+
+int symbol_count() {
+    return interner.entry_count ? interner.entry_count - 1 : 0;
+}
+
+void free_interner() {
+    for (int i = 0; i < interner.block_count; i++) {
+        free(interner.blocks[i]);
+    }
+    free(interner.blocks);
+    free(interner.entries);
+    free(interner.table);
+
+    memset(&interner, 0, sizeof(Interner));
+}
+
+// slots hold the value plus one so a zeroed slot means the id is absent
+void symbol_map_put(SymbolMap *map, SymbolId id, int value) {
+    if ((int)id >= map->capacity) {
+        int capacity = map->capacity ? map->capacity : 64;
+        while (capacity <= (int)id) capacity *= 2;
+
+        map->slots = realloc(map->slots, sizeof(int) * capacity);
+        memset(map->slots + map->capacity, 0, sizeof(int) * (capacity - map->capacity));
+        map->capacity = capacity;
+    }
+
+    map->slots[id] = value + 1;
+}
+
+// returns -1 when the id has no value
+int symbol_map_get(SymbolMap *map, SymbolId id) {
+    if ((int)id >= map->capacity) return -1;
+    return map->slots[id] - 1;
+}
+
+void symbol_map_remove(SymbolMap *map, SymbolId id) {
+    if ((int)id < map->capacity) map->slots[id] = 0;
+}
+
+void symbol_map_clear(SymbolMap *map) {
+    if (map->slots) memset(map->slots, 0, sizeof(int) * map->capacity);
+}
+
+void free_symbol_map(SymbolMap *map) {
+    free(map->slots);
+    map->slots = NULL;
+    map->capacity = 0;
+}
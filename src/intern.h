@@ -0,0 +1,40 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdint.h>
+
+// every distinct identifier spelling in a compilation maps to one id, so later
+// phases compare and index names as integers instead of strings
+typedef uint32_t SymbolId;
+
+// never handed out by the interner, ids run from 1 to symbol_count()
+#define NO_SYMBOL 0
+
+// maps symbol ids to small non-negative values, such as an index into a table
+// of symbols. ids are dense so the map is an array indexed by the id itself
+typedef struct {
+    int *slots;
+    int  capacity;
+} SymbolMap;
+
+extern SymbolId intern(const char *str, int length);
+extern SymbolId intern_str(const char *str);
+
+// the id of a string that has already been interned, NO_SYMBOL otherwise.
+// nothing is added, so probing names that may not exist costs no memory
+extern SymbolId symbol_lookup(const char *str, int length);
+
+extern const char *symbol_str(SymbolId id);
+extern int symbol_length(SymbolId id);
+extern int symbol_count();
+
+// releases every interned string, ids handed out before this are invalidated
+extern void free_interner();
+
+extern void symbol_map_put(SymbolMap *map, SymbolId id, int value);
+extern int symbol_map_get(SymbolMap *map, SymbolId id);
+extern void symbol_map_remove(SymbolMap *map, SymbolId id);
+extern void symbol_map_clear(SymbolMap *map);
+extern void free_symbol_map(SymbolMap *map);
+
+#endif
@@ -1,124 +1,69 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
+#include <pthread.h>
 
 #include "lexer.h"
+#include "scan.h"
 
-static SymbolToken KEYWORDS[] = {
-    {"int", TOKEN_INT},
-    {"return", TOKEN_RETURN},
-    {"char", TOKEN_CHAR},
-    {"float", TOKEN_FLOAT},
-    {"double", TOKEN_DOUBLE},
-    {"struct", TOKEN_STRUCT},
-    {"union", TOKEN_UNION},
-    {"long", TOKEN_LONG},
-    {"short", TOKEN_SHORT},
-    {"unsigned", TOKEN_UNSIGNED},
-    {"signed", TOKEN_SIGNED},
-    {"auto", TOKEN_AUTO},
-    {"register", TOKEN_REGISTER},
-    {"typedef", TOKEN_TYPEDEF},
-    {"static", TOKEN_STATIC},
-    {"goto", TOKEN_GOTO},
-    {"sizeof", TOKEN_SIZEOF},
-    {"break", TOKEN_BREAK},
-    {"continue", TOKEN_CONTINUE},
-    {"if", TOKEN_IF},
-    {"else", TOKEN_ELSE},
-    {"for", TOKEN_FOR},
-    {"do", TOKEN_DO},
-    {"while", TOKEN_WHILE},
-    {"switch", TOKEN_SWITCH},
-    {"case", TOKEN_CASE},
-    {"default", TOKEN_DEFAULT},
-    {"void", TOKEN_VOID},
-    {"const", TOKEN_CONST},
-    {"asm", TOKEN_ASM},
-    {"volatile", TOKEN_VOLATILE},
-    {"inline", TOKEN_INLINE},
-    {"enum", TOKEN_ENUM},
+enum {
+    CHAR_SPACE = 1 << 0,
+    CHAR_DIGIT = 1 << 1,
+    CHAR_IDENT = 1 << 2, // letters and '_', anything that may start an identifier
+    CHAR_HEX   = 1 << 3,
 };
 
-static SymbolToken SINGLE_SYMBOLS[] = {
-    {";", TOKEN_SEMICOLON},
-    {"(", TOKEN_LEFT_PAREN},
-    {")", TOKEN_RIGHT_PAREN},
-    {"{", TOKEN_LEFT_BRACE},
-    {"}", TOKEN_RIGHT_BRACE},
-    {"=", TOKEN_SINGLE_EQUALS},
-    {",", TOKEN_COMMA},
-    {"#", TOKEN_HASHTAG},
-    {"+", TOKEN_PLUS},
-    {"-", TOKEN_MINUS},
-    {"*", TOKEN_STAR},
-    {"/", TOKEN_SLASH},
-    {"%", TOKEN_MODULO},
-    {"~", TOKEN_BITWISE_NOT},
-    {"!", TOKEN_EXCLAMATION},
-    {">", TOKEN_GREATER_THAN},
-    {"<", TOKEN_LESS_THAN},
-    {".", TOKEN_DOT},
-    {"[", TOKEN_SQUARE_BRACKET_LEFT},
-    {"]", TOKEN_SQUARE_BRACKET_RIGHT},
-    {"?", TOKEN_QUESTION},
-    {":", TOKEN_COLON},
-    {"&", TOKEN_BITWISE_AND},
-    {"|", TOKEN_BITWISE_OR},
-    {"^", TOKEN_BITWISE_XOR},
-};
-
-static SymbolToken DOUBLE_SYMBOLS[] = {
-    {">=", TOKEN_GREATER_THAN_EQUALS},
-    {"<=", TOKEN_LESS_THAN_EQUALS},
-    {"==", TOKEN_EQUALS},
-    {"!=", TOKEN_NOT_EQUALS},
-    {"&&", TOKEN_AND},
-    {"||", TOKEN_OR},
-    {"++", TOKEN_INCREMENT},
-    {"--", TOKEN_DECREMENT},
-    {"->", TOKEN_ARROW_OP},
-    {">>", TOKEN_BITWISE_RIGHT_SHIFT},
-    {"<<", TOKEN_BITWISE_LEFT_SHIFT},
-    {"+=", TOKEN_PLUS_EQUALS},
-    {"-=", TOKEN_MINUS_EQUALS},
-    {"*=", TOKEN_STAR_EQUALS},
-    {"/=", TOKEN_SLASH_EQUALS},
-    {"%=", TOKEN_MODULO_EQUALS},
-    {"&=", TOKEN_BITWISE_AND_EQUALS},
-    {"|=", TOKEN_BITWISE_OR_EQUALS},
-    {"^=", TOKEN_BITWISE_XOR_EQUALS},
-};
-
-static SymbolToken TRIPLE_SYMBOLS[] = {
-    {"<<=", TOKEN_BITWISE_LEFT_SHIFT_EQUALS},
-    {">>=", TOKEN_BITWISE_RIGHT_SHIFT_EQUALS},
-    {"...", TOKEN_ELLIPSIS},
+#define S CHAR_SPACE
+#define D (CHAR_DIGIT | CHAR_HEX)
+#define A CHAR_IDENT
+#define H (CHAR_IDENT | CHAR_HEX)
+
+// character classes for every byte value, this replaces the <ctype.h> functions
+// which are locale dependent and cost a call per character.
+//
+// bytes outside of ascii are left unclassified, the same as the "C" locale
+static const unsigned char CHAR_CLASS[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0, // 0x00
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x10
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x20  !"#$%&'()*+,-./
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0, // 0x30 0123456789:;<=>?
+    0, H, H, H, H, H, H, A, A, A, A, A, A, A, A, A, // 0x40 @ABCDEFGHIJKLMNO
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, A, // 0x50 PQRSTUVWXYZ[\]^_
+    0, H, H, H, H, H, H, A, A, A, A, A, A, A, A, A, // 0x60 `abcdefghijklmno
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0, // 0x70 pqrstuvwxyz{|}~
 };
 
+#undef S
+#undef D
+#undef A
+#undef H
 
-static const int KEYWORDS_COUNT = sizeof(KEYWORDS) / sizeof(SymbolToken);
+static inline int char_is(char c, int class) {
+    return CHAR_CLASS[(unsigned char)c] & class;
+}
 
-static const int SINGLE_SYMBOL_COUNT = sizeof(SINGLE_SYMBOLS) / sizeof(SymbolToken);
-static const int DOUBLE_SYMBOL_COUNT = sizeof(DOUBLE_SYMBOLS) / sizeof(SymbolToken);
-static const int TRIPLE_SYMBOL_COUNT = sizeof(TRIPLE_SYMBOLS) / sizeof(SymbolToken);
+Lexer *init_lexer(const char *source, int debug) {
+    return init_lexer_len(source, (int)strlen(source), debug);
+}
 
-Lexer *init_lexer(char *source, int debug) {
+Lexer *init_lexer_len(const char *source, int length, int debug) {
     Lexer *lexer = (Lexer *)malloc(sizeof(Lexer));
     if (!lexer) {
         perror("Error allocating lexer");
         return NULL;
     }
 
-    lexer->source = strdup(source);
+    lexer->source = source;
+    lexer->length = length;
     lexer->current = 0;
-    lexer->token_capacity = 1;
-    lexer->token_count = 0;
-    lexer->tokens = (Token *)malloc(sizeof(Token));
+    init_token_stream(&lexer->tokens, lexer->length);
+    lexer->literals = NULL;
+    lexer->literal_count = 0;
+    lexer->literal_capacity = 0;
     lexer->err = NO_LEXER_ERROR;
     lexer->debug = debug;
-    lexer->line = 1;
+    lexer->quiet = 0;
+    lexer->line_index = NULL;
 
     return lexer;
 }
@@ -137,24 +82,24 @@ char *lexer_err_to_str(LexErr err) {
 }
 
 static inline int is_end(Lexer *lexer) {
-    return lexer->current >= (int)strlen(lexer->source);
+    return lexer->current >= lexer->length;
 }
 
-Token *init_token(const char *lexeme, TokenType type, Lexer *lexer) {
-    Token *token = (Token *)malloc(sizeof(Token));
-    token->lexeme = strdup(lexeme);
-    token->type = type;
-    token->line = lexer->line;
-    token->has_whitespace_after = !is_end(lexer) ? lexer->source[lexer->current + 1] == ' ' : 0;
+// returns the character 'offset' places after the current one, or '\0' past the end
+static inline char peek(Lexer *lexer, int offset) {
+    if (lexer->current + offset >= lexer->length) return '\0';
+    return lexer->source[lexer->current + offset];
+}
 
-    return token;
+// appends a token for the lexeme at [offset, offset + length) of the source, the
+// lexer must be positioned on the last character of the token
+static int add_token(Lexer *lexer, TokenType type, int offset, int length) {
+    token_stream_push(&lexer->tokens, type, offset, length, peek(lexer, 1) == ' ');
+    return 1;
 }
 
 static inline char current_char(Lexer *lexer) {
-    if (lexer->source == NULL) return '\0';
-
-    if (lexer->current >= (int)strlen(lexer->source)) return '\0';
-    return lexer->source[lexer->current];
+    return peek(lexer, 0);
 }
 
 static inline int match(char c, Lexer* lexer) {
@@ -169,41 +114,122 @@ static inline void recede(Lexer *lexer) {
     lexer->current--;
 }
 
-static inline Token *lexer_err(LexErr error, Lexer *lexer) {
+static inline int lexer_err(LexErr error, Lexer *lexer) {
     lexer->err = error;
-    return NULL;
+    return 0;
 }
 
-static Token *parse_symbol(Lexer *lexer) {
-    for (int i = 0; i < TRIPLE_SYMBOL_COUNT; i++) {
-        const char *symbol = TRIPLE_SYMBOLS[i].symbol;
-        size_t len = strlen(symbol);
-        if (strncmp(&lexer->source[lexer->current], symbol, len) == 0) {
-            Token *token = init_token(symbol, TRIPLE_SYMBOLS[i].type, lexer);
-            lexer->current += len - 1;
-            return token;
-        }
+// picks between an operator and its '=' form, such as '+' and '+='
+static inline TokenType with_equals(Lexer *lexer, int *len, TokenType plain, TokenType equals) {
+    if (peek(lexer, *len) == '=') {
+        (*len)++;
+        return equals;
     }
 
-    for (int i = 0; i < DOUBLE_SYMBOL_COUNT; i++) {
-        const char *symbol = DOUBLE_SYMBOLS[i].symbol;
-        size_t len = strlen(symbol);
-        if (strncmp(&lexer->source[lexer->current], symbol, len) == 0) {
-            Token *token = init_token(symbol, DOUBLE_SYMBOLS[i].type, lexer);
-            lexer->current += len - 1;
-            return token;
-        }
-    }
+    return plain;
+}
 
-    for (int i = 0; i < SINGLE_SYMBOL_COUNT; i++) {
-        const char *symbol = SINGLE_SYMBOLS[i].symbol;
-        size_t len = strlen(symbol);
-        if (strncmp(&lexer->source[lexer->current], symbol, len) == 0) {
-            return init_token(symbol, SINGLE_SYMBOLS[i].type, lexer);
-        }
+// longest match state machine over the punctuators, it switches on the first
+// character and peeks at most two more, so '<<=' wins over '<<' and '<'
+static int parse_symbol(Lexer *lexer) {
+    int start = lexer->current;
+    char next = peek(lexer, 1);
+    int len = 1;
+    TokenType type;
+
+    switch (current_char(lexer)) {
+        case ';': type = TOKEN_SEMICOLON; break;
+        case '(': type = TOKEN_LEFT_PAREN; break;
+        case ')': type = TOKEN_RIGHT_PAREN; break;
+        case '{': type = TOKEN_LEFT_BRACE; break;
+        case '}': type = TOKEN_RIGHT_BRACE; break;
+        case '[': type = TOKEN_SQUARE_BRACKET_LEFT; break;
+        case ']': type = TOKEN_SQUARE_BRACKET_RIGHT; break;
+        case ',': type = TOKEN_COMMA; break;
+        case '#': type = TOKEN_HASHTAG; break;
+        case '~': type = TOKEN_BITWISE_NOT; break;
+        case '?': type = TOKEN_QUESTION; break;
+        case ':': type = TOKEN_COLON; break;
+
+        case '=': type = with_equals(lexer, &len, TOKEN_SINGLE_EQUALS, TOKEN_EQUALS); break;
+        case '!': type = with_equals(lexer, &len, TOKEN_EXCLAMATION, TOKEN_NOT_EQUALS); break;
+        case '*': type = with_equals(lexer, &len, TOKEN_STAR, TOKEN_STAR_EQUALS); break;
+        case '/': type = with_equals(lexer, &len, TOKEN_SLASH, TOKEN_SLASH_EQUALS); break;
+        case '%': type = with_equals(lexer, &len, TOKEN_MODULO, TOKEN_MODULO_EQUALS); break;
+        case '^': type = with_equals(lexer, &len, TOKEN_BITWISE_XOR, TOKEN_BITWISE_XOR_EQUALS); break;
+
+        case '+':
+            if (next == '+') {
+                type = TOKEN_INCREMENT;
+                len = 2;
+            } else {
+                type = with_equals(lexer, &len, TOKEN_PLUS, TOKEN_PLUS_EQUALS);
+            }
+            break;
+
+        case '-':
+            if (next == '-') {
+                type = TOKEN_DECREMENT;
+                len = 2;
+            } else if (next == '>') {
+                type = TOKEN_ARROW_OP;
+                len = 2;
+            } else {
+                type = with_equals(lexer, &len, TOKEN_MINUS, TOKEN_MINUS_EQUALS);
+            }
+            break;
+
+        case '&':
+            if (next == '&') {
+                type = TOKEN_AND;
+                len = 2;
+            } else {
+                type = with_equals(lexer, &len, TOKEN_BITWISE_AND, TOKEN_BITWISE_AND_EQUALS);
+            }
+            break;
+
+        case '|':
+            if (next == '|') {
+                type = TOKEN_OR;
+                len = 2;
+            } else {
+                type = with_equals(lexer, &len, TOKEN_BITWISE_OR, TOKEN_BITWISE_OR_EQUALS);
+            }
+            break;
+
+        case '<':
+            if (next == '<') {
+                len = 2;
+                type = with_equals(lexer, &len, TOKEN_BITWISE_LEFT_SHIFT, TOKEN_BITWISE_LEFT_SHIFT_EQUALS);
+            } else {
+                type = with_equals(lexer, &len, TOKEN_LESS_THAN, TOKEN_LESS_THAN_EQUALS);
+            }
+            break;
+
+        case '>':
+            if (next == '>') {
+                len = 2;
+                type = with_equals(lexer, &len, TOKEN_BITWISE_RIGHT_SHIFT, TOKEN_BITWISE_RIGHT_SHIFT_EQUALS);
+            } else {
+                type = with_equals(lexer, &len, TOKEN_GREATER_THAN, TOKEN_GREATER_THAN_EQUALS);
+            }
+            break;
+
+        case '.':
+            if (next == '.' && peek(lexer, 2) == '.') {
+                type = TOKEN_ELLIPSIS;
+                len = 3;
+            } else {
+                type = TOKEN_DOT;
+            }
+            break;
+
+        default:
+            return lexer_err(INVALID_SYMBOL, lexer);
     }
 
-    return lexer_err(INVALID_SYMBOL, lexer);
+    lexer->current += len - 1;
+    return add_token(lexer, type, start, len);
 }
 
 static inline int is_valid_esc(char c) {
@@ -220,10 +246,118 @@ static inline int is_valid_esc(char c) {
         || c == '0';
 }
 
-static Token* parse_char(Lexer *lexer) {
+static char decode_esc(char c) {
+    switch (c) {
+        case 'a': return '\a';
+        case 'b': return '\b';
+        case 'f': return '\f';
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'v': return '\v';
+        case '0': return '\0';
+        default: return c;
+    }
+}
+
+// records the value of the last token, a literal whose source spelling at
+// [offset, offset + length) contains escape sequences
+static void add_decoded_literal(Lexer *lexer, int offset, int length) {
+    if (lexer->literal_count >= lexer->literal_capacity) {
+        lexer->literal_capacity = lexer->literal_capacity ? lexer->literal_capacity * 2 : 8;
+        lexer->literals = realloc(lexer->literals, sizeof(DecodedLiteral) * lexer->literal_capacity);
+    }
+
+    const char *raw = lexer->source + offset;
+    char *value = malloc(length + 1);
+
+    int value_length = 0;
+    for (int i = 0; i < length; i++) {
+        if (raw[i] == '\\' && i + 1 < length) {
+            value[value_length++] = decode_esc(raw[++i]);
+        } else {
+            value[value_length++] = raw[i];
+        }
+    }
+    value[value_length] = '\0';
+
+    DecodedLiteral *literal = &lexer->literals[lexer->literal_count++];
+    literal->token = lexer->tokens.count - 1;
+    literal->value = value;
+    literal->length = value_length;
+}
+
+const DecodedLiteral *lexer_decoded_literal(Lexer *lexer, int token) {
+    int low = 0;
+    int high = lexer->literal_count - 1;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (lexer->literals[mid].token == token) return &lexer->literals[mid];
+
+        if (lexer->literals[mid].token < token) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return NULL;
+}
+
+static LineIndex *build_line_index(const char *source, int length) {
+    LineIndex *index = malloc(sizeof(LineIndex));
+    int capacity = 64;
+
+    index->starts = malloc(sizeof(int) * capacity);
+    index->starts[0] = 0;
+    index->count = 1;
+
+    // memchr is vectorized by the c library, so this touches the source in
+    // wide chunks rather than a byte at a time
+    const char *p = source;
+    const char *end = source + length;
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        p++;
+
+        if (index->count >= capacity) {
+            capacity *= 2;
+            index->starts = realloc(index->starts, sizeof(int) * capacity);
+        }
+        index->starts[index->count++] = (int)(p - source);
+    }
+
+    return index;
+}
+
+void lexer_position(Lexer *lexer, int offset, int *line, int *column) {
+    if (!lexer->line_index) {
+        lexer->line_index = build_line_index(lexer->source, lexer->length);
+    }
+
+    // the last line starting at or before the offset
+    const int *starts = lexer->line_index->starts;
+    int low = 0;
+    int high = lexer->line_index->count - 1;
+
+    while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if (starts[mid] <= offset) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    *line = low + 1;
+    *column = offset - starts[low] + 1;
+}
+
+static int parse_char(Lexer *lexer) {
     advance(lexer);
 
-    char *str;
+    int start = lexer->current;
+    int has_escape = 0;
+
     char esc = current_char(lexer);
     if (esc == '\'') {
         return lexer_err(EMPTY_CHAR_LITERAL, lexer);
@@ -237,15 +371,7 @@ static Token* parse_char(Lexer *lexer) {
             return lexer_err(INVALID_ESCAPE_SEQUENCE, lexer);
         }
 
-        str = (char *)malloc(3);
-        str[0] = '\\';
-        str[1] = c;
-        str[2] = '\0';
-    }
-    else {
-        str = (char *)malloc(2);
-        str[0] = esc;
-        str[1] = '\0';
+        has_escape = 1;
     }
 
     advance(lexer);
@@ -253,25 +379,33 @@ static Token* parse_char(Lexer *lexer) {
         return lexer_err(TOO_MANY_CHARS_IN_CHAR_LITERAL, lexer);
     }
 
-    Token *token = init_token(str, TOKEN_CHAR_LITERAL, lexer);
-    free(str);
+    int len = lexer->current - start;
+    add_token(lexer, TOKEN_CHAR_LITERAL, start, len);
+    if (has_escape) add_decoded_literal(lexer, start, len);
 
-    return token;
+    return 1;
 }
 
-static Token* parse_string(Lexer *lexer) {
+static int parse_string(Lexer *lexer) {
+    advance(lexer);
+
     int start = lexer->current;
+    int has_escape = 0;
+
+    while (1) {
+        // jumps to the next quote or backslash, everything between is copied as is
+        lexer->current = scan_string_body(lexer->source, lexer->current, lexer->length);
 
-    advance(lexer);
-    while (current_char(lexer)) {
         char c = current_char(lexer);
         if (c == '\\') {
             advance(lexer);
             if (!is_valid_esc(current_char(lexer))) {
                 return lexer_err(INVALID_ESCAPE_SEQUENCE, lexer);
             }
+            has_escape = 1;
         }
-        else if (c == '\"') {
+        else {
+            // the closing quote, or '\0' at the end of the source
             break;
         }
 
@@ -281,23 +415,19 @@ static Token* parse_string(Lexer *lexer) {
     if (current_char(lexer) == '\0') {
         return lexer_err(UNTERMINATED_STRING_LITERAL, lexer);
     }
-    
-    int len = lexer->current- start;
-    char *lexeme = (char *)malloc(len + 1);
-    strncpy(lexeme, lexer->source + start + 1, len);
-    lexeme[len - 1] = '\0';
 
-    Token *token = init_token(lexeme, TOKEN_STRING_LITERAL, lexer);
-    free(lexeme);
+    int len = lexer->current - start;
+    add_token(lexer, TOKEN_STRING_LITERAL, start, len);
+    if (has_escape) add_decoded_literal(lexer, start, len);
 
-    return token;
+    return 1;
 }
 
 static inline int is_valid_binary_char(char c) {
     return c == '1' || c == '0';
 }
 
-static Token* parse_numeric(Lexer *lexer) {
+static int parse_numeric(Lexer *lexer) {
     int start = lexer->current;
     TokenType type = TOKEN_INTEGER_LITERAL;
 
@@ -308,10 +438,10 @@ static Token* parse_numeric(Lexer *lexer) {
             advance(lexer);
             type = TOKEN_HEX_LITERAL;
 
-            if (!isxdigit(current_char(lexer)))
+            if (!char_is(current_char(lexer), CHAR_HEX))
                 return lexer_err(INVALID_NUMERIC_TOKEN, lexer);
 
-            while (isxdigit(current_char(lexer))) {
+            while (char_is(current_char(lexer), CHAR_HEX)) {
                 advance(lexer);
             }
         }
@@ -330,14 +460,14 @@ static Token* parse_numeric(Lexer *lexer) {
             advance(lexer);
             type = TOKEN_FLOAT_LITERAL;
 
-            if (!isdigit(current_char(lexer)))
+            if (!char_is(current_char(lexer), CHAR_DIGIT))
                 return lexer_err(INVALID_NUMERIC_TOKEN, lexer);
 
-            while (isdigit(current_char(lexer))) {
+            while (char_is(current_char(lexer), CHAR_DIGIT)) {
                 advance(lexer);
             }
         }
-        else if (isdigit(current_char(lexer))) {
+        else if (char_is(current_char(lexer), CHAR_DIGIT)) {
             type = TOKEN_OCTAL_LITERAL;
 
             while (current_char(lexer) >= '0' && current_char(lexer) <= '7') {
@@ -349,7 +479,7 @@ static Token* parse_numeric(Lexer *lexer) {
         }
     }
     else {
-        while (isdigit(current_char(lexer))) {
+        while (char_is(current_char(lexer), CHAR_DIGIT)) {
             advance(lexer);
         }
 
@@ -357,63 +487,126 @@ static Token* parse_numeric(Lexer *lexer) {
             advance(lexer);
             type = TOKEN_FLOAT_LITERAL;
 
-            if (!isdigit(current_char(lexer)))
+            if (!char_is(current_char(lexer), CHAR_DIGIT))
                 return lexer_err(INVALID_NUMERIC_TOKEN, lexer);
 
-            while (isdigit(current_char(lexer))) {
+            while (char_is(current_char(lexer), CHAR_DIGIT)) {
                 advance(lexer);
             }
         }
     }
 
     int len = lexer->current - start;
-    char *lexeme = malloc(len + 1);
-    strncpy(lexeme, lexer->source + start, len);
-    lexeme[len] = '\0';
-
     recede(lexer);
 
-    Token *token = init_token(lexeme, type, lexer);
-    free(lexeme);
+    return add_token(lexer, type, start, len);
+}
 
-    return token;
+static inline TokenType keyword(const char *lexeme, int len, const char *keyword, TokenType type) {
+    return memcmp(lexeme, keyword, len) == 0 ? type : TOKEN_IDENTIFIER;
 }
 
-static Token* parse_identifier(Lexer *lexer) {
-    int start = lexer->current;
-    while (isalnum(current_char(lexer)) || current_char(lexer) == '_') {
-        advance(lexer);
-    }
+// sorts keywords from identifiers by switching on the length and then the first
+// character, which leaves at most one candidate keyword to compare against
+static TokenType keyword_type(const char *lexeme, int len) {
+    switch (len) {
+        case 2:
+            switch (lexeme[0]) {
+                case 'i': return keyword(lexeme, len, "if", TOKEN_IF);
+                case 'd': return keyword(lexeme, len, "do", TOKEN_DO);
+            }
+            break;
 
-    int len = lexer->current - start;
-    char *lexeme = (char *)malloc(len + 1);
-    strncpy(lexeme, lexer->source + start, len);
-    lexeme[len] = '\0';
+        case 3:
+            switch (lexeme[0]) {
+                case 'i': return keyword(lexeme, len, "int", TOKEN_INT);
+                case 'f': return keyword(lexeme, len, "for", TOKEN_FOR);
+                case 'a': return keyword(lexeme, len, "asm", TOKEN_ASM);
+            }
+            break;
 
-    recede(lexer);
+        case 4:
+            switch (lexeme[0]) {
+                case 'c':
+                    if (lexeme[1] == 'h') return keyword(lexeme, len, "char", TOKEN_CHAR);
+                    return keyword(lexeme, len, "case", TOKEN_CASE);
+                case 'e':
+                    if (lexeme[1] == 'l') return keyword(lexeme, len, "else", TOKEN_ELSE);
+                    return keyword(lexeme, len, "enum", TOKEN_ENUM);
+                case 'l': return keyword(lexeme, len, "long", TOKEN_LONG);
+                case 'a': return keyword(lexeme, len, "auto", TOKEN_AUTO);
+                case 'g': return keyword(lexeme, len, "goto", TOKEN_GOTO);
+                case 'v': return keyword(lexeme, len, "void", TOKEN_VOID);
+            }
+            break;
 
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, KEYWORDS[i].symbol) == 0) {
-            Token *token = init_token(lexeme, KEYWORDS[i].type, lexer);
-            free(lexeme);
+        case 5:
+            switch (lexeme[0]) {
+                case 'f': return keyword(lexeme, len, "float", TOKEN_FLOAT);
+                case 'u': return keyword(lexeme, len, "union", TOKEN_UNION);
+                case 's': return keyword(lexeme, len, "short", TOKEN_SHORT);
+                case 'b': return keyword(lexeme, len, "break", TOKEN_BREAK);
+                case 'w': return keyword(lexeme, len, "while", TOKEN_WHILE);
+                case 'c': return keyword(lexeme, len, "const", TOKEN_CONST);
+            }
+            break;
 
-            return token;
-        }
+        case 6:
+            switch (lexeme[0]) {
+                case 'r': return keyword(lexeme, len, "return", TOKEN_RETURN);
+                case 'd': return keyword(lexeme, len, "double", TOKEN_DOUBLE);
+                case 'i': return keyword(lexeme, len, "inline", TOKEN_INLINE);
+                case 's':
+                    switch (lexeme[2]) {
+                        case 'r': return keyword(lexeme, len, "struct", TOKEN_STRUCT);
+                        case 'g': return keyword(lexeme, len, "signed", TOKEN_SIGNED);
+                        case 'a': return keyword(lexeme, len, "static", TOKEN_STATIC);
+                        case 'z': return keyword(lexeme, len, "sizeof", TOKEN_SIZEOF);
+                        case 'i': return keyword(lexeme, len, "switch", TOKEN_SWITCH);
+                    }
+                    break;
+            }
+            break;
+
+        case 7:
+            switch (lexeme[0]) {
+                case 't': return keyword(lexeme, len, "typedef", TOKEN_TYPEDEF);
+                case 'd': return keyword(lexeme, len, "default", TOKEN_DEFAULT);
+            }
+            break;
+
+        case 8:
+            switch (lexeme[0]) {
+                case 'u': return keyword(lexeme, len, "unsigned", TOKEN_UNSIGNED);
+                case 'r': return keyword(lexeme, len, "register", TOKEN_REGISTER);
+                case 'c': return keyword(lexeme, len, "continue", TOKEN_CONTINUE);
+                case 'v': return keyword(lexeme, len, "volatile", TOKEN_VOLATILE);
+            }
+            break;
     }
 
-    Token *token = init_token(lexeme, TOKEN_IDENTIFIER, lexer);
-    free(lexeme);
+    return TOKEN_IDENTIFIER;
+}
 
-    return token;
+static int parse_identifier(Lexer *lexer) {
+    int start = lexer->current;
+    while (char_is(current_char(lexer), CHAR_IDENT | CHAR_DIGIT)) {
+        advance(lexer);
+    }
+
+    int len = lexer->current - start;
+    recede(lexer);
+
+    return add_token(lexer, keyword_type(lexer->source + start, len), start, len);
 }
 
-static Token *parse_token(Lexer *lexer) {
+static int parse_token(Lexer *lexer) {
     char c = current_char(lexer);
 
-    if (isalpha(c) || c == '_') {
+    if (char_is(c, CHAR_IDENT)) {
         return parse_identifier(lexer);
     }
-    else if (isdigit(c)) {
+    else if (char_is(c, CHAR_DIGIT)) {
         return parse_numeric(lexer);
     }
     else if (c == '\"') {
@@ -427,21 +620,25 @@ static Token *parse_token(Lexer *lexer) {
     }
 }
 
+static inline void skip_whitespace(Lexer *lexer) {
+    // most tokens are followed by a single space or none, so the bulk scan is
+    // only worth entering for a run
+    if (is_end(lexer) || !char_is(lexer->source[lexer->current], CHAR_SPACE)) return;
+    if (!char_is(peek(lexer, 1), CHAR_SPACE)) {
+        advance(lexer);
+        return;
+    }
+
+    lexer->current = scan_whitespace(lexer->source, lexer->current, lexer->length);
+}
+
 void skip_comments(Lexer *lexer) {
     while (1) {
-        if (current_char(lexer) == '/' && lexer->source[lexer->current + 1] == '/') {
-            advance(lexer);
-            advance(lexer);
-            while (current_char(lexer) != '\n' && current_char(lexer) != '\0') {
-                advance(lexer);
-            }
-        } else if (current_char(lexer) == '/' && lexer->source[lexer->current + 1] == '*') {
-            advance(lexer);
-            advance(lexer);
-            while (current_char(lexer) && !(current_char(lexer) == '*' && lexer->source[lexer->current + 1] == '/')) {
-                advance(lexer);
-            }
-            if (current_char(lexer) == '*' && lexer->source[lexer->current + 1] == '/') {
+        if (current_char(lexer) == '/' && peek(lexer, 1) == '/') {
+            lexer->current = scan_line_end(lexer->source, lexer->current + 2, lexer->length);
+        } else if (current_char(lexer) == '/' && peek(lexer, 1) == '*') {
+            lexer->current = scan_block_comment_end(lexer->source, lexer->current + 2, lexer->length);
+            if (current_char(lexer) == '*' && peek(lexer, 1) == '/') {
                 advance(lexer);
                 advance(lexer);
             }
@@ -449,63 +646,264 @@ void skip_comments(Lexer *lexer) {
             break;
         }
 
-        while (isspace(current_char(lexer))) {
-            advance(lexer);
-        }
+        skip_whitespace(lexer);
     }
 }
 
 void print_lexer(Lexer *lexer) {
   printf("\n\nLEXER SUCCESS\n");
-  for (int i = 0; i < lexer->token_count; i++) {
-        printf("%d:%d ws:%d | '%s': %s\n", i, lexer->tokens[i].line, lexer->tokens[i].has_whitespace_after, lexer->tokens[i].lexeme, token_type_to_str(lexer->tokens[i].type));
+  for (int i = 0; i < lexer->tokens.count; i++) {
+        Token token = token_at(&lexer->tokens, i);
+
+        int line, column;
+        lexer_position(lexer, token.offset, &line, &column);
+
+        printf("%d:%d ws:%d | '%.*s': %s\n", i, line, token.has_whitespace_after, token.length, lexer->source + token.offset, token_type_to_str(token.type));
     }
 }
 
-void add_token(Token *token, Lexer *lexer) {
-    if (lexer->token_count >= lexer->token_capacity) {
-        lexer->token_capacity *= 2;
-        lexer->tokens = realloc(lexer->tokens, sizeof(Token) * lexer->token_capacity);
+// lexes from the current position up to the length, without the end of file token
+static void tokenize_range(Lexer *lexer) {
+    while (!is_end(lexer)) {
+        skip_whitespace(lexer);
+        skip_comments(lexer);
+        if (is_end(lexer)) break;
+
+        if (!parse_token(lexer)) break;
+
+        advance(lexer);
+    }
+}
+
+static void finish_tokenize(Lexer *lexer) {
+    add_token(lexer, TOKEN_EOF, lexer->length, 0);
+
+    if (lexer->err != NO_LEXER_ERROR) {
+        if (!lexer->quiet) printf("%s",lexer_err_to_str(lexer->err));
+        return;
     }
-    lexer->tokens[lexer->token_count++] = *token;
-    free(token);
+
+    if (lexer->debug) print_lexer(lexer);
 }
 
 void tokenize(Lexer *lexer) {
-    while (lexer->source[lexer->current]) {
-        while (isspace(current_char(lexer))) {
-            if (current_char(lexer) == '\n') {
-                lexer->line++;
+    tokenize_range(lexer);
+    finish_tokenize(lexer);
+}
+
+enum {
+    SCAN_CODE,
+    SCAN_LINE_COMMENT,
+    SCAN_BLOCK_COMMENT,
+    SCAN_STRING,
+};
+
+int lexer_chunk_bounds(const char *source, int length, int chunk_count, int *bounds) {
+    int count = 0;
+    int state = SCAN_CODE;
+    int i = 0;
+
+    bounds[count++] = 0;
+
+    for (int chunk = 1; chunk < chunk_count; chunk++) {
+        int target = (int)((long long)length * chunk / chunk_count);
+        if (target <= bounds[count - 1]) continue;
+
+        // walks forward to the target tracking what the lexer would be inside
+        // of, then on to the first newline that ends a line of code
+        while (i < length) {
+            char c = source[i];
+
+            if (state == SCAN_CODE) {
+                if (c == '\n' && i >= target) break;
+
+                if (c == '/' && i + 1 < length && source[i + 1] == '/') {
+                    state = SCAN_LINE_COMMENT;
+                    i = scan_line_end(source, i + 2, length);
+                    continue;
+                }
+                if (c == '/' && i + 1 < length && source[i + 1] == '*') {
+                    state = SCAN_BLOCK_COMMENT;
+                    i += 2;
+                    continue;
+                }
+                if (c == '"') {
+                    state = SCAN_STRING;
+                }
+                else if (c == '\'') {
+                    // the same shape parse_char accepts, one character or an
+                    // escape and then the closing quote. anything else is an
+                    // error the serial lexer reports, so the rest is one chunk
+                    int close = i + (i + 1 < length && source[i + 1] == '\\' ? 3 : 2);
+                    if (close >= length || source[close] != '\'') {
+                        bounds[count++] = length;
+                        return count - 1;
+                    }
+                    i = close;
+                }
+                i++;
+            }
+            else if (state == SCAN_LINE_COMMENT) {
+                // sitting on the newline that ends it
+                state = SCAN_CODE;
+            }
+            else if (state == SCAN_BLOCK_COMMENT) {
+                i = scan_block_comment_end(source, i, length);
+                if (i < length) {
+                    i += 2;
+                    state = SCAN_CODE;
+                }
             }
+            else {
+                i = scan_string_body(source, i, length);
+                if (i < length && source[i] == '\\') {
+                    i += 2;
+                } else if (i < length) {
+                    i++;
+                    state = SCAN_CODE;
+                }
+            }
+        }
 
-            advance(lexer);
+        if (i >= length) break;
+
+        // a chunk starts just after the newline, so every token lies wholly
+        // inside one chunk and sees the same next character as it would serially
+        bounds[count++] = i + 1;
+        i++;
+    }
+
+    if (bounds[count - 1] != length) bounds[count++] = length;
+
+    return count - 1;
+}
+
+static void *lex_chunk(void *chunk) {
+    tokenize_range((Lexer *)chunk);
+    return NULL;
+}
+
+// appends the tokens and decoded literals of a chunk, the offsets are already
+// absolute but the literal token indexes are relative to the chunk
+static void append_chunk(Lexer *lexer, Lexer *chunk) {
+    TokenStream *to = &lexer->tokens;
+    TokenStream *from = &chunk->tokens;
+    int base = to->count;
+
+    memcpy(to->types + base, from->types, sizeof(uint8_t) * from->count);
+    memcpy(to->offsets + base, from->offsets, sizeof(int) * from->count);
+    memcpy(to->lengths + base, from->lengths, sizeof(int) * from->count);
+    memcpy(to->has_whitespace_after + base, from->has_whitespace_after, sizeof(uint8_t) * from->count);
+    to->count += from->count;
+
+    for (int i = 0; i < chunk->literal_count; i++) {
+        if (lexer->literal_count >= lexer->literal_capacity) {
+            lexer->literal_capacity = lexer->literal_capacity ? lexer->literal_capacity * 2 : 8;
+            lexer->literals = realloc(lexer->literals, sizeof(DecodedLiteral) * lexer->literal_capacity);
         }
-        skip_comments(lexer);
-        if (is_end(lexer)) break;
 
-        Token *token = parse_token(lexer);
-        if (!token) break;
-        add_token(token, lexer);
+        DecodedLiteral literal = chunk->literals[i];
+        literal.token += base;
+        lexer->literals[lexer->literal_count++] = literal;
+    }
+
+    free(chunk->literals);
+    free_token_stream(&chunk->tokens);
+}
 
-        advance(lexer);
+void tokenize_parallel(Lexer *lexer, int thread_count) {
+    if (thread_count > LEXER_MAX_THREADS) thread_count = LEXER_MAX_THREADS;
+
+    // small sources are not worth the threads
+    int chunk_count = thread_count;
+    if (lexer->length / LEXER_MIN_CHUNK < chunk_count) chunk_count = lexer->length / LEXER_MIN_CHUNK;
+
+    int bounds[LEXER_MAX_THREADS + 1];
+    if (chunk_count > 1 && lexer->current == 0) {
+        chunk_count = lexer_chunk_bounds(lexer->source, lexer->length, chunk_count, bounds);
+    }
+
+    if (chunk_count <= 1 || lexer->current != 0) {
+        tokenize(lexer);
+        return;
     }
 
-    add_token(init_token("", TOKEN_EOF, lexer), lexer);
+    // each chunk is lexed by a lexer of its own that sees the whole source but
+    // stops at the end of its chunk
+    Lexer chunks[LEXER_MAX_THREADS];
+    pthread_t threads[LEXER_MAX_THREADS];
 
-    if (lexer->err != NO_LEXER_ERROR) {
-        printf("%s",lexer_err_to_str(lexer->err));
+    for (int i = 0; i < chunk_count; i++) {
+        Lexer *chunk = &chunks[i];
+
+        memset(chunk, 0, sizeof(Lexer));
+        chunk->source = lexer->source;
+        chunk->length = bounds[i + 1];
+        chunk->current = bounds[i];
+        chunk->err = NO_LEXER_ERROR;
+        init_token_stream(&chunk->tokens, bounds[i + 1] - bounds[i]);
+    }
+
+    // the calling thread lexes the first chunk itself
+    int started = 1;
+    for (int i = 1; i < chunk_count; i++) {
+        if (pthread_create(&threads[i], NULL, lex_chunk, &chunks[i]) != 0) break;
+        started++;
+    }
+    lex_chunk(&chunks[0]);
+    for (int i = started; i < chunk_count; i++) {
+        lex_chunk(&chunks[i]);
+    }
+    for (int i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    int total = 0;
+    int failed = 0;
+    for (int i = 0; i < chunk_count; i++) {
+        total += chunks[i].tokens.count;
+        if (chunks[i].err != NO_LEXER_ERROR) failed = 1;
+    }
+
+    if (failed) {
+        // errors are rare, lexing again serially reports the same error and
+        // leaves the same tokens behind as a serial run would
+        for (int i = 0; i < chunk_count; i++) {
+            for (int j = 0; j < chunks[i].literal_count; j++) {
+                free(chunks[i].literals[j].value);
+            }
+            free(chunks[i].literals);
+            free_token_stream(&chunks[i].tokens);
+        }
+
+        tokenize(lexer);
         return;
     }
 
-    if (lexer->debug) print_lexer(lexer);
+    // room for every token and the end of file token
+    TokenStream *stream = &lexer->tokens;
+    if (stream->capacity < total + 1) {
+        token_stream_reserve(stream, total + 1);
+    }
+
+    for (int i = 0; i < chunk_count; i++) {
+        append_chunk(lexer, &chunks[i]);
+    }
+
+    lexer->current = lexer->length;
+    finish_tokenize(lexer);
 }
 
 void free_lexer(Lexer *lexer) {
-    for (int i = 0; i < lexer->token_count; i++) {
-        free(lexer->tokens[i].lexeme);
+    for (int i = 0; i < lexer->literal_count; i++) {
+        free(lexer->literals[i].value);
     }
 
-    free(lexer->source);
-    free(lexer->tokens);
+    free(lexer->literals);
+    free_token_stream(&lexer->tokens);
+    if (lexer->line_index) {
+        free(lexer->line_index->starts);
+        free(lexer->line_index);
+    }
     free(lexer);
 }
\ No newline at end of file
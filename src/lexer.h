@@ -14,22 +14,79 @@ typedef enum {
 } LexErr;
 
 typedef struct {
-    char  *source;
-    Token *tokens;
-    int    current;
-    int    token_capacity;
-    int    token_count;
-    int    line;
+    // the index of the literal's token
+    int   token;
+
+    // the value of the literal with its escape sequences decoded, this can
+    // contain '\0' so length must be used
+    char *value;
+    int   length;
+} DecodedLiteral;
+
+// the offset at which each line of a source starts, so a line and column can
+// be found for any offset without tokens having to carry them
+typedef struct {
+    int *starts;
+    int  count;
+} LineIndex;
+
+typedef struct {
+    // the source being tokenized, it is not copied and every token refers to it,
+    // so it must outlive the lexer and anything reading its tokens
+    const char     *source;
+    TokenStream     tokens;
+
+    // side table holding the values of char and string literals that contain
+    // escape sequences, ordered by token index. literals without escapes are
+    // not recorded as their lexeme is already their value
+    DecodedLiteral *literals;
+    int             literal_count;
+    int             literal_capacity;
+
+    // length of source, cached so the scanner never has to call strlen
+    int             length;
+    int             current;
+
+    // built on the first position lookup, only errors and debug output need it
+    LineIndex      *line_index;
 
     // whether to print debug information, used in development
-    int    debug;
+    int             debug;
+
+    // 1 to leave reporting an error to the caller
+    int             quiet;
 
     // the error that occurred, null if none took place
-    LexErr err;
+    LexErr          err;
 } Lexer;
 
-Lexer *init_lexer(char *source, int debug);
+Lexer *init_lexer(const char *source, int debug);
+
+// for sources that are not null terminated, such as a mapped file
+Lexer *init_lexer_len(const char *source, int length, int debug);
 void tokenize(Lexer *lexer);
+
+// the most threads tokenize_parallel will use, and the smallest piece of source
+// it hands to one of them
+#define LEXER_MAX_THREADS 64
+#define LEXER_MIN_CHUNK   (256 * 1024)
+
+// splits the source at newlines that lie outside comments, strings and char
+// literals, lexes the pieces on separate threads and joins the tokens. the
+// result is the same as tokenize, which it falls back to for small sources
+void tokenize_parallel(Lexer *lexer, int thread_count);
+
+// fills bounds with up to chunk_count + 1 offsets, each chunk [bounds[i],
+// bounds[i + 1]) starting just after a newline where the lexer is between
+// tokens. returns the number of chunks, which can be less than asked for
+int lexer_chunk_bounds(const char *source, int length, int chunk_count, int *bounds);
 void free_lexer(Lexer *lexer);
 
+// returns the decoded value of the literal at the token index, or null if the
+// literal has no escape sequences and its lexeme can be used as is
+const DecodedLiteral *lexer_decoded_literal(Lexer *lexer, int token);
+
+// finds the 1 based line and column of a source offset
+void lexer_position(Lexer *lexer, int offset, int *line, int *column);
+
 #endif
\ No newline at end of file
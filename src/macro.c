@@ -0,0 +1,1094 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+
+#include "macro.h"
+
+#define TEXT_BLOCK_SIZE (64 * 1024)
+
+// cached expansions are dropped all at once when the cache fills up
+#define CACHE_CAPACITY 4096
+
+// invocations with longer arguments are not worth keying
+#define CACHE_MAX_KEY 1024
+
+typedef struct {
+    uint32_t  hash;
+    char     *key;
+    int       key_length;
+    PPToken  *tokens;
+    int       count;
+} CacheEntry;
+
+// occupied lists the slots in use, so clearing after a define or undef costs
+// what was cached since and not the whole table
+struct ExpansionCache {
+    CacheEntry *slots;
+    int        *occupied;
+    int         count;
+    int         generation;
+};
+
+// tokens are read from a stack of lists, an expansion pushes its replacement
+// on top so it is rescanned together with whatever follows it
+typedef struct {
+    const PPToken *tokens;
+    int            count;
+    int            pos;
+    PPToken       *owned;
+} Frame;
+
+typedef struct {
+    Frame *frames;
+    int    depth;
+    int    capacity;
+
+    // the first token of the text a partial expansion left unread
+    int    stop;
+} Input;
+
+// the arguments of an invocation
+typedef struct {
+    // every token between the parentheses, commas included
+    PPTokenList tokens;
+
+    // the range of tokens each argument covers
+    int        *starts;
+    int        *ends;
+    int         count;
+    int         capacity;
+} Args;
+
+// the replacement is rescanned on its own, and given up on if it needs
+// tokens from beyond its end
+#define EXPAND_ISOLATED 1
+
+// the input is the text itself, line breaks inside an invocation are kept
+#define EXPAND_TOP      2
+
+// an invocation the input ends inside is left unread, with what came out of it
+#define EXPAND_PARTIAL  4
+
+static const char NEWLINES[] = "\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n";
+
+static int expand(MacroEngine *engine, Input *in, PPTokenList *out, int mode);
+
+void init_token_list(PPTokenList *list) {
+    list->tokens = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+void free_token_list(PPTokenList *list) {
+    free(list->tokens);
+    init_token_list(list);
+}
+
+PPToken *push_token(PPTokenList *list, PPToken token) {
+    if (list->count >= list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->tokens = realloc(list->tokens, sizeof(PPToken) * list->capacity);
+    }
+
+    list->tokens[list->count] = token;
+    return &list->tokens[list->count++];
+}
+
+static int is_ident_start(char c) {
+    return isalpha((unsigned char)c) || c == '_';
+}
+
+static int is_ident_char(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+static int punctuator_length(const char *text, int remaining) {
+    static const char *three[] = { "...", "<<=", ">>=" };
+    static const char *two[] = {
+        "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+        "*=", "/=", "%=", "+=", "-=", "&=", "^=", "|=", "##",
+    };
+
+    if (remaining >= 3) {
+        for (int i = 0; i < 3; i++) {
+            if (memcmp(text, three[i], 3) == 0) return 3;
+        }
+    }
+    if (remaining >= 2) {
+        for (int i = 0; i < (int)(sizeof(two) / sizeof(two[0])); i++) {
+            if (text[0] == two[i][0] && text[1] == two[i][1]) return 2;
+        }
+    }
+
+    return 1;
+}
+
+// whitespace, comments and escaped line breaks
+static int skip_space(const char *text, int length, int i) {
+    while (i < length) {
+        char c = text[i];
+
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v') {
+            i++;
+        }
+        else if (c == '\\' && i + 1 < length && (text[i + 1] == '\n' || text[i + 1] == '\r')) {
+            i += 2;
+        }
+        else if (c == '/' && i + 1 < length && text[i + 1] == '/') {
+            while (i < length && text[i] != '\n') i++;
+        }
+        else if (c == '/' && i + 1 < length && text[i + 1] == '*') {
+            i += 2;
+            while (i + 1 < length && !(text[i] == '*' && text[i + 1] == '/')) i++;
+            i = i + 2 < length ? i + 2 : length;
+        }
+        else {
+            break;
+        }
+    }
+
+    return i;
+}
+
+static int skip_quoted(const char *text, int length, int i, char quote) {
+    i++;
+    while (i < length && text[i] != quote && text[i] != '\n') {
+        if (text[i] == '\\' && i + 1 < length) i++;
+        i++;
+    }
+
+    return i < length && text[i] == quote ? i + 1 : i;
+}
+
+// reads one token at i, returns where it ends
+static int read_token(const char *text, int length, int i, PPToken *token) {
+    char c = text[i];
+    int end = i + 1;
+
+    if (is_ident_start(c)) {
+        while (end < length && is_ident_char(text[end])) end++;
+        token->kind = PP_IDENTIFIER;
+        token->name = symbol_lookup(&text[i], end - i);
+    }
+    else if (isdigit((unsigned char)c) || (c == '.' && i + 1 < length && isdigit((unsigned char)text[i + 1]))) {
+        while (end < length) {
+            char n = text[end];
+            if ((n == '+' || n == '-') && strchr("eEpP", text[end - 1])) end++;
+            else if (is_ident_char(n) || n == '.') end++;
+            else break;
+        }
+        token->kind = PP_NUMBER;
+    }
+    else if (c == '"') {
+        end = skip_quoted(text, length, i, '"');
+        token->kind = PP_STRING;
+    }
+    else if (c == '\'') {
+        end = skip_quoted(text, length, i, '\'');
+        token->kind = PP_CHAR;
+    }
+    else if (ispunct((unsigned char)c)) {
+        end = i + punctuator_length(&text[i], length - i);
+        token->kind = PP_PUNCTUATOR;
+    }
+    else {
+        token->kind = PP_OTHER;
+    }
+
+    token->text = &text[i];
+    token->length = end - i;
+
+    return end;
+}
+
+int pp_tokenize(const char *text, int length, PPTokenList *out) {
+    int i = 0;
+
+    while (1) {
+        int ws_start = i;
+        i = skip_space(text, length, i);
+        if (i >= length) return ws_start;
+
+        PPToken token = {0};
+        token.ws = &text[ws_start];
+        token.ws_length = i - ws_start;
+        token.space_before = token.ws_length > 0;
+
+        i = read_token(text, length, i, &token);
+        push_token(out, token);
+    }
+}
+
+static int is_punctuator(const PPToken *token, const char *spelling) {
+    int length = strlen(spelling);
+    return token->kind == PP_PUNCTUATOR && token->length == length && memcmp(token->text, spelling, length) == 0;
+}
+
+static const char *store_text(MacroEngine *engine, const char *text, int length) {
+    if (engine->text_block_count == 0 || engine->text_block_used + length > TEXT_BLOCK_SIZE) {
+        int size = length > TEXT_BLOCK_SIZE ? length : TEXT_BLOCK_SIZE;
+
+        engine->text_blocks = realloc(engine->text_blocks, sizeof(char *) * (engine->text_block_count + 1));
+        engine->text_blocks[engine->text_block_count++] = malloc(size);
+        engine->text_block_used = 0;
+    }
+
+    char *copy = engine->text_blocks[engine->text_block_count - 1] + engine->text_block_used;
+    memcpy(copy, text, length);
+
+    // an oversized piece fills its block, so the next one starts a fresh block
+    engine->text_block_used += length > TEXT_BLOCK_SIZE ? TEXT_BLOCK_SIZE : length;
+
+    return copy;
+}
+
+static int hide_contains(MacroEngine *engine, HideSet set, SymbolId name) {
+    while (set) {
+        if (engine->hide_nodes[set - 1].name == name) return 1;
+        set = engine->hide_nodes[set - 1].next;
+    }
+
+    return 0;
+}
+
+static HideSet hide_add(MacroEngine *engine, HideSet set, SymbolId name) {
+    if (hide_contains(engine, set, name)) return set;
+
+    if (engine->hide_count >= engine->hide_capacity) {
+        engine->hide_capacity = engine->hide_capacity ? engine->hide_capacity * 2 : 256;
+        engine->hide_nodes = realloc(engine->hide_nodes, sizeof(HideNode) * engine->hide_capacity);
+    }
+
+    engine->hide_nodes[engine->hide_count].name = name;
+    engine->hide_nodes[engine->hide_count].next = set;
+
+    return ++engine->hide_count;
+}
+
+static HideSet hide_union(MacroEngine *engine, HideSet a, HideSet b) {
+    if (a == b || a == 0) return b;
+    if (b == 0) return a;
+
+    for (HideSet set = a; set; set = engine->hide_nodes[set - 1].next) {
+        b = hide_add(engine, b, engine->hide_nodes[set - 1].name);
+    }
+
+    return b;
+}
+
+static HideSet hide_intersect(MacroEngine *engine, HideSet a, HideSet b) {
+    if (a == b) return a;
+
+    HideSet result = 0;
+    for (HideSet set = a; set; set = engine->hide_nodes[set - 1].next) {
+        SymbolId name = engine->hide_nodes[set - 1].name;
+        if (hide_contains(engine, b, name)) {
+            result = hide_add(engine, result, name);
+        }
+    }
+
+    return result;
+}
+
+// ids are dense, so they are spread over the table by a multiplicative hash
+static int macro_home(MacroTable *table, SymbolId name) {
+    return (int)((name * 2654435769u) & (uint32_t)(table->capacity - 1));
+}
+
+// the slot holding the name, or the empty slot that ends its run
+static int macro_slot(MacroTable *table, SymbolId name) {
+    int slot = macro_home(table, name);
+    while (table->slots[slot].name != NO_SYMBOL && table->slots[slot].name != name) {
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+
+    return slot;
+}
+
+static void grow_macro_table(MacroTable *table) {
+    MacroTable grown = *table;
+    grown.capacity = table->capacity ? table->capacity * 2 : 64;
+    grown.slots = calloc(grown.capacity, sizeof(Macro));
+
+    for (int i = 0; i < table->capacity; i++) {
+        if (table->slots[i].name != NO_SYMBOL) {
+            grown.slots[macro_slot(&grown, table->slots[i].name)] = table->slots[i];
+        }
+    }
+
+    free(table->slots);
+    *table = grown;
+}
+
+static void free_macro(Macro *macro) {
+    free(macro->value);
+    free(macro->body);
+    free(macro->body_params);
+    free(macro->params);
+}
+
+Macro *find_macro(MacroTable *table, SymbolId name) {
+    if (table->count == 0 || name == NO_SYMBOL) return NULL;
+
+    Macro *macro = &table->slots[macro_slot(table, name)];
+    return macro->name == name ? macro : NULL;
+}
+
+void define_function_macro(MacroTable *table, SymbolId name, const SymbolId *params,
+    int param_count, int variadic, const char *value, int length) {
+    // keeps the table at most half full
+    if ((table->count + 1) * 2 > table->capacity) {
+        grow_macro_table(table);
+    }
+
+    // a redefinition replaces the old one
+    Macro *macro = &table->slots[macro_slot(table, name)];
+    if (macro->name == name) {
+        free_macro(macro);
+    } else {
+        table->count++;
+    }
+    table->generation++;
+
+    macro->name = name;
+    macro->value = strndup(value, length);
+    macro->length = length;
+    macro->function_like = params != NULL;
+    macro->variadic = variadic;
+
+    macro->param_count = param_count;
+    macro->params = NULL;
+    if (param_count > 0) {
+        macro->params = malloc(sizeof(SymbolId) * param_count);
+        memcpy(macro->params, params, sizeof(SymbolId) * param_count);
+    }
+
+    PPTokenList body;
+    init_token_list(&body);
+    pp_tokenize(macro->value, length, &body);
+
+    macro->body = body.tokens;
+    macro->body_count = body.count;
+    macro->body_params = malloc(sizeof(int) * (body.count + 1));
+
+    SymbolId va_args = variadic ? intern_str("__VA_ARGS__") : NO_SYMBOL;
+    for (int i = 0; i < body.count; i++) {
+        PPToken *token = &macro->body[i];
+
+        // names in the body have to resolve to macros defined later on
+        if (token->kind == PP_IDENTIFIER) {
+            token->name = intern(token->text, token->length);
+        }
+        token->ws = NULL;
+        token->ws_length = 0;
+        if (i == 0) token->space_before = 0;
+
+        macro->body_params[i] = -1;
+        for (int p = 0; p < param_count; p++) {
+            if (token->name == params[p]) macro->body_params[i] = p;
+        }
+        if (token->name != NO_SYMBOL && token->name == va_args) {
+            macro->body_params[i] = param_count;
+        }
+    }
+}
+
+void define_macro(MacroTable *table, SymbolId name, const char *value, int length) {
+    define_function_macro(table, name, NULL, 0, 0, value, length);
+}
+
+void undef_macro(MacroTable *table, SymbolId name) {
+    Macro *macro = find_macro(table, name);
+    if (!macro) return;
+
+    free_macro(macro);
+    table->count--;
+    table->generation++;
+
+    // moves later entries of the run into the hole when it lies between their
+    // home slot and where they are now, so every run stays unbroken
+    int mask = table->capacity - 1;
+    int hole = macro - table->slots;
+    int slot = (hole + 1) & mask;
+
+    while (table->slots[slot].name != NO_SYMBOL) {
+        int home = macro_home(table, table->slots[slot].name);
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            table->slots[hole] = table->slots[slot];
+            hole = slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    memset(&table->slots[hole], 0, sizeof(Macro));
+}
+
+void free_macro_table(MacroTable *table) {
+    for (int i = 0; i < table->capacity; i++) {
+        if (table->slots[i].name != NO_SYMBOL) {
+            free_macro(&table->slots[i]);
+        }
+    }
+
+    free(table->slots);
+    table->slots = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
+
+static void clear_cache(ExpansionCache *cache) {
+    for (int i = 0; i < cache->count; i++) {
+        CacheEntry *entry = &cache->slots[cache->occupied[i]];
+        free(entry->key);
+        free(entry->tokens);
+        memset(entry, 0, sizeof(CacheEntry));
+    }
+
+    cache->count = 0;
+}
+
+MacroEngine *init_macro_engine(MacroTable *macros) {
+    MacroEngine *engine = calloc(1, sizeof(MacroEngine));
+    engine->macros = macros;
+
+    engine->cache = malloc(sizeof(ExpansionCache));
+    engine->cache->slots = calloc(CACHE_CAPACITY * 2, sizeof(CacheEntry));
+    engine->cache->occupied = malloc(sizeof(int) * CACHE_CAPACITY);
+    engine->cache->count = 0;
+    engine->cache->generation = macros->generation;
+
+    return engine;
+}
+
+void free_macro_engine(MacroEngine *engine) {
+    clear_cache(engine->cache);
+    free(engine->cache->slots);
+    free(engine->cache->occupied);
+    free(engine->cache);
+
+    for (int i = 0; i < engine->text_block_count; i++) {
+        free(engine->text_blocks[i]);
+    }
+    free(engine->text_blocks);
+    free(engine->hide_nodes);
+    free(engine);
+}
+
+static uint32_t hash_key(const char *key, int length) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// the key spells the macro and its arguments, spacing included since # sees it.
+// returns 0 if the invocation should not be cached
+static int build_key(const Macro *macro, const Args *args, StrBuf *key) {
+    strbuf_append(key, (const char *)&macro->name, sizeof(SymbolId));
+    for (int a = 0; a < args->count; a++) {
+        strbuf_push(key, '\x1f');
+
+        for (int i = args->starts[a]; i < args->ends[a]; i++) {
+            const PPToken *token = &args->tokens.tokens[i];
+            if (token->hide != 0) return 0;
+
+            strbuf_push(key, token->space_before ? ' ' : '\x1e');
+            strbuf_append(key, token->text, token->length);
+        }
+
+        if (key->length > CACHE_MAX_KEY) return 0;
+    }
+
+    return 1;
+}
+
+static CacheEntry *cache_slot(ExpansionCache *cache, const StrBuf *key, uint32_t hash) {
+    int mask = CACHE_CAPACITY * 2 - 1;
+    int slot = hash & mask;
+
+    while (cache->slots[slot].key) {
+        CacheEntry *entry = &cache->slots[slot];
+        if (entry->hash == hash && entry->key_length == key->length &&
+            memcmp(entry->key, key->data, key->length) == 0) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return &cache->slots[slot];
+}
+
+static CacheEntry *cache_find(MacroEngine *engine, const StrBuf *key) {
+    ExpansionCache *cache = engine->cache;
+
+    if (cache->generation != engine->macros->generation) {
+        clear_cache(cache);
+        cache->generation = engine->macros->generation;
+        return NULL;
+    }
+
+    CacheEntry *entry = cache_slot(cache, key, hash_key(key->data, key->length));
+    return entry->key ? entry : NULL;
+}
+
+// the tokens may point into text that goes away, so their spellings are copied
+static void cache_store(MacroEngine *engine, const StrBuf *key, const PPToken *tokens, int count) {
+    ExpansionCache *cache = engine->cache;
+    if (cache->count >= CACHE_CAPACITY) {
+        clear_cache(cache);
+    }
+
+    uint32_t hash = hash_key(key->data, key->length);
+    CacheEntry *entry = cache_slot(cache, key, hash);
+    if (entry->key) return;
+
+    entry->hash = hash;
+    entry->key = malloc(key->length);
+    memcpy(entry->key, key->data, key->length);
+    entry->key_length = key->length;
+
+    entry->tokens = malloc(sizeof(PPToken) * (count + 1));
+    entry->count = count;
+    for (int i = 0; i < count; i++) {
+        PPToken token = tokens[i];
+        token.text = token.name != NO_SYMBOL ? symbol_str(token.name) : store_text(engine, token.text, token.length);
+        token.ws = NULL;
+        token.ws_length = 0;
+
+        entry->tokens[i] = token;
+    }
+
+    cache->occupied[cache->count++] = entry - cache->slots;
+}
+
+static void push_frame(Input *in, const PPToken *tokens, int count, PPToken *owned) {
+    if (in->depth >= in->capacity) {
+        in->capacity = in->capacity ? in->capacity * 2 : 8;
+        in->frames = realloc(in->frames, sizeof(Frame) * in->capacity);
+    }
+
+    Frame *frame = &in->frames[in->depth++];
+    frame->tokens = tokens;
+    frame->count = count;
+    frame->pos = 0;
+    frame->owned = owned;
+}
+
+static void free_input(Input *in) {
+    for (int i = 0; i < in->depth; i++) {
+        free(in->frames[i].owned);
+    }
+    free(in->frames);
+}
+
+static const PPToken *peek(Input *in) {
+    while (in->depth > 0) {
+        Frame *frame = &in->frames[in->depth - 1];
+        if (frame->pos < frame->count) return &frame->tokens[frame->pos];
+
+        free(frame->owned);
+        in->depth--;
+    }
+
+    return NULL;
+}
+
+static const PPToken *next(Input *in) {
+    const PPToken *token = peek(in);
+    if (token) in->frames[in->depth - 1].pos++;
+
+    return token;
+}
+
+static void init_args(Args *args) {
+    init_token_list(&args->tokens);
+    args->starts = NULL;
+    args->ends = NULL;
+    args->count = 0;
+    args->capacity = 0;
+}
+
+static void free_args(Args *args) {
+    free_token_list(&args->tokens);
+    free(args->starts);
+    free(args->ends);
+}
+
+static void add_arg(Args *args, int start, int end) {
+    if (args->count >= args->capacity) {
+        args->capacity = args->capacity ? args->capacity * 2 : 4;
+        args->starts = realloc(args->starts, sizeof(int) * args->capacity);
+        args->ends = realloc(args->ends, sizeof(int) * args->capacity);
+    }
+
+    args->starts[args->count] = start;
+    args->ends[args->count] = end;
+    args->count++;
+}
+
+// reads the arguments after the open parenthesis up to the matching close.
+// returns the closing parenthesis, or NULL if the input ran out first
+static const PPToken *collect_args(Input *in, Args *args, int *newlines) {
+    int nesting = 0;
+    int start = 0;
+    const PPToken *token;
+
+    while ((token = next(in))) {
+        for (int i = 0; i < token->ws_length; i++) {
+            if (token->ws[i] == '\n') (*newlines)++;
+        }
+
+        if (nesting == 0 && (is_punctuator(token, ")") || is_punctuator(token, ","))) {
+            add_arg(args, start, args->tokens.count);
+            if (is_punctuator(token, ")")) return token;
+
+            push_token(&args->tokens, *token);
+            start = args->tokens.count;
+            continue;
+        }
+
+        if (is_punctuator(token, "(")) nesting++;
+        if (is_punctuator(token, ")")) nesting--;
+
+        push_token(&args->tokens, *token);
+    }
+
+    return NULL;
+}
+
+// "F()" passes one empty argument, which a macro without parameters takes as none
+static int check_arg_count(const Macro *macro, Args *args) {
+    if (macro->param_count == 0 && args->count == 1 && args->tokens.count == 0) {
+        args->count = 0;
+    }
+
+    if (macro->variadic) {
+        // the variable arguments are one argument, commas and all
+        if (args->count == macro->param_count) {
+            add_arg(args, args->tokens.count, args->tokens.count);
+        }
+        else if (args->count > macro->param_count + 1) {
+            args->ends[macro->param_count] = args->ends[args->count - 1];
+            args->count = macro->param_count + 1;
+        }
+
+        return args->count == macro->param_count + 1;
+    }
+
+    return args->count == macro->param_count;
+}
+
+static void append_arg(PPTokenList *out, const Args *args, int arg, int space_before) {
+    for (int i = args->starts[arg]; i < args->ends[arg]; i++) {
+        PPToken token = args->tokens.tokens[i];
+        token.ws = NULL;
+        token.ws_length = 0;
+        if (i == args->starts[arg]) token.space_before = space_before;
+
+        push_token(out, token);
+    }
+}
+
+static PPToken stringify(MacroEngine *engine, const Args *args, int arg) {
+    int start = args->starts[arg];
+    int end = args->ends[arg];
+
+    StrBuf text;
+    init_strbuf(&text, 64);
+
+    strbuf_push(&text, '"');
+    for (int i = start; i < end; i++) {
+        const PPToken *token = &args->tokens.tokens[i];
+        if (i > start && token->space_before) strbuf_push(&text, ' ');
+
+        if (token->kind == PP_STRING || token->kind == PP_CHAR) {
+            for (int c = 0; c < token->length; c++) {
+                if (token->text[c] == '"' || token->text[c] == '\\') strbuf_push(&text, '\\');
+                strbuf_push(&text, token->text[c]);
+            }
+        } else {
+            strbuf_append(&text, token->text, token->length);
+        }
+    }
+    strbuf_push(&text, '"');
+
+    PPToken token = {0};
+    token.kind = PP_STRING;
+    token.text = store_text(engine, text.data, text.length);
+    token.length = text.length;
+
+    free_strbuf(&text);
+    return token;
+}
+
+// joins the last token of out with the first of the right operand, the rest
+// of the operand is appended after it
+static void paste(MacroEngine *engine, PPTokenList *out, const PPToken *right, int right_count) {
+    if (right_count == 0) return;
+
+    PPToken *left = &out->tokens[out->count - 1];
+
+    StrBuf text;
+    init_strbuf(&text, left->length + right[0].length);
+    strbuf_append(&text, left->text, left->length);
+    strbuf_append(&text, right[0].text, right[0].length);
+
+    const char *joined = store_text(engine, text.data, text.length);
+    int space_before = left->space_before;
+    HideSet hide = left->hide;
+    out->count--;
+
+    // two spellings that do not form one token are left as the tokens they do form
+    PPTokenList pasted;
+    init_token_list(&pasted);
+    pp_tokenize(joined, text.length, &pasted);
+
+    for (int i = 0; i < pasted.count; i++) {
+        PPToken token = pasted.tokens[i];
+        if (token.kind == PP_IDENTIFIER) token.name = intern(token.text, token.length);
+        token.ws = NULL;
+        token.ws_length = 0;
+        token.hide = hide;
+        if (i == 0) token.space_before = space_before;
+
+        push_token(out, token);
+    }
+
+    for (int i = 1; i < right_count; i++) {
+        push_token(out, right[i]);
+    }
+
+    free_token_list(&pasted);
+    free_strbuf(&text);
+}
+
+// replaces the parameters in the body, applies # and ##, and adds the hide set
+// to every token of the result
+static void substitute(MacroEngine *engine, const Macro *macro, const Args *args, HideSet hide,
+    int space_before, PPTokenList *out) {
+    PPTokenList *expanded = calloc(args->count + 1, sizeof(PPTokenList));
+    int *is_expanded = calloc(args->count + 1, sizeof(int));
+
+    int start = out->count;
+
+    // set while the last thing added was an empty argument next to ##
+    int placemarker = 0;
+
+    for (int i = 0; i < macro->body_count; i++) {
+        const PPToken *token = &macro->body[i];
+        int param = macro->body_params[i];
+
+        int pasted_after = i + 1 < macro->body_count && is_punctuator(&macro->body[i + 1], "##");
+        int pasted_before = i > 0 && is_punctuator(&macro->body[i - 1], "##");
+
+        if (macro->function_like && is_punctuator(token, "#") && i + 1 < macro->body_count &&
+            macro->body_params[i + 1] >= 0) {
+            int p = macro->body_params[++i];
+
+            PPToken string = stringify(engine, args, p);
+            string.space_before = token->space_before;
+            push_token(out, string);
+            placemarker = 0;
+        }
+        else if (is_punctuator(token, "##") && i + 1 < macro->body_count) {
+            const PPToken *right = &macro->body[++i];
+            int right_param = macro->body_params[i];
+
+            PPTokenList operand;
+            init_token_list(&operand);
+
+            if (macro->function_like && is_punctuator(right, "#") && i + 1 < macro->body_count &&
+                macro->body_params[i + 1] >= 0) {
+                int p = macro->body_params[++i];
+                push_token(&operand, stringify(engine, args, p));
+            }
+            else if (right_param >= 0) {
+                append_arg(&operand, args, right_param, right->space_before);
+            }
+            else {
+                push_token(&operand, *right);
+            }
+
+            int left_comma = out->count > start && is_punctuator(&out->tokens[out->count - 1], ",");
+            if (right_param == macro->param_count && macro->variadic && left_comma && operand.count == 0) {
+                // , ## __VA_ARGS__ drops the comma when there are no variable arguments
+                out->count--;
+            }
+            else if (right_param == macro->param_count && macro->variadic && left_comma) {
+                // and otherwise keeps both, there is nothing to paste
+                for (int t = 0; t < operand.count; t++) push_token(out, operand.tokens[t]);
+            }
+            else if (placemarker || out->count == start) {
+                for (int t = 0; t < operand.count; t++) push_token(out, operand.tokens[t]);
+            }
+            else {
+                paste(engine, out, operand.tokens, operand.count);
+            }
+
+            placemarker = operand.count == 0 && placemarker;
+            free_token_list(&operand);
+        }
+        else if (param >= 0 && (pasted_after || pasted_before)) {
+            // operands of ## are used as written
+            append_arg(out, args, param, token->space_before);
+            placemarker = args->starts[param] == args->ends[param];
+        }
+        else if (param >= 0) {
+            if (!is_expanded[param]) {
+                Input in = {0};
+                push_frame(&in, &args->tokens.tokens[args->starts[param]], args->ends[param] - args->starts[param], NULL);
+
+                init_token_list(&expanded[param]);
+                expand(engine, &in, &expanded[param], 0);
+                free_input(&in);
+                is_expanded[param] = 1;
+            }
+
+            for (int t = 0; t < expanded[param].count; t++) {
+                PPToken arg = expanded[param].tokens[t];
+                arg.ws = NULL;
+                arg.ws_length = 0;
+                if (t == 0) arg.space_before = token->space_before;
+                push_token(out, arg);
+            }
+            placemarker = 0;
+        }
+        else {
+            push_token(out, *token);
+            placemarker = 0;
+        }
+    }
+
+    for (int i = start; i < out->count; i++) {
+        out->tokens[i].hide = hide_union(engine, out->tokens[i].hide, hide);
+    }
+    if (out->count > start) {
+        out->tokens[start].space_before = space_before;
+    }
+
+    for (int i = 0; i <= args->count; i++) {
+        if (is_expanded[i]) free_token_list(&expanded[i]);
+    }
+    free(expanded);
+    free(is_expanded);
+}
+
+// writes out an invocation that could not be expanded as it was written
+static void emit_unexpanded(PPTokenList *out, const PPToken *name, const PPToken *open, const Args *args) {
+    push_token(out, *name);
+    push_token(out, *open);
+
+    for (int i = 0; i < args->tokens.count; i++) {
+        push_token(out, args->tokens.tokens[i]);
+    }
+}
+
+// returns 0 if an isolated expansion ran out of tokens and has to be redone
+// with the tokens that follow it
+static int expand(MacroEngine *engine, Input *in, PPTokenList *out, int mode) {
+    const PPToken *token;
+    int mark = 0;
+    int mark_out = out->count;
+
+    while ((token = next(in))) {
+        // a token read straight from the input starts what may be left unread
+        if (in->depth == 1) {
+            mark = in->frames[0].pos - 1;
+            mark_out = out->count;
+        }
+
+        Macro *macro = NULL;
+        if (token->kind == PP_IDENTIFIER && !hide_contains(engine, token->hide, token->name)) {
+            macro = find_macro(engine->macros, token->name);
+        }
+
+        if (!macro) {
+            push_token(out, *token);
+            continue;
+        }
+
+        PPToken name = *token;
+        HideSet hide;
+        int newlines = 0;
+        int cacheable = name.hide == 0;
+
+        Args args;
+        init_args(&args);
+
+        if (macro->function_like) {
+            const PPToken *open = peek(in);
+
+            // a name at the end of a replacement may still be invoked by what follows it
+            if (!open && (mode & EXPAND_ISOLATED)) return 0;
+
+            if (!open && (mode & EXPAND_PARTIAL)) {
+                free_args(&args);
+                in->stop = mark;
+                out->count = mark_out;
+                return 0;
+            }
+
+            if (!open || !is_punctuator(open, "(")) {
+                push_token(out, name);
+                continue;
+            }
+
+            PPToken open_paren = *next(in);
+            for (int i = 0; i < open_paren.ws_length; i++) {
+                if (open_paren.ws[i] == '\n') newlines++;
+            }
+            const PPToken *close = collect_args(in, &args, &newlines);
+
+            if (!close && (mode & EXPAND_ISOLATED)) {
+                free_args(&args);
+                return 0;
+            }
+
+            if (!close && (mode & EXPAND_PARTIAL)) {
+                free_args(&args);
+                in->stop = mark;
+                out->count = mark_out;
+                return 0;
+            }
+
+            if (!close) {
+                fprintf(stderr, "Unterminated invocation of macro '%s'.\n", symbol_str(macro->name));
+                engine->err = 1;
+
+                emit_unexpanded(out, &name, &open_paren, &args);
+                free_args(&args);
+                continue;
+            }
+
+            if (!check_arg_count(macro, &args)) {
+                fprintf(stderr, "Macro '%s' takes %d argument(s).\n", symbol_str(macro->name), macro->param_count);
+                engine->err = 1;
+
+                emit_unexpanded(out, &name, &open_paren, &args);
+                push_token(out, *close);
+                free_args(&args);
+                continue;
+            }
+
+            hide = hide_add(engine, hide_intersect(engine, name.hide, close->hide), macro->name);
+            cacheable = cacheable && close->hide == 0;
+        }
+        else {
+            hide = hide_add(engine, name.hide, macro->name);
+        }
+
+        // nested expansions build keys of their own while this one is expanded
+        StrBuf key = {0};
+        if (cacheable) {
+            init_strbuf(&key, 64);
+            cacheable = build_key(macro, &args, &key);
+        }
+        CacheEntry *cached = cacheable ? cache_find(engine, &key) : NULL;
+
+        int first = out->count;
+        if (cached) {
+            for (int i = 0; i < cached->count; i++) push_token(out, cached->tokens[i]);
+        }
+        else {
+            PPTokenList replaced;
+            init_token_list(&replaced);
+            substitute(engine, macro, &args, hide, name.space_before, &replaced);
+
+            Input rescan = {0};
+            push_frame(&rescan, replaced.tokens, replaced.count, NULL);
+            int complete = expand(engine, &rescan, out, EXPAND_ISOLATED);
+            free_input(&rescan);
+
+            if (complete) {
+                if (cacheable) cache_store(engine, &key, &out->tokens[first], out->count - first);
+                free_token_list(&replaced);
+            }
+            else {
+                // read again together with the rest of the input
+                out->count = first;
+                if (replaced.count > 0) {
+                    replaced.tokens[0].ws = name.ws;
+                    replaced.tokens[0].ws_length = name.ws_length;
+                }
+                push_frame(in, replaced.tokens, replaced.count, replaced.tokens);
+                newlines = 0;
+            }
+        }
+
+        if (out->count > first) {
+            out->tokens[first].ws = name.ws;
+            out->tokens[first].ws_length = name.ws_length;
+            out->tokens[first].space_before = name.space_before;
+        }
+
+        // the lines the invocation spanned follow its expansion
+        if ((mode & EXPAND_TOP) && newlines > 0) {
+            PPToken lines = {0};
+            lines.kind = PP_SPACE;
+            lines.text = NEWLINES;
+
+            while (newlines > 0) {
+                lines.length = newlines < (int)sizeof(NEWLINES) - 1 ? newlines : (int)sizeof(NEWLINES) - 1;
+                push_token(out, lines);
+                newlines -= lines.length;
+            }
+        }
+
+        free_strbuf(&key);
+        free_args(&args);
+    }
+
+    return 1;
+}
+
+void expand_macros(MacroEngine *engine, const PPToken *tokens, int count, PPTokenList *out) {
+    Input in = {0};
+    push_frame(&in, tokens, count, NULL);
+
+    expand(engine, &in, out, EXPAND_TOP);
+    free_input(&in);
+}
+
+int expand_macros_partial(MacroEngine *engine, const PPToken *tokens, int count, PPTokenList *out) {
+    Input in = {0};
+    in.stop = count;
+    push_frame(&in, tokens, count, NULL);
+
+    expand(engine, &in, out, EXPAND_TOP | EXPAND_PARTIAL);
+    free_input(&in);
+
+    return in.stop;
+}
+
+static int is_word_char(char c) {
+    return is_ident_char(c) || c == '.';
+}
+
+void write_tokens(const PPTokenList *list, StrBuf *out) {
+    for (int i = 0; i < list->count; i++) {
+        const PPToken *token = &list->tokens[i];
+
+        if (token->ws) {
+            strbuf_append(out, token->ws, token->ws_length);
+        }
+        else if (token->space_before) {
+            strbuf_push(out, ' ');
+        }
+        else if (out->length > 0 && token->length > 0) {
+            // keeps tokens out of a replacement from running into each other
+            char last = out->data[out->length - 1];
+            char next = token->text[0];
+
+            int words = is_word_char(last) && is_word_char(next);
+            int puncts = ispunct((unsigned char)last) && ispunct((unsigned char)next) &&
+                !strchr("()[]{};,", last) && !strchr("()[]{};,", next);
+            if (words || puncts) strbuf_push(out, ' ');
+        }
+
+        strbuf_append(out, token->text, token->length);
+    }
+}
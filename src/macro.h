@@ -0,0 +1,131 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include <stdint.h>
+
+#include "intern.h"
+#include "strbuf.h"
+
+typedef enum {
+    PP_IDENTIFIER,
+    PP_NUMBER,
+    PP_STRING,
+    PP_CHAR,
+    PP_PUNCTUATOR,
+    PP_OTHER,
+
+    // line breaks kept so the output lines up with the input, never rescanned
+    PP_SPACE,
+} PPTokenKind;
+
+// the names of the macros a token came out of, which it may not expand again.
+// 0 is the empty set, other values index nodes in the engine
+typedef uint32_t HideSet;
+
+typedef struct {
+    SymbolId name;
+    HideSet  next;
+} HideNode;
+
+typedef struct {
+    const char *text;
+    int         length;
+
+    // identifiers only, NO_SYMBOL when the spelling was never interned
+    SymbolId    name;
+    HideSet     hide;
+    uint8_t     kind;
+    uint8_t     space_before;
+
+    // the whitespace and comments ahead of a token read from the input, written
+    // out as they were. tokens made by an expansion have none
+    const char *ws;
+    int         ws_length;
+} PPToken;
+
+typedef struct {
+    PPToken *tokens;
+    int      count;
+    int      capacity;
+} PPTokenList;
+
+typedef struct {
+    // NO_SYMBOL marks an empty slot
+    SymbolId  name;
+    char     *value;
+    int       length;
+
+    // the replacement list, pointing into value. body_params holds the
+    // parameter each body token names, or -1
+    PPToken  *body;
+    int      *body_params;
+    int       body_count;
+
+    SymbolId *params;
+    int       param_count;
+    uint8_t   function_like;
+    uint8_t   variadic;
+} Macro;
+
+// open addressed on the interned name with linear probing. removal shifts the
+// rest of the run back, so there are no tombstones to skip over
+typedef struct {
+    Macro *slots;
+    int    count;
+    int    capacity;
+
+    // bumped on every define and undef, cached expansions from an older
+    // generation are stale
+    int    generation;
+} MacroTable;
+
+typedef struct ExpansionCache ExpansionCache;
+
+typedef struct {
+    MacroTable *macros;
+
+    HideNode *hide_nodes;
+    int       hide_count;
+    int       hide_capacity;
+
+    // text made by # and ##, in blocks that never move
+    char **text_blocks;
+    int    text_block_count;
+    int    text_block_used;
+
+    ExpansionCache *cache;
+
+    // set once an invocation could not be expanded
+    int err;
+} MacroEngine;
+
+extern void init_token_list(PPTokenList *list);
+extern void free_token_list(PPTokenList *list);
+extern PPToken *push_token(PPTokenList *list, PPToken token);
+
+// splits text into preprocessing tokens, each remembering the whitespace before it.
+// returns where the trailing whitespace starts
+extern int pp_tokenize(const char *text, int length, PPTokenList *out);
+
+extern void define_macro(MacroTable *table, SymbolId name, const char *value, int length);
+extern void define_function_macro(MacroTable *table, SymbolId name, const SymbolId *params,
+    int param_count, int variadic, const char *value, int length);
+extern void undef_macro(MacroTable *table, SymbolId name);
+extern Macro *find_macro(MacroTable *table, SymbolId name);
+extern void free_macro_table(MacroTable *table);
+
+extern MacroEngine *init_macro_engine(MacroTable *macros);
+extern void free_macro_engine(MacroEngine *engine);
+
+// appends the tokens to out with every macro invocation replaced
+extern void expand_macros(MacroEngine *engine, const PPToken *tokens, int count, PPTokenList *out);
+
+// the same, but an invocation of a function-like macro the tokens end inside,
+// or that may still be opened by what follows them, is left out. returns the
+// number of tokens expanded, the rest are to be read again with the text after them
+extern int expand_macros_partial(MacroEngine *engine, const PPToken *tokens, int count, PPTokenList *out);
+
+// appends the tokens as text, adding a space where two would otherwise run together
+extern void write_tokens(const PPTokenList *list, StrBuf *out);
+
+#endif
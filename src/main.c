@@ -9,9 +9,30 @@
 #include "ppd.h"
 #include "version.h"
 #include "camc.h"
+#include "source.h"
+#include "incpath.h"
+#include "pch.h"
 
 #define match(long_arg, short_arg) strcmp(argv[i], long_arg) == 0 || strcmp(argv[i], short_arg) == 0
 
+static void free_source(SourceFile *source, const char *preprocessed_source) {
+  if (preprocessed_source != source->data) free((char *)preprocessed_source);
+  close_source_file(source);
+}
+
+// the file name without its directory and with ext in place of its extension
+static char *replace_extension(const char *path, const char *ext) {
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  const char *dot = strrchr(name, '.');
+  int length = dot ? dot - name : (int)strlen(name);
+
+  char *replaced = malloc(length + strlen(ext) + 1);
+  memcpy(replaced, name, length);
+  strcpy(replaced + length, ext);
+
+  return replaced;
+}
+
 int main(int argc, char *argv[]) {
   if (argc < 2) {
     printf("Usage: %s [ *.c ... ] -o <out>\n", argv[0]);
@@ -54,6 +75,12 @@ int main(int argc, char *argv[]) {
   int emitAsm = 0;
   int emitObj = 0;
   int debug = 0;
+  int jobs = 1;
+  char *pch_header = NULL;
+  int preprocess_only = 0;
+  int write_deps = 0;
+  char *dep_path = NULL;
+  int lazy_bodies = 0;
 
   for (int i = 1; i < argc; i++) {
     if (match("--help", "-h")) {
@@ -65,6 +92,14 @@ int main(int argc, char *argv[]) {
       printf("  --emitasm       | -ea   Tells the compiler not to delete the generated .asm file\n");
       printf("  --emitobj       | -eo   Tells the compiler not to delete the generated .o file\n");
       printf("  --debug         | -d    Prints the compiler debug output\n");
+      printf("  --jobs <n>      | -j    Lexes large sources on n threads\n");
+      printf("  --lazy          | -l    Parses only the function bodies reachable from main\n");
+      printf("  -I <dir>                Searches dir for included headers\n");
+      printf("  -isystem <dir>          Searches dir for headers after the -I directories\n");
+      printf("  --pch <header>  | -pch  Precompiles a header to <header>.pch\n");
+      printf("  --preprocess    | -E    Writes the preprocessed source to stdout and stops\n");
+      printf("  -MD                     Writes the headers read to a make rule in <name>.d\n");
+      printf("  -MF <file>              Writes the -MD rule to file instead\n");
       return 0;
     }
     else if (match("--version", "-v")) {
@@ -92,67 +127,185 @@ int main(int argc, char *argv[]) {
     else if (match("--debug", "-d")) {
       debug = 1;
     }
+    else if (match("--lazy", "-l")) {
+      lazy_bodies = 1;
+    }
+    else if (match("--jobs", "-j")) {
+      if (i + 1 >= argc || atoi(argv[i + 1]) < 1) {
+        printf("Expected a thread count after '%s'.\n", argv[i]);
+        return 1;
+      }
+      jobs = atoi(argv[++i]);
+    }
+    else if (strncmp(argv[i], "-I", 2) == 0 || strcmp(argv[i], "-isystem") == 0) {
+      int system = argv[i][1] == 'i';
+
+      // -I takes its directory joined on or as the next argument
+      const char *dir = !system && argv[i][2] ? &argv[i][2] : NULL;
+      if (!dir) {
+        if (i + 1 >= argc) {
+          printf("Expected a directory after '%s'.\n", argv[i]);
+          return 1;
+        }
+        dir = argv[++i];
+      }
+
+      add_include_dir(dir, system);
+    }
+    else if (match("--pch", "-pch")) {
+      if (i + 1 >= argc) {
+        printf("Expected a header after '%s'.\n", argv[i]);
+        return 1;
+      }
+      pch_header = argv[++i];
+    }
+    else if (match("--preprocess", "-E")) {
+      preprocess_only = 1;
+    }
+    else if (match("-MD", "")) {
+      write_deps = 1;
+    }
+    else if (match("-MF", "")) {
+      if (i + 1 >= argc) {
+        printf("Expected a file after '%s'.\n", argv[i]);
+        return 1;
+      }
+      write_deps = 1;
+      dep_path = argv[++i];
+    }
     else {
       file_path = argv[i]; 
     }
   }
 
+  // the header is found again through the same search paths when it is included
+  if (pch_header) {
+    char *pch_path = malloc(strlen(pch_header) + 5);
+    sprintf(pch_path, "%s.pch", pch_header);
+
+    int written = write_pch(pch_header, pch_path);
+
+    free(pch_path);
+    free_include_paths();
+    free_source_cache();
+    free_interner();
+    return written ? 0 : 1;
+  }
+
   if (!exe_path) {
     printf("Output directory was not specified.\n");
     return 1;
   }
 
-  FILE *fptr = fopen(file_path, "r");
-  if (!fptr) {
+  // the file is mapped, not read, and without a directive to rewrite the
+  // preprocessor is skipped, so in that case the text is never copied
+  SourceFile source;
+  if (!open_source_file(file_path, &source)) {
     fprintf(stderr, "error: file not found '%s'\n", file_path);
     return 1;
   }
 
-  fseek(fptr, 0, SEEK_END);
-  unsigned long long sz = ftell(fptr);
-  rewind(fptr);
+  int preprocessed_length = source.length;
+  const char *preprocessed_source = source.data;
 
-  char *source = (char *)malloc(sz + 1);
-  if (!source) {
-    fprintf(stderr, "Allocation failed for source.");
-    return 1;
-  }
+  // declarations a precompiled header kept, parsed ahead of the source
+  char *pch_declarations = NULL;
+  int pch_declarations_length = 0;
+
+  if (preprocess_only || write_deps || memchr(source.data, '#', source.length)) {
+    PreProcessor *ppd = init_file_preprocessor(file_path, source.data, source.length);
+    ppd->take_declarations = !preprocess_only;
+    if (preprocess_only) {
+      stream_preprocessor(ppd, stdout);
+    }
+    run_preprocessor(ppd);
+
+    int ok = 1;
+    if (write_deps) {
+      char *target = replace_extension(file_path, ".o");
+      char *default_dep_path = replace_extension(file_path, ".d");
+
+      ok = write_dependencies(ppd, target, file_path, dep_path ? dep_path : default_dep_path);
+
+      free(target);
+      free(default_dep_path);
+    }
 
-  fread(source, 1, sz, fptr);
-  source[sz] = '\0';
+    preprocessed_length = ppd->output.length;
+    preprocessed_source = strbuf_take(&ppd->output);
+    pch_declarations = ppd->declarations;
+    pch_declarations_length = ppd->declarations_length;
+    ppd->declarations = NULL;
 
-  fclose(fptr);
+    // what was reported is still output, but -E and -MD fail on it
+    if (ppd->err && (preprocess_only || write_deps)) ok = 0;
+    free_preprocessor(ppd);
 
-  char *preprocessed_source = preprocess(source);
-  free(source);
+    if (preprocess_only || !ok) {
+      free(pch_declarations);
+      free_source(&source, preprocessed_source);
+      free_include_paths();
+      free_source_cache();
+      free_interner();
+      return ok ? 0 : 1;
+    }
+  }
 
-  Lexer *lexer = init_lexer(preprocessed_source, debug);
-  free(preprocessed_source);
+  // the lexer borrows the source, which has to outlive the tokens
+  Lexer *lexer = init_lexer_len(preprocessed_source, preprocessed_length, debug);
 
-  tokenize(lexer);
+  if (jobs > 1) {
+    tokenize_parallel(lexer, jobs);
+  } else {
+    tokenize(lexer);
+  }
   if (lexer->err != NO_LEXER_ERROR) {
+    free(pch_declarations);
     free_lexer(lexer);
+    free_source(&source, preprocessed_source);
     return 1;
   }
 
-  Parser *parser = init_parser(lexer->tokens, debug, file_path);
+  Parser *parser = init_parser(lexer, debug, file_path);
+  parser->defer_bodies = lazy_bodies;
+
+  // load_pch checked the declarations before handing them over
+  if (pch_declarations) {
+    load_pch_declarations(parser, pch_declarations, pch_declarations_length);
+    free(pch_declarations);
+  }
   parse_ast(parser);
 
+  // the bodies are built from the tokens, before the lexer goes
+  if (lazy_bodies && parser->err == NO_PARSER_ERROR) {
+    parse_reachable_bodies(parser);
+  }
+
   free_lexer(lexer);
+  free_source(&source, preprocessed_source);
 
   if (parser->err != NO_PARSER_ERROR) {
     free_parser(parser);
+    free_include_paths();
+    free_source_cache();
+    free_interner();
     return 1;
   }
 
-  Analyzer *analyzer = init_analyzer(parser->tree, parser->node_count);
+  Analyzer *analyzer = init_analyzer(parser->nodes, parser->tree, parser->node_count);
   analyze_ast(analyzer);
 
-  Compiler *compiler = init_compiler(parser->tree, parser->node_count, exe_path, emitAsm, emitObj);
+  Compiler *compiler = init_compiler(parser->nodes, parser->tree, parser->node_count, exe_path, emitAsm, emitObj);
   compile(compiler);
 
+  free_analyzer(analyzer);
   free_parser(parser);
   free_compiler(compiler);
 
+  // the AST names point into the interner, so it goes last
+  free_include_paths();
+  free_source_cache();
+  free_interner();
+
   return 0;
 }
\ No newline at end of file
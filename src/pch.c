@@ -0,0 +1,589 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "pch.h"
+#include "lexer.h"
+#include "source.h"
+#include "strbuf.h"
+
+// layout, all numbers in the byte order of the machine that wrote it:
+//
+//   magic, u32 file count, u32 macro count, u32 text length,
+//   u32 declarations length
+//   per file:  u64 content hash, string path, u8 once, string guard
+//   per macro: string name, u8 function like, u8 variadic, u32 param count,
+//              string per param, string value
+//   the text
+//   the declarations, empty unless the text parses to nothing else:
+//     u32 node count, u32 declaration count
+//     per node: u8 type and its fields, see put_node
+//     per declaration: u32 node index
+//
+// where a string is a u32 length and its bytes. nodes are numbered from 1 in
+// the order they are written, a node only refers to ones before it
+
+static uint64_t hash_content(const char *data, int length) {
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+static void put_u32(StrBuf *buf, uint32_t value) {
+    strbuf_append(buf, (const char *)&value, sizeof(value));
+}
+
+static void put_string(StrBuf *buf, const char *str, int length) {
+    put_u32(buf, length);
+    strbuf_append(buf, str, length);
+}
+
+// an empty string for NO_SYMBOL
+static void put_symbol(StrBuf *buf, SymbolId symbol) {
+    if (symbol != NO_SYMBOL) {
+        put_string(buf, symbol_str(symbol), symbol_length(symbol));
+    } else {
+        put_u32(buf, 0);
+    }
+}
+
+static void put_specs(StrBuf *buf, TypeSpecifier specs) {
+    strbuf_append(buf, (const char *)&specs, sizeof(specs));
+}
+
+// the guard is empty when the file has none
+static int put_file(StrBuf *buf, const char *path, const IncludeFile *include) {
+    SourceFile file;
+    if (!open_cached_source_file(path, &file)) return 0;
+
+    uint64_t hash = hash_content(file.data, file.length);
+    strbuf_append(buf, (const char *)&hash, sizeof(hash));
+    put_string(buf, path, strlen(path));
+
+    strbuf_push(buf, include->once);
+    put_symbol(buf, include->guard);
+
+    return 1;
+}
+
+// only declarations with nothing to evaluate are kept, prototypes, types and
+// variables without initializers
+static int is_plain_declaration(const AstNode *node) {
+    switch (node->type) {
+        case AST_STRUCT:
+        case AST_UNION:
+        case AST_ENUM:
+        case AST_TYPEDEF:
+        case AST_FUNCTION_POINTER_DECLARATION:
+            return 1;
+        case AST_FUNCTION:
+            return !node->as.func->body && !node->as.func->body_deferred;
+        case AST_VARIABLE_DECLARATION:
+            for (int i = 0; i < node->as.var_dec->declarator_count; i++) {
+                if (node->as.var_dec->declarators[i]->value != NO_NODE) return 0;
+            }
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void put_fields(StrBuf *buf, SymbolId name, const NodeId *fields, int field_count) {
+    put_symbol(buf, name);
+    put_u32(buf, field_count);
+    for (int i = 0; i < field_count; i++) {
+        put_u32(buf, fields[i]);
+    }
+}
+
+// children are written as their index, which is their NodeId as every node
+// the parser made is written
+static void put_node(StrBuf *buf, const AstNode *node) {
+    strbuf_push(buf, node->type);
+
+    switch (node->type) {
+        case AST_STRUCT:
+            put_fields(buf, node->as.a_struct->name, node->as.a_struct->fields, node->as.a_struct->field_count);
+            break;
+        case AST_UNION:
+            put_fields(buf, node->as.a_union->name, node->as.a_union->fields, node->as.a_union->field_count);
+            break;
+        case AST_ENUM:
+            put_symbol(buf, node->as.an_enum->name);
+            put_u32(buf, node->as.an_enum->value_count);
+            for (int i = 0; i < node->as.an_enum->value_count; i++) {
+                AstEnumValue *value = node->as.an_enum->values[i];
+                put_symbol(buf, value->name);
+                put_u32(buf, value->value);
+                strbuf_push(buf, value->explicit_value);
+            }
+            break;
+        case AST_TYPEDEF:
+            put_specs(buf, node->as.type_def->type_specs);
+            put_symbol(buf, node->as.type_def->identifier);
+            break;
+        case AST_FUNCTION_POINTER_DECLARATION:
+            put_symbol(buf, node->as.fptr->identifier);
+            put_specs(buf, node->as.fptr->return_type_specs);
+            put_u32(buf, node->as.fptr->param_count);
+            for (int i = 0; i < node->as.fptr->param_count; i++) {
+                put_specs(buf, node->as.fptr->param_type_specs[i]);
+            }
+            break;
+        case AST_FUNCTION:
+            put_symbol(buf, node->as.func->identifier);
+            put_specs(buf, node->as.func->type_specifier);
+            strbuf_push(buf, node->as.func->is_void_params);
+            put_u32(buf, node->as.func->params_count);
+            for (int i = 0; i < node->as.func->params_count; i++) {
+                put_symbol(buf, node->as.func->params[i]->name);
+                put_specs(buf, node->as.func->params[i]->type_specifier);
+            }
+            break;
+        case AST_VARIABLE_DECLARATION:
+            put_specs(buf, node->as.var_dec->type_specifier);
+            put_u32(buf, node->as.var_dec->declarator_count);
+            for (int i = 0; i < node->as.var_dec->declarator_count; i++) {
+                put_symbol(buf, node->as.var_dec->declarators[i]->identifier);
+                put_u32(buf, node->as.var_dec->declarators[i]->pointer_level);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// parses the preprocessed header. when it holds nothing but plain
+// declarations they are written to buf, otherwise buf is left empty and the
+// text stands in for the header alone
+static void put_declarations(StrBuf *buf, const char *path, const char *text, int length) {
+    // a header this cannot parse keeps only its text, which is not an error
+    Lexer *lexer = init_lexer_len(text, length, 0);
+    lexer->quiet = 1;
+    tokenize(lexer);
+
+    Parser *parser = NULL;
+    int plain = lexer->err == NO_LEXER_ERROR;
+    if (plain) {
+        parser = init_parser(lexer, 0, (char *)path);
+        parser->quiet = 1;
+        parse_ast(parser);
+        plain = parser->err == NO_PARSER_ERROR && parser->node_count > 0;
+    }
+
+    for (uint32_t id = 1; plain && id < parser->nodes_used; id++) {
+        plain = is_plain_declaration(ast_node(parser, id));
+    }
+
+    if (plain) {
+        put_u32(buf, parser->nodes_used - 1);
+        put_u32(buf, parser->node_count);
+        for (uint32_t id = 1; id < parser->nodes_used; id++) {
+            put_node(buf, ast_node(parser, id));
+        }
+        for (int i = 0; i < parser->node_count; i++) {
+            put_u32(buf, parser->tree[i]);
+        }
+    }
+
+    if (parser) free_parser(parser);
+    free_lexer(lexer);
+}
+
+int write_pch(const char *header_path, const char *pch_path) {
+    SourceFile header;
+    if (!open_cached_source_file(header_path, &header)) {
+        fprintf(stderr, "File not found: \"%s\".\n", header_path);
+        return 0;
+    }
+
+    PreProcessor *ppd = init_header_preprocessor(header_path, header.data, header.length);
+    run_preprocessor(ppd);
+
+    StrBuf declarations;
+    init_strbuf(&declarations, 4096);
+    put_declarations(&declarations, header_path, ppd->output.data, ppd->output.length);
+
+    StrBuf out;
+    init_strbuf(&out, ppd->output.length + declarations.length + 4096);
+    strbuf_append(&out, PCH_MAGIC, strlen(PCH_MAGIC));
+    put_u32(&out, ppd->opened_count);
+    put_u32(&out, ppd->macros.count);
+    put_u32(&out, ppd->output.length);
+    put_u32(&out, declarations.length);
+
+    // the header comes first, then the others in the order they were opened
+    int ok = ppd->opened_count > 0;
+    for (int i = 0; ok && i < ppd->opened_count; i++) {
+        const char *path = symbol_str(ppd->opened[i]);
+        ok = put_file(&out, path, &ppd->includes[find_include(ppd, path)]);
+    }
+
+    for (int i = 0; i < ppd->macros.capacity; i++) {
+        Macro *macro = &ppd->macros.slots[i];
+        if (macro->name == NO_SYMBOL) continue;
+
+        put_string(&out, symbol_str(macro->name), symbol_length(macro->name));
+        strbuf_push(&out, macro->function_like);
+        strbuf_push(&out, macro->variadic);
+        put_u32(&out, macro->param_count);
+        for (int p = 0; p < macro->param_count; p++) {
+            put_string(&out, symbol_str(macro->params[p]), symbol_length(macro->params[p]));
+        }
+        put_string(&out, macro->value, macro->length);
+    }
+
+    strbuf_append(&out, ppd->output.data, ppd->output.length);
+    strbuf_append(&out, declarations.data, declarations.length);
+    free_strbuf(&declarations);
+    free_preprocessor(ppd);
+
+    FILE *fptr = ok ? fopen(pch_path, "wb") : NULL;
+    if (fptr) {
+        ok = fwrite(out.data, 1, out.length, fptr) == (size_t)out.length;
+        fclose(fptr);
+    } else {
+        fprintf(stderr, "Could not write '%s'.\n", pch_path);
+        ok = 0;
+    }
+
+    free_strbuf(&out);
+    return ok;
+}
+
+// reads from the mapped file, any read past its end marks it as malformed
+typedef struct {
+    const char *data;
+    int         length;
+    int         pos;
+    int         err;
+} PchReader;
+
+static const char *take(PchReader *reader, int length) {
+    if (reader->err || length < 0 || length > reader->length - reader->pos) {
+        reader->err = 1;
+        return NULL;
+    }
+
+    const char *at = &reader->data[reader->pos];
+    reader->pos += length;
+    return at;
+}
+
+static uint32_t take_u32(PchReader *reader) {
+    uint32_t value = 0;
+    const char *at = take(reader, sizeof(value));
+    if (at) memcpy(&value, at, sizeof(value));
+
+    return value;
+}
+
+static SymbolId take_symbol(PchReader *reader) {
+    int length = take_u32(reader);
+    const char *at = take(reader, length);
+
+    return at && length > 0 ? intern(at, length) : NO_SYMBOL;
+}
+
+// with no preprocessor every file the header was made from is only checked
+// to be unchanged. with one, the files are taken as included and opened by it
+static int read_files(PchReader *reader, int file_count, PreProcessor *ppd) {
+    for (int i = 0; i < file_count; i++) {
+        uint64_t hash = 0;
+        const char *at = take(reader, sizeof(hash));
+        if (at) memcpy(&hash, at, sizeof(hash));
+
+        int length = take_u32(reader);
+        const char *path = take(reader, length);
+        const char *once = take(reader, 1);
+        SymbolId guard = take_symbol(reader);
+        if (reader->err) return 0;
+
+        char *name = strndup(path, length);
+        SourceFile file;
+        int fresh = 1;
+
+        if (!ppd) {
+            fresh = open_cached_source_file(name, &file) && hash_content(file.data, file.length) == hash;
+        }
+        else {
+            int include = find_include(ppd, name);
+            fresh = include >= 0;
+
+            if (fresh) {
+                ppd->includes[include].once = *once;
+                ppd->includes[include].guard = guard;
+                ppd->includes[include].scanned = 1;
+                note_opened(ppd, include, name);
+            }
+        }
+        free(name);
+
+        if (!fresh) return 0;
+    }
+
+    return 1;
+}
+
+// with no table the macros are only checked to be readable
+static void read_macros(PchReader *reader, int macro_count, MacroTable *table) {
+    SymbolId *params = NULL;
+    int param_capacity = 0;
+
+    for (int i = 0; i < macro_count && !reader->err; i++) {
+        SymbolId name = take_symbol(reader);
+        const char *flags = take(reader, 2);
+        int param_count = take_u32(reader);
+
+        // allocated even for no parameters, a function like macro has a list
+        if (param_count >= param_capacity) {
+            param_capacity = param_count + 8;
+            params = realloc(params, sizeof(SymbolId) * param_capacity);
+        }
+        for (int p = 0; p < param_count && !reader->err; p++) {
+            params[p] = take_symbol(reader);
+        }
+
+        int length = take_u32(reader);
+        const char *value = take(reader, length);
+
+        if (table && !reader->err) {
+            define_function_macro(table, name, flags[0] ? params : NULL, param_count, flags[1], value, length);
+        }
+    }
+
+    free(params);
+}
+
+// a count longer than what is left of the file is malformed, so it is found
+// before anything that size is allocated
+static int take_count(PchReader *reader) {
+    uint32_t count = take_u32(reader);
+    if (count > (uint32_t)(reader->length - reader->pos)) {
+        reader->err = 1;
+        return 0;
+    }
+
+    return count;
+}
+
+static TypeSpecifier take_specs(PchReader *reader) {
+    TypeSpecifier specs = {0};
+    const char *at = take(reader, sizeof(specs));
+    if (at) memcpy(&specs, at, sizeof(specs));
+
+    return specs;
+}
+
+// a child is one of the read nodes before it, node 1 became first
+static NodeId take_child(PchReader *reader, uint32_t read, NodeId first) {
+    uint32_t index = take_u32(reader);
+    if (index < 1 || index > read) {
+        reader->err = 1;
+        return NO_NODE;
+    }
+
+    return first + index - 1;
+}
+
+static NodeId *take_fields(PchReader *reader, Arena *arena, int *field_count, uint32_t read, NodeId first) {
+    *field_count = take_count(reader);
+
+    NodeId *fields = arena_alloc(arena, sizeof(NodeId) * (*field_count + 1));
+    for (int i = 0; i < *field_count && !reader->err; i++) {
+        fields[i] = take_child(reader, read, first);
+    }
+
+    return fields;
+}
+
+// builds what the node of type points to in arena, every node kept is one
+// that holds a pointer
+static void *take_node(PchReader *reader, Arena *arena, AstType type, uint32_t read, NodeId first) {
+    switch (type) {
+        case AST_STRUCT: {
+            AstStruct *a_struct = arena_alloc(arena, sizeof(AstStruct));
+            a_struct->name = take_symbol(reader);
+            a_struct->fields = take_fields(reader, arena, &a_struct->field_count, read, first);
+            return a_struct;
+        }
+        case AST_UNION: {
+            AstUnion *a_union = arena_alloc(arena, sizeof(AstUnion));
+            a_union->name = take_symbol(reader);
+            a_union->fields = take_fields(reader, arena, &a_union->field_count, read, first);
+            return a_union;
+        }
+        case AST_ENUM: {
+            AstEnum *an_enum = arena_alloc(arena, sizeof(AstEnum));
+            an_enum->name = take_symbol(reader);
+            an_enum->value_count = take_count(reader);
+            an_enum->values = arena_alloc(arena, sizeof(AstEnumValue *) * (an_enum->value_count + 1));
+
+            for (int i = 0; i < an_enum->value_count && !reader->err; i++) {
+                AstEnumValue *value = arena_alloc(arena, sizeof(AstEnumValue));
+                value->name = take_symbol(reader);
+                value->value = (int)take_u32(reader);
+
+                const char *explicit_value = take(reader, 1);
+                value->explicit_value = explicit_value ? *explicit_value : 0;
+                an_enum->values[i] = value;
+            }
+            return an_enum;
+        }
+        case AST_TYPEDEF: {
+            AstTypedef *type_def = arena_alloc(arena, sizeof(AstTypedef));
+            type_def->type_specs = take_specs(reader);
+            type_def->identifier = take_symbol(reader);
+            return type_def;
+        }
+        case AST_FUNCTION_POINTER_DECLARATION: {
+            AstFunctionPointerDeclaration *fptr = arena_alloc(arena, sizeof(AstFunctionPointerDeclaration));
+            fptr->identifier = take_symbol(reader);
+            fptr->return_type_specs = take_specs(reader);
+            fptr->param_count = take_count(reader);
+            fptr->param_type_specs = arena_alloc(arena, sizeof(TypeSpecifier) * (fptr->param_count + 1));
+
+            for (int i = 0; i < fptr->param_count && !reader->err; i++) {
+                fptr->param_type_specs[i] = take_specs(reader);
+            }
+            return fptr;
+        }
+        case AST_FUNCTION: {
+            AstFunctionDeclaration *func = arena_alloc(arena, sizeof(AstFunctionDeclaration));
+            memset(func, 0, sizeof(AstFunctionDeclaration));
+            func->identifier = take_symbol(reader);
+            func->type_specifier = take_specs(reader);
+
+            const char *is_void_params = take(reader, 1);
+            func->is_void_params = is_void_params ? *is_void_params : 0;
+            func->params_count = take_count(reader);
+            func->params = arena_alloc(arena, sizeof(AstFunctionParameter *) * (func->params_count + 1));
+
+            for (int i = 0; i < func->params_count && !reader->err; i++) {
+                AstFunctionParameter *param = arena_alloc(arena, sizeof(AstFunctionParameter));
+                param->name = take_symbol(reader);
+                param->type_specifier = take_specs(reader);
+                func->params[i] = param;
+            }
+            return func;
+        }
+        case AST_VARIABLE_DECLARATION: {
+            AstVariableDeclaration *var_dec = arena_alloc(arena, sizeof(AstVariableDeclaration));
+            var_dec->type_specifier = take_specs(reader);
+            var_dec->declarator_count = take_count(reader);
+            var_dec->declarators = arena_alloc(arena, sizeof(AstDeclarator *) * (var_dec->declarator_count + 1));
+
+            for (int i = 0; i < var_dec->declarator_count && !reader->err; i++) {
+                AstDeclarator *declarator = arena_alloc(arena, sizeof(AstDeclarator));
+                declarator->identifier = take_symbol(reader);
+                declarator->pointer_level = take_u32(reader);
+                declarator->value = NO_NODE;
+                var_dec->declarators[i] = declarator;
+            }
+            return var_dec;
+        }
+        default:
+            reader->err = 1;
+            return NULL;
+    }
+}
+
+// with no parser the declarations are only checked to be readable, what they
+// would be made of is built in a scratch arena and dropped
+static int read_declarations(PchReader *reader, Parser *parser) {
+    Arena scratch;
+    init_arena(&scratch);
+
+    Arena *arena = parser ? &parser->arena : &scratch;
+    NodeId first = parser ? parser->nodes_used : 1;
+
+    uint32_t node_count = take_count(reader);
+    uint32_t declaration_count = take_count(reader);
+
+    for (uint32_t i = 0; i < node_count && !reader->err; i++) {
+        const char *type = take(reader, 1);
+        if (!type) break;
+
+        void *value = take_node(reader, arena, (AstType)*type, i, first);
+        if (parser && !reader->err) init_node(parser, value, (AstType)*type);
+    }
+
+    for (uint32_t i = 0; i < declaration_count && !reader->err; i++) {
+        NodeId node = take_child(reader, node_count, first);
+        if (parser && !reader->err) add_declaration(parser, node);
+    }
+
+    free_arena(&scratch);
+    return !reader->err && reader->pos == reader->length;
+}
+
+int load_pch_declarations(Parser *parser, const char *declarations, int length) {
+    PchReader reader = { declarations, length, 0, 0 };
+    return read_declarations(&reader, parser);
+}
+
+// nothing but blank lines was read before the header, so its declarations
+// come first in the tree as its text would have
+static int output_is_blank(PreProcessor *ppd) {
+    for (int i = 0; i < ppd->output.length; i++) {
+        char c = ppd->output.data[i];
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n') return 0;
+    }
+
+    return 1;
+}
+
+int load_pch(PreProcessor *ppd, const char *pch_path) {
+    SourceFile pch;
+    if (!open_source_file(pch_path, &pch)) return 0;
+
+    PchReader reader = { pch.data, pch.length, 0, 0 };
+    const char *magic = take(&reader, strlen(PCH_MAGIC));
+    int file_count = take_u32(&reader);
+    int macro_count = take_u32(&reader);
+    int text_length = take_u32(&reader);
+    int declarations_length = take_u32(&reader);
+
+    int files_start = reader.pos;
+    int usable = magic && memcmp(magic, PCH_MAGIC, strlen(PCH_MAGIC)) == 0 &&
+        read_files(&reader, file_count, NULL);
+
+    // a file cut short is found before anything is defined
+    const char *declarations = NULL;
+    if (usable) {
+        read_macros(&reader, macro_count, NULL);
+        take(&reader, text_length);
+        declarations = take(&reader, declarations_length);
+        usable = !reader.err;
+    }
+
+    int use_declarations = usable && declarations_length > 0 && ppd->take_declarations &&
+        !ppd->declarations && output_is_blank(ppd);
+    if (use_declarations) {
+        PchReader check = { declarations, declarations_length, 0, 0 };
+        use_declarations = read_declarations(&check, NULL);
+    }
+
+    if (usable) {
+        reader.pos = files_start;
+        read_files(&reader, file_count, ppd);
+        read_macros(&reader, macro_count, &ppd->macros);
+        const char *text = take(&reader, text_length);
+
+        if (use_declarations) {
+            ppd->declarations = malloc(declarations_length);
+            memcpy(ppd->declarations, declarations, declarations_length);
+            ppd->declarations_length = declarations_length;
+        } else {
+            strbuf_append(&ppd->output, text, text_length);
+        }
+    }
+
+    close_source_file(&pch);
+    return usable;
+}
@@ -0,0 +1,28 @@
+#ifndef PCH_H
+#define PCH_H
+
+#include "ppd.h"
+#include "ast.h"
+
+// a precompiled header holds what preprocessing a header leaves behind: the
+// macros it defines and its expanded text, with a content hash of every file
+// that was read for it and whether each is guarded or marked once. the file is mapped when loaded, not parsed into copies.
+// when the text parses to prototypes, types and variables alone, the
+// declarations are kept too, so a compile can skip parsing them
+#define PCH_MAGIC "CAMCPCH3"
+
+// preprocesses the header and writes the result to pch_path, 0 on failure
+extern int write_pch(const char *header_path, const char *pch_path);
+
+// defines the macros and appends the text of the header the file at pch_path
+// was made from, the files read for it count as included and opened. returns 0, leaving ppd untouched, when there is no such file
+// or any file it was made from has changed. with ppd->take_declarations set
+// and only blank lines output so far, the kept declarations are put in
+// ppd->declarations in place of the text
+extern int load_pch(PreProcessor *ppd, const char *pch_path);
+
+// adds the declarations load_pch handed over to the parser's tree, ahead of
+// what parse_ast reads. returns 0 when they are malformed
+extern int load_pch_declarations(Parser *parser, const char *declarations, int length);
+
+#endif
@@ -2,33 +2,128 @@
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <stdarg.h>
 
 #include "ppd.h"
+#include "ppexpr.h"
+#include "incpath.h"
+#include "pch.h"
+#include "macro.h"
+#include "strbuf.h"
+
+// diagnostics go to stderr, under -E stdout is the output itself
+static void report(PreProcessor *ppd, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+
+    ppd->err = 1;
+}
 
-PreProcessor *init_preprocessor(char *source) {
-    PreProcessor *ppd = malloc(sizeof(PreProcessor));
-    ppd->macros = malloc(sizeof(Macro *));
-    ppd->source = strdup(source);
-    ppd->count = 0;
-    ppd->capacity = 1;
+// the top level source is the caller's buffer and has no path, included files
+// come from the source cache, which keeps them for later includes and compiles
+static void push_file(PreProcessor *ppd, SourceFile file, char *path, int include) {
+    if (ppd->depth > 0) {
+        ppd->files[ppd->depth - 1].current = ppd->current;
+    }
+
+    if (ppd->depth >= ppd->capacity) {
+        ppd->capacity = ppd->capacity ? ppd->capacity * 2 : 8;
+        ppd->files = realloc(ppd->files, sizeof(IncludeFrame) * ppd->capacity);
+    }
+
+    IncludeFrame *frame = &ppd->files[ppd->depth++];
+    frame->file = file;
+    frame->path = path;
+    frame->current = 0;
+    frame->include = include;
+    frame->line = 1;
+    frame->line_pos = 0;
+
+    ppd->source = file.data;
+    ppd->length = file.length;
     ppd->current = 0;
+}
+
+static void pop_file(PreProcessor *ppd) {
+    IncludeFrame *frame = &ppd->files[--ppd->depth];
+    free(frame->path);
+
+    if (ppd->depth > 0) {
+        frame = &ppd->files[ppd->depth - 1];
+        ppd->source = frame->file.data;
+        ppd->length = frame->file.length;
+        ppd->current = frame->current;
+    }
+}
+
+PreProcessor *init_preprocessor(const char *source, int length) {
+    PreProcessor *ppd = malloc(sizeof(PreProcessor));
+    ppd->macros.slots = NULL;
+    ppd->macros.count = 0;
+    ppd->macros.capacity = 0;
+    ppd->macros.generation = 0;
+    ppd->engine = init_macro_engine(&ppd->macros);
+    ppd->err = 0;
+
+    ppd->files = NULL;
+    ppd->depth = 0;
+    ppd->capacity = 0;
+
+    ppd->includes = NULL;
+    ppd->include_count = 0;
+    ppd->include_capacity = 0;
+    ppd->include_index.slots = NULL;
+    ppd->include_index.capacity = 0;
+
+    ppd->conditionals = NULL;
+    ppd->conditional_count = 0;
+    ppd->conditional_capacity = 0;
+
+    ppd->opened = NULL;
+    ppd->opened_count = 0;
+    ppd->opened_capacity = 0;
+    ppd->stream = NULL;
+
+    ppd->take_declarations = 0;
+    ppd->declarations = NULL;
+    ppd->declarations_length = 0;
+
+    init_strbuf(&ppd->output, length + length / 4);
+    init_token_list(&ppd->tokens);
+    init_token_list(&ppd->expanded);
+
+    SourceFile file = { source, length, 0 };
+    push_file(ppd, file, NULL, -1);
 
     return ppd;
 }
 
-void free_macro(Macro *macro) {
-    free(macro->name);
-    free(macro->value);
-    free(macro);
+PreProcessor *init_file_preprocessor(const char *path, const char *source, int length) {
+    PreProcessor *ppd = init_preprocessor(source, length);
+    ppd->files[0].path = strdup(path);
+
+    return ppd;
 }
 
 void free_preprocessor(PreProcessor *ppd) {
-    for (int i = 0; i < ppd->count; i++ ) {
-        free_macro(ppd->macros[i]);
+    while (ppd->depth > 0) {
+        pop_file(ppd);
     }
-    free(ppd->macros);
-
-    free(ppd->source);
+    free(ppd->files);
+    free(ppd->includes);
+    free_symbol_map(&ppd->include_index);
+    free(ppd->conditionals);
+    free(ppd->opened);
+    free(ppd->declarations);
+
+    free_macro_engine(ppd->engine);
+    free_macro_table(&ppd->macros);
+
+    free_strbuf(&ppd->output);
+    free_token_list(&ppd->tokens);
+    free_token_list(&ppd->expanded);
     free(ppd);
 }
 
@@ -37,7 +132,7 @@ void advance(PreProcessor *ppd) {
 }
 
 int is_end(PreProcessor *ppd) {
-    return ppd->current >= (int)strlen(ppd->source);
+    return ppd->current >= ppd->length;
 }
 
 char current(PreProcessor *ppd) {
@@ -45,248 +140,829 @@ char current(PreProcessor *ppd) {
     return ppd->source[ppd->current];
 }
 
-void add_macro(PreProcessor *ppd, char *name, char *value) {
-    if (ppd->count >= ppd->capacity) {
-        ppd->capacity *= 2;
-        ppd->macros = realloc(ppd->macros, sizeof(Macro *) * ppd->capacity);
+// expands the macros in a run of text and writes it out, the whitespace between
+// tokens that are not replaced is kept as it was. with keep_open an invocation
+// the run ends inside is held back, returns where the text held back starts
+static int write_text(PreProcessor *ppd, int start, int end, int keep_open) {
+    ppd->tokens.count = 0;
+    ppd->expanded.count = 0;
+    int trailing = pp_tokenize(&ppd->source[start], end - start, &ppd->tokens);
+
+    if (keep_open) {
+        int used = expand_macros_partial(ppd->engine, ppd->tokens.tokens, ppd->tokens.count, &ppd->expanded);
+        write_tokens(&ppd->expanded, &ppd->output);
+        if (used < ppd->tokens.count) return ppd->tokens.tokens[used].ws - ppd->source;
+    }
+    else {
+        expand_macros(ppd->engine, ppd->tokens.tokens, ppd->tokens.count, &ppd->expanded);
+        write_tokens(&ppd->expanded, &ppd->output);
     }
 
-    Macro *macro = malloc(sizeof(Macro));
-    macro->name = strdup(name);
-    macro->value = strdup(value);
-
-    ppd->macros[ppd->count++] = macro;
+    strbuf_append(&ppd->output, &ppd->source[start + trailing], end - start - trailing);
+    return end;
 }
 
-char *replace_text(PreProcessor *ppd) {
-    char *output = malloc(strlen(ppd->source) * 2);
-    output[0] = '\0';
-
-    ppd->current = 0;
+// a run of text between directives
+void flush_text(PreProcessor *ppd, int start, int end) {
+    if (start >= end) return;
+    write_text(ppd, start, end, 0);
+}
 
+// spaces, tabs and escaped line breaks
+void skip_blanks(PreProcessor *ppd) {
     while (!is_end(ppd)) {
-        if (isalpha(current(ppd)) || current(ppd) == '_') {
-            int start = ppd->current;
-            while (isalnum(current(ppd)) || current(ppd) == '_') {
-                advance(ppd);
-            }
-            int len = ppd->current - start;
-            char *lexeme = strndup(&ppd->source[start], len);
-
-            int replaced = 0;
-            for (int i = 0; i < ppd->count; i++) {
-                if (strcmp(ppd->macros[i]->name, lexeme) == 0) {
-                    strcat(output, ppd->macros[i]->value);
-                    replaced = 1;
-                    break;
-                }
-            }
-            if (!replaced) {
-                strcat(output, lexeme);
-            }
-
-            free(lexeme);
-        } else {
-            char c[2] = { current(ppd), '\0' };
-            strcat(output, c);
+        if (current(ppd) == ' ' || current(ppd) == '\t' || current(ppd) == '\r') {
             advance(ppd);
         }
+        else if (current(ppd) == '\\' && ppd->current + 1 < ppd->length && ppd->source[ppd->current + 1] == '\n') {
+            ppd->current += 2;
+        }
+        else if (current(ppd) == '\\' && ppd->current + 2 < ppd->length &&
+            ppd->source[ppd->current + 1] == '\r' && ppd->source[ppd->current + 2] == '\n') {
+            ppd->current += 3;
+        }
+        else {
+            break;
+        }
     }
-
-    return output;
 }
 
-char *try_parse_macro_name(PreProcessor *ppd) {
+SymbolId try_parse_macro_name(PreProcessor *ppd) {
     int name_start = ppd->current;
-    while (!isspace(current(ppd))) {
+    while (isalnum(current(ppd)) || current(ppd) == '_') {
         advance(ppd);
     }
-    char *name = strndup(&ppd->source[name_start], ppd->current - name_start);
+    if (ppd->current == name_start) return NO_SYMBOL;
+
+    return intern(&ppd->source[name_start], ppd->current - name_start);
+}
 
-    while (ppd->source[ppd->current] == ' ' || ppd->source[ppd->current] == '\t') {
-        ppd->current++;
+// reads "(a, b, ...)" straight after a macro name. returns the number of
+// parameters, or -1 if the list is malformed
+int try_parse_macro_params(PreProcessor *ppd, SymbolId **params, int *variadic) {
+    int count = 0;
+    int capacity = 4;
+    *params = malloc(sizeof(SymbolId) * capacity);
+    *variadic = 0;
+
+    advance(ppd);
+    skip_blanks(ppd);
+    if (current(ppd) == ')') {
+        advance(ppd);
+        return 0;
     }
 
-    return name;
+    while (1) {
+        skip_blanks(ppd);
+
+        if (ppd->current + 3 <= ppd->length && strncmp(&ppd->source[ppd->current], "...", 3) == 0) {
+            ppd->current += 3;
+            *variadic = 1;
+        }
+        else {
+            SymbolId param = try_parse_macro_name(ppd);
+            if (param == NO_SYMBOL) return -1;
+
+            if (count >= capacity) {
+                capacity *= 2;
+                *params = realloc(*params, sizeof(SymbolId) * capacity);
+            }
+            (*params)[count++] = param;
+        }
+
+        skip_blanks(ppd);
+        if (current(ppd) == ')') {
+            advance(ppd);
+            return count;
+        }
+        if (current(ppd) != ',' || *variadic) return -1;
+        advance(ppd);
+    }
 }
 
-char *try_parse_macro_value(PreProcessor *ppd) {
-    int value_start = ppd->current;
+// the value is left in place in the source, start is where it begins. a
+// backslash at the end of a line continues it onto the next
+int try_parse_macro_value(PreProcessor *ppd, int *start) {
+    skip_blanks(ppd);
+
+    *start = ppd->current;
     while (current(ppd) != '\n' && current(ppd) != '\0') {
+        if (current(ppd) == '\\' && ppd->current + 1 < ppd->length && ppd->source[ppd->current + 1] == '\n') {
+            ppd->current++;
+        }
+        else if (current(ppd) == '\\' && ppd->current + 2 < ppd->length &&
+            ppd->source[ppd->current + 1] == '\r' && ppd->source[ppd->current + 2] == '\n') {
+            ppd->current += 2;
+        }
         ppd->current++; 
     }
-    char *value = strndup(&ppd->source[value_start], ppd->current - value_start);
 
-    return value;
+    return ppd->current - *start;
 }
 
 void process_define(PreProcessor *ppd) {
-    while (current(ppd) == ' ' || current(ppd) == '\t') {
-        advance(ppd);
+    skip_blanks(ppd);
+
+    SymbolId name = try_parse_macro_name(ppd);
+    if (name == NO_SYMBOL) {
+        report(ppd, "Expected a macro name after #define.\n");
+        return;
     }
 
-    char *name = try_parse_macro_name(ppd);
-    char *value = try_parse_macro_value(ppd);
+    // only a parenthesis touching the name starts a parameter list
+    SymbolId *params = NULL;
+    int variadic = 0;
+    int param_count = 0;
 
-    add_macro(ppd, name, value);
+    if (current(ppd) == '(') {
+        param_count = try_parse_macro_params(ppd, &params, &variadic);
+        if (param_count < 0) {
+            report(ppd, "Invalid parameter list for macro '%s'.\n", symbol_str(name));
+            free(params);
+            return;
+        }
+    }
 
-    free(name);
-    free(value);
+    int value_start;
+    int value_length = try_parse_macro_value(ppd, &value_start);
+
+    define_function_macro(&ppd->macros, name, params, param_count, variadic,
+        &ppd->source[value_start], value_length);
+    free(params);
 }
 
-void process_include(PreProcessor *ppd) {
-    while (current(ppd) == ' ' || current(ppd) == '\t') {
+// moves to the line break ending the current line, continued lines included
+void skip_line(PreProcessor *ppd) {
+    while (!is_end(ppd) && current(ppd) != '\n') {
+        if (current(ppd) == '\\' && ppd->current + 1 < ppd->length && ppd->source[ppd->current + 1] == '\n') {
+            ppd->current++;
+        }
+        else if (current(ppd) == '\\' && ppd->current + 2 < ppd->length &&
+            ppd->source[ppd->current + 1] == '\r' && ppd->source[ppd->current + 2] == '\n') {
+            ppd->current += 2;
+        }
         advance(ppd);
     }
+}
 
-    if (current(ppd) == '\"') {
-        advance(ppd);
-        int name_start = ppd->current;
-        while (!is_end(ppd) && current(ppd) != '\"') {
-            advance(ppd);
+// whitespace and comments, at the top and bottom of a guarded file
+static int skip_space_and_comments(const char *source, int length, int i) {
+    while (i < length) {
+        if (isspace((unsigned char)source[i])) {
+            i++;
         }
-        char *name = strndup(&ppd->source[name_start], ppd->current - name_start);
-        
-        FILE *fptr = fopen(name, "r");
-        free(name);
+        else if (source[i] == '/' && i + 1 < length && source[i + 1] == '/') {
+            while (i < length && source[i] != '\n') i++;
+        }
+        else if (source[i] == '/' && i + 1 < length && source[i + 1] == '*') {
+            i += 2;
+            while (i + 1 < length && !(source[i] == '*' && source[i + 1] == '/')) i++;
+            i += 2;
+        }
+        else {
+            break;
+        }
+    }
 
-        if (!fptr) {
-            printf("File not found");
-            return;
+    return i < length ? i : length;
+}
+
+static int skip_line_blanks(const char *source, int length, int i) {
+    while (i < length && (source[i] == ' ' || source[i] == '\t')) i++;
+    return i;
+}
+
+static int read_name(const char *source, int length, int *i) {
+    int start = *i;
+    while (*i < length && (isalnum((unsigned char)source[*i]) || source[*i] == '_')) (*i)++;
+    return *i - start;
+}
+
+static int is_word(const char *source, int start, int length, const char *word) {
+    return length == (int)strlen(word) && strncmp(&source[start], word, length) == 0;
+}
+
+// finds "#ifndef X" or "#if !defined(X)" followed by "#define X" at the top of
+// the file, with the #endif closing it at the bottom. only comments may sit
+// outside. returns X, or NO_SYMBOL if the file is not guarded this way
+static SymbolId detect_include_guard(const char *source, int length) {
+    int i = skip_space_and_comments(source, length, 0);
+    if (i >= length || source[i] != '#') return NO_SYMBOL;
+
+    i = skip_line_blanks(source, length, i + 1);
+    int start = i;
+    int word = read_name(source, length, &i);
+    i = skip_line_blanks(source, length, i);
+
+    if (is_word(source, start, word, "if")) {
+        if (i >= length || source[i] != '!') return NO_SYMBOL;
+        i = skip_line_blanks(source, length, i + 1);
+
+        start = i;
+        if (!is_word(source, start, read_name(source, length, &i), "defined")) return NO_SYMBOL;
+        i = skip_line_blanks(source, length, i);
+        if (i < length && source[i] == '(') i = skip_line_blanks(source, length, i + 1);
+    }
+    else if (!is_word(source, start, word, "ifndef")) {
+        return NO_SYMBOL;
+    }
+
+    int guard_start = i;
+    int guard_length = read_name(source, length, &i);
+    if (guard_length == 0) return NO_SYMBOL;
+
+    // the next directive defines the guard
+    const char *line_end = memchr(&source[i], '\n', length - i);
+    if (!line_end) return NO_SYMBOL;
+
+    i = skip_space_and_comments(source, length, line_end - source);
+    if (i >= length || source[i] != '#') return NO_SYMBOL;
+
+    i = skip_line_blanks(source, length, i + 1);
+    start = i;
+    if (!is_word(source, start, read_name(source, length, &i), "define")) return NO_SYMBOL;
+
+    i = skip_line_blanks(source, length, i);
+    start = i;
+    if (read_name(source, length, &i) != guard_length ||
+        strncmp(&source[start], &source[guard_start], guard_length) != 0) return NO_SYMBOL;
+
+    // follows the nesting of the conditionals to the #endif matching the first
+    int depth = 1;
+    while (i < length) {
+        line_end = memchr(&source[i], '\n', length - i);
+        int next = line_end ? line_end - source + 1 : length;
+
+        i = skip_line_blanks(source, length, i);
+        if (i < length && source[i] == '#') {
+            i = skip_line_blanks(source, length, i + 1);
+            start = i;
+            word = read_name(source, length, &i);
+
+            if (is_word(source, start, word, "if") || is_word(source, start, word, "ifdef") ||
+                is_word(source, start, word, "ifndef")) {
+                depth++;
+            }
+            else if ((is_word(source, start, word, "else") || is_word(source, start, word, "elif")) && depth == 1) {
+                return NO_SYMBOL;
+            }
+            else if (is_word(source, start, word, "endif") && --depth == 0) {
+                if (skip_space_and_comments(source, length, next) < length) return NO_SYMBOL;
+                return intern(&source[guard_start], guard_length);
+            }
         }
-        fseek(fptr, 0, SEEK_END);
-        long sz = ftell(fptr);
-        fseek(fptr, 0, SEEK_SET);
 
-        char *content = malloc(sz + 1);
-        fread(content, sz, 1, fptr);
-        fclose(fptr);
-        content[sz] = '\0';
+        i = next;
+    }
+
+    return NO_SYMBOL;
+}
 
-        int include_start = ppd->current;
-        while (include_start > 0 && ppd->source[include_start - 1] != '#') {
-            include_start--;
+// the entry for a file, found by the path as written without touching the
+// file system once it has been seen. returns -1 if there is no such file
+int find_include(PreProcessor *ppd, const char *path) {
+    SymbolId spelled = intern_str(path);
+    int include = symbol_map_get(&ppd->include_index, spelled);
+    if (include >= 0) return include;
+
+    FileId id;
+    if (!identify_source_file(path, &id)) return -1;
+
+    char *resolved = canonical_path(path);
+    SymbolId canonical = resolved ? intern_str(resolved) : spelled;
+    free(resolved);
+
+    // the same file under another name, or through a link
+    include = symbol_map_get(&ppd->include_index, canonical);
+    for (int i = 0; include < 0 && i < ppd->include_count; i++) {
+        FileId other = ppd->includes[i].id;
+        if ((id.device || id.inode) && other.device == id.device && other.inode == id.inode) {
+            include = i;
         }
-        include_start--; // maybe
+    }
 
-        int include_end = ppd->current;
-        while (ppd->source[include_end] != '\n' && !is_end(ppd) && ppd->source[include_end] != '\0') {
-            include_end++;
+    if (include < 0) {
+        if (ppd->include_count >= ppd->include_capacity) {
+            ppd->include_capacity = ppd->include_capacity ? ppd->include_capacity * 2 : 16;
+            ppd->includes = realloc(ppd->includes, sizeof(IncludeFile) * ppd->include_capacity);
         }
 
-        int new_len = (strlen(ppd->source) - (include_end - include_start)) + strlen(content) + 1;
-        
-        char *new_source = malloc(new_len);
-        if (!new_source) {
-            printf("Error allocating space for include.\n");
+        include = ppd->include_count++;
+        ppd->includes[include].canonical = canonical;
+        ppd->includes[include].id = id;
+        ppd->includes[include].guard = NO_SYMBOL;
+        ppd->includes[include].once = 0;
+        ppd->includes[include].scanned = 0;
+        ppd->includes[include].opened = 0;
+    }
+
+    symbol_map_put(&ppd->include_index, spelled, include);
+    symbol_map_put(&ppd->include_index, canonical, include);
+
+    return include;
+}
+
+// a file that cannot produce anything new is not opened again
+void note_opened(PreProcessor *ppd, int include, const char *path) {
+    if (ppd->includes[include].opened) return;
+    ppd->includes[include].opened = 1;
+
+    if (ppd->opened_count >= ppd->opened_capacity) {
+        ppd->opened_capacity = ppd->opened_capacity ? ppd->opened_capacity * 2 : 16;
+        ppd->opened = realloc(ppd->opened, sizeof(SymbolId) * ppd->opened_capacity);
+    }
+    ppd->opened[ppd->opened_count++] = intern_str(path);
+}
+
+PreProcessor *init_header_preprocessor(const char *path, const char *source, int length) {
+    PreProcessor *ppd = init_file_preprocessor(path, source, length);
+
+    int include = find_include(ppd, path);
+    if (include >= 0) {
+        ppd->includes[include].guard = detect_include_guard(source, length);
+        ppd->includes[include].scanned = 1;
+        note_opened(ppd, include, path);
+        ppd->files[0].include = include;
+    }
+
+    return ppd;
+}
+
+// the line pos is on in the file on top of the stack. positions only move
+// forward, so each newline is counted once
+static int line_at(PreProcessor *ppd, int pos) {
+    IncludeFrame *frame = &ppd->files[ppd->depth - 1];
+
+    const char *at = &ppd->source[frame->line_pos];
+    const char *end = &ppd->source[pos];
+    while ((at = memchr(at, '\n', end - at))) {
+        frame->line++;
+        at++;
+    }
+    frame->line_pos = pos;
+
+    return frame->line;
+}
+
+static void write_line_marker(PreProcessor *ppd, int line, const char *path) {
+    char number[32];
+    snprintf(number, sizeof(number), "# %d \"", line);
+
+    strbuf_append(&ppd->output, number, strlen(number));
+    strbuf_append(&ppd->output, path, strlen(path));
+    strbuf_append(&ppd->output, "\"\n", 2);
+}
+
+static int include_is_redundant(PreProcessor *ppd, int include) {
+    IncludeFile *file = &ppd->includes[include];
+    return file->once || (file->guard != NO_SYMBOL && find_macro(&ppd->macros, file->guard));
+}
+
+// the included file is pushed and read next, the rest of this one waits under it
+void process_include(PreProcessor *ppd) {
+    skip_blanks(ppd);
+
+    int quoted = current(ppd) == '\"';
+    if (!quoted && current(ppd) != '<') {
+        report(ppd, "Expected \"file\" or <file> after #include.\n");
+        return;
+    }
+    char close = quoted ? '\"' : '>';
+
+    advance(ppd);
+    int name_start = ppd->current;
+    while (!is_end(ppd) && current(ppd) != close && current(ppd) != '\n') {
+        advance(ppd);
+    }
+    char *name = strndup(&ppd->source[name_start], ppd->current - name_start);
+    skip_line(ppd);
+
+    // quoted names are looked for next to the file including them
+    const char *including = ppd->files[ppd->depth - 1].path;
+    SymbolId dir = including ? path_dir(including) : intern_str(".");
+
+    const char *found = find_header(name, dir, quoted);
+
+    // a header precompiled alone only stands in for itself while it is read
+    // before anything else is defined or included. -E shows the header itself
+    if (found && !ppd->stream && ppd->depth == 1 && ppd->macros.count == 0 && ppd->include_count == 0) {
+        StrBuf pch_path;
+        init_strbuf(&pch_path, 64);
+        strbuf_append(&pch_path, found, strlen(found));
+        strbuf_append(&pch_path, ".pch", 4);
+
+        int loaded = load_pch(ppd, pch_path.data);
+        free_strbuf(&pch_path);
+
+        if (loaded) {
+            free(name);
             return;
         }
+    }
+
+    int include = found ? find_include(ppd, found) : -1;
+    if (include < 0) {
+        report(ppd, "File not found: %c%s%c.\n", quoted ? '\"' : '<', name, close);
+        free(name);
+        return;
+    }
 
-        strncpy(new_source, ppd->source, include_start);
-        new_source[include_start] = '\0';
-        
-        strcat(new_source, "\n");
-        strcat(new_source, content);
+    if (include_is_redundant(ppd, include)) {
+        free(name);
+        return;
+    }
 
-        strcat(new_source, &ppd->source[include_end]);
+    if (ppd->depth >= PPD_MAX_INCLUDE_DEPTH) {
+        report(ppd, "Includes nested more than %d deep, \"%s\" was not included.\n", PPD_MAX_INCLUDE_DEPTH, name);
+        free(name);
+        return;
+    }
 
-        free(ppd->source);
-        ppd->source = new_source;
+    SourceFile file;
+    if (!open_cached_source_file(found, &file)) {
+        report(ppd, "File not found: %c%s%c.\n", quoted ? '\"' : '<', name, close);
+        free(name);
+        return;
+    }
+    free(name);
 
-        free(content);
-        ppd->current = include_start;
+    if (!ppd->includes[include].scanned) {
+        ppd->includes[include].guard = detect_include_guard(file.data, file.length);
+        ppd->includes[include].scanned = 1;
     }
-    else if (current(ppd) == '<') {
-        // handle global header files
+
+    note_opened(ppd, include, found);
+    push_file(ppd, file, strdup(found), include);
+
+    if (ppd->stream) {
+        write_line_marker(ppd, 1, found);
     }
 }
 
-void process_undef(PreProcessor *ppd) {
-    while (current(ppd) == ' ' || current(ppd) == '\t') {
+// "#pragma once", other pragmas are ignored
+void process_pragma(PreProcessor *ppd) {
+    skip_blanks(ppd);
+
+    int start = ppd->current;
+    while (isalpha(current(ppd))) {
         advance(ppd);
     }
 
-    char *name = try_parse_macro_name(ppd);
-    for (int i = 0; i < ppd->count; i++) {
-        if (strcmp(name, ppd->macros[i]->name) == 0) {
-            free_macro(ppd->macros[i]);
+    int include = ppd->files[ppd->depth - 1].include;
+    if (ppd->current - start == 4 && strncmp(&ppd->source[start], "once", 4) == 0 && include >= 0) {
+        ppd->includes[include].once = 1;
+    }
+}
 
-            for (int j = i; j < ppd->count - 1; j++) {
-                ppd->macros[j] = ppd->macros[j + 1];
-            }
-            ppd->count--;
-            i--;
-        }
+void process_undef(PreProcessor *ppd) {
+    skip_blanks(ppd);
+
+    SymbolId name = try_parse_macro_name(ppd);
+    undef_macro(&ppd->macros, name);
+}
+
+int is_active(PreProcessor *ppd) {
+    return ppd->conditional_count == 0 || ppd->conditionals[ppd->conditional_count - 1].active;
+}
+
+void push_conditional(PreProcessor *ppd, int parent_active, int value) {
+    if (ppd->conditional_count >= ppd->conditional_capacity) {
+        ppd->conditional_capacity = ppd->conditional_capacity ? ppd->conditional_capacity * 2 : 16;
+        ppd->conditionals = realloc(ppd->conditionals, sizeof(Conditional) * ppd->conditional_capacity);
     }
+
+    Conditional *conditional = &ppd->conditionals[ppd->conditional_count++];
+    conditional->parent_active = parent_active;
+    conditional->active = parent_active && value;
+    conditional->taken = !parent_active || value;
+    conditional->seen_else = 0;
+    conditional->depth = ppd->depth;
 }
 
-void remove_directives(PreProcessor *ppd) {
-    int read = 0;
+// "defined X" and "defined(X)" become 1 or 0 before the line is expanded, so
+// the names they test are not replaced
+void replace_defined(PreProcessor *ppd, PPTokenList *tokens) {
     int write = 0;
 
-    while (ppd->source[read] != '\0') {
-        if (ppd->source[read] == '#') {
-            while (ppd->source[read] != '\n' && ppd->source[read] != '\0') {
-                read++;
+    for (int read = 0; read < tokens->count; read++) {
+        PPToken token = tokens->tokens[read];
+
+        if (token.kind == PP_IDENTIFIER && token.length == 7 && strncmp(token.text, "defined", 7) == 0) {
+            int open = read + 1 < tokens->count && tokens->tokens[read + 1].length == 1 &&
+                tokens->tokens[read + 1].text[0] == '(';
+            int name = read + 1 + open;
+
+            if (name < tokens->count && tokens->tokens[name].kind == PP_IDENTIFIER) {
+                int defined = find_macro(&ppd->macros, tokens->tokens[name].name) != NULL;
+
+                token.kind = PP_NUMBER;
+                token.text = defined ? "1" : "0";
+                token.length = 1;
+                read = name + open;
             }
-        } else {
-            ppd->source[write++] = ppd->source[read++];
         }
+
+        tokens->tokens[write++] = token;
     }
 
-    ppd->source[write] = '\0';
-    ppd->current = 0;
+    tokens->count = write;
+}
+
+// reads the rest of the directive line as an expression
+int evaluate_condition(PreProcessor *ppd) {
+    int start = ppd->current;
+    skip_line(ppd);
+
+    PPTokenList tokens, expanded;
+    init_token_list(&tokens);
+    init_token_list(&expanded);
+
+    pp_tokenize(&ppd->source[start], ppd->current - start, &tokens);
+    replace_defined(ppd, &tokens);
+    expand_macros(ppd->engine, tokens.tokens, tokens.count, &expanded);
+
+    long long value = 0;
+    if (!evaluate_pp_expression(expanded.tokens, expanded.count, &value)) {
+        report(ppd, "Invalid expression in conditional directive: \"%.*s\".\n", ppd->current - start, &ppd->source[start]);
+        value = 0;
+    }
+
+    free_token_list(&tokens);
+    free_token_list(&expanded);
+
+    return value != 0;
+}
+
+int is_macro_defined(PreProcessor *ppd) {
+    skip_blanks(ppd);
+
+    SymbolId name = try_parse_macro_name(ppd);
+    if (name == NO_SYMBOL) {
+        report(ppd, "Expected a macro name in conditional directive.\n");
+        return 0;
+    }
+
+    return find_macro(&ppd->macros, name) != NULL;
+}
+
+// returns 0 if the keyword is not one of the conditional directives. these are
+// followed in skipped regions too, to keep track of the nesting
+int process_conditional(PreProcessor *ppd, const char *keyword, int length) {
+    int active = is_active(ppd);
+    Conditional *top = ppd->conditional_count > 0 ? &ppd->conditionals[ppd->conditional_count - 1] : NULL;
+
+    if (length == 2 && strncmp("if", keyword, 2) == 0) {
+        push_conditional(ppd, active, active && evaluate_condition(ppd));
+    }
+    else if (length == 5 && strncmp("ifdef", keyword, 5) == 0) {
+        push_conditional(ppd, active, active && is_macro_defined(ppd));
+    }
+    else if (length == 6 && strncmp("ifndef", keyword, 6) == 0) {
+        push_conditional(ppd, active, active && !is_macro_defined(ppd));
+    }
+    else if (length == 4 && strncmp("elif", keyword, 4) == 0) {
+        if (!top || top->seen_else) {
+            report(ppd, "#elif without #if.\n");
+        }
+        else if (top->taken) {
+            top->active = 0;
+        }
+        else {
+            top->active = evaluate_condition(ppd);
+            top->taken = top->active;
+        }
+    }
+    else if (length == 4 && strncmp("else", keyword, 4) == 0) {
+        if (!top || top->seen_else) {
+            report(ppd, "#else without #if.\n");
+        }
+        else {
+            top->active = top->parent_active && !top->taken;
+            top->taken = 1;
+            top->seen_else = 1;
+        }
+    }
+    else if (length == 5 && strncmp("endif", keyword, 5) == 0) {
+        if (!top || top->depth != ppd->depth) {
+            report(ppd, "#endif without #if.\n");
+        }
+        else {
+            ppd->conditional_count--;
+        }
+    }
+    else {
+        return 0;
+    }
+
+    return 1;
 }
 
 void parse_ppd(PreProcessor *ppd) {
-    ppd->current++;
+    advance(ppd);
+    skip_blanks(ppd);
 
-    int start = 0;
-    while (!is_end(ppd)) {
-        char keyword_buff[10];
+    int start = ppd->current;
+    while (isalpha(current(ppd))) {
+        advance(ppd);
+    }
+
+    const char *keyword = &ppd->source[start];
+    int length = ppd->current - start;
+
+    if (process_conditional(ppd, keyword, length) || !is_active(ppd)) {
+        // nothing else is looked at in a skipped region
+    }
+    else if (length == 6 && strncmp("define", keyword, 6) == 0) {
+        process_define(ppd);
+    }
+    else if (length == 5 && strncmp("undef", keyword, 5) == 0) {
+        process_undef(ppd);
+    }
+    else if (length == 7 && strncmp("include", keyword, 7) == 0) {
+        process_include(ppd);
+        return;
+    }
+    else if (length == 6 && strncmp("pragma", keyword, 6) == 0) {
+        process_pragma(ppd);
+    }
+
+    skip_line(ppd);
+}
+
+// moves to the next line starting with '#' without looking at the lines in
+// between, only their line breaks from start on are written out
+void skip_inactive(PreProcessor *ppd, int start) {
+    int target = ppd->length;
+
+    int pos = ppd->current;
+    const char *hash;
+    while ((hash = memchr(&ppd->source[pos], '#', ppd->length - pos))) {
+        int line = hash - ppd->source;
+        while (line > 0 && (ppd->source[line - 1] == ' ' || ppd->source[line - 1] == '\t')) {
+            line--;
+        }
+
+        if (line == 0 || ppd->source[line - 1] == '\n') {
+            target = line;
+            break;
+        }
+        pos = hash - ppd->source + 1;
+    }
+
+    const char *newline = &ppd->source[start];
+    const char *end = &ppd->source[target];
+    while ((newline = memchr(newline, '\n', end - newline))) {
+        strbuf_push(&ppd->output, '\n');
+        newline++;
+    }
+
+    ppd->current = target;
+}
+
+// reads the files on the stack line by line. text is gathered up to the next
+// directive, so runs of text are expanded in one go
+void stream_preprocessor(PreProcessor *ppd, FILE *stream) {
+    ppd->stream = stream;
+
+    // sized for one chunk rather than the whole output
+    free_strbuf(&ppd->output);
+    init_strbuf(&ppd->output, PPD_STREAM_CHUNK * 2);
+
+    const char *path = ppd->files[0].path;
+    write_line_marker(ppd, 1, path ? path : "<source>");
+}
+
+static void drain_output(PreProcessor *ppd, int all) {
+    if (!ppd->stream || (!all && ppd->output.length < PPD_STREAM_CHUNK)) return;
+
+    fwrite(ppd->output.data, 1, ppd->output.length, ppd->stream);
+    strbuf_clear(&ppd->output);
+}
+
+void run_preprocessor(PreProcessor *ppd) {
+    int run_start = 0;
+    int held_back = 0;
 
-        // there are no preprocessor directives with more than 7 characters, therefore,
-        // longer words are simply ignored and treated as invalid
-        if (start == 10) break; 
+    while (ppd->depth > 0) {
+        drain_output(ppd, 0);
+
+        if (!is_active(ppd)) {
+            // the line break ending the last directive is counted with the rest
+            skip_inactive(ppd, run_start);
+            run_start = ppd->current;
+        }
 
-        if (ppd->source[ppd->current] == ' ') { 
-            keyword_buff[start] = '\0';
+        if (is_end(ppd)) {
+            flush_text(ppd, run_start, ppd->length);
 
-            if (strcmp("define", keyword_buff) == 0) {
-                process_define(ppd);
+            while (ppd->conditional_count > 0 && ppd->conditionals[ppd->conditional_count - 1].depth == ppd->depth) {
+                report(ppd, "Unterminated conditional directive.\n");
+                ppd->conditional_count--;
             }
-            else if (strcmp("undef", keyword_buff) == 0) {
-                process_undef(ppd);
+
+            int ends_line = ppd->length == 0 || ppd->source[ppd->length - 1] == '\n';
+            pop_file(ppd);
+
+            // the line break ending the include belongs to the text after it
+            run_start = ppd->current;
+
+            // unless a marker takes its place, saying where the text after it is from
+            if (ppd->stream && ppd->depth > 0) {
+                if (!ends_line) strbuf_push(&ppd->output, '\n');
+
+                const char *path = ppd->files[ppd->depth - 1].path;
+                write_line_marker(ppd, line_at(ppd, ppd->current) + 1, path ? path : "<source>");
+                if (current(ppd) == '\n') run_start++;
             }
-            else if (strcmp("include", keyword_buff) == 0) {
-                process_include(ppd);
+
+            if (current(ppd) == '\n') advance(ppd);
+            continue;
+        }
+
+        int line = ppd->current;
+        while (current(ppd) == ' ' || current(ppd) == '\t') {
+            advance(ppd);
+        }
+
+        if (current(ppd) != '#') {
+            const char *end = memchr(&ppd->source[ppd->current], '\n', ppd->length - ppd->current);
+            ppd->current = end ? end - ppd->source + 1 : ppd->length;
+
+            // a long run is written out a chunk of whole lines at a time, so
+            // only an invocation still open at the end of one is kept in memory
+            if (ppd->current - run_start >= held_back + PPD_TEXT_CHUNK) {
+                int kept = write_text(ppd, run_start, ppd->current, 1);
+                held_back = ppd->current - kept;
+                run_start = kept;
             }
+            continue;
         }
-        else {
-            keyword_buff[start++] = ppd->source[ppd->current];
+
+        flush_text(ppd, run_start, line);
+
+        int depth = ppd->depth;
+        parse_ppd(ppd);
+
+        if (ppd->depth != depth) {
+            run_start = 0;
+            continue;
+        }
+
+        // continued directive lines keep their line breaks
+        for (int i = line; i < ppd->current; i++) {
+            if (ppd->source[i] == '\n') strbuf_push(&ppd->output, '\n');
         }
 
-        ppd->current++;
+        run_start = ppd->current;
+        if (current(ppd) == '\n') advance(ppd);
     }
+
+    drain_output(ppd, 1);
+    if (ppd->engine->err) ppd->err = 1;
 }
 
-char *preprocess(char *source) {
-    PreProcessor *ppd = init_preprocessor(source);
+// spaces and the characters make gives a meaning to are escaped
+static void write_make_path(FILE *fptr, const char *path) {
+    for (; *path; path++) {
+        if (*path == ' ' || *path == '#') fputc('\\', fptr);
+        if (*path == '$') fputc('$', fptr);
+        fputc(*path, fptr);
+    }
+}
 
-    while (!is_end(ppd)) {
-        if (current(ppd) == '#') {
-            parse_ppd(ppd);
+int write_dependencies(PreProcessor *ppd, const char *target, const char *source_path, const char *dep_path) {
+    FILE *fptr = fopen(dep_path, "w");
+    if (!fptr) {
+        fprintf(stderr, "Could not write '%s'.\n", dep_path);
+        return 0;
+    }
 
-            // i don't really know why but this makes it work
-            ppd->current -= 5;
-        }
+    write_make_path(fptr, target);
+    fputs(": ", fptr);
+    write_make_path(fptr, source_path);
+
+    for (int i = 0; i < ppd->opened_count; i++) {
+        fputs(" \\\n  ", fptr);
+        write_make_path(fptr, symbol_str(ppd->opened[i]));
+    }
+    fputc('\n', fptr);
+
+    fclose(fptr);
+    return 1;
+}
 
-        ppd->current++;
+const char *preprocess(const char *source, int length, int *processed_length) {
+    // every rewrite starts from a directive, without one the text is used as is
+    if (!memchr(source, '#', length)) {
+        *processed_length = length;
+        return source;
     }
 
-    remove_directives(ppd);
+    PreProcessor *ppd = init_preprocessor(source, length);
+    run_preprocessor(ppd);
 
-    char *processed = replace_text(ppd);
+    *processed_length = ppd->output.length;
+    char *processed = strbuf_take(&ppd->output);
     free_preprocessor(ppd);
 
     return processed;
@@ -1,20 +1,139 @@
 #ifndef PPD_H
 #define PPD_H
 
+#include <stdio.h>
+
+#include "macro.h"
+#include "source.h"
+#include "strbuf.h"
+
+// how deeply includes may nest before an include is refused, this stops a file
+// that includes itself
+#define PPD_MAX_INCLUDE_DEPTH 200
+
+// how much streamed output is gathered before it is written
+#define PPD_STREAM_CHUNK (64 * 1024)
+
+// how much text without a directive is expanded at once. macros usually make
+// the text longer, so this is kept well below a stream chunk
+#define PPD_TEXT_CHUNK (PPD_STREAM_CHUNK / 8)
+
+// what is known about a file that has been included, so including it again
+// can be skipped without opening it
+typedef struct {
+    SymbolId canonical;
+    FileId   id;
+
+    // the macro whose #ifndef wraps the whole file, NO_SYMBOL if there is none
+    SymbolId guard;
+    int      once;
+    int      scanned;
+
+    // whether it is listed among the opened files yet
+    int      opened;
+} IncludeFile;
+
+// a file being read, the files under it on the stack are part way through
+typedef struct {
+    SourceFile file;
+    char      *path;
+    int        current;
+
+    // its entry in the included files, -1 for the top level source
+    int        include;
+
+    // newlines up to line_pos have been counted, for line markers
+    int        line;
+    int        line_pos;
+} IncludeFrame;
+
+// an #if, #ifdef or #ifndef whose #endif has not been reached
 typedef struct {
-    char *name;
-    char *value;
-} Macro;
+    int parent_active;
+    int active;
+
+    // set once a branch has been kept, the later ones are all skipped
+    int taken;
+    int seen_else;
+
+    // a conditional has to end in the file it started in
+    int depth;
+} Conditional;
 
 typedef struct {
-    Macro **macros;
-    char  *source;
-    int    count;
-    int    capacity;
-    int    current;
+    MacroTable   macros;
+    MacroEngine *engine;
+
+    IncludeFrame *files;
+    int           depth;
+    int           capacity;
+
+    // looked up by the interned path as written and as resolved
+    IncludeFile  *includes;
+    int           include_count;
+    int           include_capacity;
+    SymbolMap     include_index;
+
+    Conditional  *conditionals;
+    int           conditional_count;
+    int           conditional_capacity;
+
+    // the file on top of the stack
+    const char *source;
+    int         length;
+    int         current;
+
+    // the paths of the headers opened, in the order they were first read
+    SymbolId   *opened;
+    int         opened_count;
+    int         opened_capacity;
+
+    // set for -E, the output is written out as it is made with line markers
+    // saying which file each part came from
+    FILE       *stream;
+
+    // set once a directive or invocation could not be carried out, what
+    // followed it is still output
+    int         err;
+
+    // set when the caller parses the output. a precompiled header read first
+    // then leaves its text out if it kept the declarations it was parsed into,
+    // they are handed over here for load_pch_declarations instead
+    int         take_declarations;
+    char       *declarations;
+    int         declarations_length;
+
+    StrBuf      output;
+    PPTokenList tokens;
+    PPTokenList expanded;
 } PreProcessor;
 
-extern char *preprocess(char *source);
+// returns the source itself when there is nothing to rewrite, otherwise a new
+// buffer that the caller frees. neither has to be null terminated
+extern const char *preprocess(const char *source, int length, int *processed_length);
+
+extern PreProcessor *init_preprocessor(const char *source, int length);
+
+// the source was read from path, quoted includes are looked for next to it
+extern PreProcessor *init_file_preprocessor(const char *path, const char *source, int length);
+
+// reads a header on its own as though it was included, so its guard and
+// #pragma once are kept in its entry like those of the headers under it
+extern PreProcessor *init_header_preprocessor(const char *path, const char *source, int length);
+
+// sends the output to stream instead of keeping it
+extern void stream_preprocessor(PreProcessor *ppd, FILE *stream);
+extern void run_preprocessor(PreProcessor *ppd);
+
+// the index of a file in ppd->includes, added on first sight. -1 if there is no such file
+extern int find_include(PreProcessor *ppd, const char *path);
+
+// adds the file to the opened headers, once
+extern void note_opened(PreProcessor *ppd, int include, const char *path);
+
+// writes a make rule naming the source and every header opened as what target
+// depends on. returns 0 if the file cannot be written
+extern int write_dependencies(PreProcessor *ppd, const char *target, const char *source_path, const char *dep_path);
 extern void free_preprocessor(PreProcessor *ppd);
 
-#endif
\ No newline at end of file
+#endif
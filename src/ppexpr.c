@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ppexpr.h"
+
+typedef struct {
+    const PPToken *tokens;
+    int            count;
+    int            pos;
+    int            err;
+} ExprParser;
+
+static long long parse_expression(ExprParser *parser, int min_precedence, int live);
+static long long parse_comma(ExprParser *parser, int live);
+
+static const PPToken *peek_token(ExprParser *parser) {
+    // line breaks kept from a macro invocation over several lines
+    while (parser->pos < parser->count && parser->tokens[parser->pos].kind == PP_SPACE) {
+        parser->pos++;
+    }
+
+    return parser->pos < parser->count ? &parser->tokens[parser->pos] : NULL;
+}
+
+static int is_op(const PPToken *token, const char *op) {
+    int length = strlen(op);
+    return token && token->kind == PP_PUNCTUATOR && token->length == length && memcmp(token->text, op, length) == 0;
+}
+
+static int match(ExprParser *parser, const char *op) {
+    if (!is_op(peek_token(parser), op)) return 0;
+
+    parser->pos++;
+    return 1;
+}
+
+// integer suffixes are read past, everything is evaluated as long long
+static long long number_value(ExprParser *parser, const PPToken *token) {
+    char buffer[64];
+    if (token->length >= (int)sizeof(buffer)) {
+        parser->err = 1;
+        return 0;
+    }
+
+    memcpy(buffer, token->text, token->length);
+    buffer[token->length] = '\0';
+
+    char *end;
+    long long value = (long long)strtoull(buffer, &end, 0);
+    while (*end == 'u' || *end == 'U' || *end == 'l' || *end == 'L') end++;
+
+    if (*end != '\0') parser->err = 1;
+    return value;
+}
+
+static long long char_value(ExprParser *parser, const PPToken *token) {
+    const char *text = token->text;
+    int length = token->length;
+
+    // an L, u or U prefix is a separate identifier token, so the literal starts here
+    if (length < 3 || text[length - 1] != '\'') {
+        parser->err = 1;
+        return 0;
+    }
+
+    if (text[1] != '\\') return (unsigned char)text[1];
+
+    switch (text[2]) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case 'a': return '\a';
+        case 'b': return '\b';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case 'x': return strtol(&text[3], NULL, 16);
+        default:
+            if (text[2] >= '0' && text[2] <= '7') return strtol(&text[2], NULL, 8);
+            return (unsigned char)text[2];
+    }
+}
+
+static long long parse_unary(ExprParser *parser, int live) {
+    const PPToken *token = peek_token(parser);
+    if (!token) {
+        parser->err = 1;
+        return 0;
+    }
+    parser->pos++;
+
+    if (is_op(token, "(")) {
+        long long value = parse_comma(parser, live);
+        if (!match(parser, ")")) parser->err = 1;
+        return value;
+    }
+    if (is_op(token, "-")) return -parse_unary(parser, live);
+    if (is_op(token, "+")) return parse_unary(parser, live);
+    if (is_op(token, "~")) return ~parse_unary(parser, live);
+    if (is_op(token, "!")) return !parse_unary(parser, live);
+
+    if (token->kind == PP_NUMBER) return number_value(parser, token);
+    if (token->kind == PP_CHAR) return char_value(parser, token);
+    if (token->kind == PP_IDENTIFIER) return 0;
+
+    parser->err = 1;
+    return 0;
+}
+
+// binding power of each binary operator, higher binds tighter
+static int precedence(const PPToken *token) {
+    static const struct { const char *op; int precedence; } OPERATORS[] = {
+        { "*", 10 }, { "/", 10 }, { "%", 10 },
+        { "+", 9 }, { "-", 9 },
+        { "<<", 8 }, { ">>", 8 },
+        { "<", 7 }, { ">", 7 }, { "<=", 7 }, { ">=", 7 },
+        { "==", 6 }, { "!=", 6 },
+        { "&", 5 }, { "^", 4 }, { "|", 3 },
+        { "&&", 2 }, { "||", 1 },
+    };
+
+    for (int i = 0; i < (int)(sizeof(OPERATORS) / sizeof(OPERATORS[0])); i++) {
+        if (is_op(token, OPERATORS[i].op)) return OPERATORS[i].precedence;
+    }
+
+    return -1;
+}
+
+static long long apply(ExprParser *parser, const PPToken *op, long long left, long long right, int live) {
+    if (is_op(op, "*")) return left * right;
+    if (is_op(op, "+")) return left + right;
+    if (is_op(op, "-")) return left - right;
+    if (is_op(op, "<<")) return left << (right & 63);
+    if (is_op(op, ">>")) return left >> (right & 63);
+    if (is_op(op, "<")) return left < right;
+    if (is_op(op, ">")) return left > right;
+    if (is_op(op, "<=")) return left <= right;
+    if (is_op(op, ">=")) return left >= right;
+    if (is_op(op, "==")) return left == right;
+    if (is_op(op, "!=")) return left != right;
+    if (is_op(op, "&")) return left & right;
+    if (is_op(op, "^")) return left ^ right;
+    if (is_op(op, "|")) return left | right;
+
+    // a division on the side of && or || that is not evaluated may divide by zero
+    if (right == 0) {
+        if (live) parser->err = 1;
+        return 0;
+    }
+    return is_op(op, "/") ? left / right : left % right;
+}
+
+static long long parse_expression(ExprParser *parser, int min_precedence, int live) {
+    long long left = parse_unary(parser, live);
+
+    while (!parser->err) {
+        const PPToken *op = peek_token(parser);
+
+        if (is_op(op, "?") && min_precedence == 0) {
+            parser->pos++;
+            long long then = parse_expression(parser, 0, live && left);
+            if (!match(parser, ":")) parser->err = 1;
+            long long otherwise = parse_expression(parser, 0, live && !left);
+
+            left = left ? then : otherwise;
+            continue;
+        }
+
+        int op_precedence = precedence(op);
+        if (op_precedence < 0 || op_precedence < min_precedence) break;
+        parser->pos++;
+
+        if (is_op(op, "&&")) {
+            long long right = parse_expression(parser, op_precedence + 1, live && left);
+            left = left && right;
+        }
+        else if (is_op(op, "||")) {
+            long long right = parse_expression(parser, op_precedence + 1, live && !left);
+            left = left || right;
+        }
+        else {
+            long long right = parse_expression(parser, op_precedence + 1, live);
+            left = apply(parser, op, left, right, live);
+        }
+    }
+
+    return left;
+}
+
+// a comma only joins expressions, the last one is the value
+static long long parse_comma(ExprParser *parser, int live) {
+    long long value = parse_expression(parser, 0, live);
+
+    while (!parser->err && match(parser, ",")) {
+        value = parse_expression(parser, 0, live);
+    }
+
+    return value;
+}
+
+int evaluate_pp_expression(const PPToken *tokens, int count, long long *value) {
+    ExprParser parser = { tokens, count, 0, 0 };
+
+    *value = parse_comma(&parser, 1);
+
+    if (peek_token(&parser)) parser.err = 1;
+    return !parser.err;
+}
@@ -0,0 +1,11 @@
+#ifndef PPEXPR_H
+#define PPEXPR_H
+
+#include "macro.h"
+
+// evaluates the controlling expression of an #if or #elif, after macros have
+// been expanded and "defined" has been replaced. names left over count as 0.
+// returns 0 if the expression is malformed
+extern int evaluate_pp_expression(const PPToken *tokens, int count, long long *value);
+
+#endif
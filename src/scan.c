@@ -0,0 +1,257 @@
+#include <pthread.h>
+
+#include "scan.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+typedef int (*ScanFn)(const char *source, int offset, int length);
+
+typedef struct {
+    ScanFn whitespace;
+    ScanFn line_end;
+    ScanFn block_comment_end;
+    ScanFn string_body;
+} ScanFns;
+
+static inline int is_space(char c) {
+    return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+static int scalar_whitespace(const char *source, int offset, int length) {
+    while (offset < length && is_space(source[offset])) offset++;
+    return offset;
+}
+
+static int scalar_line_end(const char *source, int offset, int length) {
+    while (offset < length && source[offset] != '\n') offset++;
+    return offset;
+}
+
+static int scalar_block_comment_end(const char *source, int offset, int length) {
+    while (offset < length && !(source[offset] == '*' && offset + 1 < length && source[offset + 1] == '/')) {
+        offset++;
+    }
+    return offset;
+}
+
+static int scalar_string_body(const char *source, int offset, int length) {
+    while (offset < length && source[offset] != '"' && source[offset] != '\\') offset++;
+    return offset;
+}
+
+static const ScanFns SCALAR_FNS = {
+    scalar_whitespace,
+    scalar_line_end,
+    scalar_block_comment_end,
+    scalar_string_body,
+};
+
+#ifdef SCAN_X86
+
+// the vector loops only read whole blocks inside [offset, length), whatever is
+// left over is finished by the scalar versions
+
+__attribute__((target("sse2")))
+static inline __m128i sse2_space_mask(__m128i c) {
+    // \t to \r are five consecutive bytes, so one unsigned range check covers them
+    __m128i control = _mm_sub_epi8(c, _mm_set1_epi8('\t'));
+    __m128i is_control = _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control);
+
+    return _mm_or_si128(is_control, _mm_cmpeq_epi8(c, _mm_set1_epi8(' ')));
+}
+
+__attribute__((target("sse2")))
+static int sse2_whitespace(const char *source, int offset, int length) {
+    while (offset + 16 <= length) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(source + offset));
+        unsigned int mask = ~_mm_movemask_epi8(sse2_space_mask(c)) & 0xFFFF;
+        if (mask) return offset + __builtin_ctz(mask);
+
+        offset += 16;
+    }
+
+    return scalar_whitespace(source, offset, length);
+}
+
+__attribute__((target("sse2")))
+static int sse2_find2(const char *source, int offset, int length, char a, char b) {
+    __m128i va = _mm_set1_epi8(a);
+    __m128i vb = _mm_set1_epi8(b);
+
+    while (offset + 16 <= length) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(source + offset));
+        unsigned int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(c, va), _mm_cmpeq_epi8(c, vb)));
+        if (mask) return offset + __builtin_ctz(mask);
+
+        offset += 16;
+    }
+
+    while (offset < length && source[offset] != a && source[offset] != b) offset++;
+    return offset;
+}
+
+static int sse2_line_end(const char *source, int offset, int length) {
+    return sse2_find2(source, offset, length, '\n', '\n');
+}
+
+static int sse2_block_comment_end(const char *source, int offset, int length) {
+    while (1) {
+        offset = sse2_find2(source, offset, length, '*', '*');
+        if (offset >= length || (offset + 1 < length && source[offset + 1] == '/')) return offset;
+
+        offset++;
+    }
+}
+
+static int sse2_string_body(const char *source, int offset, int length) {
+    return sse2_find2(source, offset, length, '"', '\\');
+}
+
+static const ScanFns SSE2_FNS = {
+    sse2_whitespace,
+    sse2_line_end,
+    sse2_block_comment_end,
+    sse2_string_body,
+};
+
+__attribute__((target("avx2")))
+static int avx2_whitespace(const char *source, int offset, int length) {
+    __m256i tab = _mm256_set1_epi8('\t');
+    __m256i range = _mm256_set1_epi8('\r' - '\t');
+    __m256i space = _mm256_set1_epi8(' ');
+
+    while (offset + 32 <= length) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(source + offset));
+        __m256i control = _mm256_sub_epi8(c, tab);
+        __m256i is_control = _mm256_cmpeq_epi8(_mm256_min_epu8(control, range), control);
+        __m256i is_space = _mm256_or_si256(is_control, _mm256_cmpeq_epi8(c, space));
+
+        unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(is_space);
+        if (mask) return offset + __builtin_ctz(mask);
+
+        offset += 32;
+    }
+
+    return sse2_whitespace(source, offset, length);
+}
+
+__attribute__((target("avx2")))
+static int avx2_find2(const char *source, int offset, int length, char a, char b) {
+    __m256i va = _mm256_set1_epi8(a);
+    __m256i vb = _mm256_set1_epi8(b);
+
+    while (offset + 32 <= length) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(source + offset));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(c, va), _mm256_cmpeq_epi8(c, vb)));
+        if (mask) return offset + __builtin_ctz(mask);
+
+        offset += 32;
+    }
+
+    return sse2_find2(source, offset, length, a, b);
+}
+
+static int avx2_line_end(const char *source, int offset, int length) {
+    return avx2_find2(source, offset, length, '\n', '\n');
+}
+
+static int avx2_block_comment_end(const char *source, int offset, int length) {
+    while (1) {
+        offset = avx2_find2(source, offset, length, '*', '*');
+        if (offset >= length || (offset + 1 < length && source[offset + 1] == '/')) return offset;
+
+        offset++;
+    }
+}
+
+static int avx2_string_body(const char *source, int offset, int length) {
+    return avx2_find2(source, offset, length, '"', '\\');
+}
+
+static const ScanFns AVX2_FNS = {
+    avx2_whitespace,
+    avx2_line_end,
+    avx2_block_comment_end,
+    avx2_string_body,
+};
+
+#endif
+
+static const ScanFns *active = NULL;
+static ScanLevel active_level = SCAN_SCALAR;
+
+static int level_supported(ScanLevel level) {
+    switch (level) {
+        case SCAN_SCALAR: return 1;
+#ifdef SCAN_X86
+        case SCAN_SSE2: {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        }
+        case SCAN_AVX2: {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+        }
+#endif
+        default: return 0;
+    }
+}
+
+static void use_level(ScanLevel level) {
+    switch (level) {
+#ifdef SCAN_X86
+        case SCAN_SSE2: active = &SSE2_FNS; break;
+        case SCAN_AVX2: active = &AVX2_FNS; break;
+#endif
+        default: active = &SCALAR_FNS; break;
+    }
+    active_level = level;
+}
+
+static void pick_widest_level() {
+    if (level_supported(SCAN_AVX2)) use_level(SCAN_AVX2);
+    else if (level_supported(SCAN_SSE2)) use_level(SCAN_SSE2);
+    else use_level(SCAN_SCALAR);
+}
+
+// the lexer workers can be the first callers, so the pick has to happen once
+// for all of them rather than on whichever thread gets there first
+static pthread_once_t picked = PTHREAD_ONCE_INIT;
+
+static inline const ScanFns *fns() {
+    pthread_once(&picked, pick_widest_level);
+    return active;
+}
+
+int scan_set_level(ScanLevel level) {
+    if (!level_supported(level)) return 0;
+
+    pthread_once(&picked, pick_widest_level);
+    use_level(level);
+
+    return 1;
+}
+
+ScanLevel scan_get_level() {
+    fns();
+    return active_level;
+}
+
+int scan_whitespace(const char *source, int offset, int length) {
+    return fns()->whitespace(source, offset, length);
+}
+
+int scan_line_end(const char *source, int offset, int length) {
+    return fns()->line_end(source, offset, length);
+}
+
+int scan_block_comment_end(const char *source, int offset, int length) {
+    return fns()->block_comment_end(source, offset, length);
+}
+
+int scan_string_body(const char *source, int offset, int length) {
+    return fns()->string_body(source, offset, length);
+}
@@ -0,0 +1,31 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+// bulk byte scans used by the lexer on whitespace, comments and string bodies.
+// each takes the source, a start offset and the source length, and returns the
+// offset of the first byte it stops on, or the length if there is none
+
+typedef enum {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+} ScanLevel;
+
+// skips space, \t, \n, \v, \f and \r
+extern int scan_whitespace(const char *source, int offset, int length);
+
+// finds the '\n' that ends a line comment
+extern int scan_line_end(const char *source, int offset, int length);
+
+// finds the '*' of the "*/" that closes a block comment
+extern int scan_block_comment_end(const char *source, int offset, int length);
+
+// finds the closing '"' or the next '\\' in the body of a string literal
+extern int scan_string_body(const char *source, int offset, int length);
+
+// the widest implementation the cpu supports is picked on first use, this
+// forces a narrower one and returns 0 if the requested level is not available
+extern int scan_set_level(ScanLevel level);
+extern ScanLevel scan_get_level();
+
+#endif
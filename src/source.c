@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "source.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// what a cached view was read from, a file that no longer matches is read again
+typedef struct {
+    long long mtime;
+    long long size;
+    unsigned long long inode;
+} FileStamp;
+
+typedef struct {
+    char      *path;
+    FileStamp  stamp;
+    SourceFile file;
+} CachedSource;
+
+typedef struct {
+    // views that went stale stay here too, a file still being read may use one
+    CachedSource *sources;
+    int           count;
+    int           capacity;
+
+    // open addressed on the path, each slot holds a source index + 1 or 0 when empty
+    int          *slots;
+    int           slot_capacity;
+    int           path_count;
+} SourceCache;
+
+static SourceCache cache;
+
+// read in place of a mapping on platforms without mmap
+static int read_source_file(const char *path, SourceFile *file) {
+    FILE *fptr = fopen(path, "rb");
+    if (!fptr) return 0;
+
+    fseek(fptr, 0, SEEK_END);
+    long size = ftell(fptr);
+    rewind(fptr);
+
+    char *data = malloc(size + 1);
+    if (!data) {
+        fclose(fptr);
+        return 0;
+    }
+
+    size_t read = fread(data, 1, size, fptr);
+    fclose(fptr);
+    data[read] = '\0';
+
+    file->data = data;
+    file->length = (int)read;
+    file->mapped = 0;
+
+    return 1;
+}
+
+int open_source_file(const char *path, SourceFile *file) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return read_source_file(path, file);
+    }
+
+    // an empty file cannot be mapped
+    if (st.st_size == 0) {
+        close(fd);
+        return read_source_file(path, file);
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return read_source_file(path, file);
+    }
+
+    // the lexer reads it front to back once
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    file->data = data;
+    file->length = (int)st.st_size;
+    file->mapped = 1;
+
+    return 1;
+#else
+    return read_source_file(path, file);
+#endif
+}
+
+void close_source_file(SourceFile *file) {
+#ifndef _WIN32
+    if (file->mapped) {
+        munmap((void *)file->data, file->length);
+        file->data = NULL;
+        return;
+    }
+#endif
+
+    free((void *)file->data);
+    file->data = NULL;
+}
+
+static uint32_t hash_path(const char *path) {
+    uint32_t hash = 2166136261u;
+    for (; *path; path++) {
+        hash ^= (unsigned char)*path;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static int *find_slot(int *slots, int capacity, const char *path) {
+    uint32_t slot = hash_path(path) & (capacity - 1);
+    while (slots[slot] && strcmp(cache.sources[slots[slot] - 1].path, path) != 0) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    return &slots[slot];
+}
+
+static void grow_slots() {
+    int capacity = cache.slot_capacity ? cache.slot_capacity * 2 : 64;
+    int *slots = calloc(capacity, sizeof(int));
+
+    for (int i = 0; i < cache.slot_capacity; i++) {
+        if (cache.slots[i]) {
+            *find_slot(slots, capacity, cache.sources[cache.slots[i] - 1].path) = cache.slots[i];
+        }
+    }
+
+    free(cache.slots);
+    cache.slots = slots;
+    cache.slot_capacity = capacity;
+}
+
+static int stamp_file(const char *path, FileStamp *stamp) {
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+
+    stamp->mtime = st.st_mtime;
+    stamp->size = st.st_size;
+    stamp->inode = st.st_ino;
+    return 1;
+}
+
+int open_cached_source_file(const char *path, SourceFile *file) {
+    FileStamp stamp;
+    if (!stamp_file(path, &stamp)) return 0;
+
+    if (cache.path_count * 2 >= cache.slot_capacity) {
+        grow_slots();
+    }
+
+    int *slot = find_slot(cache.slots, cache.slot_capacity, path);
+    if (*slot) {
+        CachedSource *source = &cache.sources[*slot - 1];
+        if (source->stamp.mtime == stamp.mtime && source->stamp.size == stamp.size && source->stamp.inode == stamp.inode) {
+            *file = source->file;
+            return 1;
+        }
+    }
+
+    SourceFile opened;
+    if (!open_source_file(path, &opened)) return 0;
+
+    if (cache.count >= cache.capacity) {
+        cache.capacity = cache.capacity ? cache.capacity * 2 : 16;
+        cache.sources = realloc(cache.sources, sizeof(CachedSource) * cache.capacity);
+    }
+
+    CachedSource *source = &cache.sources[cache.count++];
+    source->path = strdup(path);
+    source->stamp = stamp;
+    source->file = opened;
+
+    if (!*slot) cache.path_count++;
+    *slot = cache.count;
+
+    *file = opened;
+    return 1;
+}
+
+void free_source_cache() {
+    for (int i = 0; i < cache.count; i++) {
+        close_source_file(&cache.sources[i].file);
+        free(cache.sources[i].path);
+    }
+
+    free(cache.sources);
+    free(cache.slots);
+    memset(&cache, 0, sizeof(cache));
+}
+
+int identify_source_file(const char *path, FileId *id) {
+#ifndef _WIN32
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+
+    id->device = st.st_dev;
+    id->inode = st.st_ino;
+    return 1;
+#else
+    FILE *fptr = fopen(path, "rb");
+    if (!fptr) return 0;
+    fclose(fptr);
+
+    id->device = 0;
+    id->inode = 0;
+    return 1;
+#endif
+}
+
+char *canonical_path(const char *path) {
+#ifndef _WIN32
+    return realpath(path, NULL);
+#else
+    return _fullpath(NULL, path, 0);
+#endif
+}
@@ -0,0 +1,41 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+// a read only view of a file's contents. on posix systems the file is mapped
+// rather than read, so the text is never copied onto the heap.
+//
+// the view is not null terminated, its length must be used
+typedef struct {
+    const char *data;
+    int         length;
+
+    // 1 if data is a mapping, 0 if it was read into a heap buffer
+    int         mapped;
+} SourceFile;
+
+// tells files apart however they were named, zero when the platform has no
+// such identity
+typedef struct {
+    unsigned long long device;
+    unsigned long long inode;
+} FileId;
+
+// returns 0 if the file cannot be opened or read
+extern int open_source_file(const char *path, SourceFile *file);
+extern void close_source_file(SourceFile *file);
+
+// like open_source_file, but the view is kept and handed out again to later
+// opens of the same path for as long as the file's modification time, size
+// and inode stay the same. it stays valid until free_source_cache and must not
+// be closed by the caller
+extern int open_cached_source_file(const char *path, SourceFile *file);
+extern void free_source_cache();
+
+// returns 0 if the file does not exist
+extern int identify_source_file(const char *path, FileId *id);
+
+// the absolute path with links and . and .. resolved, NULL if there is no
+// such file. the caller frees it
+extern char *canonical_path(const char *path);
+
+#endif
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "strbuf.h"
+
+void init_strbuf(StrBuf *buf, int capacity) {
+    if (capacity < 16) capacity = 16;
+
+    buf->data = malloc(capacity);
+    buf->data[0] = '\0';
+    buf->length = 0;
+    buf->capacity = capacity;
+}
+
+void free_strbuf(StrBuf *buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->length = 0;
+    buf->capacity = 0;
+}
+
+// makes room for extra bytes and the terminator
+static void reserve(StrBuf *buf, int extra) {
+    if (buf->length + extra + 1 <= buf->capacity) return;
+
+    int capacity = buf->capacity ? buf->capacity : 16;
+    while (buf->length + extra + 1 > capacity) capacity *= 2;
+
+    buf->data = realloc(buf->data, capacity);
+    buf->capacity = capacity;
+}
+
+void strbuf_append(StrBuf *buf, const char *text, int length) {
+    reserve(buf, length);
+
+    memcpy(buf->data + buf->length, text, length);
+    buf->length += length;
+    buf->data[buf->length] = '\0';
+}
+
+void strbuf_push(StrBuf *buf, char c) {
+    reserve(buf, 1);
+
+    buf->data[buf->length++] = c;
+    buf->data[buf->length] = '\0';
+}
+
+void strbuf_clear(StrBuf *buf) {
+    buf->length = 0;
+    if (buf->data) buf->data[0] = '\0';
+}
+
+char *strbuf_take(StrBuf *buf) {
+    char *data = buf->data;
+    if (!data) data = calloc(1, 1);
+
+    buf->data = NULL;
+    buf->length = 0;
+    buf->capacity = 0;
+
+    return data;
+}
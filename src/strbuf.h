@@ -0,0 +1,24 @@
+#ifndef STRBUF_H
+#define STRBUF_H
+
+// an append only text buffer that tracks its length, appending never rescans
+// what is already there and the buffer doubles when it runs out of room
+typedef struct {
+    char *data;
+    int   length;
+    int   capacity;
+} StrBuf;
+
+extern void init_strbuf(StrBuf *buf, int capacity);
+extern void free_strbuf(StrBuf *buf);
+
+extern void strbuf_append(StrBuf *buf, const char *text, int length);
+extern void strbuf_push(StrBuf *buf, char c);
+
+// empties the buffer and keeps its room
+extern void strbuf_clear(StrBuf *buf);
+
+// hands over the text, null terminated, and leaves the buffer empty
+extern char *strbuf_take(StrBuf *buf);
+
+#endif
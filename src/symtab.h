@@ -2,6 +2,7 @@
 #define SYMTAB_H
 
 #include "ast.h"
+#include "intern.h"
 
 typedef enum {
     AUTO,
@@ -11,7 +12,7 @@ typedef enum {
 } StorageClass;
 
 typedef struct {
-    char        *identifier;
+    SymbolId     identifier;
     StorageClass storage_class;
     int          is_global;
 } VariableSymbol;
@@ -20,10 +21,13 @@ typedef struct {
     VariableSymbol **symbols;
     int              count;
     int              capacity;
+
+    // the position of each symbol in symbols, keyed on its identifier
+    SymbolMap        index;
 } VariableSymbols;
 
 typedef struct {
-    char        *identifier;
+    SymbolId     identifier;
     StorageClass storage_class;
     AstDataType  return_type;
 } FunctionSymbol;
@@ -35,7 +39,7 @@ typedef struct {
 } FunctionSymbols;
 
 typedef struct {
-    char *identifier;
+    SymbolId identifier;
 } TypedefSymbol;
 
 typedef struct {
@@ -45,7 +49,7 @@ typedef struct {
 } TypedefSymbols;
 
 typedef struct {
-    char *identifier;
+    SymbolId identifier;
 } LabelSymbol;
 
 typedef struct {
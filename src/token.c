@@ -6,6 +6,56 @@
 #include <stdio.h>
 #include "token.h"
 
+// roughly the bytes per token of ordinary C, so most sources never need to grow
+// the stream. it only has to be a good guess, the stream still grows if needed
+#define BYTES_PER_TOKEN_ESTIMATE 4
+
+// token types are stored in a byte each
+_Static_assert(TOKEN_NONE < 256, "token types must fit in a uint8_t");
+
+static void resize_token_stream(TokenStream *stream, int capacity) {
+    stream->types = realloc(stream->types, sizeof(uint8_t) * capacity);
+    stream->offsets = realloc(stream->offsets, sizeof(int) * capacity);
+    stream->lengths = realloc(stream->lengths, sizeof(int) * capacity);
+    stream->has_whitespace_after = realloc(stream->has_whitespace_after, sizeof(uint8_t) * capacity);
+    stream->capacity = capacity;
+}
+
+void token_stream_reserve(TokenStream *stream, int capacity) {
+    if (capacity > stream->capacity) resize_token_stream(stream, capacity);
+}
+
+void init_token_stream(TokenStream *stream, int source_length) {
+    stream->types = NULL;
+    stream->offsets = NULL;
+    stream->lengths = NULL;
+    stream->has_whitespace_after = NULL;
+    stream->count = 0;
+    stream->capacity = 0;
+
+    // one more for the end of file token
+    resize_token_stream(stream, source_length / BYTES_PER_TOKEN_ESTIMATE + 1);
+}
+
+void free_token_stream(TokenStream *stream) {
+    free(stream->types);
+    free(stream->offsets);
+    free(stream->lengths);
+    free(stream->has_whitespace_after);
+}
+
+void token_stream_push(TokenStream *stream, TokenType type, int offset, int length, int has_whitespace_after) {
+    if (stream->count >= stream->capacity) {
+        resize_token_stream(stream, stream->capacity * 2);
+    }
+
+    int i = stream->count++;
+    stream->types[i] = (uint8_t)type;
+    stream->offsets[i] = offset;
+    stream->lengths[i] = length;
+    stream->has_whitespace_after[i] = (uint8_t)has_whitespace_after;
+}
+
 char *token_type_to_str(TokenType type) {
     switch (type) {
         case TOKEN_INT: return "int";
@@ -111,4 +161,62 @@ char *token_type_to_str(TokenType type) {
 
         default: return "unknown token";
     }
+}
+
+// the source spelling of a punctuator, tokens no longer carry their own lexeme
+// so this is how operators are printed. keywords are spelled by their name
+char *token_type_to_lexeme(TokenType type) {
+    switch (type) {
+        case TOKEN_LEFT_PAREN: return "(";
+        case TOKEN_RIGHT_PAREN: return ")";
+        case TOKEN_SEMICOLON: return ";";
+        case TOKEN_LEFT_BRACE: return "{";
+        case TOKEN_RIGHT_BRACE: return "}";
+        case TOKEN_SINGLE_EQUALS: return "=";
+        case TOKEN_COMMA: return ",";
+        case TOKEN_HASHTAG: return "#";
+        case TOKEN_EXCLAMATION: return "!";
+        case TOKEN_GREATER_THAN: return ">";
+        case TOKEN_LESS_THAN: return "<";
+        case TOKEN_GREATER_THAN_EQUALS: return ">=";
+        case TOKEN_LESS_THAN_EQUALS: return "<=";
+        case TOKEN_EQUALS: return "==";
+        case TOKEN_NOT_EQUALS: return "!=";
+        case TOKEN_AND: return "&&";
+        case TOKEN_OR: return "||";
+        case TOKEN_DOT: return ".";
+
+        case TOKEN_PLUS: return "+";
+        case TOKEN_MINUS: return "-";
+        case TOKEN_STAR: return "*";
+        case TOKEN_SLASH: return "/";
+        case TOKEN_MODULO: return "%";
+        case TOKEN_DECREMENT: return "--";
+        case TOKEN_INCREMENT: return "++";
+        case TOKEN_PLUS_EQUALS: return "+=";
+        case TOKEN_MINUS_EQUALS: return "-=";
+        case TOKEN_STAR_EQUALS: return "*=";
+        case TOKEN_SLASH_EQUALS: return "/=";
+        case TOKEN_MODULO_EQUALS: return "%=";
+        case TOKEN_BITWISE_AND_EQUALS: return "&=";
+        case TOKEN_BITWISE_OR_EQUALS: return "|=";
+        case TOKEN_BITWISE_XOR_EQUALS: return "^=";
+        case TOKEN_BITWISE_LEFT_SHIFT_EQUALS: return "<<=";
+        case TOKEN_BITWISE_RIGHT_SHIFT_EQUALS: return ">>=";
+        case TOKEN_ARROW_OP: return "->";
+        case TOKEN_SQUARE_BRACKET_LEFT: return "[";
+        case TOKEN_SQUARE_BRACKET_RIGHT: return "]";
+        case TOKEN_QUESTION: return "?";
+        case TOKEN_COLON: return ":";
+        case TOKEN_ELLIPSIS: return "...";
+
+        case TOKEN_BITWISE_AND: return "&";
+        case TOKEN_BITWISE_OR: return "|";
+        case TOKEN_BITWISE_XOR: return "^";
+        case TOKEN_BITWISE_LEFT_SHIFT: return "<<";
+        case TOKEN_BITWISE_RIGHT_SHIFT: return ">>";
+        case TOKEN_BITWISE_NOT: return "~";
+
+        default: return token_type_to_str(type);
+    }
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <stdint.h>
+
 typedef enum {
     TOKEN_INT,
     TOKEN_RETURN,
@@ -109,17 +111,44 @@ typedef enum {
 
 
 typedef struct {
-    char     *lexeme;
     TokenType type;
-    int       line;
+
+    // the lexeme is not copied, it is the range [offset, offset + length) of
+    // the source buffer the token was read from
+    int       offset;
+    int       length;
     int       has_whitespace_after;
 } Token;
 
+// the tokens of a source, stored as parallel arrays so the parser can scan the
+// types without pulling the colder per-token fields into cache
 typedef struct {
-    const char *symbol;
-    TokenType   type;
-} SymbolToken;
+    uint8_t *types;
+    int     *offsets;
+    int     *lengths;
+    uint8_t *has_whitespace_after;
+
+    int      count;
+    int      capacity;
+} TokenStream;
+
+extern void init_token_stream(TokenStream *stream, int source_length);
+extern void free_token_stream(TokenStream *stream);
+extern void token_stream_reserve(TokenStream *stream, int capacity);
+extern void token_stream_push(TokenStream *stream, TokenType type, int offset, int length, int has_whitespace_after);
+
+// gathers the fields of the token at the index into a single value
+static inline Token token_at(const TokenStream *stream, int index) {
+    Token token;
+    token.type = (TokenType)stream->types[index];
+    token.offset = stream->offsets[index];
+    token.length = stream->lengths[index];
+    token.has_whitespace_after = stream->has_whitespace_after[index];
+
+    return token;
+}
 
 extern char *token_type_to_str(TokenType type);
+extern char *token_type_to_lexeme(TokenType type);
 
 #endif
\ No newline at end of file
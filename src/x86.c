@@ -7,15 +7,20 @@
 #include "token.h"
 #include "x86.h"
 
-static void generate_node(Compiler *c, AstNode *node);
+static void generate_node(Compiler *c, NodeId id);
 
-Compiler *init_compiler(AstNode **tree, int count, char *exe, int emitAsm, int emitObj) {
+static inline AstNode *node_at(Compiler *c, NodeId id) {
+    return &c->nodes[id];
+}
+
+Compiler *init_compiler(AstNode *nodes, NodeId *tree, int count, char *exe, int emitAsm, int emitObj) {
     Compiler *c = malloc(sizeof(Compiler));
     if (!c) {
         perror("Error allocating compiler.");
         return NULL;
     }
     
+    c->nodes = nodes;
     c->tree = tree;
     c->node_count = count;
     c->exe = exe;
@@ -26,6 +31,11 @@ Compiler *init_compiler(AstNode **tree, int count, char *exe, int emitAsm, int e
     c->symbol_table->capacity = 1;
     c->symbol_table->count = 0;
     c->symbol_table->symbols = malloc(sizeof(Symbol));
+    c->symbol_table->index = (SymbolMap){0};
+
+    c->steps = NULL;
+    c->step_count = 0;
+    c->step_capacity = 0;
 
     return c;
 }
@@ -33,14 +43,28 @@ Compiler *init_compiler(AstNode **tree, int count, char *exe, int emitAsm, int e
 void free_compiler(Compiler *c) {
     if (!c) return;
 
-    for (int i = 0; i < c->symbol_table->count; i++) {
-        free(c->symbol_table->symbols[i].name);
-    }
     free(c->symbol_table->symbols);
+    free_symbol_map(&c->symbol_table->index);
     free(c->symbol_table);
+    free(c->steps);
     free(c);
 }
 
+static void push_step(Compiler *c, StepKind kind, NodeId node, int label, int end_label) {
+    if (c->step_count >= c->step_capacity) {
+        c->step_capacity = c->step_capacity ? c->step_capacity * 2 : 16;
+        c->steps = realloc(c->steps, sizeof(Step) * c->step_capacity);
+    }
+    c->steps[c->step_count++] = (Step){ kind, node, label, end_label };
+}
+
+// pushed last to first, so the statements are generated in order
+static void push_statements(Compiler *c, NodeId *nodes, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        push_step(c, STEP_NODE, nodes[i], 0, 0);
+    }
+}
+
 static void put(Compiler *c, const char *format, ...) {
     va_list args;
     va_start(args, format);
@@ -62,7 +86,7 @@ static inline void sys_call(Compiler *c) {
     put(c, "syscall");
 }
 
-static inline void call(char *func, Compiler *c) {
+static inline void call(const char *func, Compiler *c) {
     put(c, "call %s", func);
 }
 
@@ -74,52 +98,52 @@ static void syscall_write(Compiler *c, int fd, const char *label, int len) {
     sys_call(c);
 }
 
-static void symbol_table_add(SymbolTable *table, const char *name, int offset) {
+static void symbol_table_add(SymbolTable *table, SymbolId name, int offset) {
     if (table->count >= table->capacity) {
         table->capacity *= 2;
         table->symbols = realloc(table->symbols, sizeof(Symbol) * table->capacity);
     }
-    table->symbols[table->count].name = strdup(name);
+    table->symbols[table->count].name = name;
     table->symbols[table->count].offset = offset;
 
+    symbol_map_put(&table->index, name, table->count);
     table->count++;
 }
 
-static int symbol_table_lookup(SymbolTable *table, const char *name) {
-    for (int i = 0; i < table->count; i++) {
-        if (strcmp(name, table->symbols[i].name) == 0) {
-            return table->symbols[i].offset;
-        }
-    }
+static int symbol_table_lookup(SymbolTable *table, SymbolId name) {
+    int index = symbol_map_get(&table->index, name);
+    if (index < 0) return 0;
 
-    return 0;
-} 
+    return table->symbols[index].offset;
+}
 
 static void generate_return(Compiler *c, AstReturn *ret) {
-    if (ret->value->type == AST_LITERAL_INT) {
-        put(c, "mov rax, %d", ret->value->as.lit_int->value); 
+    AstNode *value = node_at(c, ret->value);
+
+    if (value->type == AST_LITERAL_INT) {
+        put(c, "mov rax, %d", value->as.lit_int.value); 
     }
-    else if (ret->value->type == AST_LITERAL_CHAR) {
-        put(c, "mov rax, %d", ret->value->as.lit_int->value); 
+    else if (value->type == AST_LITERAL_CHAR) {
+        put(c, "mov rax, %d", value->as.lit_int.value); 
     }
-    else if (ret->value->type == AST_CALL_EXPR) {
-        call(ret->value->as.call->identifier, c);
+    else if (value->type == AST_CALL_EXPR) {
+        call(symbol_str(value->as.call.identifier), c);
     }
-    else if (ret->value->type == AST_BINARY) {
+    else if (value->type == AST_BINARY) {
         generate_node(c, ret->value);
     }
-    else if (ret->value->type == AST_IDENTIFIER) {
-        int offset = symbol_table_lookup(c->symbol_table, ret->value->as.ident->name);
+    else if (value->type == AST_IDENTIFIER) {
+        int offset = symbol_table_lookup(c->symbol_table, value->as.ident.name);
         put(c, "mov rax, [rbp%d]", offset);
     }
 }
 
 static int emit_syscall(AstCallExpr *call, Compiler *c) {
-    if (strcmp(call->identifier, "write") == 0) {
-        AstIdentifier *label = call->args[1]->as.ident;
-        int value = call->args[2]->as.lit_int->value;
+    if (call->identifier == intern_str("write")) {
+        AstIdentifier *label = &node_at(c, call->args[1])->as.ident;
+        int value = node_at(c, call->args[2])->as.lit_int.value;
 
-        syscall_write(c, 1, label->name, value);
+        syscall_write(c, 1, symbol_str(label->name), value);
         return 1;
     }
 
@@ -127,15 +151,19 @@ static int emit_syscall(AstCallExpr *call, Compiler *c) {
 }
 
 static void generate_function(Compiler *c, AstFunctionDeclaration *func) {
-    fprintf(c->file, "\n%s:\n", func->identifier);
+    // a body still deferred was not reachable from main, nothing calls it
+    if (func->body_deferred) return;
+
+    fprintf(c->file, "\n%s:\n", symbol_str(func->identifier));
     put(c, "push rbp");
     put(c, "mov rbp, rsp");
 
     int offset = -8;
     for (int i = 0; i < func->body_count; i++) {
-        if (func->body[i]->type == AST_VARIABLE_DECLARATION) {
-            for (int j = 0; j < func->body[i]->as.var_dec->declarator_count; j++) {
-                symbol_table_add(c->symbol_table, func->body[i]->as.var_dec->declarators[j]->identifier, offset);
+        AstNode *statement = node_at(c, func->body[i]);
+        if (statement->type == AST_VARIABLE_DECLARATION) {
+            for (int j = 0; j < statement->as.var_dec->declarator_count; j++) {
+                symbol_table_add(c->symbol_table, statement->as.var_dec->declarators[j]->identifier, offset);
                 offset -= 8;
             }
         }
@@ -147,7 +175,7 @@ static void generate_function(Compiler *c, AstFunctionDeclaration *func) {
         generate_node(c, func->body[i]);
 
         // skips dead code
-        if (func->body[i]->type == AST_RETURN) {
+        if (node_at(c, func->body[i])->type == AST_RETURN) {
             break;
         }
     }
@@ -160,56 +188,53 @@ static void generate_function(Compiler *c, AstFunctionDeclaration *func) {
 static void generate_call_expr(Compiler *c, AstCallExpr *call_expr) {
     if (emit_syscall(call_expr, c)) return;
 
-    call(call_expr->identifier, c);
+    call(symbol_str(call_expr->identifier), c);
 }
 
-static void generate_binary_expr(Compiler *c, AstBinaryExpr *binary) {
-    if (binary->op.type == TOKEN_PLUS) {
-        generate_node(c, binary->left);
-        put(c, "push rax");
-        generate_node(c, binary->right);
+static int is_supported_binary(TokenType op) {
+    return op == TOKEN_PLUS || op == TOKEN_MINUS || op == TOKEN_STAR ||
+        op == TOKEN_BITWISE_AND || op == TOKEN_EQUALS;
+}
+
+// the operands are generated as steps, the left one's result is pushed while
+// the right one is worked out
+static void generate_binary_expr(Compiler *c, NodeId id, AstBinaryExpr *binary) {
+    if (!is_supported_binary(binary->op)) {
+        fprintf(stderr, "Unsupported binary operator '%d'\n", binary->op);
+        return;
+    }
+
+    push_step(c, STEP_BINARY, id, 0, 0);
+    push_step(c, STEP_NODE, binary->right, 0, 0);
+    push_step(c, STEP_PUSH_RESULT, NO_NODE, 0, 0);
+    push_step(c, STEP_NODE, binary->left, 0, 0);
+}
 
+// rax holds the right operand and the left one is on the stack
+static void apply_binary(Compiler *c, AstBinaryExpr *binary) {
+    if (binary->op == TOKEN_PLUS) {
         put(c, "pop rbx");
         put(c, "add rax, rbx");
     }
-    else if (binary->op.type == TOKEN_MINUS) {
-        generate_node(c, binary->left);
-        put(c, "push rax");
-        generate_node(c, binary->right);
-
+    else if (binary->op == TOKEN_MINUS) {
         put(c, "mov rbx, rax");
         put(c, "pop rax");
         put(c, "sub rax, rbx");
     }
-    else if (binary->op.type == TOKEN_STAR) {
-        generate_node(c, binary->left);
-        put(c, "push rax");
-        generate_node(c, binary->right);
-
+    else if (binary->op == TOKEN_STAR) {
         put(c, "pop rbx");
         put(c, "imul rax, rbx");
     }
-    else if (binary->op.type == TOKEN_BITWISE_AND) {
-        generate_node(c, binary->left);
-        put(c, "push rax");
-        generate_node(c, binary->right);
-
+    else if (binary->op == TOKEN_BITWISE_AND) {
         put(c, "pop rbx");
         put(c, "and rax, rbx");
     }
-    else if (binary->op.type == TOKEN_EQUALS) {
-        generate_node(c, binary->left);
-        put(c, "push rax");
-        generate_node(c, binary->right);
-
+    else if (binary->op == TOKEN_EQUALS) {
         put(c, "pop rbx");
         put(c, "cmp rax, rbx");
         put(c, "sete al");
         put(c, "movzx rax, al");
     }
-    else {
-        fprintf(stderr, "Unsupported binary operator '%d'\n", binary->op.type);
-    }
 }
 
 static void generate_lit_int(Compiler *c, AstLiteralInt *lit) {
@@ -222,9 +247,38 @@ static void generate_inline_asm(Compiler *c, AstInlineAsmBlock *asm_inl) {
     }
 }
 
-static void emit_string_literal(Compiler *c, const char *value, char *identifier) {
+// string values arrive with their escapes decoded, so printable runs are
+// emitted quoted and every other byte as a number, e.g. "hi", 10, "there"
+static void emit_string_literal(Compiler *c, const char *value, const char *identifier) {
     putf(c, "section .rodata");
-    put(c, "%s db \"%s\"", identifier, value);
+    fprintf(c->file, "  %s db ", identifier);
+
+    int in_quotes = 0;
+    int first = 1;
+    for (const unsigned char *p = (const unsigned char *)value; *p; p++) {
+        int printable = *p >= ' ' && *p <= '~' && *p != '"';
+
+        if (printable && in_quotes) {
+            fputc(*p, c->file);
+            continue;
+        }
+
+        if (in_quotes) fputc('"', c->file);
+        if (!first) fprintf(c->file, ", ");
+        first = 0;
+
+        if (printable) {
+            fprintf(c->file, "\"%c", *p);
+            in_quotes = 1;
+        } else {
+            fprintf(c->file, "%d", *p);
+            in_quotes = 0;
+        }
+    }
+    if (in_quotes) fputc('"', c->file);
+    if (first) fprintf(c->file, "\"\"");
+    fprintf(c->file, "\n");
+
     putf(c, "section .text");
 }
 
@@ -232,21 +286,22 @@ static void generate_variable_declaration(Compiler *c, AstVariableDeclaration *v
     for (int i = 0; i < var_dec->declarator_count; i++) {
         int stack_offset = symbol_table_lookup(c->symbol_table, var_dec->declarators[i]->identifier);
         AstDeclarator *decl = var_dec->declarators[i];
+        AstNode *value = node_at(c, decl->value);
 
-        if (decl->value->type == AST_LITERAL_INT) {
-            put(c, "mov qword [rbp%d], %d", stack_offset, var_dec->declarators[i]->value->as.lit_int->value);
+        if (value->type == AST_LITERAL_INT) {
+            put(c, "mov qword [rbp%d], %d", stack_offset, value->as.lit_int.value);
         }
-        else if (decl->value->type == AST_IDENTIFIER) {
-            int source_offset = symbol_table_lookup(c->symbol_table, decl->value->as.ident->name);
+        else if (value->type == AST_IDENTIFIER) {
+            int source_offset = symbol_table_lookup(c->symbol_table, value->as.ident.name);
             put(c, "mov rax, qword [rbp%d]", source_offset);
             put(c, "mov qword [rbp%d], rax", stack_offset);
         }
-        else if (decl->value->type == AST_BINARY) {
-            generate_binary_expr(c, decl->value->as.binary);
+        else if (value->type == AST_BINARY) {
+            generate_node(c, decl->value);
             put(c, "mov qword [rbp%d], rax", stack_offset);
         }
-        else if (decl->value->type == AST_LITERAL_STRING) {
-            emit_string_literal(c, decl->value->as.lit_str->value, decl->identifier);
+        else if (value->type == AST_LITERAL_STRING) {
+            emit_string_literal(c, value->as.lit_str.value, symbol_str(decl->identifier));
         }
         else {
             printf("Unknown variable declarator type");
@@ -266,15 +321,16 @@ static void generate_if_statement(Compiler *c, AstIfStatement *iff) {
     int end_label = label_counter++;
     int else_label = label_counter++;
 
-    if (iff->condition->type == AST_BINARY) {
-        generate_node(c, iff->condition->as.binary->left);
+    AstNode *condition = node_at(c, iff->condition);
+    if (condition->type == AST_BINARY) {
+        generate_node(c, condition->as.binary.left);
         put(c, "push rax");
-        generate_node(c, iff->condition->as.binary->right);
+        generate_node(c, condition->as.binary.right);
         put(c, "mov rbx, rax");
         put(c, "pop rax");
         put(c, "cmp rax, rbx");
 
-        switch (iff->condition->as.binary->op.type) {
+        switch (condition->as.binary.op) {
             case TOKEN_GREATER_THAN:
                 put(c, "jle .Lelse%d", else_label);
                 break;
@@ -304,17 +360,11 @@ static void generate_if_statement(Compiler *c, AstIfStatement *iff) {
         put(c, "je .Lelse%d", else_label);
     }
 
-    for (int i = 0; i < iff->body_count; i++) {
-        generate_node(c, iff->body[i]);
-    }
-    put(c, "jmp .Lend%d", end_label);
-
-    put(c, ".Lelse%d:", else_label);
-    for (int i = 0; i < iff->else_body_count; i++) {
-        generate_node(c, iff->else_body[i]);
-    }
-
-    putf(c, ".Lend%d:", end_label);
+    // the bodies are generated as steps, so nesting is bounded by the heap
+    push_step(c, STEP_IF_END, NO_NODE, end_label, end_label);
+    push_statements(c, iff->else_body, iff->else_body_count);
+    push_step(c, STEP_IF_ELSE, NO_NODE, else_label, end_label);
+    push_statements(c, iff->body, iff->body_count);
 }
 
 static void generate_while_statement(Compiler *c, AstWhile *whilee) {
@@ -324,15 +374,16 @@ static void generate_while_statement(Compiler *c, AstWhile *whilee) {
 
     putf(c, ".Lwhile_start%d:", start_label);
 
-    if (whilee->condition->type == AST_BINARY) {
-        generate_node(c, whilee->condition->as.binary->left);
+    AstNode *condition = node_at(c, whilee->condition);
+    if (condition->type == AST_BINARY) {
+        generate_node(c, condition->as.binary.left);
         put(c, "push rax");
-        generate_node(c, whilee->condition->as.binary->right);
+        generate_node(c, condition->as.binary.right);
         put(c, "mov rbx, rax");
         put(c, "pop rax");
         put(c, "cmp rax, rbx");
         
-        switch (whilee->condition->as.binary->op.type) {
+        switch (condition->as.binary.op) {
             case TOKEN_EQUALS:
                 put(c, "jne .Lwhile_end%d", end_label); 
                 break;
@@ -362,29 +413,27 @@ static void generate_while_statement(Compiler *c, AstWhile *whilee) {
         put(c, "je .Lwhile_end%d", end_label);
     }
 
-    for (int i = 0; i < whilee->body_count; i++) {
-        generate_node(c, whilee->body[i]);
-    }
-
-    put(c, "jmp .Lwhile_start%d", start_label);
-    putf(c, ".Lwhile_end%d:", end_label);
+    push_step(c, STEP_WHILE_END, NO_NODE, start_label, end_label);
+    push_statements(c, whilee->body, whilee->body_count);
 }
 
-static void generate_node(Compiler *c, AstNode *node) {
+static void generate_step(Compiler *c, NodeId id) {
+    AstNode *node = node_at(c, id);
+
     if (node->type == AST_FUNCTION) {
         generate_function(c, node->as.func);
     }
     else if (node->type == AST_RETURN) {
-        generate_return(c, node->as.ret);
+        generate_return(c, &node->as.ret);
     }
     else if (node->type == AST_CALL_EXPR) {
-        generate_call_expr(c, node->as.call);
+        generate_call_expr(c, &node->as.call);
     }
     else if (node->type == AST_BINARY) {
-        generate_binary_expr(c, node->as.binary);
+        generate_binary_expr(c, id, &node->as.binary);
     }
     else if (node->type == AST_LITERAL_INT) {
-        generate_lit_int(c, node->as.lit_int);
+        generate_lit_int(c, &node->as.lit_int);
     }
     else if (node->type == AST_INLINE_ASM_BLOCK) {
         generate_inline_asm(c, node->as.asm_inl);
@@ -393,11 +442,11 @@ static void generate_node(Compiler *c, AstNode *node) {
         generate_variable_declaration(c, node->as.var_dec);
     }
     else if (node->type == AST_IDENTIFIER) {
-        int offset = symbol_table_lookup(c->symbol_table, node->as.ident->name);
+        int offset = symbol_table_lookup(c->symbol_table, node->as.ident.name);
         put(c, "mov rax, qword [rbp%d]", offset);
     }
     else if (node->type == AST_ASSIGNMENT) {
-        generate_assignment(c, node->as.assign);
+        generate_assignment(c, &node->as.assign);
     }
     else if (node->type == AST_IF) {
         generate_if_statement(c, node->as.if_stmt);
@@ -410,6 +459,40 @@ static void generate_node(Compiler *c, AstNode *node) {
     }
 }
 
+// the steps a node leaves are run until the stack is back where it started,
+// steps below that belong to an enclosing generate_node
+static void generate_node(Compiler *c, NodeId id) {
+    int base = c->step_count;
+    push_step(c, STEP_NODE, id, 0, 0);
+
+    while (c->step_count > base) {
+        Step step = c->steps[--c->step_count];
+
+        switch (step.kind) {
+            case STEP_NODE:
+                generate_step(c, step.node);
+                break;
+            case STEP_PUSH_RESULT:
+                put(c, "push rax");
+                break;
+            case STEP_BINARY:
+                apply_binary(c, &node_at(c, step.node)->as.binary);
+                break;
+            case STEP_IF_ELSE:
+                put(c, "jmp .Lend%d", step.end_label);
+                put(c, ".Lelse%d:", step.label);
+                break;
+            case STEP_IF_END:
+                putf(c, ".Lend%d:", step.end_label);
+                break;
+            case STEP_WHILE_END:
+                put(c, "jmp .Lwhile_start%d", step.label);
+                putf(c, ".Lwhile_end%d:", step.end_label);
+                break;
+        }
+    }
+}
+
 static void asm_init(Compiler *c) {
     putf(c, "section .rodata");
     putf(c, "section .data");
@@ -427,8 +510,9 @@ static void asm_init(Compiler *c) {
 static int check_main(Compiler *c) {
     int has_entry_point = 0;
     for (int i = 0; i < c->node_count; i++) {
-        if (c->tree[i]->type == AST_FUNCTION) {
-            if (strcmp(c->tree[i]->as.func->identifier, "main") == 0) {
+        AstNode *node = node_at(c, c->tree[i]);
+        if (node->type == AST_FUNCTION) {
+            if (node->as.func->identifier == intern_str("main")) {
                 has_entry_point = 1;
                 break;
             }
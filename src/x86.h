@@ -4,7 +4,7 @@
 #include "ast.h"
 
 typedef struct {
-    char *name;
+    SymbolId name;
     int offset;
 } Symbol;
 
@@ -12,10 +12,32 @@ typedef struct {
     Symbol *symbols;
     int count;
     int capacity;
+
+    // the position of each symbol in symbols, keyed on its name
+    SymbolMap index;
 } SymbolTable;
 
+typedef enum {
+    STEP_NODE,
+    STEP_PUSH_RESULT,
+    STEP_BINARY,
+    STEP_IF_ELSE,
+    STEP_IF_END,
+    STEP_WHILE_END,
+} StepKind;
+
+// what is left of generating a node once its children have been
 typedef struct {
-    AstNode **tree;
+    StepKind kind;
+    NodeId   node;
+    int      label;
+    int      end_label;
+} Step;
+
+typedef struct {
+    // the parser's nodes, tree indexes into it
+    AstNode  *nodes;
+    NodeId   *tree;
     int       node_count;
     FILE     *file;
 
@@ -29,9 +51,14 @@ typedef struct {
     char     *exe;
 
     SymbolTable *symbol_table;
+
+    // the steps left to generate, the next one last
+    Step        *steps;
+    int          step_count;
+    int          step_capacity;
 } Compiler;
 
-extern Compiler *init_compiler(AstNode **tree, int count, char *exe, int emitAsm, int emitObj);
+extern Compiler *init_compiler(AstNode *nodes, NodeId *tree, int count, char *exe, int emitAsm, int emitObj);
 extern void free_compiler(Compiler *compiler);
 extern void compile(Compiler *compiler);
 
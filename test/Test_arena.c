@@ -0,0 +1,66 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "unity.h"
+#include "arena.h"
+
+static Arena arena;
+
+void setUp() {
+    init_arena(&arena);
+}
+
+void tearDown() {
+    free_arena(&arena);
+}
+
+void test_allocations_are_aligned_and_apart() {
+    char *a = arena_alloc(&arena, 3);
+    char *b = arena_alloc(&arena, 8);
+
+    TEST_ASSERT_EQUAL_INT(0, (uintptr_t)a % sizeof(size_t));
+    TEST_ASSERT_EQUAL_INT(0, (uintptr_t)b % sizeof(size_t));
+    TEST_ASSERT_TRUE(b >= a + 3);
+
+    TEST_ASSERT_EQUAL_INT(2, arena.allocations);
+    TEST_ASSERT_EQUAL_INT(1, arena.block_count);
+}
+
+void test_last_allocation_grows_in_place() {
+    int *list = arena_alloc(&arena, sizeof(int));
+    list[0] = 7;
+
+    int *grown = arena_realloc(&arena, list, sizeof(int) * 64);
+    TEST_ASSERT_EQUAL_PTR(list, grown);
+
+    // once something follows it, it is copied
+    arena_alloc(&arena, 1);
+    int *moved = arena_realloc(&arena, grown, sizeof(int) * 128);
+    TEST_ASSERT_TRUE(moved != grown);
+    TEST_ASSERT_EQUAL_INT(7, moved[0]);
+}
+
+void test_large_allocation_gets_its_own_block() {
+    char *small = arena_alloc(&arena, 16);
+    char *large = arena_alloc(&arena, ARENA_BLOCK_SIZE * 2);
+    memset(large, 1, ARENA_BLOCK_SIZE * 2);
+
+    TEST_ASSERT_NOT_NULL(small);
+    TEST_ASSERT_EQUAL_INT(2, arena.block_count);
+}
+
+void test_strndup_terminates() {
+    char *copy = arena_strndup(&arena, "hello world", 5);
+    TEST_ASSERT_EQUAL_STRING("hello", copy);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_allocations_are_aligned_and_apart);
+    RUN_TEST(test_last_allocation_grows_in_place);
+    RUN_TEST(test_large_allocation_gets_its_own_block);
+    RUN_TEST(test_strndup_terminates);
+
+    return UNITY_END();
+}
@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include "lexer.h"
+#include "ast.h"
+
+static Lexer *lexer;
+static Parser *parser;
+
+void setUp() {}
+void tearDown() {
+    free_parser(parser);
+    free_lexer(lexer);
+}
+
+static AstNode *node(NodeId id) {
+    return ast_node(parser, id);
+}
+
+static AstNode *parse_return_value(const char *source) {
+    lexer = init_lexer(source, 0);
+    tokenize(lexer);
+
+    parser = init_parser(lexer, 0, "");
+    parse_ast(parser);
+
+    TEST_ASSERT_TRUE(parser->err == NO_PARSER_ERROR);
+    TEST_ASSERT_EQUAL_INT(AST_RETURN, node(parser->tree[0])->type);
+
+    return node(node(parser->tree[0])->as.ret.value);
+}
+
+static void assert_binary(AstNode *expr, TokenType op) {
+    TEST_ASSERT_EQUAL_INT(AST_BINARY, expr->type);
+    TEST_ASSERT_EQUAL_INT(op, expr->as.binary.op);
+}
+
+static void assert_ident(AstNode *expr, const char *name) {
+    TEST_ASSERT_EQUAL_INT(AST_IDENTIFIER, expr->type);
+    TEST_ASSERT_EQUAL_STRING(name, symbol_str(expr->as.ident.name));
+}
+
+void test_binary_precedence() {
+    AstNode *expr = parse_return_value("return a + b * c - d;");
+
+    // (a + (b * c)) - d
+    assert_binary(expr, TOKEN_MINUS);
+    assert_ident(node(expr->as.binary.right), "d");
+
+    AstNode *sum = node(expr->as.binary.left);
+    assert_binary(sum, TOKEN_PLUS);
+    assert_ident(node(sum->as.binary.left), "a");
+    assert_binary(node(sum->as.binary.right), TOKEN_STAR);
+}
+
+void test_bitwise_operators_chain() {
+    AstNode *expr = parse_return_value("return a & b & c | d;");
+
+    assert_binary(expr, TOKEN_BITWISE_OR);
+    AstNode *left = node(expr->as.binary.left);
+    assert_binary(left, TOKEN_BITWISE_AND);
+    assert_binary(node(left->as.binary.left), TOKEN_BITWISE_AND);
+    assert_ident(node(left->as.binary.right), "c");
+}
+
+void test_ternary_is_right_associative() {
+    AstNode *expr = parse_return_value("return a || b ? c : d ? e : f;");
+
+    TEST_ASSERT_EQUAL_INT(AST_TERNARY, expr->type);
+    assert_binary(node(expr->as.ternary.condition), TOKEN_OR);
+    assert_ident(node(expr->as.ternary.true_expr), "c");
+    TEST_ASSERT_EQUAL_INT(AST_TERNARY, node(expr->as.ternary.false_expr)->type);
+}
+
+void test_unary_and_postfix_operators() {
+    AstNode *expr = parse_return_value("return -a[1]++ * sizeof(b);");
+
+    assert_binary(expr, TOKEN_STAR);
+
+    // the postfix operators bind before the prefix minus
+    AstNode *negate = node(expr->as.binary.left);
+    TEST_ASSERT_EQUAL_INT(AST_UNARY, negate->type);
+    TEST_ASSERT_EQUAL_INT(TOKEN_MINUS, negate->as.unary.op);
+
+    AstNode *increment = node(negate->as.unary.left);
+    TEST_ASSERT_EQUAL_INT(AST_UNARY, increment->type);
+    TEST_ASSERT_TRUE(increment->as.unary.is_postfix);
+    TEST_ASSERT_EQUAL_INT(AST_ARR_SUBSCRIPT, node(increment->as.unary.left)->type);
+
+    AstNode *size = node(expr->as.binary.right);
+    TEST_ASSERT_EQUAL_INT(AST_UNARY, size->type);
+    TEST_ASSERT_EQUAL_INT(TOKEN_SIZEOF, size->as.unary.op);
+}
+
+void test_call_arguments() {
+    AstNode *expr = parse_return_value("return f(1, (a + b) * 2, g());");
+
+    TEST_ASSERT_EQUAL_INT(AST_CALL_EXPR, expr->type);
+    TEST_ASSERT_EQUAL_INT(3, expr->as.call.arg_count);
+    assert_binary(node(expr->as.call.args[1]), TOKEN_STAR);
+    TEST_ASSERT_EQUAL_INT(AST_CALL_EXPR, node(expr->as.call.args[2])->type);
+    TEST_ASSERT_EQUAL_INT(0, node(expr->as.call.args[2])->as.call.arg_count);
+}
+
+void test_compound_assignment_needs_a_name() {
+    AstNode *expr = parse_return_value("return a += b * 2;");
+
+    TEST_ASSERT_EQUAL_INT(AST_ASSIGNMENT, expr->type);
+    TEST_ASSERT_EQUAL_STRING("a", symbol_str(expr->as.assign.identifier));
+    assert_binary(node(expr->as.assign.value), TOKEN_PLUS);
+    free_parser(parser);
+    free_lexer(lexer);
+
+    const char *sources[] = {
+        "void f() { a[0] += 1; }",
+        "void f() { *p += 2; }",
+        "return (a + b) -= 1;",
+    };
+    for (int i = 0; i < 3; i++) {
+        lexer = init_lexer(sources[i], 0);
+        tokenize(lexer);
+
+        parser = init_parser(lexer, 0, "");
+        parse_ast(parser);
+        TEST_ASSERT_EQUAL_INT(PARSE_ERR_INVALID_SYNTAX, parser->err);
+
+        if (i < 2) {
+            free_parser(parser);
+            free_lexer(lexer);
+        }
+    }
+}
+
+// deep enough to overflow the native stack if each level were a call
+void test_deeply_nested_expression() {
+    int depth = 100000;
+    char *source = malloc(depth * 4 + 32);
+
+    char *p = source;
+    p += sprintf(p, "return ");
+    for (int i = 0; i < depth; i++) { memcpy(p, "-(", 2); p += 2; }
+    *p++ = '1';
+    for (int i = 0; i < depth; i++) *p++ = ')';
+    strcpy(p, ";");
+
+    AstNode *expr = parse_return_value(source);
+    for (int i = 0; i < depth; i++) {
+        TEST_ASSERT_EQUAL_INT(AST_UNARY, expr->type);
+        expr = node(expr->as.unary.left);
+    }
+    TEST_ASSERT_EQUAL_INT(AST_LITERAL_INT, expr->type);
+
+    free(source);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_binary_precedence);
+    RUN_TEST(test_bitwise_operators_chain);
+    RUN_TEST(test_ternary_is_right_associative);
+    RUN_TEST(test_unary_and_postfix_operators);
+    RUN_TEST(test_call_arguments);
+    RUN_TEST(test_compound_assignment_needs_a_name);
+    RUN_TEST(test_deeply_nested_expression);
+
+    return UNITY_END();
+}
@@ -0,0 +1,112 @@
+#include <stdlib.h>
+
+#include "unity.h"
+#include "lexer.h"
+#include "ast.h"
+
+static Lexer *lexer;
+static Parser *parser;
+
+void setUp() {}
+void tearDown() {
+    free_parser(parser);
+    free_lexer(lexer);
+}
+
+static void parse_deferred(const char *source) {
+    lexer = init_lexer(source, 0);
+    tokenize(lexer);
+
+    parser = init_parser(lexer, 0, "");
+    parser->defer_bodies = 1;
+    parse_ast(parser);
+
+    TEST_ASSERT_TRUE(parser->err == NO_PARSER_ERROR);
+}
+
+static AstFunctionDeclaration *function_at(int index) {
+    AstNode *node = ast_node(parser, parser->tree[index]);
+    TEST_ASSERT_EQUAL_INT(AST_FUNCTION, node->type);
+    return node->as.func;
+}
+
+void test_body_is_skipped_to_its_closing_brace() {
+    parse_deferred("int f() { if (x) { return 1; } while (x) { } return 2; } int g() { return 3; }");
+
+    TEST_ASSERT_EQUAL_INT(2, parser->node_count);
+
+    AstFunctionDeclaration *f = function_at(0);
+    TEST_ASSERT_TRUE(f->body_deferred);
+    TEST_ASSERT_EQUAL_INT(0, f->body_count);
+    TEST_ASSERT_EQUAL_INT(TOKEN_RIGHT_BRACE, parser->tokens->types[f->body_end]);
+    TEST_ASSERT_EQUAL_INT(TOKEN_INT, parser->tokens->types[f->body_end + 1]);
+
+    TEST_ASSERT_TRUE(parse_function_body(parser, f));
+    TEST_ASSERT_FALSE(f->body_deferred);
+    TEST_ASSERT_EQUAL_INT(3, f->body_count);
+    TEST_ASSERT_EQUAL_INT(AST_IF, ast_node(parser, f->body[0])->type);
+    TEST_ASSERT_EQUAL_INT(AST_WHILE, ast_node(parser, f->body[1])->type);
+    TEST_ASSERT_EQUAL_INT(AST_RETURN, ast_node(parser, f->body[2])->type);
+
+    // building it again is a no-op
+    NodeId *body = f->body;
+    TEST_ASSERT_TRUE(parse_function_body(parser, f));
+    TEST_ASSERT_EQUAL_PTR(body, f->body);
+}
+
+void test_only_reachable_bodies_are_built() {
+    parse_deferred(
+        "int unused() { return helper(); }"
+        "int helper() { return leaf(); }"
+        "int leaf() { return 1; }"
+        "int main() { return helper(); }"
+    );
+
+    parse_reachable_bodies(parser);
+    TEST_ASSERT_TRUE(parser->err == NO_PARSER_ERROR);
+
+    TEST_ASSERT_TRUE(function_at(0)->body_deferred);
+    TEST_ASSERT_FALSE(function_at(1)->body_deferred);
+    TEST_ASSERT_FALSE(function_at(2)->body_deferred);
+    TEST_ASSERT_FALSE(function_at(3)->body_deferred);
+}
+
+void test_every_body_is_built_without_main() {
+    parse_deferred("int a() { return 1; } int b() { return 2; }");
+
+    parse_reachable_bodies(parser);
+
+    TEST_ASSERT_FALSE(function_at(0)->body_deferred);
+    TEST_ASSERT_FALSE(function_at(1)->body_deferred);
+}
+
+void test_error_in_body_is_found_when_built() {
+    parse_deferred("int f() { return 1 } int main() { return 0; }");
+
+    AstFunctionDeclaration *f = function_at(0);
+    TEST_ASSERT_FALSE(parse_function_body(parser, f));
+    TEST_ASSERT_TRUE(parser->err == PARSE_ERR_EXPECTED_SEMICOLON);
+}
+
+void test_unclosed_body_is_an_error() {
+    lexer = init_lexer("int f() { if (x) { return 1; }", 0);
+    tokenize(lexer);
+
+    parser = init_parser(lexer, 0, "");
+    parser->defer_bodies = 1;
+    parse_ast(parser);
+
+    TEST_ASSERT_TRUE(parser->err == PARSE_ERR_INVALID_SYNTAX);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_body_is_skipped_to_its_closing_brace);
+    RUN_TEST(test_only_reachable_bodies_are_built);
+    RUN_TEST(test_every_body_is_built_without_main);
+    RUN_TEST(test_error_in_body_is_found_when_built);
+    RUN_TEST(test_unclosed_body_is_an_error);
+
+    return UNITY_END();
+}
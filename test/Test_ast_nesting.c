@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include "lexer.h"
+#include "ast.h"
+#include "analyze.h"
+
+// deep enough to overflow the 8 MB native stack if each level were a call
+#define DEPTH 100000
+
+static char *source;
+static Lexer *lexer;
+static Parser *parser;
+
+void setUp() {}
+void tearDown() {
+    free_parser(parser);
+    free_lexer(lexer);
+    free(source);
+}
+
+static void parse_source() {
+    lexer = init_lexer(source, 0);
+    tokenize(lexer);
+
+    parser = init_parser(lexer, 0, "");
+    parse_ast(parser);
+}
+
+static char *repeat(char *p, const char *text, int count) {
+    size_t len = strlen(text);
+    for (int i = 0; i < count; i++) {
+        memcpy(p, text, len);
+        p += len;
+    }
+    return p;
+}
+
+// the statements cycle through every compound statement with a body
+static const char *OPENERS[] = { "if (x) { ", "while (x) { ", "for (;;) { ", "do { ", "if (x) { } else { " };
+static const char *CLOSERS[] = { "} ", "} ", "} ", "} while (x); ", "} " };
+static const AstType TYPES[] = { AST_IF, AST_WHILE, AST_FOR, AST_DO_WHILE, AST_IF };
+
+static AstNode *only_statement(AstNode *node, int kind) {
+    AstBlock *block;
+
+    switch (kind) {
+        case 0:
+            TEST_ASSERT_EQUAL_INT(1, node->as.if_stmt->body_count);
+            return ast_node(parser, node->as.if_stmt->body[0]);
+        case 1:
+            TEST_ASSERT_EQUAL_INT(1, node->as.while_stmt->body_count);
+            return ast_node(parser, node->as.while_stmt->body[0]);
+        case 2:
+            block = ast_node(parser, node->as.for_stmt->block)->as.block;
+            TEST_ASSERT_EQUAL_INT(1, block->body_count);
+            return ast_node(parser, block->body[0]);
+        case 3:
+            TEST_ASSERT_EQUAL_INT(1, node->as.do_while->block->body_count);
+            return ast_node(parser, node->as.do_while->block->body[0]);
+        default:
+            TEST_ASSERT_EQUAL_INT(0, node->as.if_stmt->body_count);
+            TEST_ASSERT_EQUAL_INT(1, node->as.if_stmt->else_body_count);
+            return ast_node(parser, node->as.if_stmt->else_body[0]);
+    }
+}
+
+void test_deeply_nested_statements() {
+    source = malloc(DEPTH * 32 + 64);
+
+    char *p = source;
+    p += sprintf(p, "int main() { ");
+    for (int i = 0; i < DEPTH; i++) p = repeat(p, OPENERS[i % 5], 1);
+    p = repeat(p, "x = 1; ", 1);
+    for (int i = DEPTH - 1; i >= 0; i--) p = repeat(p, CLOSERS[i % 5], 1);
+    strcpy(p, "}");
+
+    parse_source();
+    TEST_ASSERT_TRUE(parser->err == NO_PARSER_ERROR);
+    TEST_ASSERT_EQUAL_INT(1, parser->node_count);
+    TEST_ASSERT_EQUAL_INT(0, parser->open_body_count);
+
+    AstNode *node = ast_node(parser, ast_node(parser, parser->tree[0])->as.func->body[0]);
+    for (int i = 0; i < DEPTH; i++) {
+        TEST_ASSERT_EQUAL_INT(TYPES[i % 5], node->type);
+        node = only_statement(node, i % 5);
+    }
+    TEST_ASSERT_EQUAL_INT(AST_ASSIGNMENT, node->type);
+
+    // x is not declared, the error shows the innermost body was reached
+    Analyzer *analyzer = init_analyzer(parser->nodes, parser->tree, parser->node_count);
+    analyze_ast(analyzer);
+
+    TEST_ASSERT_TRUE(analyzer->err == ANALYZE_ERR_UNDEFINED_IDENTIFIER);
+    TEST_ASSERT_EQUAL_INT(0, analyzer->pending_count);
+    TEST_ASSERT_EQUAL_INT(0, analyzer->scope_count);
+
+    free_analyzer(analyzer);
+}
+
+void test_deeply_nested_switches() {
+    source = malloc(DEPTH * 32 + 64);
+
+    char *p = source;
+    p += sprintf(p, "int main() { ");
+    p = repeat(p, "switch (x) { case 1: ", DEPTH);
+    p = repeat(p, "break; ", 1);
+    p = repeat(p, "} ", DEPTH);
+    strcpy(p, "}");
+
+    parse_source();
+    TEST_ASSERT_TRUE(parser->err == NO_PARSER_ERROR);
+
+    AstNode *node = ast_node(parser, ast_node(parser, parser->tree[0])->as.func->body[0]);
+    for (int i = 0; i < DEPTH; i++) {
+        TEST_ASSERT_EQUAL_INT(AST_SWITCH, node->type);
+        TEST_ASSERT_EQUAL_INT(1, node->as.switch_stmt->case_count);
+        node = ast_node(parser, node->as.switch_stmt->cases[0]->block->body[0]);
+    }
+    TEST_ASSERT_EQUAL_INT(AST_BREAK, node->type);
+}
+
+void test_error_inside_nested_statements() {
+    source = malloc(DEPTH * 16 + 64);
+
+    char *p = source;
+    p += sprintf(p, "int main() { ");
+    // a line each, the error is reported with its source line
+    p = repeat(p, "while (x) {\n", DEPTH);
+    strcpy(p, "x = ; }");
+
+    parse_source();
+    TEST_ASSERT_TRUE(parser->err == PARSE_ERR_EXPECTED_SEMICOLON);
+    TEST_ASSERT_EQUAL_INT(0, parser->open_body_count);
+}
+
+void test_analyze_scopes_end_with_their_body() {
+    source = malloc(256);
+    strcpy(source,
+        "int main() { int x = 0; "
+        "if (x) { int t = 1; x = t; } else { int t = 2; x = t; } "
+        "while (x) { int t = 3; } "
+        "x = t; }");
+
+    parse_source();
+    TEST_ASSERT_TRUE(parser->err == NO_PARSER_ERROR);
+
+    // t is declared once in each body and not after them
+    Analyzer *analyzer = init_analyzer(parser->nodes, parser->tree, parser->node_count);
+    analyze_ast(analyzer);
+
+    TEST_ASSERT_TRUE(analyzer->err == ANALYZE_ERR_UNDEFINED_IDENTIFIER);
+    TEST_ASSERT_EQUAL_INT(0, analyzer->variable_symbols->count);
+
+    free_analyzer(analyzer);
+}
+
+void test_analyze_long_function() {
+    source = malloc(DEPTH * 16 + 64);
+
+    char *p = source;
+    p += sprintf(p, "int main() { int x = 0; int y = 1; ");
+    p = repeat(p, "x = y; ", DEPTH);
+    strcpy(p, "}");
+
+    parse_source();
+    TEST_ASSERT_TRUE(parser->err == NO_PARSER_ERROR);
+
+    Analyzer *analyzer = init_analyzer(parser->nodes, parser->tree, parser->node_count);
+    analyze_ast(analyzer);
+
+    TEST_ASSERT_TRUE(analyzer->err == NO_ANALYZE_ERR);
+    TEST_ASSERT_EQUAL_INT(0, analyzer->pending_count);
+
+    free_analyzer(analyzer);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_deeply_nested_statements);
+    RUN_TEST(test_deeply_nested_switches);
+    RUN_TEST(test_error_inside_nested_statements);
+    RUN_TEST(test_analyze_scopes_end_with_their_body);
+    RUN_TEST(test_analyze_long_function);
+
+    return UNITY_END();
+}
@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "unity.h"
+#include "intern.h"
+
+void setUp() {}
+void tearDown() {
+    free_interner();
+}
+
+void test_same_spelling_same_id() {
+    SymbolId a = intern_str("counter");
+    SymbolId b = intern_str("counter");
+    SymbolId c = intern_str("count");
+
+    TEST_ASSERT_TRUE(a != NO_SYMBOL);
+    TEST_ASSERT_EQUAL_UINT32(a, b);
+    TEST_ASSERT_TRUE(a != c);
+    TEST_ASSERT_EQUAL_INT(2, symbol_count());
+}
+
+void test_intern_slice_of_source() {
+    const char *source = "int value = other;";
+
+    SymbolId value = intern(source + 4, 5);
+    SymbolId other = intern(source + 12, 5);
+
+    TEST_ASSERT_EQUAL_STRING("value", symbol_str(value));
+    TEST_ASSERT_EQUAL_STRING("other", symbol_str(other));
+    TEST_ASSERT_EQUAL_INT(5, symbol_length(value));
+    TEST_ASSERT_EQUAL_UINT32(value, intern_str("value"));
+}
+
+void test_many_symbols_keep_their_strings() {
+    char name[32];
+    SymbolId ids[20000];
+    const char *first = NULL;
+
+    for (int i = 0; i < 20000; i++) {
+        snprintf(name, sizeof(name), "name_%d", i);
+        ids[i] = intern_str(name);
+        if (i == 0) first = symbol_str(ids[i]);
+    }
+
+    // growing the table does not move strings handed out earlier
+    TEST_ASSERT_EQUAL_PTR(first, symbol_str(ids[0]));
+
+    for (int i = 0; i < 20000; i++) {
+        snprintf(name, sizeof(name), "name_%d", i);
+        TEST_ASSERT_EQUAL_UINT32(ids[i], intern_str(name));
+        TEST_ASSERT_EQUAL_STRING(name, symbol_str(ids[i]));
+    }
+
+    TEST_ASSERT_EQUAL_INT(20000, symbol_count());
+}
+
+void test_long_symbol() {
+    int length = 100000;
+    char *name = malloc(length + 1);
+    memset(name, 'x', length);
+    name[length] = '\0';
+
+    SymbolId id = intern_str(name);
+    SymbolId small = intern_str("y");
+
+    TEST_ASSERT_EQUAL_STRING(name, symbol_str(id));
+    TEST_ASSERT_EQUAL_STRING("y", symbol_str(small));
+
+    free(name);
+}
+
+void test_symbol_map() {
+    SymbolMap map = {0};
+
+    SymbolId a = intern_str("a");
+    SymbolId b = intern_str("b");
+
+    TEST_ASSERT_EQUAL_INT(-1, symbol_map_get(&map, a));
+
+    symbol_map_put(&map, a, 0);
+    symbol_map_put(&map, b, 7);
+
+    TEST_ASSERT_EQUAL_INT(0, symbol_map_get(&map, a));
+    TEST_ASSERT_EQUAL_INT(7, symbol_map_get(&map, b));
+    TEST_ASSERT_EQUAL_INT(-1, symbol_map_get(&map, intern_str("c")));
+
+    symbol_map_clear(&map);
+    TEST_ASSERT_EQUAL_INT(-1, symbol_map_get(&map, a));
+
+    free_symbol_map(&map);
+}
+
+void test_lookup_does_not_intern() {
+    SymbolId value = intern_str("value");
+
+    TEST_ASSERT_EQUAL_UINT32(value, symbol_lookup("value", 5));
+    TEST_ASSERT_EQUAL_UINT32(NO_SYMBOL, symbol_lookup("missing", 7));
+    TEST_ASSERT_EQUAL_INT(1, symbol_count());
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_same_spelling_same_id);
+    RUN_TEST(test_intern_slice_of_source);
+    RUN_TEST(test_many_symbols_keep_their_strings);
+    RUN_TEST(test_long_symbol);
+    RUN_TEST(test_symbol_map);
+    RUN_TEST(test_lookup_does_not_intern);
+
+    return UNITY_END();
+}
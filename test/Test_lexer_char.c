@@ -12,7 +12,7 @@ void test_declare_char() {
     tokenize(lexer);
 
     TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
-    TEST_ASSERT_TRUE(lexer->token_count == 4);
+    TEST_ASSERT_TRUE(lexer->tokens.count == 4);
 
     ASSERT_TOKEN(0, TOKEN_CHAR, "char");
     ASSERT_TOKEN(1, TOKEN_IDENTIFIER, "x");
@@ -27,7 +27,7 @@ void test_declare_char_with_initialization() {
     tokenize(lexer);
 
     TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
-    TEST_ASSERT_TRUE(lexer->token_count == 6);
+    TEST_ASSERT_TRUE(lexer->tokens.count == 6);
 
     ASSERT_TOKEN(0, TOKEN_CHAR, "char");
     ASSERT_TOKEN(1, TOKEN_IDENTIFIER, "x");
@@ -44,7 +44,7 @@ void test_declare_escape_char() {
     tokenize(lexer);
 
     TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
-    TEST_ASSERT_TRUE(lexer->token_count == 6);
+    TEST_ASSERT_TRUE(lexer->tokens.count == 6);
 
     ASSERT_TOKEN(0, TOKEN_CHAR, "char");
     ASSERT_TOKEN(1, TOKEN_IDENTIFIER, "x");
@@ -70,7 +70,7 @@ void test_declare_empty_char_pointer() {
     tokenize(lexer);
 
     TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
-    TEST_ASSERT_TRUE(lexer->token_count == 7);
+    TEST_ASSERT_TRUE(lexer->tokens.count == 7);
 
     ASSERT_TOKEN(0, TOKEN_CHAR, "char");
     ASSERT_TOKEN(1, TOKEN_STAR, "*");
@@ -88,7 +88,7 @@ void test_declare_char_pointer() {
     tokenize(lexer);
 
     TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
-    TEST_ASSERT_TRUE(lexer->token_count == 7);
+    TEST_ASSERT_TRUE(lexer->tokens.count == 7);
 
     ASSERT_TOKEN(0, TOKEN_CHAR, "char");
     ASSERT_TOKEN(1, TOKEN_STAR, "*");
@@ -106,7 +106,7 @@ void test_declare_char_pointer_with_escape_chars() {
     tokenize(lexer);
 
     TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
-    TEST_ASSERT_TRUE(lexer->token_count == 7);
+    TEST_ASSERT_TRUE(lexer->tokens.count == 7);
 
     ASSERT_TOKEN(0, TOKEN_CHAR, "char");
     ASSERT_TOKEN(1, TOKEN_STAR, "*");
@@ -128,6 +128,30 @@ void test_declare_char_pointer_invalid_escape_char() {
     free(lexer);
 }
 
+void test_decoded_escape_literals() {
+    Lexer *lexer = init_lexer("char c = '\\n'; char *x = \"a\\tb\"; char *y = \"ab\";", 0);
+    tokenize(lexer);
+
+    TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
+
+    ASSERT_TOKEN(3, TOKEN_CHAR_LITERAL, "\\n");
+    const DecodedLiteral *c = lexer_decoded_literal(lexer, 3);
+    TEST_ASSERT_NOT_NULL(c);
+    TEST_ASSERT_EQUAL_INT(1, c->length);
+    TEST_ASSERT_EQUAL_INT('\n', c->value[0]);
+
+    ASSERT_TOKEN(9, TOKEN_STRING_LITERAL, "a\\tb");
+    const DecodedLiteral *x = lexer_decoded_literal(lexer, 9);
+    TEST_ASSERT_NOT_NULL(x);
+    TEST_ASSERT_EQUAL_STRING("a\tb", x->value);
+
+    // literals without escapes are read straight from the source
+    ASSERT_TOKEN(15, TOKEN_STRING_LITERAL, "ab");
+    TEST_ASSERT_NULL(lexer_decoded_literal(lexer, 15));
+
+    free_lexer(lexer);
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -139,6 +163,7 @@ int main(void) {
     RUN_TEST(test_declare_char_pointer);
     RUN_TEST(test_declare_char_pointer_with_escape_chars);
     RUN_TEST(test_declare_char_pointer_invalid_escape_char);
+    RUN_TEST(test_decoded_escape_literals);
 
     return UNITY_END();
 }
\ No newline at end of file
@@ -12,7 +12,7 @@ void test_unterminated_string_literal() {
     tokenize(lexer);
 
     TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
-    TEST_ASSERT_TRUE(lexer->token_count == 4);
+    TEST_ASSERT_TRUE(lexer->tokens.count == 4);
 
     ASSERT_TOKEN(0, TOKEN_INT, "int");
     ASSERT_TOKEN(1, TOKEN_IDENTIFIER, "x");
@@ -27,7 +27,7 @@ void test_declare_int_with_initialization() {
     tokenize(lexer);
 
     TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
-    TEST_ASSERT_TRUE(lexer->token_count == 6);
+    TEST_ASSERT_TRUE(lexer->tokens.count == 6);
 
     ASSERT_TOKEN(0, TOKEN_INT, "int");
     ASSERT_TOKEN(1, TOKEN_IDENTIFIER, "x");
@@ -44,7 +44,7 @@ void test_declare_multiple_int() {
     tokenize(lexer);
 
     TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
-    TEST_ASSERT_TRUE(lexer->token_count == 8);
+    TEST_ASSERT_TRUE(lexer->tokens.count == 8);
 
     ASSERT_TOKEN(0, TOKEN_INT, "int");
     ASSERT_TOKEN(1, TOKEN_IDENTIFIER, "x");
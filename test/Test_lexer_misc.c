@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "unity.h"
 #include "lexer.h"
@@ -12,7 +13,7 @@ void test_unterminated_string_literal() {
     tokenize(lexer);
 
     TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
-    TEST_ASSERT_TRUE(lexer->token_count == 4);
+    TEST_ASSERT_TRUE(lexer->tokens.count == 4);
 
     ASSERT_TOKEN(0, TOKEN_INT, "int");
     ASSERT_TOKEN(1, TOKEN_IDENTIFIER, "x");
@@ -22,10 +23,98 @@ void test_unterminated_string_literal() {
     free(lexer);
 }
 
+void test_longest_match_operators() {
+    Lexer *lexer = init_lexer("x<<=1; p->y; f(...); a<<b<c; ..", 0);
+    tokenize(lexer);
+
+    TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
+    TEST_ASSERT_TRUE(lexer->tokens.count == 22);
+
+    ASSERT_TOKEN(0, TOKEN_IDENTIFIER, "x");
+    ASSERT_TOKEN(1, TOKEN_BITWISE_LEFT_SHIFT_EQUALS, "<<=");
+    ASSERT_TOKEN(2, TOKEN_INTEGER_LITERAL, "1");
+    ASSERT_TOKEN(3, TOKEN_SEMICOLON, ";");
+    ASSERT_TOKEN(4, TOKEN_IDENTIFIER, "p");
+    ASSERT_TOKEN(5, TOKEN_ARROW_OP, "->");
+    ASSERT_TOKEN(6, TOKEN_IDENTIFIER, "y");
+    ASSERT_TOKEN(7, TOKEN_SEMICOLON, ";");
+    ASSERT_TOKEN(8, TOKEN_IDENTIFIER, "f");
+    ASSERT_TOKEN(9, TOKEN_LEFT_PAREN, "(");
+    ASSERT_TOKEN(10, TOKEN_ELLIPSIS, "...");
+    ASSERT_TOKEN(11, TOKEN_RIGHT_PAREN, ")");
+    ASSERT_TOKEN(12, TOKEN_SEMICOLON, ";");
+    ASSERT_TOKEN(13, TOKEN_IDENTIFIER, "a");
+    ASSERT_TOKEN(14, TOKEN_BITWISE_LEFT_SHIFT, "<<");
+    ASSERT_TOKEN(15, TOKEN_IDENTIFIER, "b");
+    ASSERT_TOKEN(16, TOKEN_LESS_THAN, "<");
+    ASSERT_TOKEN(17, TOKEN_IDENTIFIER, "c");
+    ASSERT_TOKEN(18, TOKEN_SEMICOLON, ";");
+    ASSERT_TOKEN(19, TOKEN_DOT, ".");
+    ASSERT_TOKEN(20, TOKEN_DOT, ".");
+    ASSERT_TOKEN(21, TOKEN_EOF, "");
+
+    free(lexer);
+}
+
+void test_token_stream_grows_past_estimate() {
+    // one token per byte, well past the capacity estimated from the source length
+    int length = 4096;
+    char *source = malloc(length + 1);
+    memset(source, ';', length);
+    source[length] = '\0';
+
+    Lexer *lexer = init_lexer(source, 0);
+    tokenize(lexer);
+
+    TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
+    TEST_ASSERT_EQUAL_INT(length + 1, lexer->tokens.count);
+    TEST_ASSERT_TRUE(lexer->tokens.capacity >= lexer->tokens.count);
+
+    for (int i = 0; i < length; i++) {
+        ASSERT_TOKEN(i, TOKEN_SEMICOLON, ";");
+    }
+    ASSERT_TOKEN(length, TOKEN_EOF, "");
+
+    free_lexer(lexer);
+    free(source);
+}
+
+void test_line_and_column_of_offset() {
+    Lexer *lexer = init_lexer("int x;\n/* a\nb */\n\n  return x;", 0);
+    tokenize(lexer);
+
+    TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
+    ASSERT_TOKEN(3, TOKEN_RETURN, "return");
+
+    int line, column;
+
+    lexer_position(lexer, lexer->tokens.offsets[0], &line, &column);
+    TEST_ASSERT_EQUAL_INT(1, line);
+    TEST_ASSERT_EQUAL_INT(1, column);
+
+    lexer_position(lexer, lexer->tokens.offsets[2], &line, &column);
+    TEST_ASSERT_EQUAL_INT(1, line);
+    TEST_ASSERT_EQUAL_INT(6, column);
+
+    // newlines inside comments and blank lines still count
+    lexer_position(lexer, lexer->tokens.offsets[3], &line, &column);
+    TEST_ASSERT_EQUAL_INT(5, line);
+    TEST_ASSERT_EQUAL_INT(3, column);
+
+    lexer_position(lexer, lexer->tokens.offsets[4], &line, &column);
+    TEST_ASSERT_EQUAL_INT(5, line);
+    TEST_ASSERT_EQUAL_INT(10, column);
+
+    free_lexer(lexer);
+}
+
 int main(void) {
     UNITY_BEGIN();
 
     RUN_TEST(test_unterminated_string_literal);
+    RUN_TEST(test_longest_match_operators);
+    RUN_TEST(test_token_stream_grows_past_estimate);
+    RUN_TEST(test_line_and_column_of_offset);
 
     return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include "lexer.h"
+
+// large enough to be split into several chunks
+#define CORPUS_BYTES (4 * 1024 * 1024)
+
+// lines that put newlines, quotes and comment markers inside comments, strings
+// and char literals, where a naive split at a newline would go wrong
+static const char *LINES[] = {
+    "int counter = 0x1F + 12; // trailing \"quote\n",
+    "/* a block comment\n   over \"several\" lines // with markers\n   and a ' quote */\n",
+    "char *text = \"a string with // and /* inside\";\n",
+    "char *escaped = \"an escaped \\\" quote and \\\\ backslash\\n\";\n",
+    "char *multi = \"a string\nthat runs onto the next line\";\n",
+    "char quote = '\"'; char tick = '\\''; char slash = '/';\n",
+    "    if (a <= b && c != d) { x += y << 2; }\n",
+    "\n",
+};
+
+static const int LINE_COUNT = sizeof(LINES) / sizeof(LINES[0]);
+
+static char *make_corpus(size_t size) {
+    char *corpus = malloc(size + 1);
+    unsigned int seed = 777;
+
+    size_t written = 0;
+    while (1) {
+        seed = seed * 1103515245 + 12345;
+        const char *line = LINES[(seed >> 16) % LINE_COUNT];
+        size_t len = strlen(line);
+
+        if (written + len > size) break;
+
+        memcpy(corpus + written, line, len);
+        written += len;
+    }
+    memset(corpus + written, ' ', size - written);
+    corpus[size] = '\0';
+
+    return corpus;
+}
+
+static void assert_same_tokens(Lexer *serial, Lexer *parallel) {
+    TEST_ASSERT_EQUAL_INT(serial->err, parallel->err);
+    TEST_ASSERT_EQUAL_INT(serial->tokens.count, parallel->tokens.count);
+
+    int count = serial->tokens.count;
+    TEST_ASSERT_EQUAL_MEMORY(serial->tokens.types, parallel->tokens.types, count);
+    TEST_ASSERT_EQUAL_MEMORY(serial->tokens.offsets, parallel->tokens.offsets, sizeof(int) * count);
+    TEST_ASSERT_EQUAL_MEMORY(serial->tokens.lengths, parallel->tokens.lengths, sizeof(int) * count);
+    TEST_ASSERT_EQUAL_MEMORY(serial->tokens.has_whitespace_after, parallel->tokens.has_whitespace_after, count);
+
+    TEST_ASSERT_EQUAL_INT(serial->literal_count, parallel->literal_count);
+    for (int i = 0; i < serial->literal_count; i++) {
+        TEST_ASSERT_EQUAL_INT(serial->literals[i].token, parallel->literals[i].token);
+        TEST_ASSERT_EQUAL_INT(serial->literals[i].length, parallel->literals[i].length);
+        TEST_ASSERT_EQUAL_MEMORY(serial->literals[i].value, parallel->literals[i].value, serial->literals[i].length);
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_parallel_matches_serial() {
+    char *corpus = make_corpus(CORPUS_BYTES);
+
+    Lexer *serial = init_lexer(corpus, 0);
+    tokenize(serial);
+    TEST_ASSERT_TRUE(serial->err == NO_LEXER_ERROR);
+
+    int thread_counts[] = { 1, 2, 3, 4, 8, 16 };
+    for (int i = 0; i < 6; i++) {
+        Lexer *parallel = init_lexer(corpus, 0);
+        tokenize_parallel(parallel, thread_counts[i]);
+
+        assert_same_tokens(serial, parallel);
+        free_lexer(parallel);
+    }
+
+    free_lexer(serial);
+    free(corpus);
+}
+
+void test_chunks_start_between_tokens() {
+    char *corpus = make_corpus(CORPUS_BYTES);
+
+    int bounds[LEXER_MAX_THREADS + 1];
+    int count = lexer_chunk_bounds(corpus, CORPUS_BYTES, 16, bounds);
+
+    TEST_ASSERT_EQUAL_INT(16, count);
+    TEST_ASSERT_EQUAL_INT(0, bounds[0]);
+    TEST_ASSERT_EQUAL_INT(CORPUS_BYTES, bounds[count]);
+
+    for (int i = 1; i < count; i++) {
+        TEST_ASSERT_TRUE(bounds[i] > bounds[i - 1]);
+        TEST_ASSERT_EQUAL_CHAR('\n', corpus[bounds[i] - 1]);
+    }
+
+    free(corpus);
+}
+
+void test_parallel_error_matches_serial() {
+    char *corpus = make_corpus(CORPUS_BYTES);
+
+    // an unterminated string in the last chunk
+    corpus[CORPUS_BYTES - 2] = '"';
+
+    Lexer *serial = init_lexer(corpus, 0);
+    tokenize(serial);
+
+    Lexer *parallel = init_lexer(corpus, 0);
+    tokenize_parallel(parallel, 4);
+
+    TEST_ASSERT_TRUE(serial->err == UNTERMINATED_STRING_LITERAL);
+    assert_same_tokens(serial, parallel);
+
+    free_lexer(serial);
+    free_lexer(parallel);
+    free(corpus);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parallel_matches_serial);
+    RUN_TEST(test_chunks_start_between_tokens);
+    RUN_TEST(test_parallel_error_matches_serial);
+
+    return UNITY_END();
+}
@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "unity.h"
+#include "lexer.h"
+
+// the largest input lexed by the scaling test, pass -DSCALE_MAX_BYTES=104857600
+// to run the full 1 KB to 100 MB range
+#ifndef SCALE_MAX_BYTES
+#define SCALE_MAX_BYTES (16 * 1024 * 1024)
+#endif
+
+// inputs smaller than this are lexed repeatedly so the timings are not just noise
+#define SCALE_MIN_WORK (4 * 1024 * 1024)
+
+// the reference size the per-byte cost of every other size is compared against
+#define SCALE_REF_BYTES (1024 * 1024)
+
+// how much slower per byte the largest input may be than the reference, a
+// quadratic lexer is hundreds of times slower at 16 MB than at 1 MB
+#define SCALE_MAX_RATIO 4.0
+
+static const char *LINE = "static int counter_value = 0x1F + 12; /* comment */ // trailing\n";
+
+void setUp() {}
+void tearDown() {}
+
+static char *make_source(size_t size) {
+    char *source = malloc(size + 1);
+    size_t line_len = strlen(LINE);
+
+    size_t written = 0;
+    while (written + line_len <= size) {
+        memcpy(source + written, LINE, line_len);
+        written += line_len;
+    }
+    memset(source + written, ' ', size - written);
+    source[size] = '\0';
+
+    return source;
+}
+
+// returns the seconds spent in tokenize per byte of input
+static double lex_seconds_per_byte(size_t size) {
+    char *source = make_source(size);
+
+    int reps = size >= SCALE_MIN_WORK ? 1 : (int)(SCALE_MIN_WORK / size);
+    double total = 0;
+
+    for (int i = 0; i < reps; i++) {
+        Lexer *lexer = init_lexer(source, 0);
+
+        clock_t start = clock();
+        tokenize(lexer);
+        total += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
+        free_lexer(lexer);
+    }
+
+    free(source);
+    return total / ((double)size * reps);
+}
+
+void test_lexing_time_is_linear() {
+    double ref = lex_seconds_per_byte(SCALE_REF_BYTES);
+    double worst = 0;
+
+    for (size_t size = 1024; ; size *= 4) {
+        if (size > SCALE_MAX_BYTES) size = SCALE_MAX_BYTES;
+
+        double per_byte = lex_seconds_per_byte(size);
+        printf("%10zu bytes: %8.2f ns/byte\n", size, per_byte * 1e9);
+
+        if (size >= SCALE_REF_BYTES && per_byte / ref > worst) {
+            worst = per_byte / ref;
+        }
+
+        if (size == SCALE_MAX_BYTES) break;
+    }
+
+    TEST_ASSERT_TRUE(worst < SCALE_MAX_RATIO);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_lexing_time_is_linear);
+
+    return UNITY_END();
+}
@@ -0,0 +1,859 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "unity.h"
+#include "ppd.h"
+#include "strbuf.h"
+#include "intern.h"
+#include "macro.h"
+#include "incpath.h"
+#include "source.h"
+#include "pch.h"
+#include "lexer.h"
+#include "ast.h"
+
+void setUp() {}
+void tearDown() {
+    remove("build/test_ppd_a.h");
+    remove("build/test_ppd_b.h");
+    remove("build/test_ppd_self.h");
+    remove("build/test_ppd_a.h.pch");
+    remove("build/test_ppd.d");
+    remove("build/test_ppd_sys/test_ppd_a.h");
+    remove("build/test_ppd_sys");
+    free_include_paths();
+    free_source_cache();
+    free_interner();
+}
+
+static void write_file(const char *path, const char *content) {
+    FILE *fptr = fopen(path, "wb");
+    fwrite(content, 1, strlen(content), fptr);
+    fclose(fptr);
+}
+
+void test_strbuf_grows() {
+    StrBuf buf;
+    init_strbuf(&buf, 0);
+
+    for (int i = 0; i < 10000; i++) {
+        strbuf_append(&buf, "abc", 3);
+        strbuf_push(&buf, ';');
+    }
+
+    TEST_ASSERT_EQUAL_INT(40000, buf.length);
+    TEST_ASSERT_EQUAL_STRING_LEN("abc;abc;", buf.data, 8);
+    TEST_ASSERT_EQUAL_INT(40000, strlen(buf.data));
+
+    char *text = strbuf_take(&buf);
+    TEST_ASSERT_NULL(buf.data);
+    TEST_ASSERT_EQUAL_INT(0, buf.length);
+
+    free(text);
+}
+
+void test_expansion_larger_than_twice_the_source() {
+    const char *define = "#define X aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\n";
+    int uses = 100000;
+
+    StrBuf source;
+    init_strbuf(&source, 0);
+    strbuf_append(&source, define, strlen(define));
+    for (int i = 0; i < uses; i++) {
+        strbuf_append(&source, "X ", 2);
+    }
+
+    int length;
+    const char *processed = preprocess(source.data, source.length, &length);
+
+    // the directive line leaves its newline behind
+    TEST_ASSERT_EQUAL_INT(1 + uses * 51, length);
+    TEST_ASSERT_EQUAL_INT(length, strlen(processed));
+    TEST_ASSERT_EQUAL_STRING_LEN("\naaaaa", processed, 6);
+
+    free((char *)processed);
+    free_strbuf(&source);
+}
+
+void test_macro_table_define_undef_lookup() {
+    MacroTable table = {0};
+    char name[32];
+
+    for (int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "MACRO_%d", i);
+        define_macro(&table, intern_str(name), name, strlen(name));
+    }
+    TEST_ASSERT_EQUAL_INT(5000, table.count);
+
+    // removes every other one, the rest must still be reachable
+    for (int i = 0; i < 5000; i += 2) {
+        snprintf(name, sizeof(name), "MACRO_%d", i);
+        undef_macro(&table, intern_str(name));
+    }
+    TEST_ASSERT_EQUAL_INT(2500, table.count);
+
+    for (int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "MACRO_%d", i);
+        Macro *macro = find_macro(&table, intern_str(name));
+
+        if (i % 2 == 0) {
+            TEST_ASSERT_NULL(macro);
+        } else {
+            TEST_ASSERT_NOT_NULL(macro);
+            TEST_ASSERT_EQUAL_STRING(name, macro->value);
+        }
+    }
+
+    free_macro_table(&table);
+}
+
+void test_redefine_replaces_value() {
+    MacroTable table = {0};
+    SymbolId name = intern_str("SIZE");
+
+    define_macro(&table, name, "10", 2);
+    define_macro(&table, name, "200", 3);
+
+    TEST_ASSERT_EQUAL_INT(1, table.count);
+    TEST_ASSERT_EQUAL_STRING("200", find_macro(&table, name)->value);
+    TEST_ASSERT_EQUAL_INT(3, find_macro(&table, name)->length);
+
+    free_macro_table(&table);
+}
+
+void test_undef_removes_macro() {
+    const char *source = "#define A 1\n#define B 2\n#undef A\nA B";
+    int length;
+
+    const char *processed = preprocess(source, strlen(source), &length);
+    TEST_ASSERT_EQUAL_STRING("\n\n\nA 2", processed);
+
+    free((char *)processed);
+}
+
+static char *preprocess_str(const char *source) {
+    int length;
+    return (char *)preprocess(source, strlen(source), &length);
+}
+
+static char *expand_str(MacroTable *table, const char *text) {
+    PPTokenList tokens, expanded;
+    init_token_list(&tokens);
+    init_token_list(&expanded);
+    pp_tokenize(text, strlen(text), &tokens);
+
+    MacroEngine *engine = init_macro_engine(table);
+    expand_macros(engine, tokens.tokens, tokens.count, &expanded);
+
+    StrBuf out;
+    init_strbuf(&out, 64);
+    write_tokens(&expanded, &out);
+
+    free_macro_engine(engine);
+    free_token_list(&tokens);
+    free_token_list(&expanded);
+    return strbuf_take(&out);
+}
+
+void test_function_like_macro() {
+    char *out = preprocess_str("#define SQ(x) ((x) * (x))\nint y = SQ(a + 1);");
+    TEST_ASSERT_EQUAL_STRING("\nint y = ((a + 1) * (a + 1));", out);
+    free(out);
+}
+
+void test_name_without_parens_is_not_invoked() {
+    char *out = preprocess_str("#define F(x) x\nint F = 1; F (2);");
+    TEST_ASSERT_EQUAL_STRING("\nint F = 1; 2;", out);
+    free(out);
+}
+
+void test_stringify_and_paste() {
+    char *out = preprocess_str(
+        "#define str(x) # x\n"
+        "#define xstr(x) str(x)\n"
+        "#define glue(a, b) a ## b\n"
+        "#define N 4\n"
+        "glue(va, lue) str(N) xstr(N) str(\"a\\n\" 'b') glue(N,) glue(, N)");
+
+    // pasting onto an empty argument leaves a name that is rescanned
+    TEST_ASSERT_EQUAL_STRING("\n\n\n\nvalue \"N\" \"4\" \"\\\"a\\\\n\\\" 'b'\" 4 4", out);
+    free(out);
+}
+
+void test_variadic_macro() {
+    char *out = preprocess_str(
+        "#define LOG(fmt, ...) printf(fmt, ## __VA_ARGS__)\n"
+        "LOG(\"x\"); LOG(\"%d %d\", 1, 2);");
+
+    TEST_ASSERT_EQUAL_STRING("\nprintf(\"x\"); printf(\"%d %d\", 1, 2);", out);
+    free(out);
+}
+
+// the examples from the C standard, 6.10.3.5
+void test_rescanning_and_hide_sets() {
+    char *out = preprocess_str(
+        "#define x 3\n"
+        "#define f(a) f(x * (a))\n"
+        "#undef x\n"
+        "#define x 2\n"
+        "#define g f\n"
+        "#define z z[0]\n"
+        "#define h g(~\n"
+        "#define m(a) a(w)\n"
+        "#define w 0,1\n"
+        "#define t(a) a\n"
+        "#define p() int\n"
+        "#define q(x) x\n"
+        "#define r(x,y) x ## y\n"
+        "f(y+1) + f(f(z)) % t(t(g)(0) + t)(1);\n"
+        "g(x+(3,4)-w) | h 5) & m\n"
+        "(f)^m(m);\n"
+        "p() i[q()] = { q(1), r(2,3), r(4,), r(,5), r(,) };");
+
+    TEST_ASSERT_EQUAL_STRING(
+        "\n\n\n\n\n\n\n\n\n\n\n\n\n"
+        "f(2 * (y+1)) + f(2 * (f(2 * (z[0])))) % f(2 * (0)) + t(1);\n"
+        "f(2 * (2+(3,4)-0,1)) | f(2 * (~ 5)) & f(2 * (0,1))\n"
+        "^m(0,1);\n"
+        "int i[] = { 1, 23, 4, 5, };", out);
+    free(out);
+}
+
+void test_self_reference_is_not_expanded() {
+    char *out = preprocess_str("#define foo foo\n#define A B\n#define B A\nfoo A B");
+    TEST_ASSERT_EQUAL_STRING("\n\n\nfoo A B", out);
+    free(out);
+}
+
+void test_invocation_lines_are_kept() {
+    char *out = preprocess_str("#define ADD(a, b) a + b\nint x = ADD(1,\n  2);\nint y;");
+    TEST_ASSERT_EQUAL_STRING("\nint x = 1 + 2\n;\nint y;", out);
+    free(out);
+}
+
+void test_cached_expansion_follows_redefinition() {
+    MacroTable table = {0};
+    SymbolId x = intern_str("x");
+    SymbolId n = intern_str("N");
+
+    define_function_macro(&table, intern_str("F"), &x, 1, 0, "x + N", 5);
+    define_macro(&table, n, "1", 1);
+
+    char *first = expand_str(&table, "F(a) F(a) F(b)");
+    TEST_ASSERT_EQUAL_STRING("a + 1 a + 1 b + 1", first);
+
+    define_macro(&table, n, "2", 1);
+    char *second = expand_str(&table, "F(a) F(a)");
+    TEST_ASSERT_EQUAL_STRING("a + 2 a + 2", second);
+
+    free(first);
+    free(second);
+    free_macro_table(&table);
+}
+
+void test_nested_includes_are_read_in_order() {
+    write_file("build/test_ppd_a.h", "int a;\n#include \"test_ppd_b.h\"\nint a2 = B;\n");
+    write_file("build/test_ppd_b.h", "#define B 2\nint b;\n");
+
+    char *out = preprocess_str("int before;\n#include \"build/test_ppd_a.h\"\nint after = B;");
+    TEST_ASSERT_EQUAL_STRING("int before;\nint a;\n\nint b;\n\nint a2 = 2;\n\nint after = 2;", out);
+    free(out);
+}
+
+void test_missing_include_is_skipped() {
+    char *out = preprocess_str("#include \"build/does_not_exist.h\"\nint x;");
+    TEST_ASSERT_EQUAL_STRING("\nint x;", out);
+    free(out);
+}
+
+void test_diagnostics_set_the_error_flag() {
+    const char *sources[] = {
+        "#include \"build/does_not_exist.h\"\n",
+        "#if 1 +\n#endif\n",
+        "#endif\n",
+        "#define F(a) a\nF(1, 2)\n",
+    };
+
+    for (int i = 0; i < 4; i++) {
+        PreProcessor *ppd = init_file_preprocessor("build/main.c", sources[i], strlen(sources[i]));
+        run_preprocessor(ppd);
+        TEST_ASSERT_TRUE(ppd->err);
+        free_preprocessor(ppd);
+    }
+
+    const char *source = "#define A 1\n#if A\nint a = A;\n#endif\n";
+    PreProcessor *ppd = init_file_preprocessor("build/main.c", source, strlen(source));
+    run_preprocessor(ppd);
+    TEST_ASSERT_FALSE(ppd->err);
+    free_preprocessor(ppd);
+}
+
+void test_include_depth_is_limited() {
+    write_file("build/test_ppd_self.h", "x\n#include \"test_ppd_self.h\"\n");
+
+    char *out = preprocess_str("#include \"build/test_ppd_self.h\"\n");
+
+    // the top level source counts as the first level
+    int count = 0;
+    for (char *c = out; *c; c++) count += *c == 'x';
+    TEST_ASSERT_EQUAL_INT(PPD_MAX_INCLUDE_DEPTH - 1, count);
+
+    free(out);
+}
+
+static int count_of(const char *text, const char *word) {
+    int count = 0;
+    for (const char *at = strstr(text, word); at; at = strstr(at + 1, word)) count++;
+    return count;
+}
+
+void test_expansions_between_redefinitions() {
+    StrBuf source;
+    init_strbuf(&source, 0);
+    strbuf_append(&source, "#define F(x) x + N\n", 19);
+
+    // a define between every run of expansions, each run is cached afresh
+    char line[64];
+    for (int i = 0; i < 200; i++) {
+        int length = snprintf(line, sizeof(line), "#define N %d\n", i);
+        strbuf_append(&source, line, length);
+
+        for (int k = 0; k < 30; k++) {
+            length = snprintf(line, sizeof(line), "F(%d)\n", k);
+            strbuf_append(&source, line, length);
+        }
+    }
+    strbuf_push(&source, '\0');
+
+    char *out = preprocess_str(source.data);
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "\n0 + 0\n"));
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "\n29 + 199\n"));
+    TEST_ASSERT_EQUAL_INT(200, count_of(out, "\n7 + "));
+    TEST_ASSERT_EQUAL_INT(30, count_of(out, " + 123\n"));
+
+    free(out);
+    free_strbuf(&source);
+}
+
+void test_guarded_header_is_read_once() {
+    write_file("build/test_ppd_a.h",
+        "// banner\n#ifndef A_H\n#define A_H\n#ifdef X\n#endif\nint guarded;\n#endif /* A_H */\n\n");
+
+    char *out = preprocess_str(
+        "#include \"build/test_ppd_a.h\"\n"
+        "#include \"build/test_ppd_a.h\"\n"
+        "#include \"build/./test_ppd_a.h\"\n");
+
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "guarded"));
+    free(out);
+}
+
+void test_guard_is_only_honoured_while_defined() {
+    write_file("build/test_ppd_a.h", "#if !defined(A_H)\n#define A_H\nint guarded;\n#endif\n");
+
+    char *out = preprocess_str(
+        "#include \"build/test_ppd_a.h\"\n"
+        "#undef A_H\n"
+        "#include \"build/test_ppd_a.h\"\n");
+
+    TEST_ASSERT_EQUAL_INT(2, count_of(out, "guarded"));
+    free(out);
+}
+
+void test_text_outside_guard_is_not_a_guard() {
+    write_file("build/test_ppd_a.h", "#ifndef A_H\n#define A_H\n#endif\nint unguarded;\n");
+
+    char *out = preprocess_str("#include \"build/test_ppd_a.h\"\n#include \"build/test_ppd_a.h\"\n");
+
+    TEST_ASSERT_EQUAL_INT(2, count_of(out, "unguarded"));
+    free(out);
+}
+
+void test_pragma_once() {
+    write_file("build/test_ppd_b.h", "#pragma once\nint once;\n");
+
+    char *out = preprocess_str("#include \"build/test_ppd_b.h\"\n#include \"build/test_ppd_b.h\"\n");
+
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "once"));
+    free(out);
+}
+
+void test_ifdef_else_nesting() {
+    char *out = preprocess_str(
+        "#define A\n"
+        "#ifdef A\n"
+        "#ifndef B\n"
+        "int a;\n"
+        "#else\n"
+        "int b;\n"
+        "#endif\n"
+        "#else\n"
+        "int c;\n"
+        "#endif\n"
+        "int d;");
+
+    TEST_ASSERT_EQUAL_STRING("\n\n\nint a;\n\n\n\n\n\n\nint d;", out);
+    free(out);
+}
+
+void test_if_elif_chain() {
+    char *out = preprocess_str(
+        "#define V 2\n"
+        "#if V == 1\none\n"
+        "#elif V == 2\ntwo\n"
+        "#elif V == 2\nagain\n"
+        "#else\nother\n"
+        "#endif\n");
+
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "two"));
+    TEST_ASSERT_EQUAL_INT(0, count_of(out, "one"));
+    TEST_ASSERT_EQUAL_INT(0, count_of(out, "again"));
+    TEST_ASSERT_EQUAL_INT(0, count_of(out, "other"));
+    free(out);
+}
+
+void test_if_expressions() {
+    char *out = preprocess_str(
+        "#define TWICE(x) ((x) * 2)\n"
+        "#define ON 1\n"
+        "#if defined(ON) && defined ON && !defined OFF\nyes1\n#endif\n"
+        "#if TWICE(3) == 6 && (1 << 4) == 16 && -1 < 0 && ~0 == -1\nyes2\n#endif\n"
+        "#if 10 % 4 == 2 && 0x10 == 16 && 010 == 8 && 'A' == 65\nyes3\n#endif\n"
+        "#if UNDEFINED_NAME || (ON ? 0 : 1)\nno1\n#endif\n"
+        "#if 0 && 1 / 0\nno2\n#elif 1 || 1 / 0\nyes4\n#endif\n"
+        "#if (2, 3) == 3 && 1 ? 2 : 3\nyes5\n#endif\n");
+
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "yes1"));
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "yes2"));
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "yes3"));
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "yes4"));
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "yes5"));
+    TEST_ASSERT_EQUAL_INT(0, count_of(out, "no1"));
+    TEST_ASSERT_EQUAL_INT(0, count_of(out, "no2"));
+    free(out);
+}
+
+void test_inactive_region_is_not_tokenized() {
+    // nothing in a skipped region is looked at, so unterminated quotes and
+    // other directives do no harm
+    char *out = preprocess_str(
+        "#if 0\n"
+        "it's \"not closed\n"
+        "#define X 1\n"
+        "  #if 1\n"
+        "#include \"build/does_not_exist.h\"\n"
+        "  #endif\n"
+        "a # b\n"
+        "#endif\n"
+        "X");
+
+    TEST_ASSERT_EQUAL_STRING("\n\n\n\n\n\n\n\nX", out);
+    free(out);
+}
+
+void test_conditional_in_header_must_end_there() {
+    write_file("build/test_ppd_a.h", "#if 1\nint a;\n");
+
+    char *out = preprocess_str("#include \"build/test_ppd_a.h\"\nint b;\n#endif\nint c;");
+
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "int a"));
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "int b"));
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "int c"));
+    free(out);
+}
+
+void test_angle_include_searches_dirs_in_order() {
+    mkdir("build/test_ppd_sys", 0700);
+    write_file("build/test_ppd_sys/test_ppd_a.h", "int sys;\n");
+    write_file("build/test_ppd_b.h", "int user;\n");
+    write_file("build/test_ppd_sys/test_ppd_b.h", "int sys_b;\n");
+
+    // -I directories come before -isystem ones whatever order they were given in
+    add_include_dir("build/test_ppd_sys/", 1);
+    add_include_dir("build", 0);
+
+    char *out = preprocess_str("#include <test_ppd_a.h>\n#include <test_ppd_b.h>\n#include <test_ppd_none.h>\n");
+
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "int sys;"));
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "int user;"));
+    TEST_ASSERT_EQUAL_INT(0, count_of(out, "sys_b"));
+    free(out);
+
+    remove("build/test_ppd_sys/test_ppd_b.h");
+}
+
+void test_header_lookups_are_cached() {
+    write_file("build/test_ppd_a.h", "int a;\n");
+    SymbolId dir = intern_str("build");
+
+    TEST_ASSERT_EQUAL_STRING("build/test_ppd_a.h", find_header("test_ppd_a.h", dir, 1));
+    TEST_ASSERT_NULL(find_header("test_ppd_b.h", dir, 1));
+
+    // neither directory is probed again, so changes to the files go unseen
+    remove("build/test_ppd_a.h");
+    write_file("build/test_ppd_b.h", "int b;\n");
+
+    TEST_ASSERT_EQUAL_STRING("build/test_ppd_a.h", find_header("test_ppd_a.h", dir, 1));
+    TEST_ASSERT_NULL(find_header("test_ppd_b.h", dir, 1));
+
+    // an angled name does not look next to the including file
+    TEST_ASSERT_NULL(find_header("test_ppd_a.h", dir, 0));
+}
+
+void test_precompiled_header_matches_source() {
+    write_file("build/test_ppd_a.h", "#define TWICE(x) ((x) * 2)\n#include \"test_ppd_b.h\"\nint a = TWICE(B);\n");
+    write_file("build/test_ppd_b.h", "#define B 3\nint b;\n");
+    const char *source = "#include \"build/test_ppd_a.h\"\nint c = TWICE(B);";
+
+    char *plain = preprocess_str(source);
+    TEST_ASSERT_TRUE(write_pch("build/test_ppd_a.h", "build/test_ppd_a.h.pch"));
+
+    PreProcessor *ppd = init_preprocessor("", 0);
+    TEST_ASSERT_TRUE(load_pch(ppd, "build/test_ppd_a.h.pch"));
+    TEST_ASSERT_NOT_NULL(find_macro(&ppd->macros, intern_str("TWICE")));
+    TEST_ASSERT_NOT_NULL(find_macro(&ppd->macros, intern_str("B")));
+    free_preprocessor(ppd);
+
+    char *loaded = preprocess_str(source);
+    TEST_ASSERT_EQUAL_STRING(plain, loaded);
+
+    free(plain);
+    free(loaded);
+}
+
+void test_stale_precompiled_header_is_not_used() {
+    write_file("build/test_ppd_a.h", "#include \"test_ppd_b.h\"\nint a = B;\n");
+    write_file("build/test_ppd_b.h", "#define B 3\n");
+    TEST_ASSERT_TRUE(write_pch("build/test_ppd_a.h", "build/test_ppd_a.h.pch"));
+
+    // a header it included changed
+    write_file("build/test_ppd_b.h", "#define B 42\n");
+
+    PreProcessor *ppd = init_preprocessor("", 0);
+    TEST_ASSERT_FALSE(load_pch(ppd, "build/test_ppd_a.h.pch"));
+    TEST_ASSERT_EQUAL_INT(0, ppd->macros.count);
+    free_preprocessor(ppd);
+
+    char *out = preprocess_str("#include \"build/test_ppd_a.h\"\n");
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "int a = 42;"));
+    free(out);
+
+    // nor is a file that is not one
+    write_file("build/test_ppd_a.h.pch", "CAMCPCH3 cut short");
+    ppd = init_preprocessor("", 0);
+    TEST_ASSERT_FALSE(load_pch(ppd, "build/test_ppd_a.h.pch"));
+    free_preprocessor(ppd);
+}
+
+void test_precompiled_header_keeps_once_and_guards() {
+    write_file("build/test_ppd_a.h", "#pragma once\n#include \"test_ppd_b.h\"\nint helper();\n");
+    write_file("build/test_ppd_b.h", "#ifndef B\n#define B\nint b;\n#endif\n");
+    const char *source =
+        "#include \"build/test_ppd_a.h\"\n"
+        "#include \"build/test_ppd_a.h\"\n"
+        "#include \"build/test_ppd_b.h\"\n";
+
+    char *plain = preprocess_str(source);
+    TEST_ASSERT_TRUE(write_pch("build/test_ppd_a.h", "build/test_ppd_a.h.pch"));
+    char *loaded = preprocess_str(source);
+
+    TEST_ASSERT_EQUAL_INT(1, count_of(loaded, "int helper();"));
+    TEST_ASSERT_EQUAL_INT(1, count_of(loaded, "int b;"));
+    TEST_ASSERT_EQUAL_STRING(plain, loaded);
+
+    // the guard is known without reading the file again
+    PreProcessor *ppd = init_preprocessor("", 0);
+    TEST_ASSERT_TRUE(load_pch(ppd, "build/test_ppd_a.h.pch"));
+    int include = find_include(ppd, "build/test_ppd_b.h");
+    TEST_ASSERT_EQUAL_INT(intern_str("B"), ppd->includes[include].guard);
+    TEST_ASSERT_TRUE(ppd->includes[find_include(ppd, "build/test_ppd_a.h")].once);
+    free_preprocessor(ppd);
+
+    free(plain);
+    free(loaded);
+}
+
+void test_precompiled_header_keeps_declarations() {
+    write_file("build/test_ppd_a.h",
+        "#ifndef A\n#define A\n"
+        "struct point { int x; int y; };\n"
+        "typedef int size;\n"
+        "int add(int a, int b);\n"
+        "int total;\n"
+        "#endif\n");
+    TEST_ASSERT_TRUE(write_pch("build/test_ppd_a.h", "build/test_ppd_a.h.pch"));
+
+    const char *source = "#include \"test_ppd_a.h\"\nint add(int a, int b) { return a + b; }\n";
+    PreProcessor *ppd = init_file_preprocessor("build/main.c", source, strlen(source));
+    ppd->take_declarations = 1;
+    run_preprocessor(ppd);
+
+    // the declarations are handed over in place of the text
+    TEST_ASSERT_NOT_NULL(ppd->declarations);
+    int length = ppd->output.length;
+    char *out = strbuf_take(&ppd->output);
+    TEST_ASSERT_EQUAL_INT(0, count_of(out, "struct point"));
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "return a + b;"));
+
+    Lexer *lexer = init_lexer_len(out, length, 0);
+    tokenize(lexer);
+    Parser *parser = init_parser(lexer, 0, "build/main.c");
+    TEST_ASSERT_TRUE(load_pch_declarations(parser, ppd->declarations, ppd->declarations_length));
+    parse_ast(parser);
+    free_preprocessor(ppd);
+
+    TEST_ASSERT_EQUAL_INT(NO_PARSER_ERROR, parser->err);
+    TEST_ASSERT_EQUAL_INT(5, parser->node_count);
+
+    AstNode *node = ast_node(parser, parser->tree[0]);
+    TEST_ASSERT_EQUAL_INT(AST_STRUCT, node->type);
+    TEST_ASSERT_EQUAL_INT(intern_str("point"), node->as.a_struct->name);
+    TEST_ASSERT_EQUAL_INT(2, node->as.a_struct->field_count);
+    AstNode *field = ast_node(parser, node->as.a_struct->fields[1]);
+    TEST_ASSERT_EQUAL_INT(AST_VARIABLE_DECLARATION, field->type);
+    TEST_ASSERT_EQUAL_INT(intern_str("y"), field->as.var_dec->declarators[0]->identifier);
+
+    node = ast_node(parser, parser->tree[1]);
+    TEST_ASSERT_EQUAL_INT(AST_TYPEDEF, node->type);
+    TEST_ASSERT_EQUAL_INT(intern_str("size"), node->as.type_def->identifier);
+
+    node = ast_node(parser, parser->tree[2]);
+    TEST_ASSERT_EQUAL_INT(AST_FUNCTION, node->type);
+    TEST_ASSERT_EQUAL_INT(intern_str("add"), node->as.func->identifier);
+    TEST_ASSERT_EQUAL_INT(2, node->as.func->params_count);
+    TEST_ASSERT_NULL(node->as.func->body);
+
+    node = ast_node(parser, parser->tree[3]);
+    TEST_ASSERT_EQUAL_INT(AST_VARIABLE_DECLARATION, node->type);
+    TEST_ASSERT_EQUAL_INT(intern_str("total"), node->as.var_dec->declarators[0]->identifier);
+
+    // the source is parsed after them
+    node = ast_node(parser, parser->tree[4]);
+    TEST_ASSERT_EQUAL_INT(AST_FUNCTION, node->type);
+    TEST_ASSERT_NOT_NULL(node->as.func->body);
+
+    free_parser(parser);
+    free_lexer(lexer);
+    free(out);
+}
+
+void test_precompiled_header_text_is_kept_when_needed() {
+    // code is not kept as declarations
+    write_file("build/test_ppd_a.h", "int one() { return 1; }\n");
+    TEST_ASSERT_TRUE(write_pch("build/test_ppd_a.h", "build/test_ppd_a.h.pch"));
+
+    const char *source = "#include \"test_ppd_a.h\"\n";
+    PreProcessor *ppd = init_file_preprocessor("build/main.c", source, strlen(source));
+    ppd->take_declarations = 1;
+    run_preprocessor(ppd);
+    TEST_ASSERT_NULL(ppd->declarations);
+    char *out = strbuf_take(&ppd->output);
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "return 1;"));
+    free_preprocessor(ppd);
+    free(out);
+
+    // nor is a header the parser cannot read
+    write_file("build/test_ppd_a.h", "typedef unsigned long u64;\nint f(u64 a);\n");
+    TEST_ASSERT_TRUE(write_pch("build/test_ppd_a.h", "build/test_ppd_a.h.pch"));
+
+    ppd = init_file_preprocessor("build/main.c", source, strlen(source));
+    ppd->take_declarations = 1;
+    run_preprocessor(ppd);
+    TEST_ASSERT_NULL(ppd->declarations);
+    out = strbuf_take(&ppd->output);
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "int f(u64 a);"));
+    free_preprocessor(ppd);
+    free(out);
+
+    // nor are declarations that would not come first
+    write_file("build/test_ppd_a.h", "int one();\n");
+    TEST_ASSERT_TRUE(write_pch("build/test_ppd_a.h", "build/test_ppd_a.h.pch"));
+
+    source = "int zero();\n#include \"test_ppd_a.h\"\n";
+    ppd = init_file_preprocessor("build/main.c", source, strlen(source));
+    ppd->take_declarations = 1;
+    run_preprocessor(ppd);
+    TEST_ASSERT_NULL(ppd->declarations);
+    out = strbuf_take(&ppd->output);
+    TEST_ASSERT_EQUAL_INT(1, count_of(out, "int one();"));
+    free_preprocessor(ppd);
+    free(out);
+}
+
+static char *read_stream(FILE *stream) {
+    long size = ftell(stream);
+    rewind(stream);
+
+    char *text = calloc(size + 1, 1);
+    TEST_ASSERT_EQUAL_INT(size, fread(text, 1, size, stream));
+    return text;
+}
+
+void test_streamed_output_has_line_markers() {
+    write_file("build/test_ppd_a.h", "int a;\n#include \"test_ppd_b.h\"\nint a2;");
+    write_file("build/test_ppd_b.h", "int b;\n");
+    const char *source = "#define X 1\n#include \"test_ppd_a.h\"\nint x = X;\n";
+
+    FILE *stream = tmpfile();
+    PreProcessor *ppd = init_file_preprocessor("build/test_ppd_main.c", source, strlen(source));
+    stream_preprocessor(ppd, stream);
+    run_preprocessor(ppd);
+
+    TEST_ASSERT_EQUAL_INT(0, ppd->output.length);
+    free_preprocessor(ppd);
+
+    char *out = read_stream(stream);
+    TEST_ASSERT_EQUAL_STRING(
+        "# 1 \"build/test_ppd_main.c\"\n"
+        "\n"
+        "# 1 \"build/test_ppd_a.h\"\n"
+        "int a;\n"
+        "# 1 \"build/test_ppd_b.h\"\n"
+        "int b;\n"
+        "# 3 \"build/test_ppd_a.h\"\n"
+        "int a2;\n"
+        "# 3 \"build/test_ppd_main.c\"\n"
+        "int x = 1;\n", out);
+
+    free(out);
+    fclose(stream);
+}
+
+void test_streamed_output_is_written_in_chunks() {
+    // expands to far more than one chunk without a directive in between
+    StrBuf source;
+    init_strbuf(&source, 64);
+    const char *define = "#define W wide_identifier_expansion\n";
+    strbuf_append(&source, define, strlen(define));
+    for (int i = 0; i < 20000; i++) strbuf_append(&source, "W W W\n", 6);
+
+    FILE *stream = tmpfile();
+    PreProcessor *ppd = init_file_preprocessor("build/test_ppd_main.c", source.data, source.length);
+    stream_preprocessor(ppd, stream);
+    run_preprocessor(ppd);
+
+    TEST_ASSERT_TRUE(ppd->output.capacity <= 4 * PPD_STREAM_CHUNK);
+    free_preprocessor(ppd);
+
+    char *out = read_stream(stream);
+    TEST_ASSERT_EQUAL_INT(60000, count_of(out, "wide_identifier_expansion"));
+
+    free(out);
+    fclose(stream);
+    free_strbuf(&source);
+}
+
+void test_long_run_is_expanded_a_chunk_at_a_time() {
+    // every invocation spans two lines, so some are cut by the end of a chunk
+    StrBuf source;
+    init_strbuf(&source, 64);
+    const char *define = "#define F(a, b) a + b\n";
+    strbuf_append(&source, define, strlen(define));
+    for (int i = 0; i < 40000; i++) strbuf_append(&source, "F(x,\n y)\n", 9);
+
+    PreProcessor *ppd = init_preprocessor(source.data, source.length);
+    run_preprocessor(ppd);
+
+    TEST_ASSERT_TRUE(ppd->tokens.capacity < 40000);
+    char *out = strbuf_take(&ppd->output);
+    free_preprocessor(ppd);
+
+    TEST_ASSERT_EQUAL_INT(40000, count_of(out, "x + y\n\n"));
+    TEST_ASSERT_EQUAL_INT(1 + 80000, count_of(out, "\n"));
+
+    free(out);
+    free_strbuf(&source);
+}
+
+void test_dependencies_list_precompiled_headers() {
+    write_file("build/test_ppd_a.h", "#include \"test_ppd_b.h\"\nint a;\n");
+    write_file("build/test_ppd_b.h", "int b;\n");
+    TEST_ASSERT_TRUE(write_pch("build/test_ppd_a.h", "build/test_ppd_a.h.pch"));
+
+    // loading it opens every file it was made from
+    PreProcessor *ppd = init_preprocessor("", 0);
+    TEST_ASSERT_TRUE(load_pch(ppd, "build/test_ppd_a.h.pch"));
+    TEST_ASSERT_EQUAL_INT(2, ppd->opened_count);
+    free_preprocessor(ppd);
+
+    const char *source = "#include \"test_ppd_a.h\"\n";
+    ppd = init_file_preprocessor("build/main.c", source, strlen(source));
+    run_preprocessor(ppd);
+    TEST_ASSERT_TRUE(write_dependencies(ppd, "main.o", "build/main.c", "build/test_ppd.d"));
+    free_preprocessor(ppd);
+
+    FILE *fptr = fopen("build/test_ppd.d", "rb");
+    fseek(fptr, 0, SEEK_END);
+    char *rule = read_stream(fptr);
+    fclose(fptr);
+
+    TEST_ASSERT_EQUAL_STRING("main.o: build/main.c \\\n  build/test_ppd_a.h \\\n  build/test_ppd_b.h\n", rule);
+    free(rule);
+}
+
+void test_dependencies_list_opened_headers() {
+    write_file("build/test_ppd_a.h", "#ifndef A\n#define A\n#include \"test_ppd_b.h\"\n#endif\n");
+    write_file("build/test_ppd_b.h", "int b;\n");
+    const char *source = "#include \"test_ppd_a.h\"\n#include \"test_ppd_a.h\"\n#include \"missing.h\"\n";
+
+    PreProcessor *ppd = init_file_preprocessor("build/my main.c", source, strlen(source));
+    run_preprocessor(ppd);
+    TEST_ASSERT_TRUE(write_dependencies(ppd, "my main.o", "build/my main.c", "build/test_ppd.d"));
+    free_preprocessor(ppd);
+
+    FILE *fptr = fopen("build/test_ppd.d", "rb");
+    fseek(fptr, 0, SEEK_END);
+    char *rule = read_stream(fptr);
+    fclose(fptr);
+
+    TEST_ASSERT_EQUAL_STRING("my\\ main.o: build/my\\ main.c \\\n  build/test_ppd_a.h \\\n  build/test_ppd_b.h\n", rule);
+    free(rule);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_strbuf_grows);
+    RUN_TEST(test_expansion_larger_than_twice_the_source);
+    RUN_TEST(test_macro_table_define_undef_lookup);
+    RUN_TEST(test_redefine_replaces_value);
+    RUN_TEST(test_undef_removes_macro);
+    RUN_TEST(test_function_like_macro);
+    RUN_TEST(test_name_without_parens_is_not_invoked);
+    RUN_TEST(test_stringify_and_paste);
+    RUN_TEST(test_variadic_macro);
+    RUN_TEST(test_rescanning_and_hide_sets);
+    RUN_TEST(test_self_reference_is_not_expanded);
+    RUN_TEST(test_invocation_lines_are_kept);
+    RUN_TEST(test_cached_expansion_follows_redefinition);
+    RUN_TEST(test_expansions_between_redefinitions);
+    RUN_TEST(test_nested_includes_are_read_in_order);
+    RUN_TEST(test_missing_include_is_skipped);
+    RUN_TEST(test_diagnostics_set_the_error_flag);
+    RUN_TEST(test_include_depth_is_limited);
+    RUN_TEST(test_guarded_header_is_read_once);
+    RUN_TEST(test_guard_is_only_honoured_while_defined);
+    RUN_TEST(test_text_outside_guard_is_not_a_guard);
+    RUN_TEST(test_pragma_once);
+    RUN_TEST(test_ifdef_else_nesting);
+    RUN_TEST(test_if_elif_chain);
+    RUN_TEST(test_if_expressions);
+    RUN_TEST(test_inactive_region_is_not_tokenized);
+    RUN_TEST(test_conditional_in_header_must_end_there);
+    RUN_TEST(test_angle_include_searches_dirs_in_order);
+    RUN_TEST(test_header_lookups_are_cached);
+    RUN_TEST(test_precompiled_header_matches_source);
+    RUN_TEST(test_stale_precompiled_header_is_not_used);
+    RUN_TEST(test_precompiled_header_keeps_once_and_guards);
+    RUN_TEST(test_precompiled_header_keeps_declarations);
+    RUN_TEST(test_precompiled_header_text_is_kept_when_needed);
+    RUN_TEST(test_streamed_output_has_line_markers);
+    RUN_TEST(test_streamed_output_is_written_in_chunks);
+    RUN_TEST(test_long_run_is_expanded_a_chunk_at_a_time);
+    RUN_TEST(test_dependencies_list_opened_headers);
+    RUN_TEST(test_dependencies_list_precompiled_headers);
+
+    return UNITY_END();
+}
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include "scan.h"
+
+#define BUFFER_SIZE 300
+
+typedef int (*ScanFn)(const char *source, int offset, int length);
+
+static const ScanFn SCANS[] = {
+    scan_whitespace,
+    scan_line_end,
+    scan_block_comment_end,
+    scan_string_body,
+};
+
+static const int SCAN_COUNT = sizeof(SCANS) / sizeof(SCANS[0]);
+
+void setUp() {}
+void tearDown() {
+    scan_set_level(SCAN_SCALAR);
+}
+
+// fills the buffer with bytes drawn from the alphabet, the alphabets are small
+// so every scan meets the bytes it stops on at many different offsets
+static void fill(char *buffer, int size, const char *alphabet, unsigned int *seed) {
+    int count = strlen(alphabet);
+    for (int i = 0; i < size; i++) {
+        *seed = *seed * 1103515245 + 12345;
+        buffer[i] = alphabet[(*seed >> 16) % count];
+    }
+}
+
+// runs every scan from every offset with every length and compares the
+// vectorized level against the scalar one
+static void compare_with_scalar(ScanLevel level, const char *alphabet) {
+    char buffer[BUFFER_SIZE];
+    unsigned int seed = 42;
+
+    for (int round = 0; round < 8; round++) {
+        fill(buffer, BUFFER_SIZE, alphabet, &seed);
+
+        for (int scan = 0; scan < SCAN_COUNT; scan++) {
+            for (int length = 0; length <= BUFFER_SIZE; length += 7) {
+                for (int offset = 0; offset <= length; offset++) {
+                    scan_set_level(SCAN_SCALAR);
+                    int expected = SCANS[scan](buffer, offset, length);
+
+                    scan_set_level(level);
+                    int actual = SCANS[scan](buffer, offset, length);
+
+                    TEST_ASSERT_EQUAL_INT(expected, actual);
+                }
+            }
+        }
+    }
+}
+
+void test_scalar_scans() {
+    scan_set_level(SCAN_SCALAR);
+
+    const char *source = "  \t\r\n x // note\n /* a * b **/ \"ab\\\"c\"";
+    int length = strlen(source);
+
+    TEST_ASSERT_EQUAL_INT(6, scan_whitespace(source, 0, length));
+    TEST_ASSERT_EQUAL_INT(15, scan_line_end(source, 8, length));
+    TEST_ASSERT_EQUAL_INT(27, scan_block_comment_end(source, 19, length));
+    TEST_ASSERT_EQUAL_INT(33, scan_string_body(source, 31, length));
+    TEST_ASSERT_EQUAL_INT(length, scan_line_end(source, 16, length));
+}
+
+void test_sse2_matches_scalar() {
+    if (!scan_set_level(SCAN_SSE2)) TEST_IGNORE_MESSAGE("sse2 not supported");
+
+    compare_with_scalar(SCAN_SSE2, " \t\n\r\v\fa*/\"\\");
+    compare_with_scalar(SCAN_SSE2, "       \n*");
+    compare_with_scalar(SCAN_SSE2, "abcdefgh/*\"");
+}
+
+void test_avx2_matches_scalar() {
+    if (!scan_set_level(SCAN_AVX2)) TEST_IGNORE_MESSAGE("avx2 not supported");
+
+    compare_with_scalar(SCAN_AVX2, " \t\n\r\v\fa*/\"\\");
+    compare_with_scalar(SCAN_AVX2, "       \n*");
+    compare_with_scalar(SCAN_AVX2, "abcdefgh/*\"");
+}
+
+void test_bytes_outside_ascii() {
+    char buffer[64];
+    for (int i = 0; i < 64; i++) buffer[i] = (char)(0x80 + i);
+
+    for (ScanLevel level = SCAN_SCALAR; level <= SCAN_AVX2; level++) {
+        if (!scan_set_level(level)) continue;
+
+        TEST_ASSERT_EQUAL_INT(0, scan_whitespace(buffer, 0, 64));
+        TEST_ASSERT_EQUAL_INT(64, scan_line_end(buffer, 0, 64));
+        TEST_ASSERT_EQUAL_INT(64, scan_string_body(buffer, 0, 64));
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_scalar_scans);
+    RUN_TEST(test_sse2_matches_scalar);
+    RUN_TEST(test_avx2_matches_scalar);
+    RUN_TEST(test_bytes_outside_ascii);
+
+    return UNITY_END();
+}
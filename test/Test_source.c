@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "unity.h"
+#include "source.h"
+#include "lexer.h"
+#include "lexer_tests.h"
+#include "ppd.h"
+
+#define TEST_FILE "build/test_source.c"
+
+void setUp() {}
+void tearDown() {
+    remove(TEST_FILE);
+    free_source_cache();
+}
+
+static void write_file(const char *content) {
+    FILE *fptr = fopen(TEST_FILE, "wb");
+    fwrite(content, 1, strlen(content), fptr);
+    fclose(fptr);
+}
+
+void test_open_source_file() {
+    write_file("int x = 42;");
+
+    SourceFile file;
+    TEST_ASSERT_TRUE(open_source_file(TEST_FILE, &file));
+    TEST_ASSERT_EQUAL_INT(11, file.length);
+    TEST_ASSERT_EQUAL_STRING_LEN("int x = 42;", file.data, file.length);
+
+    // the view is lexed in place, a number can end the source
+    Lexer *lexer = init_lexer_len(file.data, file.length - 1, 0);
+    tokenize(lexer);
+
+    TEST_ASSERT_TRUE(lexer->err == NO_LEXER_ERROR);
+    ASSERT_TOKEN(3, TOKEN_INTEGER_LITERAL, "42");
+    ASSERT_TOKEN(4, TOKEN_EOF, "");
+
+    free_lexer(lexer);
+    close_source_file(&file);
+}
+
+void test_open_empty_source_file() {
+    write_file("");
+
+    SourceFile file;
+    TEST_ASSERT_TRUE(open_source_file(TEST_FILE, &file));
+    TEST_ASSERT_EQUAL_INT(0, file.length);
+
+    close_source_file(&file);
+}
+
+void test_open_missing_source_file() {
+    SourceFile file;
+    TEST_ASSERT_FALSE(open_source_file("build/does_not_exist.c", &file));
+}
+
+void test_cached_source_is_shared_until_changed() {
+    write_file("int x;");
+
+    SourceFile first, second;
+    TEST_ASSERT_TRUE(open_cached_source_file(TEST_FILE, &first));
+    TEST_ASSERT_TRUE(open_cached_source_file(TEST_FILE, &second));
+    TEST_ASSERT_EQUAL_PTR(first.data, second.data);
+
+    // a new size means new contents
+    write_file("int longer;");
+    TEST_ASSERT_TRUE(open_cached_source_file(TEST_FILE, &second));
+    TEST_ASSERT_EQUAL_STRING_LEN("int longer;", second.data, second.length);
+
+    remove(TEST_FILE);
+    TEST_ASSERT_FALSE(open_cached_source_file(TEST_FILE, &second));
+}
+
+void test_identify_file_under_two_names() {
+    write_file("int x;");
+
+    FileId a, b;
+    TEST_ASSERT_TRUE(identify_source_file(TEST_FILE, &a));
+    TEST_ASSERT_TRUE(identify_source_file("build/../" TEST_FILE, &b));
+    TEST_ASSERT_TRUE(a.device == b.device && a.inode == b.inode);
+    TEST_ASSERT_FALSE(identify_source_file("build/does_not_exist.c", &a));
+
+    char *first = canonical_path(TEST_FILE);
+    char *second = canonical_path("build/../" TEST_FILE);
+    TEST_ASSERT_EQUAL_STRING(first, second);
+    TEST_ASSERT_NULL(canonical_path("build/does_not_exist.c"));
+
+    free(first);
+    free(second);
+}
+
+void test_preprocess_without_directives_is_not_copied() {
+    const char *source = "int main() { return 0; }";
+    int length;
+
+    const char *processed = preprocess(source, strlen(source), &length);
+
+    TEST_ASSERT_EQUAL_PTR(source, processed);
+    TEST_ASSERT_EQUAL_INT(strlen(source), length);
+}
+
+void test_preprocess_with_directives_is_rewritten() {
+    const char *source = "#define X 5\nint x = X;";
+    int length;
+
+    const char *processed = preprocess(source, strlen(source), &length);
+
+    TEST_ASSERT_TRUE(processed != source);
+    TEST_ASSERT_EQUAL_STRING("\nint x = 5;", processed);
+    TEST_ASSERT_EQUAL_INT(strlen(processed), length);
+
+    free((char *)processed);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_open_source_file);
+    RUN_TEST(test_open_empty_source_file);
+    RUN_TEST(test_open_missing_source_file);
+    RUN_TEST(test_cached_source_is_shared_until_changed);
+    RUN_TEST(test_identify_file_under_two_names);
+    RUN_TEST(test_preprocess_without_directives_is_not_copied);
+    RUN_TEST(test_preprocess_with_directives_is_rewritten);
+
+    return UNITY_END();
+}
@@ -1,8 +1,11 @@
 #ifndef LEXER_TESTS_H
 #define LEXER_TESTS_H
 
+#include <string.h>
+
 #define ASSERT_TOKEN(i, expected_type, expected_lexeme) \
-    TEST_ASSERT_EQUAL_INT(expected_type, lexer->tokens[i].type); \
-    TEST_ASSERT_EQUAL_STRING(expected_lexeme, lexer->tokens[i].lexeme);
+    TEST_ASSERT_EQUAL_INT(expected_type, lexer->tokens.types[i]); \
+    TEST_ASSERT_EQUAL_INT(strlen(expected_lexeme), lexer->tokens.lengths[i]); \
+    TEST_ASSERT_EQUAL_STRING_LEN(expected_lexeme, lexer->source + lexer->tokens.offsets[i], lexer->tokens.lengths[i]);
 
 #endif
\ No newline at end of file